@@ -19,6 +19,60 @@ async function fetchWithTimeout(url, options = {}, timeout = 5000) {
     }
 }
 
+// Value types (ValueType in sensor_interface.h)
+const VALUE_TYPES = [
+    [0, 'Temperature (°C)'], [1, 'Humidity (%)'], [2, 'Pressure (hPa)'], [3, 'Light (lx)'],
+    [4, 'Voltage (V)'], [5, 'Current (A)'], [6, 'Power (W)'], [7, 'Energy (Wh)'],
+    [8, 'Gas Resistance (Ω)'], [9, 'Battery (%)'], [10, 'Signal Strength (dBm)'],
+    [11, 'Moisture (%)'], [12, 'Generic']
+];
+const RULE_KINDS = [['above', 'Above'], ['below', 'Below'], ['rate', 'Changes faster than (/min)']];
+let ruleCapacity = 8;
+
+function optionsHtml(options, selected) {
+    return options.map(([value, label]) =>
+        `<option value="${value}"${String(value) === String(selected) ? ' selected' : ''}>${label}</option>`).join('');
+}
+
+function addRule(rule = { enabled: true, type: 1, kind: 'above', threshold: 0, hysteresis: 0 }) {
+    const body = document.getElementById('rulesBody');
+    if (body.rows.length >= ruleCapacity) {
+        showMessage(`At most ${ruleCapacity} rules`, 'error');
+        return;
+    }
+    const row = body.insertRow();
+    row.innerHTML = `
+        <td><select class="form-select form-select-sm rule-type" aria-label="Value type">${optionsHtml(VALUE_TYPES, rule.type)}</select></td>
+        <td><select class="form-select form-select-sm rule-kind" aria-label="Condition">${optionsHtml(RULE_KINDS, rule.kind)}</select></td>
+        <td><input type="number" class="form-control form-control-sm rule-threshold" step="any" value="${rule.threshold}" aria-label="Threshold"></td>
+        <td><input type="number" class="form-control form-control-sm rule-hysteresis" step="any" min="0" value="${rule.hysteresis}" aria-label="Hysteresis"></td>
+        <td><input type="checkbox" class="form-check-input rule-enabled" aria-label="Enabled"${rule.enabled ? ' checked' : ''}></td>
+        <td><button type="button" class="btn btn-sm btn-outline-danger" aria-label="Remove rule">✕</button></td>`;
+    row.querySelector('button').addEventListener('click', () => row.remove());
+}
+
+async function loadRules() {
+    try {
+        const response = await fetchWithTimeout('/api/alerts/rules');
+        const data = await response.json();
+        ruleCapacity = data.capacity || ruleCapacity;
+        document.getElementById('rulesBody').innerHTML = '';
+        (data.rules || []).forEach(rule => addRule(rule));
+    } catch (error) {
+        showMessage('Failed to load reading rules', 'error');
+    }
+}
+
+function collectRules() {
+    return Array.from(document.querySelectorAll('#rulesBody tr')).map(row => ({
+        enabled: row.querySelector('.rule-enabled').checked,
+        type: parseInt(row.querySelector('.rule-type').value),
+        kind: row.querySelector('.rule-kind').value,
+        threshold: parseFloat(row.querySelector('.rule-threshold').value) || 0,
+        hysteresis: parseFloat(row.querySelector('.rule-hysteresis').value) || 0
+    }));
+}
+
 // Load current configuration
 async function loadConfig() {
     try {
@@ -87,7 +141,15 @@ document.getElementById('alertsForm').addEventListener('submit', async (e) => {
         });
         
         const result = await response.json();
-        if (result.success) {
+        
+        const rulesResponse = await fetchWithTimeout('/api/alerts/rules', {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/json' },
+            body: JSON.stringify({ rules: collectRules() })
+        });
+        const rulesResult = await rulesResponse.json();
+        
+        if (result.success && rulesResult.success) {
             showMessage('Configuration saved successfully!', 'success');
         } else {
             showMessage('Failed to save configuration', 'error');
@@ -161,7 +223,8 @@ function showMessage(message, type) {
 document.addEventListener('DOMContentLoaded', () => {
     console.log('Alerts page loaded');
     // Small delay to let AsyncWebServer free up the connection used to serve this HTML
-    setTimeout(() => {
-        loadConfig();
+    setTimeout(async () => {
+        await loadConfig();
+        loadRules();
     }, 250);
 });
@@ -277,29 +277,19 @@ async function loadHistoricalData() {
         }
         
         // Update each chart with its specific metric
-        const labels = data.map(d => new Date(d.t * 1000).toLocaleTimeString());
+        // (multi-day ranges from the flash store need the date in the label)
+        const spanSec = data[data.length - 1].t - data[0].t;
+        const labels = data.map(d => spanSec > 86400
+            ? new Date(d.t * 1000).toLocaleString()
+            : new Date(d.t * 1000).toLocaleTimeString());
         
-        // Check which data fields exist in the response
-        // API only returns: t, batt, rssi, charging
-        const hasBatt = data.some(d => d.batt !== undefined && d.batt !== null);
-        const hasRssi = data.some(d => d.rssi !== undefined && d.rssi !== null);
-        
-        // Note: Historical data API currently only tracks battery and RSSI
-        // Other metrics (temp, humidity, etc.) are not stored in history
+        // Flash history (source: "flash") carries every sensor value; the RAM
+        // fallback only has t, batt, rssi, charging
+        const hasField = field => data.some(d => d[field] !== undefined && d[field] !== null);
         
         // Hide all charts that don't have data
-        const chartFields = [
-            { id: 'tempChart', field: 'temp', hasData: false },
-            { id: 'humidityChart', field: 'humidity', hasData: false },
-            { id: 'pressureChart', field: 'pressure', hasData: false },
-            { id: 'gasChart', field: 'gas', hasData: false },
-            { id: 'lightChart', field: 'light', hasData: false },
-            { id: 'voltageChart', field: 'voltage', hasData: false },
-            { id: 'currentChart', field: 'current', hasData: false },
-            { id: 'powerChart', field: 'power', hasData: false },
-            { id: 'battChart', field: 'batt', hasData: hasBatt },
-            { id: 'rssiChart', field: 'rssi', hasData: hasRssi }
-        ];
+        const chartFields = ['temp', 'humidity', 'pressure', 'gas', 'light', 'voltage', 'current', 'power', 'batt', 'rssi']
+            .map(field => ({ id: `${field}Chart`, field: field, hasData: hasField(field) }));
         
         chartFields.forEach(chart => {
             const canvas = document.getElementById(chart.id);
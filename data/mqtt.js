@@ -32,6 +32,7 @@ async function loadConfig() {
         document.getElementById('topicPrefix').value = config.topicPrefix;
         document.getElementById('haDiscovery').checked = config.haDiscovery;
         document.getElementById('qos').value = config.qos;
+        document.getElementById('publishMode').value = config.publishMode || 0;
     } catch (error) {
         showMessage('Failed to load configuration', 'error');
     }
@@ -62,7 +63,8 @@ document.getElementById('mqttForm').addEventListener('submit', async (e) => {
         password: document.getElementById('password').value,
         topicPrefix: document.getElementById('topicPrefix').value,
         haDiscovery: document.getElementById('haDiscovery').checked,
-        qos: parseInt(document.getElementById('qos').value)
+        qos: parseInt(document.getElementById('qos').value),
+        publishMode: parseInt(document.getElementById('publishMode').value)
     };
     
     try {
@@ -69,12 +69,58 @@
 // Packet Configuration
 #define SYNC_WORD                   0x1234
 
+// Sensors send compact v3 telemetry (no location/zone, varint/delta values).
+// Bases decode v1, v2 and v3 regardless of this setting.
+#ifndef TELEMETRY_PACKET_V3
+  #define TELEMETRY_PACKET_V3       1
+#endif
+
+// v3 keyframes carry the sensor clock so the base can spot unsynced or drifting
+// sensors. Bases older than this field reject such keyframes; set to 0 for them.
+#ifndef TELEMETRY_CLOCK_REPORT
+  #define TELEMETRY_CLOCK_REPORT    1
+#endif
+
+// Base station time sync: one broadcast beacon per NTP interval, then a unicast
+// CMD_TIME_SYNC only to sensors whose reported clock is unsynced or off by more
+// than TIME_SYNC_DRIFT_LIMIT_S
+#define TIME_VALID_EPOCH            1700000000UL  // Clocks before 2023-11 are not set
+#ifndef TIME_SYNC_DRIFT_LIMIT_S
+  #define TIME_SYNC_DRIFT_LIMIT_S   5
+#endif
+#define TIME_SYNC_FOLLOWUP_HOLDOFF_MS (10UL * 60 * 1000)  // Per sensor, between unicast resyncs
+#define TIME_BEACON_RETRY_MS        10000       // Radio busy or budget exhausted
+#define CLOCK_DRIFT_MIN_SPAN_MS     (30UL * 60 * 1000)  // Reports this far apart give a drift estimate
+
+// Base station RX pipeline (OnRxDone only enqueues; a task decodes/publishes)
+#define RX_QUEUE_DEPTH              16          // Raw frame slots (must be a power of two)
+#define RX_DECODE_TASK_STACK        8192        // Bytes
+#define RX_DECODE_TASK_PRIORITY     2
+#define RX_DECODE_TASK_CORE         0           // Arduino loop() runs on core 1
+
+// Base station MQTT task (owns the broker connection and drains the outbound queue)
+#define MQTT_TASK_STACK             6144        // Bytes
+#define MQTT_TASK_PRIORITY          1
+#define MQTT_TASK_CORE              0
+
+// Base station alert worker (formats and delivers Teams/email alerts off the main loop)
+#define ALERT_TASK_STACK            12288       // Bytes (TLS handshake and SMTP session)
+#define ALERT_TASK_PRIORITY         1
+#define ALERT_TASK_CORE             0
+
 // ============================================================================
 // SENSOR CONFIGURATION
 // ============================================================================
 #define SENSOR_ID                   1           // Change for each sensor
 #define SENSOR_INTERVAL             30000       // 30 seconds between transmissions
 #define BATTERY_SAMPLES             10          // Number of samples for battery average
+#define TIME_SYNC_INTERVAL_MS       (3UL * 60 * 60 * 1000)  // Sensor time sync request (3 hours, without keyframe clock reports)
+
+// Longest idle delay between sensor loop passes. The radio IRQ flag and the
+// button are polled, so this bounds their latency while the loop sleeps.
+#ifndef SENSOR_IDLE_SLEEP_MAX_MS
+  #define SENSOR_IDLE_SLEEP_MAX_MS  20
+#endif
 
 // Thermistor Configuration (10K NTC thermistor with 10K series resistor)
 #define THERMISTOR_NOMINAL          10000       // Nominal resistance at 25°C
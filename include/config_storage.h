@@ -57,37 +57,54 @@ struct NTPConfig {
 };
 
 // Configuration storage class
+// NVS is read once in begin() into a RAM snapshot; getters serve the snapshot and
+// setters write through to NVS and then refresh it. Hot paths (loop, RX decode)
+// should use the const reference accessors to avoid copying.
 class ConfigStorage {
 public:
     ConfigStorage();
     
-    // Initialize NVS
+    // Initialize NVS and load the RAM snapshot
     void begin();
     
     // Device mode
-    DeviceMode getDeviceMode();
+    DeviceMode getDeviceMode() const { return cachedMode; }
     void setDeviceMode(DeviceMode mode);
     
     // Sensor configuration
-    SensorConfig getSensorConfig();
+    SensorConfig getSensorConfig() const { return cachedSensor; }
+    const SensorConfig& getSensorConfigRef() const { return cachedSensor; }
     void setSensorConfig(const SensorConfig& config);
     
     // Base station configuration
-    BaseStationConfig getBaseStationConfig();
+    BaseStationConfig getBaseStationConfig() const { return cachedBase; }
+    const BaseStationConfig& getBaseStationConfigRef() const { return cachedBase; }
     void setBaseStationConfig(const BaseStationConfig& config);
 
     // NTP configuration
-    NTPConfig getNTPConfig();
+    NTPConfig getNTPConfig() const { return cachedNtp; }
+    const NTPConfig& getNTPConfigRef() const { return cachedNtp; }
     void setNTPConfig(const NTPConfig& cfg);
     
     // Factory reset
     void clearAll();
     
     // Check if first boot (unconfigured)
-    bool isFirstBoot();
+    bool isFirstBoot() const;
     
 private:
     Preferences prefs;
+    
+    // RAM snapshot of the "lora-config" namespace
+    DeviceMode cachedMode;
+    SensorConfig cachedSensor;
+    BaseStationConfig cachedBase;
+    NTPConfig cachedNtp;
+    
+    void loadAll();
+    void loadSensorConfig();
+    void loadBaseStationConfig();
+    void loadNTPConfig();
 };
 
 // Global instance
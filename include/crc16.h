@@ -0,0 +1,46 @@
+/**
+ * @file crc16.h
+ * @brief Table-driven CRC-16 shared by all LoRa packet types
+ *
+ * - CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF): telemetry, ACK and command frames
+ * - CRC-16/MODBUS (poly 0xA001 reflected, init 0xFFFF): pre-v2.19 command frames
+ *
+ * Lookup tables are generated at compile time and live in flash.
+ *
+ * @version 1.0.0
+ * @date 2026-10-16
+ */
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC16_INIT 0xFFFF
+
+/**
+ * @brief CRC-16/CCITT, one table lookup per byte
+ * @param crc Running CRC from a previous call (chain calls to cover non-contiguous fields)
+ */
+uint16_t crc16Ccitt(const uint8_t* data, size_t length, uint16_t crc = CRC16_INIT);
+
+/**
+ * @brief CRC-16/CCITT, slicing-by-4 (four independent lookups per 4 bytes)
+ *
+ * Same result as crc16Ccitt(); faster for anything longer than a few bytes.
+ */
+uint16_t crc16CcittSlice4(const uint8_t* data, size_t length, uint16_t crc = CRC16_INIT);
+
+/**
+ * @brief CRC-16/MODBUS, one table lookup per byte (legacy command checksum)
+ */
+uint16_t crc16Modbus(const uint8_t* data, size_t length, uint16_t crc = CRC16_INIT);
+
+/**
+ * @brief Check all variants against the standard "123456789" check values
+ * @return true if the tables are intact
+ */
+bool crc16SelfTest();
+
+#endif // CRC16_H
@@ -4,10 +4,34 @@
 #include <stdint.h>
 #include "sensor_interface.h"
 
+// ====== PROTOCOL VERSION BIT (v2.19+) ======
+// Frames checksummed with CRC-16/CCITT carry their family's sync word with bit 15
+// flipped. Unflipped frames keep the original checksum (additive for telemetry,
+// CRC-16/MODBUS for commands). Receivers accept both forms.
+#define SYNC_WORD_CRC16_FLIP    0x8000
+#define MULTI_SENSOR_SYNC_WORD  0xABCD
+
+#ifndef PROTOCOL_CRC16
+  #define PROTOCOL_CRC16        1   // Send CRC-16/CCITT frames
+#endif
+
+inline bool isSyncWord(uint16_t received, uint16_t syncWord) {
+    return received == syncWord || received == (uint16_t)(syncWord ^ SYNC_WORD_CRC16_FLIP);
+}
+
+inline bool isCrc16SyncWord(uint16_t received, uint16_t syncWord) {
+    return received == (uint16_t)(syncWord ^ SYNC_WORD_CRC16_FLIP);
+}
+
+// Sync word to put on outgoing frames of this family
+inline uint16_t txSyncWord(uint16_t syncWord) {
+    return PROTOCOL_CRC16 ? (uint16_t)(syncWord ^ SYNC_WORD_CRC16_FLIP) : syncWord;
+}
+
 // ====== LEGACY PACKET FORMAT (v1.x - v2.8) ======
 // Maintained for backward compatibility
 struct SensorData {
-  uint16_t syncWord;        // Packet validation
+  uint16_t syncWord;        // Packet validation (SYNC_WORD, bit 15 flipped = CRC-16)
   uint16_t networkId;       // Network ID for pairing (v2.11+)
   uint8_t sensorId;         // Client identifier (device with multiple sensors)
   float temperature;        // Temperature in Celsius
@@ -16,7 +40,7 @@ struct SensorData {
   bool powerState;          // Power state (charging/discharging)
   char location[32];        // Device location/name (v2.12+)
   char zone[16];            // Zone/group name (v2.12+)
-  uint16_t checksum;        // Simple checksum for validation
+  uint16_t checksum;        // Additive or CRC-16/CCITT, selected by syncWord
 };
 
 // ====== NEW VARIABLE-LENGTH PACKET FORMAT (v2.9+) ======
@@ -28,14 +52,15 @@ enum PacketType {
     PACKET_LEGACY = 0,      // Old SensorData format (backward compatible)
     PACKET_MULTI_SENSOR = 1, // New variable-length format
     PACKET_CONFIG = 2,      // Configuration packets
-    PACKET_ACK = 3          // Acknowledgment packets
+    PACKET_ACK = 3,         // Acknowledgment packets (base -> sensor telemetry ACK)
+    PACKET_MULTI_SENSOR_V3 = 4  // Compact varint/delta format (v3)
 };
 
 /**
  * @brief Packet header for multi-sensor data
  */
 struct MultiSensorHeader {
-    uint16_t syncWord;      // 0xABCD for validation
+    uint16_t syncWord;      // 0xABCD for validation (bit 15 flipped = CRC-16)
     uint16_t networkId;     // Network ID for pairing (v2.11+)
     uint8_t packetType;     // PacketType enum
     uint8_t sensorId;       // Node ID (which device is sending)
@@ -70,13 +95,101 @@ struct MultiSensorPacket {
 #define MAX_VALUES_PER_PACKET 16
 #define MAX_PACKET_SIZE 255
 
+// ====== COMPACT PACKET FORMAT (v3) ======
+// Layout: MultiSensorHeaderV3 [+ clock if V3_FLAG_CLOCK] [+ refSeq if V3_FLAG_DELTA] + values + checksum
+// Absolute value: type byte + zigzag varint of the fixed-point reading
+// Delta value:    zigzag varint of (reading - reference), types taken from the reference
+// Location/zone are not sent; the base station uses its own sensor metadata.
+// v3 frames and TelemetryAckPackets always use CRC-16/CCITT (no version bit).
+
+#define V3_FLAG_POWER_STATE  0x01  // Charging
+#define V3_FLAG_DELTA        0x02  // Values are deltas against the frame in refSeq
+#define V3_FLAG_ACK_REQ      0x04  // Keyframe: base should reply with a TelemetryAckPacket
+#define V3_FLAG_CLOCK        0x08  // Sensor clock follows the header (uint32 local seconds, 0 = never synced)
+
+// Sensors send an absolute keyframe at least this often, so a base that lost its
+// reference (reboot, missed ACK) resynchronises quickly
+#define V3_KEYFRAME_INTERVAL 16
+
+/**
+ * @brief Header for compact v3 multi-sensor packets (12 bytes)
+ * Field offsets up to packetType match MultiSensorHeader so receivers can dispatch on it.
+ */
+struct MultiSensorHeaderV3 {
+    uint16_t syncWord;      // 0xABCD for validation
+    uint16_t networkId;     // Network ID for pairing
+    uint8_t packetType;     // PACKET_MULTI_SENSOR_V3
+    uint8_t sensorId;       // Node ID
+    uint8_t valueCount;     // Number of sensor values in this packet
+    uint8_t batteryPercent; // Battery percentage
+    uint8_t flags;          // V3_FLAG_*
+    uint8_t lastCommandSeq; // Sequence number of last processed command (0 = none)
+    uint8_t ackStatus;      // ACK status: 0 = success, non-zero = error code
+    uint8_t frameSeq;       // Telemetry frame counter (wraps)
+} __attribute__((packed));
+
+/**
+ * @brief Base -> sensor acknowledgment of a v3 keyframe
+ * After receiving it the sensor may send deltas against that keyframe.
+ */
+struct TelemetryAckPacket {
+    uint16_t syncWord;      // 0xABCD
+    uint16_t networkId;
+    uint8_t packetType;     // PACKET_ACK
+    uint8_t sensorId;       // Sensor being acknowledged
+    uint8_t frameSeq;       // Keyframe being acknowledged
+    uint16_t checksum;      // CRC-16/CCITT
+} __attribute__((packed));
+
+/**
+ * @brief Quantized values of an acknowledged keyframe (delta reference)
+ */
+struct TelemetryReferenceV3 {
+    bool valid;
+    uint8_t frameSeq;
+    uint8_t valueCount;
+    uint8_t types[MAX_VALUES_PER_PACKET];
+    int32_t quantized[MAX_VALUES_PER_PACKET];
+};
+
+// Size of the same readings in the v2 (MultiSensorPacket) wire format
+#define MULTI_SENSOR_V2_SIZE(valueCount) \
+    (sizeof(MultiSensorHeader) + (valueCount) * sizeof(SensorValuePacket) + sizeof(uint16_t))
+
 // Utility functions
+// Checksums follow the frame's sync word: CRC-16/CCITT if the version bit is set,
+// otherwise the original additive sum.
 uint16_t calculateChecksum(SensorData* data);
 bool validateChecksum(SensorData* data);
 
 // New utility functions for multi-sensor packets
+// Covers the header and the first valueCount values exactly as they appear on air
 uint16_t calculateMultiSensorChecksum(MultiSensorPacket* packet);
 bool validateMultiSensorChecksum(MultiSensorPacket* packet);
 size_t getMultiSensorPacketSize(MultiSensorPacket* packet);
 
+// Compact v3 packets
+// NaN readings are sent as the "no reading" value used for absent temperatures
+#define SENSOR_NO_READING -127.0f
+int32_t quantizeSensorValue(uint8_t type, float value);
+float dequantizeSensorValue(uint8_t type, int32_t quantized);
+void makeTelemetryReferenceV3(const MultiSensorPacket* packet, uint8_t frameSeq, TelemetryReferenceV3* ref);
+
+// Encodes packet into out. If ref is valid and matches the value layout, a delta
+// frame is produced; a non-null clock is sent with V3_FLAG_CLOCK. Returns the
+// encoded size, or 0 if out is too small.
+size_t encodeMultiSensorV3(const MultiSensorPacket* packet, uint8_t frameSeq, bool ackRequest,
+                           const TelemetryReferenceV3* ref, uint8_t* out, size_t outSize,
+                           const uint32_t* clock = nullptr);
+
+// Decodes a v3 frame into packet (location/zone left empty). Delta frames need
+// the matching reference; returns false on malformed frames, bad checksum or
+// reference mismatch. refMissing is set when only the reference was the problem.
+// clock receives the sensor clock when flags has V3_FLAG_CLOCK.
+bool decodeMultiSensorV3(const uint8_t* buf, size_t len, const TelemetryReferenceV3* ref,
+                         MultiSensorPacket* packet, uint8_t* frameSeq, uint8_t* flags,
+                         bool* refMissing, uint32_t* clock = nullptr);
+
+uint16_t calculateTelemetryAckChecksum(const TelemetryAckPacket* ack);
+
 #endif // DATA_TYPES_H
@@ -11,6 +11,12 @@ void setLED(uint32_t color, uint8_t brightness = 255);
 void setLEDColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t brightness = 255);
 void blinkLED(uint32_t color, int times = 1, int delayMs = 100);
 
+// Non-blocking blink for other tasks (e.g. RX decode): only records the request,
+// serviceLED() plays it from the main loop and then shows restColor. A new
+// request replaces one still playing.
+void requestLEDBlink(uint32_t color, uint8_t times, uint16_t intervalMs, uint32_t restColor);
+void serviceLED();
+
 // LED color definitions
 uint32_t getColorOff();
 uint32_t getColorGreen();
@@ -20,18 +20,67 @@ void OnRxError();
 
 // LoRa communication functions
 void sendSensorData(const SensorData& data);
+bool sendFrame(const uint8_t* frame, size_t size);  // Radio.Send, sealed with AES-CCM when encryption is on
 void enterRxMode();
 
 #ifdef BASE_STATION
 void handlePendingWebSocketBroadcast();  // Handle WebSocket broadcast from main loop
 void handlePendingCommandSend();  // Send scheduled command after RX hold-down
-void checkCommandRetries();  // Maintain retry timers (does NOT force-send)
+void checkCommandRetries();  // Schedule a send for a queued command nobody picked up (run every second)
 void sendBroadcastWakePing();  // Send a broadcast ping that wakes client displays (no ACK expected)
+bool sendTimeBeacon();  // Broadcast CMD_TIME_SYNC to all sensors (no ACK); false if not sent
+
+// RX pipeline counters (OnRxDone enqueues raw frames, decode task drains them)
+struct RxQueueStats {
+  uint16_t depth;      // Frames currently waiting for decode
+  uint16_t capacity;   // RX_QUEUE_DEPTH
+  uint16_t highWater;  // Deepest the queue has been since boot
+  uint32_t drops;      // Frames dropped because the queue was full
+  uint32_t enqueued;
+  uint32_t processed;
+};
+void getRxQueueStats(RxQueueStats& out);
+
+// Telemetry size/airtime comparison (last frame per sensor vs. v2 and v3 encodings)
+struct PacketEfficiency {
+  uint8_t format;        // PacketType actually received
+  uint8_t valueCount;
+  uint16_t bytes;        // On-air size of the received frame
+  uint16_t v2Bytes;      // Same readings as a v2 MultiSensorPacket
+  uint16_t v3Bytes;      // Same readings as a v3 keyframe
+  uint16_t airtimeMs;
+  uint16_t v2AirtimeMs;
+  uint16_t v3AirtimeMs;
+};
+struct PacketEfficiencyTotals {
+  uint32_t packets;
+  uint32_t bytes;
+  uint32_t v2Bytes;
+  uint32_t airtimeMs;
+  uint32_t v2AirtimeMs;
+  uint32_t v3ReferenceMisses;  // Delta frames dropped for lack of a matching keyframe
+  uint32_t v3AcksSent;         // Keyframe ACKs transmitted
+};
+bool getPacketEfficiency(uint8_t sensorId, PacketEfficiency& out);  // false if nothing received yet
+void getPacketEfficiencyTotals(PacketEfficiencyTotals& out);
+
+// Command frame airtime: short form vs. a fixed sizeof(CommandPacket) frame
+struct CommandAirtime {
+  uint32_t sent;            // Command frames transmitted (including retries)
+  uint16_t lastBytes;       // On-air size of the last command frame
+  uint16_t lastAirtimeMs;
+  uint16_t lastSavedMs;     // Airtime saved by the last frame
+  uint32_t totalSavedMs;
+};
+bool getCommandAirtime(uint8_t sensorId, CommandAirtime& out);  // false if nothing sent yet
+void getCommandAirtimeTotals(CommandAirtime& out);
 #endif
 
 #ifdef SENSOR_NODE
 bool shouldSendImmediateAck();  // Check if immediate ACK telemetry should be sent
 uint32_t getEffectiveTransmitInterval(uint32_t configuredInterval);  // Get effective interval (may be forced after command)
+size_t buildTelemetryFrameV3(const MultiSensorPacket& packet, uint8_t* out, size_t outSize);  // Keyframe or delta
+bool sendTelemetryFrame(const uint8_t* frame, size_t size);  // Via the mesh when enabled, else direct
 #endif
 
 #endif // LORA_COMM_H
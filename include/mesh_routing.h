@@ -17,11 +17,17 @@
 
 #include <Arduino.h>
 #include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "data_types.h"
+#include "config.h"
 
 // Maximum hops before packet is dropped
 #define MAX_HOPS 5
 
+// Node ID the base station uses on the mesh
+#define MESH_BASE_STATION_ID 1
+
 // Maximum routing table entries
 #define MAX_ROUTES 32
 
@@ -34,6 +40,82 @@
 // Neighbor beacon interval (30 seconds)
 #define NEIGHBOR_BEACON_INTERVAL_MS 30000
 
+// RREQ rebroadcasts after the first before buffered packets are dropped
+// (each retry waits twice as long as the one before)
+#ifndef MESH_RREQ_RETRIES
+  #define MESH_RREQ_RETRIES 2
+#endif
+
+// Destinations with a route discovery in flight
+#ifndef MESH_MAX_DISCOVERIES
+  #define MESH_MAX_DISCOVERIES 4
+#endif
+
+// Outbound payloads held while their route is being discovered
+#ifndef MESH_PENDING_SLOTS
+  #define MESH_PENDING_SLOTS 4
+#endif
+
+// Largest payload carried behind a MeshHeader
+#ifndef MESH_MAX_PAYLOAD
+  #define MESH_MAX_PAYLOAD 200
+#endif
+
+// Frames waiting for the radio (own packets, relays, RREQ/RREP, beacons)
+#ifndef MESH_TX_QUEUE_DEPTH
+  #define MESH_TX_QUEUE_DEPTH 8
+#endif
+
+// Relayed and flooded frames wait a random 0..N ms so neighbours that heard
+// the same frame do not all transmit at once
+#ifndef MESH_REBROADCAST_JITTER_MS
+  #define MESH_REBROADCAST_JITTER_MS 250
+#endif
+
+// A queued frame the radio could not take within this long is dropped
+#ifndef MESH_TX_MAX_WAIT_MS
+  #define MESH_TX_MAX_WAIT_MS 3000
+#endif
+
+#define MESH_MAX_FRAME (sizeof(MeshHeader) + MESH_MAX_PAYLOAD)
+
+// Link and path costs are ETX (expected transmissions per delivered frame) x 100
+#define MESH_COST_SCALE 100
+#define MESH_COST_UNREACHABLE 0xFFFF
+
+// Weight of the newest sample in the per-neighbour delivery ratio and SNR averages
+#ifndef MESH_LINK_EWMA_ALPHA
+  #define MESH_LINK_EWMA_ALPHA 0.2f
+#endif
+
+// Delivery ratio assumed for a neighbour whose beacons we have not heard yet
+#ifndef MESH_LINK_DEFAULT_RATIO
+  #define MESH_LINK_DEFAULT_RATIO 0.7f
+#endif
+
+// Demodulation floor for the configured spreading factor (SX126x: SF7 -7.5 dB ... SF12 -20 dB)
+#ifndef MESH_SNR_FLOOR_DB
+  #define MESH_SNR_FLOOR_DB (-2.5f * (LORA_SPREADING_FACTOR - 4))
+#endif
+
+// Links with less SNR margin than this above the floor get a cost penalty
+// (up to 2x at zero margin) since they are the first to fail on a fade
+#ifndef MESH_SNR_MARGIN_DB
+  #define MESH_SNR_MARGIN_DB 10.0f
+#endif
+
+// A new next hop must be this much cheaper before an existing route switches
+#ifndef MESH_ROUTE_SWITCH_PERCENT
+  #define MESH_ROUTE_SWITCH_PERCENT 10
+#endif
+
+// Duplicate suppression keeps, per source, the newest sequence number and a
+// bitmap of the 32 before it. A sequence number further behind than this is
+// taken as the source having rebooted rather than a late copy.
+#ifndef MESH_SEEN_RESTART_GAP
+  #define MESH_SEEN_RESTART_GAP 1024
+#endif
+
 /**
  * @brief Mesh packet types
  */
@@ -67,6 +149,7 @@ struct RouteRequest {
     uint8_t destId;             // Who we're looking for
     uint8_t hopCount;           // Hops from source
     uint16_t requestId;         // Unique RREQ identifier
+    uint16_t pathCost;          // ETX x100 from source to the sender
 } __attribute__((packed));
 
 /**
@@ -77,6 +160,7 @@ struct RouteReply {
     uint8_t destId;             // Destination of original request
     uint8_t hopCount;           // Hops to destination
     uint16_t requestId;         // Matching RREQ identifier
+    uint16_t pathCost;          // ETX x100 from the sender to destination
 } __attribute__((packed));
 
 /**
@@ -87,6 +171,7 @@ struct NeighborBeacon {
     uint8_t neighborId;         // Who is sending beacon
     int16_t rssi;               // Signal strength
     uint8_t hopDistance;        // Hops to base station
+    uint16_t baseCost;          // ETX x100 to base station (MESH_COST_UNREACHABLE if none)
 } __attribute__((packed));
 
 /**
@@ -98,6 +183,7 @@ struct RouteEntry {
     uint8_t hopCount;           // Number of hops to destination
     uint32_t lastUsed;          // Timestamp of last use
     int16_t linkQuality;        // RSSI or similar metric
+    uint16_t cost;              // Path ETX x100 (next-hop selection)
     bool isValid;               // Entry is active
 };
 
@@ -110,8 +196,22 @@ struct Neighbor {
     uint32_t lastSeen;          // Last beacon timestamp
     uint8_t hopDistance;        // Hops to base station
     bool isActive;              // Neighbor is reachable
+    float deliveryRatio;        // EWMA of beacons received vs. expected
+    float snr;                  // EWMA of SNR over all frames heard (dB)
+    uint32_t lastBeacon;        // millis() of the last beacon
+    uint16_t baseCost;          // Advertised ETX x100 to base station
 };
 
+/**
+ * @brief Radio hook used to put a mesh frame on air
+ *
+ * The router never touches the radio directly, so several routers can run in
+ * one process against a simulated channel; context tells them apart.
+ *
+ * @return false if the radio cannot take the frame now (it is retried later)
+ */
+typedef bool (*MeshTransmitFn)(void* context, const uint8_t* frame, size_t size);
+
 /**
  * @brief Mesh routing manager
  * 
@@ -127,30 +227,37 @@ public:
     
     // Initialization
     void begin(uint8_t nodeId, bool isBaseStation = false);
+    void setTransmitter(MeshTransmitFn fn, void* context = nullptr) {
+        transmitter = fn;
+        transmitterContext = context;
+    }
     
-    // Packet handling
-    bool sendPacket(uint8_t destId, uint8_t* payload, size_t payloadSize);
+    // Packet handling (never blocks: without a route the payload is held
+    // while loop() runs discovery; returns false only if it cannot be held)
+    bool sendPacket(uint8_t destId, const uint8_t* payload, size_t payloadSize);
     bool forwardPacket(MeshHeader* header, uint8_t* payload, size_t payloadSize);
-    void processReceivedPacket(uint8_t* packet, size_t packetSize, int16_t rssi);
+    // Returns true for a data frame addressed to this node, first copy only
+    bool processReceivedPacket(uint8_t* packet, size_t packetSize, int16_t rssi, int8_t snr = 0);
     
     // Route management
     bool hasRouteTo(uint8_t destId);
     RouteEntry* getRoute(uint8_t destId);
-    void addRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount);
+    void addRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount, uint16_t cost);
     void removeRoute(uint8_t destId);
-    void updateRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount, int16_t rssi);
+    void updateRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount, uint16_t cost, int16_t rssi);
     void cleanupExpiredRoutes();
     
     // Route discovery
     bool discoverRoute(uint8_t destId);
     void sendRouteRequest(uint8_t destId);
-    void processRouteRequest(RouteRequest* rreq, int16_t rssi);
-    void processRouteReply(RouteReply* rrep);
+    void processRouteRequest(RouteRequest* rreq, int8_t snr);
+    void processRouteReply(RouteReply* rrep, int8_t snr);
     
     // Neighbor management
     void sendNeighborBeacon();
-    void processNeighborBeacon(NeighborBeacon* beacon, int16_t rssi);
+    void processNeighborBeacon(NeighborBeacon* beacon, int16_t rssi, int8_t snr);
     Neighbor* getNeighbor(uint8_t nodeId);
+    uint16_t getLinkCost(uint8_t neighborId, int8_t snrHint);
     void cleanupExpiredNeighbors();
     std::vector<Neighbor>& getNeighbors() { return neighbors; }
     
@@ -182,25 +289,78 @@ private:
     uint32_t lastBeaconTime;
     uint32_t lastRouteCleanup;
     uint32_t lastNeighborCleanup;
+    uint32_t lastSeenCleanup;
     
     // Statistics
     uint32_t packetsForwarded;
     uint32_t packetsDropped;
     uint32_t routeDiscoveries;
+    uint32_t framesSent;
+    
+    // Route discovery in flight for one destination
+    struct Discovery {
+        bool active;
+        uint8_t destId;
+        uint8_t retries;            // RREQs sent after the first
+        uint32_t deadline;          // millis() at which to retry or give up
+    };
+    Discovery discoveries[MESH_MAX_DISCOVERIES];
+    
+    // Payload waiting for a route
+    struct PendingPacket {
+        bool used;
+        uint8_t destId;
+        uint16_t size;
+        uint8_t payload[MESH_MAX_PAYLOAD];
+    };
+    PendingPacket pending[MESH_PENDING_SLOTS];
+    
+    // Frame waiting for the radio
+    struct TxFrame {
+        bool used;
+        uint32_t dueAt;             // Earliest send time (jitter applied)
+        uint16_t size;
+        uint8_t data[MESH_MAX_FRAME];
+    };
+    TxFrame txQueue[MESH_TX_QUEUE_DEPTH];
+    
+    MeshTransmitFn transmitter;
+    void* transmitterContext;
+    
+    // Guards tables and queues (RX decode task vs. main loop on the base)
+    SemaphoreHandle_t mutex;
+    inline bool lock(TickType_t ticksToWait) {
+        return (mutex == nullptr) || (xSemaphoreTake(mutex, ticksToWait) == pdTRUE);
+    }
+    inline void unlock() {
+        if (mutex != nullptr) {
+            xSemaphoreGive(mutex);
+        }
+    }
+    
+    bool queueFrame(const MeshHeader* header, const uint8_t* payload, size_t payloadSize, uint16_t jitterMs);
+    void serviceTxQueue(uint32_t now);
+    void serviceDiscoveries(uint32_t now);
+    void flushPending(uint8_t destId);
+    void dropPending(uint8_t destId);
+    Discovery* findDiscovery(uint8_t destId);
     
     // Helper functions
     bool isPacketDuplicate(uint8_t sourceId, uint16_t seqNum);
     void updateSeenPackets(uint8_t sourceId, uint16_t seqNum);
     uint16_t getNextSequenceNumber();
     uint16_t getNextRequestId();
+    float effectiveDeliveryRatio(const Neighbor& neighbor, uint32_t now) const;
+    void observeLink(uint8_t neighborId, int16_t rssi, int8_t snr);
     
-    // Duplicate packet tracking (simple cache)
-    struct PacketId {
-        uint8_t sourceId;
-        uint16_t seqNum;
-        uint32_t timestamp;
+    // Duplicate packet tracking: sliding window per source ID (no allocation)
+    struct SeenWindow {
+        uint32_t lastSeen;          // millis() of the last recorded frame
+        uint32_t bitmap;            // Bit n = (newest - n) was seen
+        uint16_t newest;            // Highest sequence number seen
+        bool active;
     };
-    std::vector<PacketId> seenPackets;
+    SeenWindow seenWindows[256];
     void cleanupSeenPackets();
 };
 
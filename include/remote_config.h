@@ -2,9 +2,9 @@
 #define REMOTE_CONFIG_H
 
 #include <Arduino.h>
-#include <queue>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "timer_wheel.h"
 
 // Command types for remote configuration
 enum CommandType : uint8_t {
@@ -27,13 +27,13 @@ enum CommandType : uint8_t {
 
 // Command packet structure (max 200 bytes to fit within LoRa SF10 limit)
 struct __attribute__((packed)) CommandPacket {
-    uint16_t syncWord;            // 0xCDEF for command packets
+    uint16_t syncWord;            // 0xCDEF for command packets (bit 15 flipped = CRC-16/CCITT)
     uint8_t commandType;          // CommandType enum
     uint8_t targetSensorId;       // Target sensor/client ID
     uint8_t sequenceNumber;       // For tracking ACKs
     uint8_t dataLength;           // Length of payload data
     uint8_t data[192];            // Command-specific payload (reduced to fit SF10 limit)
-    uint16_t checksum;            // CRC16 checksum
+    uint16_t checksum;            // CRC-16/MODBUS or CRC-16/CCITT, selected by syncWord
 };
 
 // ACK/NACK response structure
@@ -48,14 +48,38 @@ struct __attribute__((packed)) AckPacket {
     uint16_t checksum;
 };
 
-// Queued command with retry logic
+// Command store sizing. Queued commands for all sensors share one slab of
+// COMMAND_POOL_SIZE entries; payloads are stored at their real dataLength in
+// COMMAND_CHUNK_SIZE-byte chunks instead of a 192-byte buffer per command.
+#ifndef COMMAND_POOL_SIZE
+  #define COMMAND_POOL_SIZE       48
+#endif
+#ifndef COMMAND_CHUNK_SIZE
+  #define COMMAND_CHUNK_SIZE      16
+#endif
+#ifndef COMMAND_CHUNK_COUNT
+  #define COMMAND_CHUNK_COUNT     96      // 1.5 KB of payload
+#endif
+// Sensors whose command state (queue, last sent/ACKed/failed) is tracked at once;
+// an idle sensor's slot is reused when a new sensor needs one
+#ifndef COMMAND_SENSOR_SLOTS
+  #define COMMAND_SENSOR_SLOTS    32
+#endif
+#define COMMAND_NONE              0xFF    // Null index for pool links
+
+// Queued command with retry logic. The packet header is rebuilt when the
+// command is copied out; the payload lives in a chain of pool chunks.
 struct QueuedCommand {
-    CommandPacket packet;
+    uint8_t commandType;
+    uint8_t sequenceNumber;
+    uint8_t dataLength;
     uint8_t retryCount;
+    uint8_t next;                 // Next command for the same sensor (free list when unused)
+    uint8_t firstChunk;           // Payload chunk chain, COMMAND_NONE if dataLength == 0
+    bool waitingForAck;
     uint32_t queuedAt;
     uint32_t lastAttempt;
     uint32_t timeout;
-    bool waitingForAck;
 };
 
 // Failed command tracking
@@ -66,7 +90,24 @@ struct FailedCommand {
     uint8_t reason;  // 0=timeout, 1=NACK
 };
 
+// Command store usage for /api/stats
+struct CommandPoolStats {
+    uint8_t queued;
+    uint8_t capacity;
+    uint16_t payloadBytes;        // Chunk bytes in use
+    uint16_t payloadCapacity;
+    uint8_t activeSensors;        // Sensors with at least one queued command
+    uint8_t trackedSensors;       // Sensors holding a slot
+    uint32_t rejected;            // queueCommand() calls refused because the store was full
+};
+
 #define COMMAND_SYNC_WORD 0xCDEF
+
+// On-air command frame: header + dataLength bytes of data + checksum.
+// CRC-16 frames (sync word version bit set) are sent in this short form; legacy
+// frames keep the full sizeof(CommandPacket) layout expected by pre-v2.19 sensors.
+#define COMMAND_HEADER_SIZE offsetof(CommandPacket, data)
+#define COMMAND_FRAME_SIZE(dataLength) (COMMAND_HEADER_SIZE + (dataLength) + sizeof(uint16_t))
 #define MAX_RETRY_COUNT 3
 #define COMMAND_TIMEOUT_MS 12000  // 12 seconds
 
@@ -81,6 +122,10 @@ public:
     // Get next pending command for a sensor (returns false if none)
     // Copies the packet out so callers don't hold pointers into the queue across threads/cores.
     bool getPendingCommand(uint8_t sensorId, CommandPacket& outPacket);
+
+    // Copy the command getPendingCommand() would return, without marking it sent
+    // (lets the caller check the airtime budget first)
+    bool peekPendingCommand(uint8_t sensorId, CommandPacket& outPacket);
     
     // Mark command as acknowledged
     void markCommandAcked(uint8_t sensorId, uint8_t sequenceNumber);
@@ -94,9 +139,6 @@ public:
     // Handle ACK embedded in telemetry packet (new piggyback method)
     void handleAck(uint8_t sensorId, uint8_t sequenceNumber, uint8_t status);
     
-    // Check for commands that need retry
-    void processRetries();
-    
     // Clear all pending commands for a sensor
     void clearCommands(uint8_t sensorId);
     
@@ -119,9 +161,24 @@ public:
 
     // Get last ACK/NACK observed from device (piggyback or explicit).
     bool getLastAckedCommand(uint8_t sensorId, uint8_t& commandType, uint8_t& seqNum, uint8_t& statusCode, uint32_t& ageMs);
+
+    // Find a sensor whose next command has not been sent yet. Walks only the
+    // sensors that have queued commands.
+    bool findUnsentCommand(uint8_t& sensorId);
+
+    void getPoolStats(CommandPoolStats& out);
     
-    // Checksum calculation (public for sensor use)
+    // Checksum calculation (public for sensor use); data must start with the sync word
     uint16_t calculateChecksum(const uint8_t* data, size_t length);
+
+    // Serialize cmd for transmission and fill in its checksum.
+    // Returns the frame size, or 0 if out is too small or dataLength is invalid.
+    size_t encodeCommandFrame(CommandPacket& cmd, uint8_t* out, size_t outSize);
+
+    // Parse a received command frame (short or full form) into cmd; the trailing
+    // checksum is copied to cmd.checksum but not validated. Returns false if the
+    // frame is not a command or its length does not match dataLength.
+    bool parseCommandFrame(const uint8_t* frame, size_t size, CommandPacket& cmd);
     
 private:
     SemaphoreHandle_t mutex = nullptr;
@@ -136,9 +193,6 @@ private:
         }
     }
 
-    std::queue<QueuedCommand> commandQueues[256]; // One queue per sensor ID
-    FailedCommand lastFailedCommand[256];          // Track last failed command per sensor
-
     struct CommandEvent {
         uint8_t commandType;
         uint8_t sequenceNumber;
@@ -146,10 +200,50 @@ private:
         uint32_t atMs;        // millis() when event occurred
     };
 
-    CommandEvent lastSentCommand[256];
-    CommandEvent lastAckedCommand[256];
+    // Command state of one sensor. Slots with queued commands are linked into
+    // the active list, so retry and kick scans are O(sensors with work).
+    struct SensorSlot {
+        uint8_t sensorId = 0;
+        uint8_t head = COMMAND_NONE;        // Oldest queued command (COMMAND_NONE = empty)
+        uint8_t tail = COMMAND_NONE;
+        uint8_t count = 0;
+        uint8_t activeNext = COMMAND_NONE;  // Active list links (slot indices)
+        uint8_t activePrev = COMMAND_NONE;
+        FailedCommand lastFailed;
+        CommandEvent lastSent;
+        CommandEvent lastAcked;
+        TimerNode ackTimer;                 // ACK deadline of the in-flight command
+    };
+
+    QueuedCommand commands[COMMAND_POOL_SIZE];
+    uint8_t chunks[COMMAND_CHUNK_COUNT][COMMAND_CHUNK_SIZE];
+    uint8_t chunkNext[COMMAND_CHUNK_COUNT];
+    uint8_t freeCommand = COMMAND_NONE;     // Free lists, filled by init() (COMMAND_NONE = exhausted)
+    uint8_t freeChunk = COMMAND_NONE;
+    uint8_t commandsUsed = 0;
+    uint8_t chunksUsed = 0;
+    uint32_t rejectedCount = 0;
+
+    SensorSlot slots[COMMAND_SENSOR_SLOTS];
+    uint8_t slotOf[256] = {};               // Sensor ID -> slot index + 1, 0 = no slot
+    uint8_t slotsUsed = 0;
+    uint8_t activeHead = COMMAND_NONE;      // First slot with queued commands
 
     uint8_t nextSequenceNumber;
+
+    // Pool and slot helpers (lock held)
+    SensorSlot* findSlot(uint8_t sensorId);
+    SensorSlot* claimSlot(uint8_t sensorId);
+    uint8_t allocCommand(const uint8_t* data, uint8_t dataLen);
+    void releaseCommand(uint8_t index);
+    void pushCommand(SensorSlot& slot, uint8_t index);
+    void popCommand(SensorSlot& slot);
+    void copyPacket(const SensorSlot& slot, const QueuedCommand& cmd, CommandPacket& out);
+
+    // ACK wait expired: count a retry; drops the command after MAX_RETRY_COUNT
+    // and returns true (lock held)
+    bool expireAckWait(SensorSlot& slot);
+    static void onAckTimeout(TimerNode* node, void* context);
 };
 
 // Helper functions for creating specific commands
@@ -4,6 +4,15 @@
 #include <Arduino.h>
 #include <Preferences.h>
 #include "config_storage.h"  // For SensorPriority enum
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "timer_wheel.h"
+
+// Health counters live in RAM and are checkpointed to NVS ("sensor-health",
+// one blob per sensor) on this interval and before an orderly reboot.
+#ifndef HEALTH_CHECKPOINT_INTERVAL_SEC
+#define HEALTH_CHECKPOINT_INTERVAL_SEC 900  // 15 minutes
+#endif
 
 // Sensor health scoring
 struct SensorHealthScore {
@@ -17,6 +26,16 @@ struct SensorHealthScore {
     uint16_t failedPackets;          // Failed/lost packets
 };
 
+// Raw health counters per sensor (RAM table entry and NVS checkpoint blob)
+struct SensorHealthRecord {
+    uint16_t totalPackets;
+    uint16_t failedPackets;
+    uint32_t uptimeSeconds;
+    uint32_t lastSeen;        // millis() of last contact
+    float batteryVoltage;
+    float temperature;
+};
+
 /**
  * @brief Sensor metadata stored on base station
  */
@@ -63,23 +82,65 @@ public:
     // Clear sensor configuration
     bool clearSensorMetadata(uint8_t sensorId);
     
-    // Health score management
+    // Health score management (RAM only; see checkpointHealthScores)
     void updateHealthScore(uint8_t sensorId, bool packetSuccess, float batteryVoltage, float temperature);
     SensorHealthScore getHealthScore(uint8_t sensorId);
     
+    // Health scores are checkpointed on a timer every healthCheckpointIntervalSec;
+    // call checkpointHealthScores() before an orderly restart
+    uint8_t checkpointHealthScores();  // Returns number of sensors written
+    uint32_t getHealthCheckpointInterval() const { return healthCheckpointIntervalSec; }
+    void setHealthCheckpointInterval(uint32_t seconds);
+    
     // Zone management
     String getSensorZone(uint8_t sensorId);
     bool setSensorZone(uint8_t sensorId, const char* zone);
     
-    // Priority management
-    SensorPriority getSensorPriority(uint8_t sensorId);
+    // Priority management. Reads come from RAM (the alert path calls this per
+    // reading on the RX decode task); setSensorPriority writes NVS and RAM.
+    SensorPriority getSensorPriority(uint8_t sensorId) const { return (SensorPriority)priorityTable[sensorId]; }
     bool setSensorPriority(uint8_t sensorId, SensorPriority priority);
 
 private:
-    Preferences prefs;
-    
+    // Each operation opens its own Preferences handle, so the health checkpoint
+    // (main loop) and lookups from other tasks never share one
     String getSensorKey(uint8_t sensorId, const char* field);
     
+    // Sensor priority by ID, loaded at begin()
+    uint8_t priorityTable[256];
+    void loadPriorities();
+    
+    // RAM health table indexed by sensor ID
+    SensorHealthRecord healthTable[256];
+    uint32_t healthFirstSeen[256];  // millis() base for uptime (not persisted)
+    uint8_t healthDirty[32];        // One bit per sensor ID
+    uint32_t healthCheckpointIntervalSec;
+    TimerNode healthCheckpointTimer;
+    SemaphoreHandle_t healthMutex = nullptr;
+    
+    void loadHealthTable();
+    void armHealthCheckpoint();
+    static void onHealthCheckpointDue(TimerNode* node, void* context);
+    inline bool isHealthDirty(uint8_t id) const { return healthDirty[id >> 3] & (1 << (id & 7)); }
+    inline void setHealthDirty(uint8_t id, bool dirty) {
+        if (dirty) healthDirty[id >> 3] |= (1 << (id & 7));
+        else healthDirty[id >> 3] &= ~(1 << (id & 7));
+    }
+    inline bool lockHealth(TickType_t ticks = pdMS_TO_TICKS(100)) {
+        return (healthMutex == nullptr) || (xSemaphoreTake(healthMutex, ticks) == pdTRUE);
+    }
+    inline void unlockHealth() {
+        if (healthMutex != nullptr) {
+            xSemaphoreGive(healthMutex);
+        }
+    }
+    // Re-mark a record whose write failed; waits for the lock so the retry is never lost
+    inline void requeueHealth(uint8_t id) {
+        lockHealth(portMAX_DELAY);
+        setHealthDirty(id, true);
+        unlockHealth();
+    }
+    
     // Health calculation helpers
     float calculateCommunicationReliability(uint16_t totalPackets, uint16_t failedPackets);
     float calculateReadingQuality(float currentValue, float* history, uint8_t historySize);
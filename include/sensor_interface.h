@@ -102,7 +102,7 @@ public:
     
     // Optional features
     virtual bool supportsCalibration() { return false; }
-    virtual bool calibrate(float reference) { return false; }
+    virtual bool calibrate(float /*reference*/) { return false; }
     
     // Status
     virtual uint32_t getLastReadTime() const = 0;
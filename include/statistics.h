@@ -7,6 +7,18 @@
 // Historical data storage size
 #define HISTORY_SIZE 100  // Store last 100 readings
 
+// Client/sensor table capacities. The stored values (setStatsCapacity) are applied
+// by initStats() at boot; each client slot is ~1.2 KB and each sensor slot ~0.8 KB of heap,
+// plus rollup series on the base station (two per client, one per sensor).
+#define STATS_DEFAULT_MAX_CLIENTS 10
+#define STATS_DEFAULT_MAX_SENSORS 40  // 10 clients * 4 sensors each
+#ifndef STATS_MAX_CLIENTS_LIMIT
+  #define STATS_MAX_CLIENTS_LIMIT 32
+#endif
+#ifndef STATS_MAX_SENSORS_LIMIT
+  #define STATS_MAX_SENSORS_LIMIT 96
+#endif
+
 // ============================================================================
 // CLIENT (Physical Device) Data Structures
 // ============================================================================
@@ -26,6 +38,18 @@ struct ClientHistory {
   uint8_t count;
 };
 
+// Sensor clock as reported in v3 keyframes (base station usage)
+struct ClientClock {
+  uint32_t reportMs;    // millis() of the last report, 0 = never reported
+  int32_t offsetS;      // Sensor clock minus base local time at that report
+  bool synced;          // false = the sensor has never been time-synced
+  bool driftValid;
+  int32_t driftPpm;     // Offset change rate since the reference report
+  uint32_t refMs;       // Reference report for the drift estimate, 0 = none
+  int32_t refOffsetS;
+  uint32_t followUpMs;  // millis() of the last unicast resync, 0 = none
+};
+
 // Client information (physical device with radio and battery)
 struct ClientInfo {
   uint8_t clientId;  // Physical device ID
@@ -41,6 +65,7 @@ struct ClientInfo {
   ClientHistory history;
   // Time sync tracking (base station usage)
   uint32_t lastTimeSyncMs;   // millis() when last time-sync ACK was observed
+  ClientClock clock;
   
   // Legacy compatibility fields (deprecated - for old code that expects these)
   uint8_t sensorId;  // Alias for clientId
@@ -75,6 +100,57 @@ struct PhysicalSensor {
   SensorHistory history;
 };
 
+// ============================================================================
+// MULTI-RESOLUTION ROLLUPS
+// ============================================================================
+
+// Incremental min/mean/max buckets per series (sensor value, client battery, client RSSI),
+// updated as readings arrive. Tier 0 = 1 minute, tier 1 = 15 minutes, tier 2 = 1 hour.
+#define ROLLUP_TIER_COUNT 3
+
+#ifndef ROLLUP_1M_BUCKETS
+  #define ROLLUP_1M_BUCKETS   60    // Last hour
+#endif
+#ifndef ROLLUP_15M_BUCKETS
+  #define ROLLUP_15M_BUCKETS  96    // Last 24 hours
+#endif
+#ifndef ROLLUP_1H_BUCKETS
+  #define ROLLUP_1H_BUCKETS   48    // Last 2 days
+#endif
+#define ROLLUP_TOTAL_BUCKETS (ROLLUP_1M_BUCKETS + ROLLUP_15M_BUCKETS + ROLLUP_1H_BUCKETS)
+
+// Series slots (~2.5 KB each) are allocated by initStats() for every client (battery, RSSI)
+// and sensor slot; if that does not fit in heap the pool shrinks and a series that finds
+// no free slot has no rollups
+#define ROLLUP_SERIES_PER_CLIENT  (2 + MAX_VALUES_PER_PACKET)
+
+// Heap left free for WiFi, the web server and MQTT after the rollup pool is allocated
+#ifndef ROLLUP_HEAP_RESERVE
+  #define ROLLUP_HEAP_RESERVE (96 * 1024)
+#endif
+
+// Channel numbers for client telemetry series (sensor series use the sensor index);
+// same numbering as the flash history store (TS_CHANNEL_*)
+#define ROLLUP_CHANNEL_BATTERY  0xFE
+#define ROLLUP_CHANNEL_RSSI     0xFF
+
+// One bucket; mean is NaN while the bucket holds no readings
+struct RollupBucket {
+  float minValue;
+  float mean;
+  float maxValue;
+};
+
+struct SeriesRollups {
+  uint8_t clientId;
+  uint8_t channel;  // Sensor index or ROLLUP_CHANNEL_*
+  uint8_t type;     // ValueType
+  bool active;
+  uint32_t newestBucket[ROLLUP_TIER_COUNT];  // timestamp / resolution of the newest bucket
+  uint16_t newestCount[ROLLUP_TIER_COUNT];   // Readings merged into the newest bucket
+  RollupBucket buckets[ROLLUP_TOTAL_BUCKETS];  // Rings, tier 0 first
+};
+
 // ============================================================================
 // SYSTEM STATISTICS
 // ============================================================================
@@ -90,6 +166,7 @@ struct SystemStats {
   uint32_t lastRxTime;
   int16_t rssiHistory[32];  // Ring buffer for signal graph
   uint8_t rssiHistoryIndex;
+  uint32_t loopIterationsPerSec;  // main loop() passes over the last full second
 };
 
 // ============================================================================
@@ -99,6 +176,12 @@ struct SystemStats {
 // Initialize statistics
 void initStats();
 
+// Client, sensor and rollup tables are shared by the RX decode task, the main loop
+// and web handlers. Every function below takes the (recursive) stats lock itself;
+// a pointer it returns into the tables is only stable while the caller holds it.
+bool lockStats();
+void unlockStats();
+
 // Update statistics
 void recordTxAttempt();
 void recordTxSuccess();
@@ -111,11 +194,17 @@ void updateClientInfo(uint8_t clientId, uint8_t batteryPercent, bool powerState,
 uint8_t getActiveClientCount();
 ClientInfo* getClientInfo(uint8_t clientId);
 ClientInfo* getClientByIndex(uint8_t index);
-ClientInfo* getAllClients();
+ClientInfo* getAllClients();  // getClientCapacity() entries
+uint8_t getClientCapacity();
+uint16_t getSensorCapacity();
+bool setStatsCapacity(uint8_t maxClients, uint16_t maxSensors);  // Stored in NVS, applied at next boot
+void getStoredStatsCapacity(uint8_t& maxClients, uint16_t& maxSensors);
 void checkClientTimeouts();
 bool isClientTimedOut(uint8_t clientId);
 void setClientLocation(uint8_t clientId, const char* location);
 const char* getClientLocation(uint8_t clientId);
+bool copyClientLocation(uint8_t clientId, char* out, size_t outSize);  // false if not tracked
+bool isClientLocationPending(uint8_t clientId);  // Configured name not looked up yet (base station)
 ClientHistory* getClientHistory(uint8_t clientId);
 bool forgetClient(uint8_t clientId);
 
@@ -128,13 +217,25 @@ PhysicalSensor* getAllPhysicalSensors();  // Renamed to avoid collision
 void checkSensorTimeouts();
 SensorHistory* getSensorHistory(uint8_t clientId, uint8_t sensorIndex);
 
+// Rollups (base station only)
+uint32_t historyTimestamp();  // Epoch seconds once NTP has set the clock, uptime seconds before
+uint32_t getRollupResolution(uint8_t tier);  // Seconds per bucket
+uint16_t getRollupBucketCount(uint8_t tier);
+uint8_t getRollupSeriesForClient(uint8_t clientId, uint16_t* slots, uint8_t maxSlots);  // Returns count
+const SeriesRollups* getRollupSeries(uint16_t slot);
+bool getRollupBucket(const SeriesRollups* series, uint8_t tier, uint32_t bucketNumber, RollupBucket& out);
+
 // Get statistics
 SystemStats* getStats();
+void recordLoopIteration();  // Call once per main loop() pass
 
 // Time sync tracking helpers (base station)
 void recordClientTimeSync(uint8_t clientId);
 uint8_t countClientsWithTimeSync();
 uint32_t getMostRecentClientTimeSyncMs();
+void recordClientClock(uint8_t clientId, bool synced, int32_t offsetS);
+void resetClientClockReference(uint8_t clientId);  // Clock was just set; restart the drift estimate
+void resetAllClientClockReferences();
 
 // Legacy compatibility (deprecated)
 void updateSensorInfo(const SensorData& data, int16_t rssi, int8_t snr);
@@ -0,0 +1,160 @@
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel for periodic and one-shot deadlines
+ *
+ * Every deadline the firmware keeps (checkpoints, flushes, ACK timeouts,
+ * offline detection, delayed reboots) is an intrusive TimerNode owned by the
+ * module that arms it. Nodes hang off one of TIMER_WHEEL_LEVELS wheels of
+ * TIMER_WHEEL_SLOTS slots each; arming and cancelling are O(1), and runDue()
+ * only touches the slots whose ticks have elapsed, so a main loop with nothing
+ * due does no work. Nodes further out than the wheel span are parked in the
+ * last slot and re-placed when it cascades.
+ *
+ * schedule() and cancel() may be called from any task. Callbacks run on the
+ * task that calls runDue() (the Arduino loop) without the wheel lock held,
+ * so they may re-arm or cancel any node, including their own.
+ *
+ * @version 1.0.0
+ * @date 2026-10-16
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Wheel resolution. Deadlines fire on the first runDue() after their tick ends.
+#ifndef TIMER_WHEEL_TICK_MS
+  #define TIMER_WHEEL_TICK_MS       10
+#endif
+
+// 4 levels of 64 slots span 64^4 ticks (~46 hours at 10 ms)
+#define TIMER_WHEEL_SLOT_BITS       6
+#define TIMER_WHEEL_SLOTS           (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_LEVELS          4
+
+// Callbacks collected per runDue() pass; the rest fire on the next pass
+#ifndef TIMER_WHEEL_BATCH
+  #define TIMER_WHEEL_BATCH         32
+#endif
+
+// Lag histogram bucket upper bounds (ms); the last bucket is open-ended
+#define TIMER_LAG_BUCKETS           5
+#define TIMER_LAG_BOUNDS_MS         {10, 50, 250, 1000}
+
+class TimerWheel;
+struct TimerNode;
+
+typedef void (*TimerCallback)(TimerNode* node, void* context);
+
+enum TimerNodeState : uint8_t {
+    TIMER_IDLE = 0,
+    TIMER_ARMED = 1,
+    TIMER_FIRING = 2        // Collected by runDue(), callback not yet run
+};
+
+/**
+ * @brief One deadline, embedded in the structure that owns it
+ */
+struct TimerNode {
+    TimerNode* next = nullptr;
+    TimerNode* prev = nullptr;
+    TimerCallback callback = nullptr;
+    void* context = nullptr;
+    uint32_t expiresTick = 0;
+    uint32_t dueMs = 0;         // millis() the deadline was set for (lag reference)
+    uint32_t periodMs = 0;      // 0 = one-shot
+    uint8_t level = 0;
+    uint8_t slot = 0;
+    volatile uint8_t state = TIMER_IDLE;
+};
+
+/**
+ * @brief Timer statistics for /api/stats
+ */
+struct TimerWheelStats {
+    uint16_t armed;
+    uint32_t fired;
+    uint32_t skipped;           // Periodic runs dropped after the loop fell a whole period behind
+    uint32_t passes;            // runDue() calls
+    uint32_t busyPasses;        // runDue() calls that fired at least one callback
+    uint32_t lagLastMs;         // Lateness of the most recent callback
+    uint32_t lagMaxMs;
+    uint32_t lagAvgMs;
+    uint32_t lagHistogram[TIMER_LAG_BUCKETS];
+};
+
+class TimerWheel {
+public:
+    /**
+     * @brief Create the lock and anchor tick 0 at the current millis()
+     */
+    void begin();
+
+    /**
+     * @brief Arm (or re-arm) a node
+     * @param delayMs Time from now until the first callback
+     * @param periodMs Re-arm interval after each callback, 0 for one-shot
+     * @return false only for a null node or callback; waits for the wheel lock
+     */
+    bool schedule(TimerNode* node, uint32_t delayMs, TimerCallback callback, void* context, uint32_t periodMs = 0);
+
+    /**
+     * @brief Disarm a node; a callback already collected by runDue() is skipped
+     *
+     * Waits for the wheel lock, so the node is guaranteed idle on return.
+     * @return true if the node was armed or about to fire
+     */
+    bool cancel(TimerNode* node);
+
+    bool isArmed(const TimerNode* node) const { return node->state != TIMER_IDLE; }
+
+    /**
+     * @brief Advance the wheel to now and run every callback that is due
+     * @return Number of callbacks run
+     */
+    uint8_t runDue();
+
+    /**
+     * @brief Milliseconds until the earliest armed deadline (capped at limitMs)
+     */
+    uint32_t msUntilNext(uint32_t limitMs);
+
+    void getStats(TimerWheelStats& out);
+
+private:
+    void link(TimerNode* node);
+    void unlink(TimerNode* node);
+    void cascade(uint8_t level, uint8_t slot);
+    void recordLag(uint32_t lagMs);
+
+    SemaphoreHandle_t mutex = nullptr;
+    inline bool lock(TickType_t ticksToWait) {
+        return (mutex == nullptr) || (xSemaphoreTake(mutex, ticksToWait) == pdTRUE);
+    }
+    inline void unlock() {
+        if (mutex != nullptr) {
+            xSemaphoreGive(mutex);
+        }
+    }
+
+    TimerNode* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS] = {};
+    uint32_t currentTick = 0;       // Every tick up to and including this one has run
+    uint32_t tickStartMs = 0;       // millis() at the start of currentTick + 1
+    uint16_t armedCount = 0;
+
+    uint32_t fired = 0;
+    uint32_t skipped = 0;
+    uint32_t passes = 0;
+    uint32_t busyPasses = 0;
+    uint32_t lagLastMs = 0;
+    uint32_t lagMaxMs = 0;
+    uint64_t lagTotalMs = 0;
+    uint32_t lagHistogram[TIMER_LAG_BUCKETS] = {};
+};
+
+extern TimerWheel timerWheel;
+
+#endif // TIMER_WHEEL_H
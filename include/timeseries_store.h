@@ -0,0 +1,285 @@
+/**
+ * @file timeseries_store.h
+ * @brief Append-only sensor history log on LittleFS
+ *
+ * Readings are appended as fixed-size records to small block files under TS_DIR.
+ * A RAM index keeps the time range and client set of every block, so a history
+ * query opens only the blocks it needs and streams them record by record instead
+ * of loading the series into RAM.
+ *
+ * Raw blocks older than TS_RAW_RETENTION_SEC are compacted into hourly
+ * min/mean/max rollup blocks. When TS_MAX_BLOCKS is reached the oldest block is
+ * dropped, so flash use is bounded at TS_MAX_BLOCKS * TS_BLOCK_BYTES.
+ *
+ * Records carry wall-clock (epoch) timestamps; readings that arrive before NTP
+ * has set the clock are kept in the RAM history only.
+ *
+ * @version 1.0.0
+ * @date 2026-10-16
+ */
+
+#ifndef TIMESERIES_STORE_H
+#define TIMESERIES_STORE_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "timer_wheel.h"
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+#ifndef TS_DIR
+  #define TS_DIR                    "/ts"
+#endif
+
+// Block file size; LittleFS allocates in 4 KB blocks
+#ifndef TS_BLOCK_BYTES
+  #define TS_BLOCK_BYTES            4096
+#endif
+
+// Flash budget: TS_MAX_BLOCKS * TS_BLOCK_BYTES (384 KB by default)
+#ifndef TS_MAX_BLOCKS
+  #define TS_MAX_BLOCKS             96
+#endif
+
+// Raw readings older than this are folded into hourly rollups
+#ifndef TS_RAW_RETENTION_SEC
+  #define TS_RAW_RETENTION_SEC      (6UL * 3600UL)
+#endif
+
+#ifndef TS_ROLLUP_SEC
+  #define TS_ROLLUP_SEC             3600UL
+#endif
+
+// Readings are buffered in RAM and written in batches
+#ifndef TS_WRITE_BUFFER
+  #define TS_WRITE_BUFFER           64
+#endif
+
+#ifndef TS_FLUSH_INTERVAL_MS
+  #define TS_FLUSH_INTERVAL_MS      60000UL
+#endif
+
+#ifndef TS_COMPACT_INTERVAL_MS
+  #define TS_COMPACT_INTERVAL_MS    60000UL
+#endif
+
+// Raw blocks compacted per pass (bounds the time spent in one loop() call)
+#ifndef TS_COMPACT_BATCH
+  #define TS_COMPACT_BATCH          4
+#endif
+
+// Timestamps before this are uptime, not wall clock (same check as the time broadcast)
+#define TS_MIN_VALID_EPOCH          1700000000UL
+
+// Channel numbers for client telemetry (sensor channels use the sensor index)
+#define TS_CHANNEL_BATTERY          0xFE
+#define TS_CHANNEL_RSSI             0xFF
+
+#define TS_FLAG_CHARGING            0x01
+
+#define TS_LEVEL_RAW                0
+#define TS_LEVEL_HOURLY             1
+
+// ============================================================================
+// RECORDS
+// ============================================================================
+
+/**
+ * @brief Raw reading as stored in raw blocks (12 bytes)
+ */
+struct __attribute__((packed)) TimeSeriesSample {
+    uint32_t timestamp;     // Epoch seconds
+    uint8_t clientId;
+    uint8_t channel;        // Sensor index, TS_CHANNEL_BATTERY or TS_CHANNEL_RSSI
+    uint8_t type;           // ValueType
+    uint8_t flags;          // TS_FLAG_*
+    float value;
+};
+
+/**
+ * @brief Rollup record as stored in hourly blocks (22 bytes)
+ *
+ * Also the form the cursor returns for every record; raw samples come back
+ * with samples = 1 and min = max = mean.
+ */
+struct __attribute__((packed)) TimeSeriesPoint {
+    uint32_t timestamp;     // Epoch seconds (rollups: start of the bucket)
+    uint8_t clientId;
+    uint8_t channel;
+    uint8_t type;
+    uint8_t flags;          // OR of the merged samples' flags
+    uint16_t samples;       // Readings merged into this record
+    float mean;
+    float minValue;
+    float maxValue;
+};
+
+/**
+ * @brief Index entry for one block file
+ */
+struct TimeSeriesBlockInfo {
+    uint32_t seq;               // File name number; increases with every new block
+    uint32_t firstTime;         // Oldest record timestamp
+    uint32_t lastTime;          // Newest record timestamp
+    uint16_t records;
+    uint8_t level;              // TS_LEVEL_RAW or TS_LEVEL_HOURLY
+    uint8_t sealed;             // Full (or damaged); no further appends
+    uint32_t clientMask[8];     // Bit per client ID with records in the block
+};
+
+/**
+ * @brief Store snapshot for /api/stats
+ */
+struct TimeSeriesStats {
+    bool ready;
+    uint16_t blocks;
+    uint16_t rawBlocks;
+    uint16_t rollupBlocks;
+    uint32_t bytesUsed;
+    uint32_t oldestTime;
+    uint32_t newestTime;
+    uint16_t pending;           // Buffered, not yet on flash
+    uint32_t appended;
+    uint32_t dropped;           // Buffer full or flash write error
+    uint32_t flushes;
+    uint32_t compactions;
+    uint32_t blocksEvicted;
+};
+
+// ============================================================================
+// CURSOR
+// ============================================================================
+
+#define TS_CURSOR_CHUNK 528     // Multiple of both record sizes
+
+/**
+ * @brief Forward iterator over one client's records in a time range
+ *
+ * Holds a snapshot of the matching block list and the unflushed buffer, and
+ * reads block files in small chunks, so a query never holds the store lock
+ * while it streams. Records come back in block order (oldest first).
+ */
+class TimeSeriesCursor {
+public:
+    /**
+     * @brief Next matching record
+     * @return false when the range is exhausted
+     */
+    bool next(TimeSeriesPoint& out);
+
+private:
+    friend class TimeSeriesStore;
+
+    bool fillChunk();
+
+    uint8_t clientId = 0;
+    uint32_t fromTime = 0;
+    uint32_t toTime = 0;
+
+    uint32_t blockSeq[TS_MAX_BLOCKS];
+    uint8_t blockLevel[TS_MAX_BLOCKS];
+    uint8_t blockCount = 0;
+    uint8_t blockPos = 0;
+    uint32_t fileOffset = 0;
+
+    uint8_t chunk[TS_CURSOR_CHUNK];
+    uint16_t chunkLen = 0;
+    uint16_t chunkPos = 0;
+
+    TimeSeriesSample pending[TS_WRITE_BUFFER];
+    uint8_t pendingCount = 0;
+    uint8_t pendingPos = 0;
+};
+
+// ============================================================================
+// STORE
+// ============================================================================
+
+class TimeSeriesStore {
+public:
+    /**
+     * @brief Mount the log directory and load (or rebuild) the block index
+     */
+    bool begin();
+
+    /**
+     * @brief Write buffered readings now (call before an orderly restart)
+     */
+    void flush();
+
+    /**
+     * @brief Buffer client telemetry (battery and RSSI); safe from the RX task
+     */
+    void appendClient(uint8_t clientId, uint8_t batteryPercent, int16_t rssi, bool charging);
+
+    /**
+     * @brief Buffer one sensor reading; safe from the RX task
+     */
+    void appendSensor(uint8_t clientId, uint8_t sensorIndex, uint8_t type, float value);
+
+    /**
+     * @brief Start a query for one client over [fromTime, toTime]
+     * @param cursor Filled in place (large; allocate on the heap)
+     * @return false if the store holds nothing for the client in that range
+     */
+    bool openCursor(uint8_t clientId, uint32_t fromTime, uint32_t toTime, TimeSeriesCursor& cursor);
+
+    bool isReady() const { return ready; }
+
+    void getStats(TimeSeriesStats& out);
+
+private:
+    void append(const TimeSeriesSample& sample);
+    bool appendRecords(uint8_t level, const uint8_t* records, size_t count);
+    int findActiveBlock(uint8_t level);
+    int createBlock(uint8_t level);
+    void removeBlock(int index);
+    bool evictOldestBlock();
+    void compact();
+    bool loadIndex();
+    bool saveIndex();
+    void reconcileIndex();
+    void scanBlock(TimeSeriesBlockInfo& info, size_t fileSize);
+
+    SemaphoreHandle_t mutex = nullptr;
+    inline bool lock(TickType_t ticksToWait) {
+        return (mutex == nullptr) || (xSemaphoreTake(mutex, ticksToWait) == pdTRUE);
+    }
+    inline void unlock() {
+        if (mutex != nullptr) {
+            xSemaphoreGive(mutex);
+        }
+    }
+
+    bool ready = false;
+
+    // Block index, ordered by seq
+    TimeSeriesBlockInfo blocks[TS_MAX_BLOCKS];
+    uint8_t blockCount = 0;
+    uint32_t nextSeq = 1;
+    bool indexDirty = false;
+
+    // Readings waiting for the next flush
+    TimeSeriesSample pending[TS_WRITE_BUFFER];
+    uint8_t pendingCount = 0;
+
+    // Flush every TS_FLUSH_INTERVAL_MS (sooner once the buffer is 3/4 full),
+    // compact every TS_COMPACT_INTERVAL_MS
+    TimerNode flushTimer;
+    TimerNode compactTimer;
+    static void onFlushDue(TimerNode* node, void* context);
+    static void onCompactDue(TimerNode* node, void* context);
+
+    uint32_t appended = 0;
+    uint32_t dropped = 0;
+    uint32_t flushes = 0;
+    uint32_t compactions = 0;
+    uint32_t blocksEvicted = 0;
+};
+
+extern TimeSeriesStore timeSeriesStore;
+
+#endif // TIMESERIES_STORE_H
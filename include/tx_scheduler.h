@@ -0,0 +1,137 @@
+/**
+ * @file tx_scheduler.h
+ * @brief LoRa time-on-air calculator and duty-cycle budget for base station TX
+ *
+ * Every base station transmission reserves its airtime from a token bucket that
+ * refills at TX_DUTY_CYCLE_PERCENT of wall-clock time. Lower priorities must leave
+ * a reserve in the bucket, so a busy channel sheds broadcast pings first, then
+ * relayed mesh traffic, then time syncs, and keeps ACK-critical traffic flowing
+ * the longest.
+ *
+ * @version 1.0.0
+ * @date 2026-10-16
+ */
+
+#ifndef TX_SCHEDULER_H
+#define TX_SCHEDULER_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Share of time the base may occupy the channel. US915 has no duty-cycle rule;
+// this is a courtesy budget. Use 1 for EU868 g-band.
+#ifndef TX_DUTY_CYCLE_PERCENT
+  #define TX_DUTY_CYCLE_PERCENT     10
+#endif
+
+// Bucket size: up to this many seconds of budget can be saved up for a burst
+#ifndef TX_BUDGET_WINDOW_SEC
+  #define TX_BUDGET_WINDOW_SEC      600
+#endif
+
+/**
+ * @brief Transmission priority (lower value = more important)
+ */
+enum TxPriority {
+    TX_PRIORITY_ACK_CRITICAL = 0,   // Keyframe ACKs, ACK-tracked config commands
+    TX_PRIORITY_TIME_SYNC = 1,      // CMD_TIME_SYNC
+    TX_PRIORITY_DATA = 2,           // Unicast mesh traffic: relayed data, route replies/errors
+    TX_PRIORITY_BROADCAST = 3,      // Broadcast wake ping, route requests, beacons
+    TX_PRIORITY_COUNT
+};
+
+/**
+ * @brief Radio settings that determine time on air
+ */
+struct LoRaModemParams {
+    uint8_t spreadingFactor;    // 7..12
+    uint32_t bandwidthHz;       // 125000, 250000, 500000
+    uint8_t codingRate;         // 1..4 (4/5..4/8)
+    uint16_t preambleLength;    // Symbols
+    bool crcOn;
+    bool implicitHeader;
+};
+
+/**
+ * @brief Airtime budget snapshot for /api/stats
+ */
+struct TxBudgetStats {
+    uint8_t dutyCyclePercent;
+    uint32_t budgetPerHourMs;                   // Airtime allowed per hour
+    uint32_t usedLastHourMs;                    // Airtime spent in the last 60 minutes
+    uint32_t availableMs;                       // Tokens currently in the bucket
+    uint32_t capacityMs;
+    uint32_t sent[TX_PRIORITY_COUNT];
+    uint32_t deferred[TX_PRIORITY_COUNT];       // Denied for lack of budget
+    uint32_t usedLastHourByPriorityMs[TX_PRIORITY_COUNT];
+};
+
+/**
+ * @brief Semtech SX126x time-on-air formula (low data rate optimisation is
+ *        enabled automatically for symbols >= 16 ms, as the radio driver does)
+ * @return Airtime in microseconds
+ */
+uint32_t loraTimeOnAirUs(const LoRaModemParams& params, size_t payloadBytes);
+
+class TxScheduler {
+public:
+    /**
+     * @brief Set active radio parameters (call from initLoRa and after changes)
+     */
+    void begin(const LoRaModemParams& params, uint8_t dutyCyclePercent = TX_DUTY_CYCLE_PERCENT);
+
+    /**
+     * @brief Time on air for a frame with the active parameters
+     */
+    uint32_t timeOnAirUs(size_t payloadBytes) const;
+    uint16_t timeOnAirMs(size_t payloadBytes) const;
+
+    /**
+     * @brief Spend the airtime for one frame if the budget allows it at this priority
+     * @return true if the caller may transmit now, false if it must defer
+     */
+    bool reserve(size_t payloadBytes, TxPriority priority);
+
+    /**
+     * @brief Return a reservation whose frame never went on air
+     */
+    void refund(size_t payloadBytes, TxPriority priority);
+
+    /**
+     * @brief Fill a stats snapshot
+     */
+    void getStats(TxBudgetStats& out);
+
+private:
+    void refill(uint32_t nowMs);
+    void rollMinutes(uint32_t nowMs);
+
+    SemaphoreHandle_t mutex = nullptr;
+    inline bool lock(TickType_t ticksToWait) {
+        return (mutex == nullptr) || (xSemaphoreTake(mutex, ticksToWait) == pdTRUE);
+    }
+    inline void unlock() {
+        if (mutex != nullptr) {
+            xSemaphoreGive(mutex);
+        }
+    }
+
+    LoRaModemParams params = {10, 125000, 1, 8, true, false};
+    uint8_t dutyCyclePercent = TX_DUTY_CYCLE_PERCENT;
+    uint64_t tokensUs = 0;
+    uint64_t capacityUs = 0;
+    uint32_t lastRefillMs = 0;
+    bool started = false;
+
+    // Airtime per minute for the rolling last-hour figure
+    uint32_t minuteUsedMs[60][TX_PRIORITY_COUNT] = {};
+    uint32_t currentMinute = 0;
+
+    uint32_t sent[TX_PRIORITY_COUNT] = {};
+    uint32_t deferred[TX_PRIORITY_COUNT] = {};
+};
+
+extern TxScheduler txScheduler;
+
+#endif // TX_SCHEDULER_H
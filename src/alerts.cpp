@@ -18,17 +18,26 @@
  *    - Supports Gmail, Outlook, and other SMTP servers
  * 
  * Features:
+ * - Rule engine: built-in temperature/battery rules and user rules for any
+ *   value type are compiled into per-type bitmasks and evaluated with
+ *   hysteresis as readings are stored; a rule alerts once when it trips
+ * - Offline detection from per-client deadlines on the shared timer wheel
  * - Rate limiting (300s default cooldown)
- * - Dual-channel delivery (succeeds if either works)
+ * - Delivery queue drained by a low-priority worker task, so a slow webhook
+ *   or SMTP server never stalls the main loop
+ * - Per-sensor coalescing and exponential backoff on failed deliveries
+ * - Dual-channel delivery (each channel retried until it succeeds)
  * - NVS persistent configuration
  * - Test mode for validation
  * - Per-sensor alert tracking
  */
 
 #include "alerts.h"
+#include "config.h"
 #include "config_storage.h"
 #include "statistics.h"
 #include <Preferences.h>
+#include <math.h>
 
 #ifdef BASE_STATION
 #include <ESP_Mail_Client.h>
@@ -76,18 +85,47 @@ AlertManager::AlertManager() : initialized(false) {
     config.alertBatteryCritical = true;
     config.alertSensorOffline = true;
     config.alertSensorOnline = false;
+    memset(config.rules, 0, sizeof(config.rules));
     
     // Initialize alert state
-    for (int i = 0; i < 20; i++) {
+    for (int i = 0; i < 256; i++) {
         state.lastAlertTime[i] = 0;
         state.lastAlertType[i] = ALERT_SYSTEM_ERROR;
+        state.lastRuleKey[i] = 0xFF;
     }
+    
+    memset(batches, 0, sizeof(batches));
+    memset(&counters, 0, sizeof(counters));
+    
+    memset(rules, 0, sizeof(rules));
+    memset(rulesByType, 0, sizeof(rulesByType));
+    memset(series, 0, sizeof(series));
+    memset(clientSeries, 0, sizeof(clientSeries));
+    memset(clientFlags, 0, sizeof(clientFlags));
 }
 
 void AlertManager::begin() {
     Serial.println("Initializing Alert Manager...");
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    if (ruleMutex == nullptr) {
+        ruleMutex = xSemaphoreCreateMutex();
+    }
     loadConfig();
+    compileRules();
     initialized = true;
+    
+    // Deliveries (TLS handshakes, SMTP sessions) run on their own task
+    if (taskHandle == nullptr) {
+        BaseType_t ok = xTaskCreatePinnedToCore(taskEntry, "alerts", ALERT_TASK_STACK, this,
+                                                ALERT_TASK_PRIORITY, &taskHandle, ALERT_TASK_CORE);
+        if (ok != pdPASS) {
+            taskHandle = nullptr;
+            Serial.println("Failed to start alert task; delivering from loop()");
+            timerWheel.schedule(&deliveryTimer, ALERT_TASK_IDLE_MS, onDeliveryDue, this, ALERT_TASK_IDLE_MS);
+        }
+    }
 }
 
 void AlertManager::loadConfig() {
@@ -119,6 +157,10 @@ void AlertManager::loadConfig() {
         config.alertSensorOffline = prefs.getBool("enOffline", true);
         config.alertSensorOnline = prefs.getBool("enOnline", false);
         
+        if (prefs.getBytesLength("rules") == sizeof(config.rules)) {
+            prefs.getBytes("rules", config.rules, sizeof(config.rules));
+        }
+        
         prefs.end();
         Serial.println("Alert configuration loaded from NVS");
     }
@@ -152,10 +194,16 @@ void AlertManager::saveConfig() {
         prefs.putBool("enBattC", config.alertBatteryCritical);
         prefs.putBool("enOffline", config.alertSensorOffline);
         prefs.putBool("enOnline", config.alertSensorOnline);
+        prefs.putBytes("rules", config.rules, sizeof(config.rules));
         
         prefs.end();
         Serial.println("Alert configuration saved to NVS");
     }
+    
+    // Every config change goes through here; pick up new thresholds and rules
+    if (initialized) {
+        compileRules();
+    }
 }
 
 AlertConfig* AlertManager::getConfig() {
@@ -210,16 +258,15 @@ void AlertManager::enableAlert(AlertType type, bool enabled) {
     }
 }
 
-bool AlertManager::shouldSendAlert(uint8_t sensorId, AlertType type) {
-    if (!initialized || !config.teamsEnabled) return false;
-    if (sensorId >= 20) return false;
+bool AlertManager::shouldSendAlert(uint8_t sensorId, AlertType type, uint8_t ruleKey) {
+    if (!initialized || (!config.teamsEnabled && !config.emailEnabled)) return false;
     
     uint32_t now = millis();
     uint32_t lastTime = state.lastAlertTime[sensorId];
     AlertType lastType = state.lastAlertType[sensorId];
     
-    // Always allow if it's a different alert type
-    if (lastType != type) return true;
+    // Always allow if it's a different alert type (or raised by a different rule)
+    if (lastType != type || state.lastRuleKey[sensorId] != ruleKey) return true;
     
     // Get sensor priority to adjust rate limit
     #ifdef BASE_STATION
@@ -261,6 +308,9 @@ String AlertManager::getAlertTitle(AlertType type) {
         case ALERT_SENSOR_ONLINE: return "✅ Sensor Back Online";
         case ALERT_COMMUNICATION_FAILURE: return "📡 Communication Failure";
         case ALERT_SYSTEM_ERROR: return "❌ System Error";
+        case ALERT_VALUE_HIGH: return "📈 High Reading Alert";
+        case ALERT_VALUE_LOW: return "📉 Low Reading Alert";
+        case ALERT_VALUE_RATE: return "⏩ Rapid Change Alert";
         default: return "📢 Alert";
     }
 }
@@ -275,6 +325,9 @@ String AlertManager::getAlertColor(AlertType type) {
         case ALERT_SENSOR_ONLINE: return "4CAF50";     // Green
         case ALERT_COMMUNICATION_FAILURE: return "D32F2F"; // Red
         case ALERT_SYSTEM_ERROR: return "9E9E9E";      // Gray
+        case ALERT_VALUE_HIGH: return "FF6B35";        // Orange-red
+        case ALERT_VALUE_LOW: return "4A90E2";         // Blue
+        case ALERT_VALUE_RATE: return "FFB800";        // Yellow
         default: return "0078D4";  // Microsoft Blue
     }
 }
@@ -295,7 +348,62 @@ String AlertManager::formatTeamsCard(const String& title, const String& message,
     return json;
 }
 
+// Most severe alert in a batch sets the card colour
+static uint8_t alertSeverity(AlertType type) {
+    switch (type) {
+        case ALERT_BATTERY_CRITICAL:
+        case ALERT_SENSOR_OFFLINE:
+        case ALERT_COMMUNICATION_FAILURE: return 3;
+        case ALERT_TEMPERATURE_HIGH:
+        case ALERT_TEMPERATURE_LOW:
+        case ALERT_VALUE_HIGH:
+        case ALERT_VALUE_LOW: return 2;
+        case ALERT_BATTERY_LOW:
+        case ALERT_VALUE_RATE: return 1;
+        default: return 0;
+    }
+}
+
+String AlertManager::formatBatchCard(const AlertBatch& batch) {
+    if (batch.count == 1) {
+        const AlertItem& item = batch.items[0];
+        return formatTeamsCard(getAlertTitle(item.type), item.message, getAlertColor(item.type), item.details);
+    }
+    
+    AlertType lead = batch.items[0].type;
+    for (uint8_t i = 1; i < batch.count; i++) {
+        if (alertSeverity(batch.items[i].type) > alertSeverity(lead)) {
+            lead = batch.items[i].type;
+        }
+    }
+    
+    // One section per alert
+    String json = "{";
+    json += "\"@type\":\"MessageCard\",";
+    json += "\"@context\":\"https://schema.org/extensions\",";
+    json += "\"themeColor\":\"" + getAlertColor(lead) + "\",";
+    json += "\"title\":\"" + String(batch.count) + " alerts for Sensor #" + String(batch.sensorId) + "\",";
+    json += "\"text\":\"" + getAlertTitle(lead) + "\",";
+    json += "\"sections\":[";
+    for (uint8_t i = 0; i < batch.count; i++) {
+        const AlertItem& item = batch.items[i];
+        if (i > 0) json += ",";
+        json += "{\"activityTitle\":\"" + getAlertTitle(item.type) + "\",";
+        json += "\"text\":\"" + String(item.message);
+        if (item.details[0] != '\0') {
+            json += " (" + String(item.details) + ")";
+        }
+        json += "\"}";
+    }
+    json += "]}";
+    return json;
+}
+
 bool AlertManager::sendTeamsAlert(const String& title, const String& message, const String& color) {
+    return postTeamsCard(formatTeamsCard(title, message, color, ""));
+}
+
+bool AlertManager::postTeamsCard(const String& payload) {
     if (!config.teamsEnabled || strlen(config.teamsWebhook) == 0) {
         Serial.println("Teams alerts not enabled or webhook not configured");
         return false;
@@ -312,8 +420,8 @@ bool AlertManager::sendTeamsAlert(const String& title, const String& message, co
     // For Microsoft Teams webhooks, we need to accept their certificate
     client.setInsecure();
 
-    // Prevent rare long stalls (DNS/TLS/connect/write/read) from blocking the main loop
-    // or the AsyncWebServer callback for too long and triggering a watchdog reset.
+    // Bound DNS/TLS/connect/write/read stalls; the alert task (or the
+    // AsyncWebServer callback for tests) is blocked meanwhile.
     client.setTimeout(5); // seconds
 #if defined(ARDUINO_ARCH_ESP32)
     client.setHandshakeTimeout(5); // seconds
@@ -324,8 +432,6 @@ bool AlertManager::sendTeamsAlert(const String& title, const String& message, co
     http.begin(client, config.teamsWebhook);
     http.addHeader("Content-Type", "application/json");
     
-    String payload = formatTeamsCard(title, message, color, "");
-    
     Serial.println("Sending Teams alert...");
     Serial.println("Webhook: " + String(config.teamsWebhook));
     
@@ -345,95 +451,620 @@ bool AlertManager::sendTeamsAlert(const String& title, const String& message, co
     return false;
 }
 
-bool AlertManager::sendAlert(uint8_t sensorId, AlertType type, const String& message, const String& details) {
-    if (!shouldSendAlert(sensorId, type)) {
+bool AlertManager::sendAlert(uint8_t sensorId, AlertType type, const String& message, const String& details,
+                             uint8_t ruleKey) {
+    if (!shouldSendAlert(sensorId, type, ruleKey)) {
         Serial.printf("Alert rate limited for sensor %d, type %d\n", sensorId, type);
         return false;
     }
     
-    String title = getAlertTitle(type);
-    String color = getAlertColor(type);
+    uint8_t channels = config.teamsEnabled ? ALERT_CHANNEL_TEAMS : 0;
+#ifdef BASE_STATION
+    if (config.emailEnabled) {
+        channels |= ALERT_CHANNEL_EMAIL;
+    }
+#endif
+    if (channels == 0) {
+        return false;
+    }
+    
+    // Only the enqueue happens here; never wait long for the worker
+    if (!lock(pdMS_TO_TICKS(20))) {
+        counters.dropped++;
+        return false;
+    }
     
-    bool success = false;
+    // Join this sensor's waiting batch, or start one
+    AlertBatch* batch = nullptr;
+    AlertBatch* freeSlot = nullptr;
+    for (int i = 0; i < ALERT_QUEUE_SLOTS; i++) {
+        if (batches[i].used && batches[i].sensorId == sensorId) {
+            batch = &batches[i];
+            break;
+        }
+        if (!batches[i].used && freeSlot == nullptr) {
+            freeSlot = &batches[i];
+        }
+    }
     
-    // Send Teams alert if enabled
-    if (config.teamsEnabled) {
-        success = sendTeamsAlert(title, message, color);
+    AlertItem* item = nullptr;
+    if (batch != nullptr) {
+        // A newer alert of the same type (and rule) replaces the older one
+        for (uint8_t i = 0; i < batch->count; i++) {
+            if (batch->items[i].type == type && batch->items[i].ruleKey == ruleKey) {
+                item = &batch->items[i];
+                break;
+            }
+        }
+        if (item == nullptr && batch->count < ALERT_BATCH_MAX) {
+            item = &batch->items[batch->count++];
+        }
+        if (item != nullptr) {
+            batch->channels |= channels;
+            counters.coalesced++;
+        }
+    } else if (freeSlot != nullptr) {
+        batch = freeSlot;
+        memset(batch, 0, sizeof(AlertBatch));
+        batch->used = true;
+        batch->sensorId = sensorId;
+        batch->channels = channels;
+        batch->queuedMs = millis();
+        batch->nextAttemptMs = batch->queuedMs;
+        item = &batch->items[batch->count++];
+    }
+    
+    if (item == nullptr) {
+        counters.dropped++;
+        unlock();
+        Serial.printf("Alert queue full - dropped alert for sensor %d, type %d\n", sensorId, type);
+        return false;
+    }
+    
+    item->type = type;
+    item->ruleKey = ruleKey;
+    strncpy(item->message, message.c_str(), sizeof(item->message) - 1);
+    item->message[sizeof(item->message) - 1] = '\0';
+    strncpy(item->details, details.c_str(), sizeof(item->details) - 1);
+    item->details[sizeof(item->details) - 1] = '\0';
+    counters.queued++;
+    
+    // Rate limit from when the alert was raised; delivery retries are the worker's job
+    state.lastAlertTime[sensorId] = millis();
+    state.lastAlertType[sensorId] = type;
+    state.lastRuleKey[sensorId] = ruleKey;
+    unlock();
+    
+    return true;
+}
+
+void AlertManager::getQueueStats(AlertQueueStats& out) {
+    memset(&out, 0, sizeof(out));
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;
+    }
+    out = counters;
+    out.pending = 0;
+    for (int i = 0; i < ALERT_QUEUE_SLOTS; i++) {
+        if (batches[i].used) {
+            out.pending++;
+        }
+    }
+    out.capacity = ALERT_QUEUE_SLOTS;
+    unlock();
+}
+
+// ============================================================================
+// DELIVERY WORKER
+// ============================================================================
+
+void AlertManager::taskEntry(void* arg) {
+    AlertManager* self = static_cast<AlertManager*>(arg);
+    for (;;) {
+        self->serviceQueue();
+        vTaskDelay(pdMS_TO_TICKS(ALERT_TASK_IDLE_MS));
+    }
+}
+
+/**
+ * @brief Worker task unavailable: deliver from the main loop (blocks while sending)
+ */
+void AlertManager::onDeliveryDue(TimerNode* /*node*/, void* context) {
+    static_cast<AlertManager*>(context)->serviceQueue();
+}
+
+/**
+ * @brief Deliver every batch that is due (coalescing window over, backoff expired)
+ */
+void AlertManager::serviceQueue() {
+    AlertBatch batch;
+    while (takeDueBatch(batch)) {
+        uint8_t failed = deliverBatch(batch);
+        
+        if (failed != batch.channels && lock(pdMS_TO_TICKS(50))) {
+            counters.delivered++;
+            unlock();
+        }
+        if (failed != 0) {
+            requeueBatch(batch, failed);
+        }
+    }
+}
+
+bool AlertManager::takeDueBatch(AlertBatch& out) {
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return false;
+    }
+    
+    // Oldest due batch first
+    const uint32_t now = millis();
+    AlertBatch* due = nullptr;
+    for (int i = 0; i < ALERT_QUEUE_SLOTS; i++) {
+        AlertBatch& b = batches[i];
+        if (!b.used || (now - b.queuedMs) < ALERT_COALESCE_MS || (int32_t)(now - b.nextAttemptMs) < 0) {
+            continue;
+        }
+        if (due == nullptr || (int32_t)(b.queuedMs - due->queuedMs) < 0) {
+            due = &b;
+        }
+    }
+    
+    // Taken out of the queue while it is sent, so new alerts for the sensor start a new batch
+    if (due != nullptr) {
+        out = *due;
+        due->used = false;
+    }
+    unlock();
+    return due != nullptr;
+}
+
+void AlertManager::requeueBatch(AlertBatch& batch, uint8_t failedChannels) {
+    batch.attempts++;
+    if (batch.attempts >= ALERT_MAX_ATTEMPTS) {
+        if (lock(pdMS_TO_TICKS(50))) {
+            counters.failed++;
+            unlock();
+        }
+        Serial.printf("Giving up on %d alert(s) for sensor %d after %d attempts\n",
+                      batch.count, batch.sensorId, batch.attempts);
+        return;
+    }
+    
+    uint32_t delayMs = ALERT_RETRY_BASE_MS << min((int)batch.attempts - 1, 16);
+    if (delayMs > ALERT_RETRY_MAX_MS || delayMs < ALERT_RETRY_BASE_MS) {
+        delayMs = ALERT_RETRY_MAX_MS;
+    }
+    batch.channels = failedChannels;
+    batch.nextAttemptMs = millis() + delayMs;
+    
+    if (!lock(pdMS_TO_TICKS(50))) {
+        counters.dropped++;
+        return;
+    }
+    
+    AlertBatch* slot = nullptr;
+    for (int i = 0; i < ALERT_QUEUE_SLOTS; i++) {
+        if (batches[i].used && batches[i].sensorId == batch.sensorId) {
+            slot = &batches[i];
+            break;
+        }
+    }
+    
+    if (slot != nullptr) {
+        // Newer alerts arrived meanwhile: carry over the types they do not cover
+        // and wait out the backoff together (the endpoint is failing)
+        for (uint8_t i = 0; i < batch.count && slot->count < ALERT_BATCH_MAX; i++) {
+            bool covered = false;
+            for (uint8_t j = 0; j < slot->count; j++) {
+                covered = covered || (slot->items[j].type == batch.items[i].type &&
+                                      slot->items[j].ruleKey == batch.items[i].ruleKey);
+            }
+            if (!covered) {
+                slot->items[slot->count++] = batch.items[i];
+            }
+        }
+        slot->channels |= failedChannels;
+        slot->attempts = batch.attempts;
+        slot->queuedMs = batch.queuedMs;
+        slot->nextAttemptMs = batch.nextAttemptMs;
+    } else {
+        for (int i = 0; i < ALERT_QUEUE_SLOTS && slot == nullptr; i++) {
+            if (!batches[i].used) {
+                slot = &batches[i];
+                *slot = batch;
+                slot->used = true;
+            }
+        }
+        if (slot == nullptr) {
+            counters.dropped++;
+        }
+    }
+    
+    if (slot != nullptr) {
+        counters.retries++;
+        Serial.printf("Alert delivery for sensor %d failed; retry %d in %lu s\n",
+                      batch.sensorId, batch.attempts, (unsigned long)(delayMs / 1000));
+    }
+    unlock();
+}
+
+/**
+ * @brief Format and send one batch on its remaining channels
+ * @return Channels that failed
+ */
+uint8_t AlertManager::deliverBatch(const AlertBatch& batch) {
+    uint8_t failed = 0;
+    
+    if (batch.channels & ALERT_CHANNEL_TEAMS) {
+        if (!config.teamsEnabled || !postTeamsCard(formatBatchCard(batch))) {
+            failed |= config.teamsEnabled ? ALERT_CHANNEL_TEAMS : 0;
+        }
     }
     
-    // Send email alert if enabled (base station only)
 #ifdef BASE_STATION
-    if (config.emailEnabled) {
-        String emailSubject = "LoRa Alert: " + title;
-        String emailBody = message;
-        if (details.length() > 0) {
-            emailBody += "\n\n" + details;
+    if (batch.channels & ALERT_CHANNEL_EMAIL) {
+        String subject = "LoRa Alert: ";
+        if (batch.count == 1) {
+            subject += getAlertTitle(batch.items[0].type);
+        } else {
+            subject += String(batch.count) + " alerts for Sensor #" + String(batch.sensorId);
+        }
+        
+        String body;
+        for (uint8_t i = 0; i < batch.count; i++) {
+            const AlertItem& item = batch.items[i];
+            if (batch.count > 1) {
+                body += getAlertTitle(item.type) + "\n";
+            }
+            body += item.message;
+            if (item.details[0] != '\0') {
+                body += "\n\n";
+                body += item.details;
+            }
+            if (i + 1 < batch.count) {
+                body += "\n\n";
+            }
+        }
+        
+        if (!config.emailEnabled || !sendEmailAlert(subject, body)) {
+            failed |= config.emailEnabled ? ALERT_CHANNEL_EMAIL : 0;
         }
-        bool emailSuccess = sendEmailAlert(emailSubject, emailBody);
-        success = success || emailSuccess;  // Success if either method works
     }
 #endif
     
-    if (success && sensorId < 20) {
-        state.lastAlertTime[sensorId] = millis();
-        state.lastAlertType[sensorId] = type;
+    return failed;
+}
+
+// ============================================================================
+// RULE ENGINE
+// ============================================================================
+
+// Fixed rule indices; user rule slot n is ALERT_BUILTIN_RULES + n
+#define RULE_TEMP_HIGH          0
+#define RULE_TEMP_LOW           1
+#define RULE_BATTERY_CRITICAL   2
+#define RULE_BATTERY_LOW        3
+
+static AlertRule makeRule(bool active, uint8_t valueType, uint8_t kind, AlertType alertType,
+                          float threshold, float hysteresis) {
+    AlertRule rule;
+    rule.active = active;
+    rule.valueType = valueType;
+    rule.kind = kind;
+    rule.alertType = (uint8_t)alertType;
+    rule.threshold = threshold;
+    rule.hysteresis = hysteresis;
+    return rule;
+}
+
+static bool sameRule(const AlertRule& a, const AlertRule& b) {
+    return a.active == b.active && a.valueType == b.valueType && a.kind == b.kind &&
+           a.alertType == b.alertType && a.threshold == b.threshold && a.hysteresis == b.hysteresis;
+}
+
+/**
+ * @brief Rebuild the rule table and per-type masks from the configuration
+ * 
+ * Rule indices are fixed, so a series keeps its tripped state across a
+ * recompile; only rules whose definition changed start over (and alert
+ * again if their condition still holds).
+ */
+void AlertManager::compileRules() {
+    AlertRule compiled[ALERT_RULE_COUNT];
+    
+    // Battery alerts fire at or below the configured percentage
+    compiled[RULE_TEMP_HIGH] = makeRule(config.alertTempHigh, VALUE_TEMPERATURE, ALERT_RULE_ABOVE,
+                                        ALERT_TEMPERATURE_HIGH, config.tempHighThreshold, ALERT_TEMP_HYSTERESIS);
+    compiled[RULE_TEMP_LOW] = makeRule(config.alertTempLow, VALUE_TEMPERATURE, ALERT_RULE_BELOW,
+                                       ALERT_TEMPERATURE_LOW, config.tempLowThreshold, ALERT_TEMP_HYSTERESIS);
+    compiled[RULE_BATTERY_CRITICAL] = makeRule(config.alertBatteryCritical, VALUE_BATTERY, ALERT_RULE_BELOW,
+                                               ALERT_BATTERY_CRITICAL, config.batteryCriticalThreshold + 0.5f,
+                                               ALERT_BATTERY_HYSTERESIS);
+    compiled[RULE_BATTERY_LOW] = makeRule(config.alertBatteryLow, VALUE_BATTERY, ALERT_RULE_BELOW,
+                                          ALERT_BATTERY_LOW, config.batteryLowThreshold + 0.5f,
+                                          ALERT_BATTERY_HYSTERESIS);
+    
+    for (int i = 0; i < ALERT_CUSTOM_RULES; i++) {
+        const AlertRuleConfig& rc = config.rules[i];
+        bool valid = rc.used && rc.enabled && rc.valueType < ALERT_VALUE_TYPES && rc.kind <= ALERT_RULE_RATE &&
+                     !isnan(rc.threshold) && !isnan(rc.hysteresis);
+        AlertType type = (rc.kind == ALERT_RULE_ABOVE) ? ALERT_VALUE_HIGH :
+                         (rc.kind == ALERT_RULE_BELOW) ? ALERT_VALUE_LOW : ALERT_VALUE_RATE;
+        float hysteresis = fabsf(rc.hysteresis);
+        if (rc.kind == ALERT_RULE_RATE && hysteresis > fabsf(rc.threshold) / 2) {
+            // A rate rule must be able to re-arm
+            hysteresis = fabsf(rc.threshold) / 2;
+        }
+        compiled[ALERT_BUILTIN_RULES + i] = makeRule(valid, rc.valueType, rc.kind, type,
+                                                     rc.kind == ALERT_RULE_RATE ? fabsf(rc.threshold) : rc.threshold,
+                                                     hysteresis);
+    }
+    
+    if (!lockRules(portMAX_DELAY)) {
+        return;
+    }
+    
+    uint16_t changed = 0;
+    for (int r = 0; r < ALERT_RULE_COUNT; r++) {
+        if (!sameRule(compiled[r], rules[r])) {
+            changed |= (uint16_t)(1u << r);
+        }
+        rules[r] = compiled[r];
+    }
+    
+    memset(rulesByType, 0, sizeof(rulesByType));
+    uint8_t activeRules = 0;
+    for (int r = 0; r < ALERT_RULE_COUNT; r++) {
+        if (rules[r].active) {
+            rulesByType[rules[r].valueType] |= (uint16_t)(1u << r);
+            activeRules++;
+        }
+    }
+    
+    for (int i = 0; i < ALERT_RULE_SERIES; i++) {
+        if (series[i].used) {
+            series[i].tripped &= (uint16_t)~changed;
+        }
     }
+    unlockRules();
     
-    return success;
+    Serial.printf("Alert rules compiled: %d active\n", activeRules);
+}
+
+/**
+ * @brief Find (or start) the rule state of one series; rule lock held
+ */
+AlertSeries* AlertManager::findSeries(uint8_t clientId, uint8_t channel, uint8_t valueType, bool create) {
+    for (uint8_t slot = clientSeries[clientId]; slot != 0; slot = series[slot - 1].next) {
+        AlertSeries& s = series[slot - 1];
+        if (s.channel == channel && s.valueType == valueType) {
+            return &s;
+        }
+    }
+    if (!create) {
+        return nullptr;
+    }
+    
+    for (int i = 0; i < ALERT_RULE_SERIES; i++) {
+        if (!series[i].used) {
+            AlertSeries& s = series[i];
+            memset(&s, 0, sizeof(s));
+            s.used = true;
+            s.clientId = clientId;
+            s.channel = channel;
+            s.valueType = valueType;
+            s.next = clientSeries[clientId];
+            clientSeries[clientId] = i + 1;
+            return &s;
+        }
+    }
+    return nullptr;
 }
 
-void AlertManager::checkSensorAlerts(uint8_t sensorId, float temperature, uint8_t battery, bool online) {
-    if (!initialized || (!config.teamsEnabled && !config.emailEnabled)) return;
+/**
+ * @brief Evaluate the rules for one stored reading
+ * 
+ * Called from the statistics layer (RX decode task). Only rules compiled for
+ * the reading's value type are looked at; a rule alerts when it trips and
+ * stays quiet until the value has come back past its hysteresis band.
+ */
+void AlertManager::onReading(uint8_t clientId, uint8_t channel, uint8_t valueType, float value) {
+    if (!initialized || valueType >= ALERT_VALUE_TYPES || isnan(value)) {
+        return;
+    }
+    if (rulesByType[valueType] == 0) {
+        return;  // Nothing watches this type
+    }
+    
+    struct Fired {
+        uint8_t index;
+        AlertRule rule;
+        float value;
+    } fired[ALERT_RULE_COUNT];
+    uint8_t firedCount = 0;
+    uint16_t tripped = 0;
     
-    // Check temperature thresholds
-    if (config.alertTempHigh && temperature > config.tempHighThreshold) {
-        String msg = "Sensor #" + String(sensorId) + " temperature is " + String(temperature, 1) + "°C";
-        String details = "Threshold: " + String(config.tempHighThreshold, 1) + "°C";
-        sendAlert(sensorId, ALERT_TEMPERATURE_HIGH, msg, details);
+    if (!lockRules(pdMS_TO_TICKS(20))) {
+        return;
     }
     
-    if (config.alertTempLow && temperature < config.tempLowThreshold) {
-        String msg = "Sensor #" + String(sensorId) + " temperature is " + String(temperature, 1) + "°C";
-        String details = "Threshold: " + String(config.tempLowThreshold, 1) + "°C";
-        sendAlert(sensorId, ALERT_TEMPERATURE_LOW, msg, details);
+    const uint16_t mask = rulesByType[valueType];
+    AlertSeries* s = findSeries(clientId, channel, valueType, mask != 0);
+    if (s == nullptr) {
+        unlockRules();
+        return;  // Series table full
     }
     
-    // Check battery thresholds
-    if (config.alertBatteryCritical && battery <= config.batteryCriticalThreshold) {
-        String msg = "Sensor #" + String(sensorId) + " battery critically low: " + String(battery) + "%";
-        String details = "Please replace or charge battery immediately!";
-        sendAlert(sensorId, ALERT_BATTERY_CRITICAL, msg, details);
-    } else if (config.alertBatteryLow && battery <= config.batteryLowThreshold) {
-        String msg = "Sensor #" + String(sensorId) + " battery low: " + String(battery) + "%";
-        String details = "Consider replacing or charging battery soon";
-        sendAlert(sensorId, ALERT_BATTERY_LOW, msg, details);
+    // Change per minute against a reading at least ALERT_RATE_MIN_SPAN_MS older
+    const uint32_t now = millis();
+    bool haveRate = false;
+    float rate = 0;
+    if (!s->rateBaseValid) {
+        s->rateBaseValid = true;
+        s->rateBaseValue = value;
+        s->rateBaseMs = now;
+    } else if (now - s->rateBaseMs >= ALERT_RATE_MIN_SPAN_MS) {
+        rate = (value - s->rateBaseValue) * 60000.0f / (float)(now - s->rateBaseMs);
+        haveRate = true;
+        s->rateBaseValue = value;
+        s->rateBaseMs = now;
+    }
+    
+    for (uint8_t r = 0; r < ALERT_RULE_COUNT; r++) {
+        const uint16_t bit = (uint16_t)(1u << r);
+        if ((mask & bit) == 0) {
+            continue;
+        }
+        
+        const AlertRule& rule = rules[r];
+        float subject = value;
+        bool over;
+        bool clear;
+        switch (rule.kind) {
+            case ALERT_RULE_ABOVE:
+                over = value > rule.threshold;
+                clear = value < rule.threshold - rule.hysteresis;
+                break;
+            case ALERT_RULE_BELOW:
+                over = value < rule.threshold;
+                clear = value > rule.threshold + rule.hysteresis;
+                break;
+            default:
+                if (!haveRate) {
+                    continue;
+                }
+                subject = rate;
+                over = fabsf(rate) > rule.threshold;
+                clear = fabsf(rate) < rule.threshold - rule.hysteresis;
+                break;
+        }
+        
+        if ((s->tripped & bit) == 0 && over) {
+            s->tripped |= bit;
+            fired[firedCount].index = r;
+            fired[firedCount].rule = rule;
+            fired[firedCount].value = subject;
+            firedCount++;
+        } else if ((s->tripped & bit) != 0 && clear) {
+            s->tripped &= (uint16_t)~bit;
+        }
     }
+    tripped = s->tripped;
+    unlockRules();
     
-    // Check online status
-    if (!online && config.alertSensorOffline) {
-        String msg = "Sensor #" + String(sensorId) + " has gone offline";
-        String details = "No communication for " + String(config.sensorTimeoutMinutes) + " minutes";
-        sendAlert(sensorId, ALERT_SENSOR_OFFLINE, msg, details);
-    } else if (online && config.alertSensorOnline) {
-        // Only send "back online" if we previously sent an offline alert
-        if (state.lastAlertType[sensorId] == ALERT_SENSOR_OFFLINE) {
-            String msg = "Sensor #" + String(sensorId) + " is back online";
-            sendAlert(sensorId, ALERT_SENSOR_ONLINE, msg, "");
+    for (uint8_t i = 0; i < firedCount; i++) {
+        // Critical battery covers low battery when both trip on one reading
+        if (fired[i].index == RULE_BATTERY_LOW && (tripped & (1u << RULE_BATTERY_CRITICAL)) != 0) {
+            continue;
         }
+        sendRuleAlert(clientId, channel, fired[i].index, fired[i].rule, fired[i].value);
     }
 }
 
-void AlertManager::checkAllSensors() {
-    if (!initialized || (!config.teamsEnabled && !config.emailEnabled)) return;
+void AlertManager::sendRuleAlert(uint8_t clientId, uint8_t channel, uint8_t ruleIndex, const AlertRule& rule, float value) {
+    String msg = "Sensor #" + String(clientId);
+    String details;
     
-    for (uint8_t i = 0; i < 10; i++) {
-        SensorInfo* sensor = getSensorByIndex(i);
-        if (sensor != NULL) {
-            bool online = !isSensorTimedOut(sensor->sensorId);
-            checkSensorAlerts(sensor->sensorId, sensor->lastTemperature, 
-                            sensor->lastBatteryPercent, online);
+    switch (rule.alertType) {
+        case ALERT_TEMPERATURE_HIGH:
+        case ALERT_TEMPERATURE_LOW:
+            msg += " temperature is " + String(value, 1) + "°C";
+            details = "Threshold: " + String(rule.threshold, 1) + "°C";
+            break;
+        case ALERT_BATTERY_CRITICAL:
+            msg += " battery critically low: " + String((int)lroundf(value)) + "%";
+            details = "Please replace or charge battery immediately!";
+            break;
+        case ALERT_BATTERY_LOW:
+            msg += " battery low: " + String((int)lroundf(value)) + "%";
+            details = "Consider replacing or charging battery soon";
+            break;
+        default: {
+            const char* unit = SensorHelpers::getUnit((ValueType)rule.valueType);
+            msg += " " + String(SensorHelpers::getValueName((ValueType)rule.valueType));
+            if (rule.kind == ALERT_RULE_RATE) {
+                msg += " changing at " + String(value, 2) + unit + "/min";
+                details = "Limit: " + String(rule.threshold, 2) + unit + "/min";
+            } else {
+                msg += " is " + String(value, 2) + unit;
+                details = "Threshold: " + String(rule.threshold, 2) + unit;
+            }
+            if (channel != ALERT_CHANNEL_CLIENT_BATTERY) {
+                details += ", sensor index " + String(channel);
+            }
+            break;
         }
     }
+    
+    sendAlert(clientId, (AlertType)rule.alertType, msg, details, ruleIndex);
+}
+
+// ============================================================================
+// OFFLINE DETECTION
+// ============================================================================
+
+/**
+ * @brief Push a client's offline deadline out to now + timeout
+ */
+void AlertManager::onClientSeen(uint8_t clientId) {
+    if (!initialized) {
+        return;
+    }
+    const uint32_t timeoutMs = (uint32_t)config.sensorTimeoutMinutes * 60000UL;
+    
+    if (!lockRules(pdMS_TO_TICKS(20))) {
+        return;
+    }
+    bool wasOffline = (clientFlags[clientId] & ALERT_CLIENT_OFFLINE) != 0;
+    clientFlags[clientId] &= ~ALERT_CLIENT_OFFLINE;
+    if (timeoutMs > 0) {
+        timerWheel.schedule(&offlineTimers[clientId], timeoutMs, onOfflineDeadline, this);
+    } else {
+        timerWheel.cancel(&offlineTimers[clientId]);
+    }
+    unlockRules();
+    
+    if (wasOffline && config.alertSensorOnline) {
+        sendAlert(clientId, ALERT_SENSOR_ONLINE, "Sensor #" + String(clientId) + " is back online", "");
+    }
+}
+
+void AlertManager::onClientForgotten(uint8_t clientId) {
+    if (!lockRules(pdMS_TO_TICKS(50))) {
+        return;
+    }
+    timerWheel.cancel(&offlineTimers[clientId]);
+    clientFlags[clientId] = 0;
+    for (uint8_t slot = clientSeries[clientId]; slot != 0; slot = series[slot - 1].next) {
+        series[slot - 1].used = false;
+    }
+    clientSeries[clientId] = 0;
+    unlockRules();
+}
+
+/**
+ * @brief Timer callback: a client has been silent for the whole timeout
+ */
+void AlertManager::onOfflineDeadline(TimerNode* node, void* context) {
+    AlertManager* self = static_cast<AlertManager*>(context);
+    const uint8_t clientId = (uint8_t)(node - self->offlineTimers);
+    
+    if (!self->lockRules(pdMS_TO_TICKS(20))) {
+        timerWheel.schedule(node, 1000, onOfflineDeadline, self);  // Decode task busy; look again shortly
+        return;
+    }
+    // A packet that arrived after the deadline fired re-armed the node
+    bool offline = !timerWheel.isArmed(node);
+    if (offline) {
+        self->clientFlags[clientId] |= ALERT_CLIENT_OFFLINE;
+    }
+    self->unlockRules();
+    
+    if (offline && self->config.alertSensorOffline) {
+        String msg = "Sensor #" + String(clientId) + " has gone offline";
+        String details = "No communication for " + String(self->config.sensorTimeoutMinutes) + " minutes";
+        self->sendAlert(clientId, ALERT_SENSOR_OFFLINE, msg, details);
+    }
 }
 
 bool AlertManager::testTeamsWebhook() {
@@ -9,9 +9,14 @@
  * - Email notifications (SMTP)
  * 
  * Features:
- * - Configurable thresholds (temperature, battery)
+ * - Configurable thresholds (temperature, battery) plus user rules for any
+ *   value type (above / below / rate of change), evaluated with hysteresis
+ *   as each reading is stored
+ * - Offline detection from per-client deadlines on the shared timer wheel
  * - Rate limiting to prevent alert spam
- * - Dual-channel delivery (succeeds if either works)
+ * - Queued delivery on a worker task: alerts for one sensor are coalesced
+ *   into a single card/email, failed deliveries retry with exponential backoff
+ * - Dual-channel delivery (each channel retried until it succeeds)
  * - Persistent configuration storage (NVS)
  * - Test functionality for each notification channel
  */
@@ -22,6 +27,68 @@
 #include <Arduino.h>
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sensor_interface.h"
+#include "timer_wheel.h"
+
+// Sensors that can have alerts waiting for delivery at once
+#ifndef ALERT_QUEUE_SLOTS
+#define ALERT_QUEUE_SLOTS 8
+#endif
+
+// Alerts combined into one card/email per sensor
+#ifndef ALERT_BATCH_MAX
+#define ALERT_BATCH_MAX 4
+#endif
+
+// A sensor's first alert waits this long so others raised with it share the message
+#ifndef ALERT_COALESCE_MS
+#define ALERT_COALESCE_MS 3000
+#endif
+
+// Delivery retries: base delay doubles per failed attempt up to the cap
+#ifndef ALERT_RETRY_BASE_MS
+#define ALERT_RETRY_BASE_MS 10000
+#endif
+#ifndef ALERT_RETRY_MAX_MS
+#define ALERT_RETRY_MAX_MS 600000
+#endif
+#ifndef ALERT_MAX_ATTEMPTS
+#define ALERT_MAX_ATTEMPTS 6
+#endif
+
+// Worker poll interval
+#define ALERT_TASK_IDLE_MS 1000
+
+#define ALERT_CHANNEL_TEAMS 0x01
+#define ALERT_CHANNEL_EMAIL 0x02
+
+// User-defined value rules (in addition to the built-in temperature/battery rules)
+#ifndef ALERT_CUSTOM_RULES
+#define ALERT_CUSTOM_RULES 8
+#endif
+#define ALERT_BUILTIN_RULES 4
+#define ALERT_RULE_COUNT (ALERT_BUILTIN_RULES + ALERT_CUSTOM_RULES)  // At most 16 (uint16_t masks)
+#define ALERT_VALUE_TYPES (VALUE_GENERIC + 1)
+
+// (client, sensor index, value type) series that carry rule state (at most 255)
+#ifndef ALERT_RULE_SERIES
+#define ALERT_RULE_SERIES 64
+#endif
+
+// Rate-of-change rules compare readings at least this far apart
+#define ALERT_RATE_MIN_SPAN_MS 10000
+
+// Built-in rules re-arm once the value is back this far past the threshold
+#define ALERT_TEMP_HYSTERESIS 0.5f
+#define ALERT_BATTERY_HYSTERESIS 3.0f
+
+#define ALERT_CLIENT_OFFLINE   0x02     // Offline deadline passed, not heard from since
+
+// Sensor index used for the client battery series
+#define ALERT_CHANNEL_CLIENT_BATTERY 0xFE
 
 /**
  * @enum AlertType
@@ -35,7 +102,49 @@ enum AlertType {
     ALERT_SENSOR_OFFLINE,
     ALERT_SENSOR_ONLINE,
     ALERT_COMMUNICATION_FAILURE,
-    ALERT_SYSTEM_ERROR
+    ALERT_SYSTEM_ERROR,
+    ALERT_VALUE_HIGH,
+    ALERT_VALUE_LOW,
+    ALERT_VALUE_RATE
+};
+
+enum AlertRuleKind {
+    ALERT_RULE_ABOVE = 0,
+    ALERT_RULE_BELOW = 1,
+    ALERT_RULE_RATE = 2     // |change per minute| above the threshold
+};
+
+// User rule, stored in NVS
+struct AlertRuleConfig {
+    bool used;              // Slot holds a rule
+    bool enabled;
+    uint8_t valueType;      // ValueType
+    uint8_t kind;           // AlertRuleKind
+    float threshold;        // Value, or change per minute for ALERT_RULE_RATE
+    float hysteresis;       // Distance back past the threshold before the rule re-arms
+};
+
+// Compiled rule (built-in rules first, then user rules by slot)
+struct AlertRule {
+    bool active;
+    uint8_t valueType;
+    uint8_t kind;
+    uint8_t alertType;      // AlertType sent when the rule trips
+    float threshold;
+    float hysteresis;
+};
+
+// Rule state for one (client, sensor index, value type) series
+struct AlertSeries {
+    bool used;
+    uint8_t clientId;
+    uint8_t channel;        // Sensor index, or ALERT_CHANNEL_CLIENT_BATTERY
+    uint8_t valueType;
+    uint8_t next;           // Next series of the same client (slot + 1, 0 = end)
+    bool rateBaseValid;
+    uint16_t tripped;       // Rules currently past their threshold (bit = rule index)
+    float rateBaseValue;
+    uint32_t rateBaseMs;
 };
 
 // Alert configuration structure
@@ -74,12 +183,48 @@ struct AlertConfig {
     bool alertBatteryCritical;
     bool alertSensorOffline;
     bool alertSensorOnline;
+    
+    // User rules for any value type
+    AlertRuleConfig rules[ALERT_CUSTOM_RULES];
 };
 
-// Alert tracking structure
+// Alert tracking structure (rate limiting, indexed by sensor ID)
 struct AlertState {
-    uint32_t lastAlertTime[20];  // Last alert time per sensor (max 20 sensors)
-    AlertType lastAlertType[20];  // Last alert type per sensor
+    uint32_t lastAlertTime[256];  // Last alert time per sensor
+    AlertType lastAlertType[256];  // Last alert type per sensor
+    uint8_t lastRuleKey[256];      // Rule that raised it (0xFF = not a rule alert)
+};
+
+// One alert waiting for delivery
+struct AlertItem {
+    AlertType type;
+    uint8_t ruleKey;            // Rule index, or 0xFF
+    char message[96];
+    char details[80];
+};
+
+// Alerts for one sensor, delivered together
+struct AlertBatch {
+    bool used;
+    uint8_t sensorId;
+    uint8_t count;
+    uint8_t attempts;           // Failed delivery attempts so far
+    uint8_t channels;           // ALERT_CHANNEL_* still to deliver
+    uint32_t queuedMs;          // When the first alert was queued
+    uint32_t nextAttemptMs;
+    AlertItem items[ALERT_BATCH_MAX];
+};
+
+// Delivery queue snapshot for /api/stats
+struct AlertQueueStats {
+    uint8_t pending;            // Batches waiting (including retries)
+    uint8_t capacity;
+    uint32_t queued;            // Alerts accepted by sendAlert()
+    uint32_t coalesced;         // Alerts that joined an existing batch
+    uint32_t delivered;         // Batches sent on at least one channel
+    uint32_t retries;
+    uint32_t failed;            // Batches given up after ALERT_MAX_ATTEMPTS
+    uint32_t dropped;           // Queue or batch full
 };
 
 class AlertManager {
@@ -98,9 +243,12 @@ public:
     void setRateLimit(uint32_t seconds);
     void enableAlert(AlertType type, bool enabled);
     
-    // Alert sending
-    bool sendAlert(uint8_t sensorId, AlertType type, const String& message, const String& details = "");
+    // Alert sending: sendAlert() only queues; the worker task delivers.
+    // ruleKey tells apart alerts of the same type raised by different rules.
+    bool sendAlert(uint8_t sensorId, AlertType type, const String& message, const String& details = "",
+                   uint8_t ruleKey = 0xFF);
     bool sendTeamsAlert(const String& title, const String& message, const String& color = "0078D4");
+    void getQueueStats(AlertQueueStats& out);
     
 #ifdef BASE_STATION
     bool sendEmailAlert(const String& subject, const String& message);
@@ -111,12 +259,14 @@ public:
     inline bool testEmailSettings() { return false; }
 #endif
     
-    // Alert checking
-    void checkSensorAlerts(uint8_t sensorId, float temperature, uint8_t battery, bool online);
-    void checkAllSensors();
+    // Rule evaluation, driven by the statistics layer as readings are stored
+    void compileRules();
+    void onReading(uint8_t clientId, uint8_t channel, uint8_t valueType, float value);
+    void onClientSeen(uint8_t clientId);
+    void onClientForgotten(uint8_t clientId);
     
     // Rate limiting
-    bool shouldSendAlert(uint8_t sensorId, AlertType type);
+    bool shouldSendAlert(uint8_t sensorId, AlertType type, uint8_t ruleKey = 0xFF);
     
     // Test functions
     bool testTeamsWebhook();
@@ -126,9 +276,59 @@ private:
     AlertState state;
     bool initialized;
     
+    // Delivery queue; the main loop appends, the worker takes due batches out
+    AlertBatch batches[ALERT_QUEUE_SLOTS];
+    AlertQueueStats counters;
+    TaskHandle_t taskHandle = nullptr;
+    
+    SemaphoreHandle_t mutex = nullptr;
+    inline bool lock(TickType_t ticksToWait) {
+        return (mutex == nullptr) || (xSemaphoreTake(mutex, ticksToWait) == pdTRUE);
+    }
+    inline void unlock() {
+        if (mutex != nullptr) {
+            xSemaphoreGive(mutex);
+        }
+    }
+    
+    // Compiled rules: rulesByType[t] has a bit per rule that applies to value type t
+    AlertRule rules[ALERT_RULE_COUNT];
+    uint16_t rulesByType[ALERT_VALUE_TYPES];
+    AlertSeries series[ALERT_RULE_SERIES];
+    uint8_t clientSeries[256];      // First series of each client (slot + 1, 0 = none)
+    
+    // Offline deadlines, one node per client on the shared timer wheel
+    TimerNode offlineTimers[256];
+    uint8_t clientFlags[256];       // ALERT_CLIENT_* bits
+    TimerNode deliveryTimer;        // Inline delivery when the worker task is missing
+    
+    // Rules and client state are shared by the RX decode task and the main loop
+    SemaphoreHandle_t ruleMutex = nullptr;
+    inline bool lockRules(TickType_t ticksToWait) {
+        return (ruleMutex == nullptr) || (xSemaphoreTake(ruleMutex, ticksToWait) == pdTRUE);
+    }
+    inline void unlockRules() {
+        if (ruleMutex != nullptr) {
+            xSemaphoreGive(ruleMutex);
+        }
+    }
+    
+    AlertSeries* findSeries(uint8_t clientId, uint8_t channel, uint8_t valueType, bool create);
+    void sendRuleAlert(uint8_t clientId, uint8_t channel, uint8_t ruleIndex, const AlertRule& rule, float value);
+    
+    static void taskEntry(void* arg);
+    static void onOfflineDeadline(TimerNode* node, void* context);
+    static void onDeliveryDue(TimerNode* node, void* context);
+    void serviceQueue();
+    bool takeDueBatch(AlertBatch& out);
+    void requeueBatch(AlertBatch& batch, uint8_t failedChannels);
+    uint8_t deliverBatch(const AlertBatch& batch);
+    
     String getAlertTitle(AlertType type);
     String getAlertColor(AlertType type);
     String formatTeamsCard(const String& title, const String& message, const String& color, const String& details);
+    String formatBatchCard(const AlertBatch& batch);
+    bool postTeamsCard(const String& payload);
 };
 
 extern AlertManager alertManager;
@@ -3,23 +3,31 @@
 // Global instance
 ConfigStorage configStorage;
 
-ConfigStorage::ConfigStorage() {
+ConfigStorage::ConfigStorage() : cachedMode(MODE_UNCONFIGURED) {
+    memset(&cachedSensor, 0, sizeof(cachedSensor));
+    memset(&cachedBase, 0, sizeof(cachedBase));
+    memset(&cachedNtp, 0, sizeof(cachedNtp));
 }
 
 void ConfigStorage::begin() {
     prefs.begin("lora-config", false);
+    loadAll();
 }
 
-DeviceMode ConfigStorage::getDeviceMode() {
-    return (DeviceMode)prefs.getUChar("mode", MODE_UNCONFIGURED);
+void ConfigStorage::loadAll() {
+    cachedMode = (DeviceMode)prefs.getUChar("mode", MODE_UNCONFIGURED);
+    loadSensorConfig();
+    loadBaseStationConfig();
+    loadNTPConfig();
 }
 
 void ConfigStorage::setDeviceMode(DeviceMode mode) {
     prefs.putUChar("mode", mode);
+    cachedMode = mode;
 }
 
-SensorConfig ConfigStorage::getSensorConfig() {
-    SensorConfig config;
+void ConfigStorage::loadSensorConfig() {
+    SensorConfig& config = cachedSensor;
     config.sensorId = prefs.getUChar("sensor_id", 0);
     
     // Initialize location with default if not set
@@ -42,7 +50,6 @@ SensorConfig ConfigStorage::getSensorConfig() {
     config.meshEnabled = prefs.getBool("mesh_en", false);  // Disabled by default for backward compatibility
     config.meshForwarding = prefs.getBool("mesh_fwd", true);  // Forwarding enabled by default
     config.configured = (config.sensorId != 0);
-    return config;
 }
 
 void ConfigStorage::setSensorConfig(const SensorConfig& config) {
@@ -55,16 +62,18 @@ void ConfigStorage::setSensorConfig(const SensorConfig& config) {
     prefs.putUChar("client_type", config.clientType);
     prefs.putBool("mesh_en", config.meshEnabled);
     prefs.putBool("mesh_fwd", config.meshForwarding);
+    // network_id and mesh_en are shared with the base station view
+    loadSensorConfig();
+    loadBaseStationConfig();
 }
 
-BaseStationConfig ConfigStorage::getBaseStationConfig() {
-    BaseStationConfig config;
+void ConfigStorage::loadBaseStationConfig() {
+    BaseStationConfig& config = cachedBase;
     prefs.getString("wifi_ssid", config.ssid, sizeof(config.ssid));
     prefs.getString("wifi_pass", config.password, sizeof(config.password));
     config.networkId = prefs.getUShort("network_id", 12345);  // Default to 12345 if not set
     config.meshEnabled = prefs.getBool("mesh_en", false);  // Disabled by default for backward compatibility
     config.configured = (strlen(config.ssid) > 0);
-    return config;
 }
 
 void ConfigStorage::setBaseStationConfig(const BaseStationConfig& config) {
@@ -72,18 +81,21 @@ void ConfigStorage::setBaseStationConfig(const BaseStationConfig& config) {
     prefs.putString("wifi_pass", config.password);
     prefs.putUShort("network_id", config.networkId);
     prefs.putBool("mesh_en", config.meshEnabled);
+    loadBaseStationConfig();
+    loadSensorConfig();
 }
 
 void ConfigStorage::clearAll() {
     prefs.clear();
+    loadAll();
 }
 
-bool ConfigStorage::isFirstBoot() {
-    return (getDeviceMode() == MODE_UNCONFIGURED);
+bool ConfigStorage::isFirstBoot() const {
+    return (cachedMode == MODE_UNCONFIGURED);
 }
 
-NTPConfig ConfigStorage::getNTPConfig() {
-    NTPConfig cfg;
+void ConfigStorage::loadNTPConfig() {
+    NTPConfig& cfg = cachedNtp;
     cfg.enabled = prefs.getBool("ntp_en", true);
     
     // Check if key exists to avoid error spam in logs
@@ -98,7 +110,6 @@ NTPConfig ConfigStorage::getNTPConfig() {
     
     cfg.intervalSec = prefs.getUInt("ntp_int", 3600); // default 1 hour
     cfg.tzOffsetMinutes = (int16_t)prefs.getShort("tz_offset", 0);
-    return cfg;
 }
 
 void ConfigStorage::setNTPConfig(const NTPConfig& cfg) {
@@ -106,4 +117,5 @@ void ConfigStorage::setNTPConfig(const NTPConfig& cfg) {
     prefs.putString("ntp_srv", cfg.server);
     prefs.putUInt("ntp_int", cfg.intervalSec);
     prefs.putShort("tz_offset", cfg.tzOffsetMinutes);
+    loadNTPConfig();
 }
@@ -0,0 +1,89 @@
+/**
+ * @file crc16.cpp
+ * @brief Table-driven CRC-16 implementation
+ * @version 1.0.0
+ * @date 2026-10-16
+ */
+
+#include "crc16.h"
+
+// ====== COMPILE-TIME TABLE GENERATION ======
+// C++11 constexpr (single return statement), so the bit loop is written recursively.
+
+static constexpr uint16_t ccittShift(uint16_t crc, int bits) {
+    return bits == 0 ? crc
+                     : ccittShift((crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1),
+                                  bits - 1);
+}
+
+static constexpr uint16_t modbusShift(uint16_t crc, int bits) {
+    return bits == 0 ? crc
+                     : modbusShift((crc & 0x0001) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1),
+                                   bits - 1);
+}
+
+// slice 0: CRC of byte i; slice k: CRC of byte i followed by k zero bytes
+static constexpr uint16_t ccittEntry(int slice, int i) {
+    return slice == 0 ? ccittShift((uint16_t)(i << 8), 8)
+                      : (uint16_t)((ccittEntry(slice - 1, i) << 8) ^
+                                   ccittShift((uint16_t)(ccittEntry(slice - 1, i) & 0xFF00), 8));
+}
+
+static constexpr uint16_t modbusEntry(int /*slice*/, int i) {
+    return modbusShift((uint16_t)i, 8);
+}
+
+#define CRC16_ROW4(f, s, i)   f(s, (i)), f(s, (i) + 1), f(s, (i) + 2), f(s, (i) + 3)
+#define CRC16_ROW16(f, s, i)  CRC16_ROW4(f, s, (i)), CRC16_ROW4(f, s, (i) + 4), \
+                              CRC16_ROW4(f, s, (i) + 8), CRC16_ROW4(f, s, (i) + 12)
+#define CRC16_ROW64(f, s, i)  CRC16_ROW16(f, s, (i)), CRC16_ROW16(f, s, (i) + 16), \
+                              CRC16_ROW16(f, s, (i) + 32), CRC16_ROW16(f, s, (i) + 48)
+#define CRC16_TABLE(f, s)     { CRC16_ROW64(f, s, 0), CRC16_ROW64(f, s, 64), \
+                                CRC16_ROW64(f, s, 128), CRC16_ROW64(f, s, 192) }
+
+static constexpr uint16_t ccittTable[4][256] = {
+    CRC16_TABLE(ccittEntry, 0),
+    CRC16_TABLE(ccittEntry, 1),
+    CRC16_TABLE(ccittEntry, 2),
+    CRC16_TABLE(ccittEntry, 3)
+};
+
+static constexpr uint16_t modbusTable[256] = CRC16_TABLE(modbusEntry, 0);
+
+static_assert(ccittTable[0][1] == 0x1021, "CRC-16/CCITT table generation");
+static_assert(modbusTable[1] == 0xC0C1, "CRC-16/MODBUS table generation");
+
+// ====== CRC FUNCTIONS ======
+
+uint16_t crc16Ccitt(const uint8_t* data, size_t length, uint16_t crc) {
+    while (length--) {
+        crc = (uint16_t)(crc << 8) ^ ccittTable[0][(crc >> 8) ^ *data++];
+    }
+    return crc;
+}
+
+uint16_t crc16CcittSlice4(const uint8_t* data, size_t length, uint16_t crc) {
+    while (length >= 4) {
+        crc = ccittTable[3][(crc >> 8) ^ data[0]] ^
+              ccittTable[2][(crc & 0xFF) ^ data[1]] ^
+              ccittTable[1][data[2]] ^
+              ccittTable[0][data[3]];
+        data += 4;
+        length -= 4;
+    }
+    return crc16Ccitt(data, length, crc);
+}
+
+uint16_t crc16Modbus(const uint8_t* data, size_t length, uint16_t crc) {
+    while (length--) {
+        crc = (crc >> 8) ^ modbusTable[(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+bool crc16SelfTest() {
+    static const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    return crc16Ccitt(check, sizeof(check)) == 0x29B1 &&
+           crc16CcittSlice4(check, sizeof(check)) == 0x29B1 &&
+           crc16Modbus(check, sizeof(check)) == 0x4B37;
+}
@@ -1,8 +1,25 @@
 #include "data_types.h"
+#include "config.h"
+#include "crc16.h"
+#include <Arduino.h>
+#include <math.h>
 
 // ====== LEGACY CHECKSUM FUNCTIONS ======
 
 uint16_t calculateChecksum(SensorData* data) {
+  if (isCrc16SyncWord(data->syncWord, SYNC_WORD)) {
+    // Field by field: struct padding is not part of the checksum
+    uint16_t crc = crc16Ccitt((const uint8_t*)&data->syncWord, sizeof(data->syncWord));
+    crc = crc16Ccitt((const uint8_t*)&data->networkId, sizeof(data->networkId), crc);
+    crc = crc16Ccitt(&data->sensorId, sizeof(data->sensorId), crc);
+    crc = crc16Ccitt((const uint8_t*)&data->temperature, sizeof(data->temperature), crc);
+    crc = crc16Ccitt((const uint8_t*)&data->batteryVoltage, sizeof(data->batteryVoltage), crc);
+    crc = crc16Ccitt(&data->batteryPercent, sizeof(data->batteryPercent), crc);
+    crc = crc16Ccitt((const uint8_t*)&data->powerState, sizeof(data->powerState), crc);
+    crc = crc16CcittSlice4((const uint8_t*)data->location, sizeof(data->location), crc);
+    return crc16CcittSlice4((const uint8_t*)data->zone, sizeof(data->zone), crc);
+  }
+
   uint16_t sum = 0;
   sum += data->syncWord;
   sum += data->sensorId;
@@ -21,6 +38,14 @@ bool validateChecksum(SensorData* data) {
 // ====== NEW MULTI-SENSOR CHECKSUM FUNCTIONS ======
 
 uint16_t calculateMultiSensorChecksum(MultiSensorPacket* packet) {
+    if (isCrc16SyncWord(packet->header.syncWord, MULTI_SENSOR_SYNC_WORD)) {
+        // Header and values are contiguous in the packed struct, same as on air
+        uint8_t count = packet->header.valueCount;
+        if (count > MAX_VALUES_PER_PACKET) count = MAX_VALUES_PER_PACKET;
+        return crc16CcittSlice4((const uint8_t*)packet,
+                                sizeof(MultiSensorHeader) + count * sizeof(SensorValuePacket));
+    }
+
     uint16_t sum = 0;
     
     // Add header fields
@@ -54,3 +79,237 @@ size_t getMultiSensorPacketSize(MultiSensorPacket* packet) {
            sizeof(uint16_t);
 }
 
+
+// ====== COMPACT V3 PACKET FUNCTIONS ======
+
+// Fixed-point scale per ValueType (readings are sent as round(value * scale))
+static int32_t v3Scale(uint8_t type) {
+    switch (type) {
+        case VALUE_TEMPERATURE:     return 100;   // 0.01 C
+        case VALUE_HUMIDITY:        return 100;   // 0.01 %
+        case VALUE_PRESSURE:        return 100;   // 0.01 hPa
+        case VALUE_LIGHT:           return 10;    // 0.1 lx
+        case VALUE_VOLTAGE:         return 1000;  // 1 mV
+        case VALUE_CURRENT:         return 1000;
+        case VALUE_POWER:           return 100;
+        case VALUE_ENERGY:          return 1000;
+        case VALUE_GAS_RESISTANCE:  return 1;     // 1 ohm
+        case VALUE_BATTERY:         return 10;
+        case VALUE_SIGNAL_STRENGTH: return 1;
+        case VALUE_MOISTURE:        return 10;
+        default:                    return 100;
+    }
+}
+
+int32_t quantizeSensorValue(uint8_t type, float value) {
+    if (isnan(value)) {
+        value = SENSOR_NO_READING;  // lround(NaN) is undefined
+    }
+    double scaled = (double)value * v3Scale(type);
+    if (scaled > 2147483647.0) return INT32_MAX;
+    if (scaled < -2147483648.0) return INT32_MIN;
+    return (int32_t)lround(scaled);
+}
+
+float dequantizeSensorValue(uint8_t type, int32_t quantized) {
+    return (float)((double)quantized / v3Scale(type));
+}
+
+static size_t putVarint(uint8_t* out, size_t outSize, size_t pos, int32_t value) {
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);  // zigzag
+    do {
+        if (pos >= outSize) {
+            return 0;
+        }
+        uint8_t b = zz & 0x7F;
+        zz >>= 7;
+        out[pos++] = zz ? (b | 0x80) : b;
+    } while (zz);
+    return pos;
+}
+
+static bool getVarint(const uint8_t* buf, size_t len, size_t* pos, int32_t* value) {
+    uint32_t zz = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (*pos >= len) {
+            return false;
+        }
+        uint8_t b = buf[(*pos)++];
+        zz |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *value = (int32_t)((zz >> 1) ^ (~(zz & 1) + 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+void makeTelemetryReferenceV3(const MultiSensorPacket* packet, uint8_t frameSeq, TelemetryReferenceV3* ref) {
+    ref->valid = true;
+    ref->frameSeq = frameSeq;
+    ref->valueCount = min((int)packet->header.valueCount, MAX_VALUES_PER_PACKET);
+    for (uint8_t i = 0; i < ref->valueCount; i++) {
+        ref->types[i] = packet->values[i].type;
+        ref->quantized[i] = quantizeSensorValue(packet->values[i].type, packet->values[i].value);
+    }
+}
+
+size_t encodeMultiSensorV3(const MultiSensorPacket* packet, uint8_t frameSeq, bool ackRequest,
+                           const TelemetryReferenceV3* ref, uint8_t* out, size_t outSize,
+                           const uint32_t* clock) {
+    uint8_t count = min((int)packet->header.valueCount, MAX_VALUES_PER_PACKET);
+    
+    int32_t quantized[MAX_VALUES_PER_PACKET];
+    for (uint8_t i = 0; i < count; i++) {
+        quantized[i] = quantizeSensorValue(packet->values[i].type, packet->values[i].value);
+    }
+    
+    // Delta only when the reference has exactly the same value layout and every
+    // difference fits an int32 (saturated readings can be a full range apart)
+    bool delta = (ref != nullptr && ref->valid && !ackRequest && ref->valueCount == count);
+    for (uint8_t i = 0; delta && i < count; i++) {
+        int64_t diff = (int64_t)quantized[i] - ref->quantized[i];
+        if (ref->types[i] != packet->values[i].type || diff < INT32_MIN || diff > INT32_MAX) {
+            delta = false;
+        }
+    }
+    
+    MultiSensorHeaderV3 hdr;
+    hdr.syncWord = MULTI_SENSOR_SYNC_WORD;
+    hdr.networkId = packet->header.networkId;
+    hdr.packetType = PACKET_MULTI_SENSOR_V3;
+    hdr.sensorId = packet->header.sensorId;
+    hdr.valueCount = count;
+    hdr.batteryPercent = packet->header.batteryPercent;
+    hdr.flags = (packet->header.powerState ? V3_FLAG_POWER_STATE : 0) |
+                (delta ? V3_FLAG_DELTA : 0) |
+                (ackRequest ? V3_FLAG_ACK_REQ : 0) |
+                (clock != nullptr ? V3_FLAG_CLOCK : 0);
+    hdr.lastCommandSeq = packet->header.lastCommandSeq;
+    hdr.ackStatus = packet->header.ackStatus;
+    hdr.frameSeq = frameSeq;
+    
+    if (outSize < sizeof(hdr) + (clock != nullptr ? sizeof(uint32_t) : 0) + 1 + sizeof(uint16_t)) {
+        return 0;
+    }
+    memcpy(out, &hdr, sizeof(hdr));
+    size_t pos = sizeof(hdr);
+    if (clock != nullptr) {
+        memcpy(out + pos, clock, sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+    }
+    if (delta) {
+        out[pos++] = ref->frameSeq;
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        int32_t q = quantized[i];
+        if (delta) {
+            pos = putVarint(out, outSize, pos, (int32_t)((int64_t)q - ref->quantized[i]));
+        } else {
+            if (pos >= outSize) {
+                return 0;
+            }
+            out[pos++] = packet->values[i].type;
+            pos = putVarint(out, outSize, pos, q);
+        }
+        if (pos == 0) {
+            return 0;
+        }
+    }
+    
+    if (pos + sizeof(uint16_t) > outSize) {
+        return 0;
+    }
+    uint16_t checksum = crc16CcittSlice4(out, pos);
+    memcpy(out + pos, &checksum, sizeof(uint16_t));
+    return pos + sizeof(uint16_t);
+}
+
+bool decodeMultiSensorV3(const uint8_t* buf, size_t len, const TelemetryReferenceV3* ref,
+                         MultiSensorPacket* packet, uint8_t* frameSeq, uint8_t* flags,
+                         bool* refMissing, uint32_t* clock) {
+    *refMissing = false;
+    if (len < sizeof(MultiSensorHeaderV3) + sizeof(uint16_t)) {
+        return false;
+    }
+    
+    uint16_t receivedChecksum;
+    memcpy(&receivedChecksum, buf + len - sizeof(uint16_t), sizeof(uint16_t));
+    if (receivedChecksum != crc16CcittSlice4(buf, len - sizeof(uint16_t))) {
+        return false;
+    }
+    size_t end = len - sizeof(uint16_t);
+    
+    MultiSensorHeaderV3 hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.packetType != PACKET_MULTI_SENSOR_V3 || hdr.valueCount > MAX_VALUES_PER_PACKET) {
+        return false;
+    }
+    
+    memset(packet, 0, sizeof(MultiSensorPacket));
+    packet->header.syncWord = hdr.syncWord;
+    packet->header.networkId = hdr.networkId;
+    packet->header.packetType = PACKET_MULTI_SENSOR_V3;
+    packet->header.sensorId = hdr.sensorId;
+    packet->header.valueCount = hdr.valueCount;
+    packet->header.batteryPercent = hdr.batteryPercent;
+    packet->header.powerState = (hdr.flags & V3_FLAG_POWER_STATE) ? 1 : 0;
+    packet->header.lastCommandSeq = hdr.lastCommandSeq;
+    packet->header.ackStatus = hdr.ackStatus;
+    *frameSeq = hdr.frameSeq;
+    *flags = hdr.flags;
+    
+    size_t pos = sizeof(hdr);
+    if (hdr.flags & V3_FLAG_CLOCK) {
+        if (pos + sizeof(uint32_t) > end) {
+            return false;
+        }
+        if (clock != nullptr) {
+            memcpy(clock, buf + pos, sizeof(uint32_t));
+        }
+        pos += sizeof(uint32_t);
+    }
+    bool delta = (hdr.flags & V3_FLAG_DELTA) != 0;
+    if (delta) {
+        if (pos >= end) {
+            return false;
+        }
+        uint8_t refSeq = buf[pos++];
+        if (ref == nullptr || !ref->valid || ref->frameSeq != refSeq || ref->valueCount != hdr.valueCount) {
+            *refMissing = true;
+            return false;
+        }
+    }
+    
+    for (uint8_t i = 0; i < hdr.valueCount; i++) {
+        uint8_t type;
+        int32_t v;
+        if (delta) {
+            type = ref->types[i];
+        } else {
+            if (pos >= end) {
+                return false;
+            }
+            type = buf[pos++];
+        }
+        if (!getVarint(buf, end, &pos, &v)) {
+            return false;
+        }
+        if (delta) {
+            int64_t sum = (int64_t)v + ref->quantized[i];
+            if (sum < INT32_MIN || sum > INT32_MAX) {
+                return false;
+            }
+            v = (int32_t)sum;
+        }
+        packet->values[i].type = type;
+        packet->values[i].value = dequantizeSensorValue(type, v);
+    }
+    
+    return pos == end;
+}
+
+uint16_t calculateTelemetryAckChecksum(const TelemetryAckPacket* ack) {
+    return crc16CcittSlice4((const uint8_t*)ack, sizeof(TelemetryAckPacket) - sizeof(uint16_t));
+}
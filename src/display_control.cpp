@@ -10,6 +10,11 @@
 #include <qrcode.h>
 #include <Preferences.h>
 #include <time.h>
+#ifdef BASE_STATION
+#include "sensor_config.h"
+#include "timeseries_store.h"
+extern SensorConfigManager sensorConfigManager;
+#endif
 
 static SSD1306Wire display(0x3c, 500000, SDA_OLED, SCL_OLED, GEOMETRY_128_64, RST_OLED);
 static bool displayOn = true;
@@ -237,6 +242,11 @@ void handleButton() {
       // Triple click = Reboot
       Serial.println("Triple click: Rebooting...");
       displayMessage("Rebooting...", "", "", 1000);
+      #ifdef BASE_STATION
+      sensorConfigManager.checkpointHealthScores();
+      timeSeriesStore.flush();
+      #endif
+      securityManager.checkpointReplayWindows();
       ESP.restart();
     }
     
@@ -405,6 +415,7 @@ void displayBaseStationPage() {
       // Show oldest sensor last seen time
       if (totalCount > 0) {
         uint32_t oldestTime = 0;
+        lockStats();
         for (uint8_t i = 0; i < totalCount; i++) {
           SensorInfo* sensor = getSensorByIndex(i);
           if (sensor) {
@@ -412,6 +423,7 @@ void displayBaseStationPage() {
             if (secAgo > oldestTime) oldestTime = secAgo;
           }
         }
+        unlockStats();
         display.drawString(0, 38, "Oldest: " + String(oldestTime) + "s ago");
       }
       
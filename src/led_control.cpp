@@ -4,6 +4,23 @@
 
 static Adafruit_NeoPixel strip(NUM_LEDS, LED_PIN, NEO_GRB + NEO_KHZ800);
 
+struct LEDBlink {
+  uint32_t color;
+  uint32_t restColor;
+  uint16_t intervalMs;
+  uint8_t times;
+};
+
+// Posted by any task, taken by serviceLED()
+static portMUX_TYPE ledMux = portMUX_INITIALIZER_UNLOCKED;
+static LEDBlink requestedBlink;
+static bool blinkRequested = false;
+
+// Blink being played (main loop only)
+static LEDBlink activeBlink;
+static uint8_t blinkStepsLeft = 0;  // On/off half-periods still to show
+static uint32_t blinkStepStartMs = 0;
+
 void initLED() {
   strip.begin();
   strip.setBrightness(50);  // 0-255
@@ -32,6 +49,44 @@ void blinkLED(uint32_t color, int times, int delayMs) {
   }
 }
 
+void requestLEDBlink(uint32_t color, uint8_t times, uint16_t intervalMs, uint32_t restColor) {
+  portENTER_CRITICAL(&ledMux);
+  requestedBlink = { color, restColor, intervalMs, times };
+  blinkRequested = true;
+  portEXIT_CRITICAL(&ledMux);
+}
+
+void serviceLED() {
+  bool start = false;
+  portENTER_CRITICAL(&ledMux);
+  if (blinkRequested) {
+    activeBlink = requestedBlink;
+    blinkRequested = false;
+    start = true;
+  }
+  portEXIT_CRITICAL(&ledMux);
+
+  const uint8_t brightness = strip.getBrightness();
+  if (start) {
+    blinkStepsLeft = activeBlink.times * 2;
+    blinkStepStartMs = millis();
+    setLED(activeBlink.color, brightness);
+    return;
+  }
+  if (blinkStepsLeft == 0 || millis() - blinkStepStartMs < activeBlink.intervalMs) {
+    return;
+  }
+
+  blinkStepsLeft--;
+  blinkStepStartMs = millis();
+  if (blinkStepsLeft == 0) {
+    setLED(activeBlink.restColor);
+  } else {
+    // Odd steps are the off half of a blink
+    setLED((blinkStepsLeft % 2) ? getColorOff() : activeBlink.color, brightness);
+  }
+}
+
 // Color definitions
 uint32_t getColorOff()    { return strip.Color(0, 0, 0); }
 uint32_t getColorGreen()  { return strip.Color(0, 255, 0); }
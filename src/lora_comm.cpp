@@ -11,12 +11,14 @@
 #ifdef BASE_STATION
 #include "mqtt_client.h"
 #include "remote_config.h"
+#include "tx_scheduler.h"
 #endif
 #ifdef SENSOR_NODE
 #include "remote_config.h"
 #include "buzzer.h"
 #endif
 #include <Arduino.h>
+#include <atomic>
 #include <sys/time.h>
 #include "time_status.h"
 #include "logger.h"
@@ -26,11 +28,189 @@ static bool lora_idle = true;
 static uint16_t currentNetworkId = 0;  // Current network ID for validation
 
 #ifdef BASE_STATION
-static bool pendingWebSocketBroadcast = false;  // Flag to trigger broadcast from main loop
-static bool pendingCommandSend = false;  // Flag to send command from main loop
-static uint8_t pendingCommandSensorId = 0;
-static uint32_t pendingCommandReadyAtMs = 0;
+// Set by the RX decode task, consumed by the main loop
+static volatile bool pendingWebSocketBroadcast = false;  // Flag to trigger broadcast from main loop
+static volatile bool pendingCommandSend = false;  // Flag to send command from main loop
+static volatile uint8_t pendingCommandSensorId = 0;
+static volatile uint32_t pendingCommandReadyAtMs = 0;
 static const uint32_t BASE_RX_TO_TX_HOLDDOWN_MS = 120;  // allow radio to settle after RX before TX
+
+// RX ring: single producer (OnRxDone, main loop via Radio.IrqProcess) and single
+// consumer (RX decode task). Slots are preallocated; head/tail are free-running.
+static_assert((RX_QUEUE_DEPTH & (RX_QUEUE_DEPTH - 1)) == 0, "RX_QUEUE_DEPTH must be a power of two");
+
+struct RxFrame {
+  uint8_t data[MAX_PACKET_SIZE];
+  uint16_t size;
+  int16_t rssi;
+  int8_t snr;
+};
+
+static RxFrame rxRing[RX_QUEUE_DEPTH];
+static std::atomic<uint32_t> rxRingHead(0);  // written by producer only
+static std::atomic<uint32_t> rxRingTail(0);  // written by consumer only
+static uint16_t rxQueueHighWater = 0;
+static uint32_t rxQueueDrops = 0;
+static uint32_t rxQueueEnqueued = 0;
+static uint32_t rxQueueProcessed = 0;
+static TaskHandle_t rxDecodeTaskHandle = nullptr;
+
+static bool rxRingPush(const uint8_t* payload, uint16_t size, int16_t rssi, int8_t snr) {
+  uint32_t head = rxRingHead.load(std::memory_order_relaxed);
+  uint32_t tail = rxRingTail.load(std::memory_order_acquire);
+  uint32_t depth = head - tail;
+  if (depth >= RX_QUEUE_DEPTH || size > MAX_PACKET_SIZE) {
+    rxQueueDrops++;
+    return false;
+  }
+
+  RxFrame& frame = rxRing[head & (RX_QUEUE_DEPTH - 1)];
+  memcpy(frame.data, payload, size);
+  frame.size = size;
+  frame.rssi = rssi;
+  frame.snr = snr;
+  rxRingHead.store(head + 1, std::memory_order_release);
+
+  rxQueueEnqueued++;
+  if (depth + 1 > rxQueueHighWater) {
+    rxQueueHighWater = depth + 1;
+  }
+  return true;
+}
+
+// Returns the oldest queued frame (still owned by the ring until rxRingPop)
+static RxFrame* rxRingPeek() {
+  uint32_t tail = rxRingTail.load(std::memory_order_relaxed);
+  if (tail == rxRingHead.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return &rxRing[tail & (RX_QUEUE_DEPTH - 1)];
+}
+
+static void rxRingPop() {
+  rxRingTail.store(rxRingTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  rxQueueProcessed++;
+}
+
+static void processReceivedFrame(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr);
+static void rxDecodeTask(void *param);
+
+void getRxQueueStats(RxQueueStats& out) {
+  out.depth = (uint16_t)(rxRingHead.load(std::memory_order_acquire) - rxRingTail.load(std::memory_order_acquire));
+  out.capacity = RX_QUEUE_DEPTH;
+  out.highWater = rxQueueHighWater;
+  out.drops = rxQueueDrops;
+  out.enqueued = rxQueueEnqueued;
+  out.processed = rxQueueProcessed;
+}
+
+// Compact v3 telemetry: per-sensor delta references (keyframes we have ACKed)
+#define V3_REFERENCE_SLOTS 16
+struct SensorReferenceSlot {
+  uint8_t sensorId;  // 0 = free
+  uint32_t lastUsedMs;
+  TelemetryReferenceV3 ref;
+};
+static SensorReferenceSlot v3References[V3_REFERENCE_SLOTS];
+static uint32_t v3ReferenceMisses = 0;
+static uint32_t v3TelemetryAcksSent = 0;
+
+// Keyframe ACK scheduled after RX hold-down (queued commands take precedence)
+static volatile bool pendingTelemetryAck = false;
+static volatile uint8_t pendingTelemetryAckSensorId = 0;
+static volatile uint8_t pendingTelemetryAckSeq = 0;
+static volatile uint32_t pendingTelemetryAckReadyAtMs = 0;
+
+// Per-sensor size/airtime of the last telemetry frame vs. the other formats
+static PacketEfficiency packetEfficiency[256];
+static PacketEfficiencyTotals packetEfficiencyTotals;
+
+// Per-sensor command frame airtime (short form vs. full struct)
+static CommandAirtime commandAirtime[256];
+static CommandAirtime commandAirtimeTotals;
+
+static TelemetryReferenceV3* findTelemetryReference(uint8_t sensorId, bool create) {
+  SensorReferenceSlot* victim = nullptr;
+  for (int i = 0; i < V3_REFERENCE_SLOTS; i++) {
+    SensorReferenceSlot& slot = v3References[i];
+    if (slot.sensorId == sensorId) {
+      slot.lastUsedMs = millis();
+      return &slot.ref;
+    }
+    // Prefer a free slot, otherwise the least recently used one
+    if (victim == nullptr || (victim->sensorId != 0 &&
+        (slot.sensorId == 0 || slot.lastUsedMs < victim->lastUsedMs))) {
+      victim = &slot;
+    }
+  }
+  if (!create) {
+    return nullptr;
+  }
+  memset(victim, 0, sizeof(SensorReferenceSlot));
+  victim->sensorId = sensorId;
+  victim->lastUsedMs = millis();
+  return &victim->ref;
+}
+
+static uint16_t airtimeMs(size_t bytes) {
+  return txScheduler.timeOnAirMs(min(bytes, (size_t)MAX_PACKET_SIZE));
+}
+
+static void recordPacketEfficiency(uint8_t sensorId, uint8_t format, uint16_t bytes, const MultiSensorPacket* decoded) {
+  PacketEfficiency& e = packetEfficiency[sensorId];
+  e.format = format;
+  e.valueCount = decoded ? decoded->header.valueCount : 1;
+  e.bytes = bytes;
+  e.v2Bytes = MULTI_SENSOR_V2_SIZE(e.valueCount);
+  e.v3Bytes = bytes;
+  if (decoded != nullptr && format != PACKET_MULTI_SENSOR_V3) {
+    uint8_t scratch[MAX_PACKET_SIZE];
+    e.v3Bytes = encodeMultiSensorV3(decoded, 0, true, nullptr, scratch, sizeof(scratch));
+  }
+  e.airtimeMs = airtimeMs(e.bytes);
+  e.v2AirtimeMs = airtimeMs(e.v2Bytes);
+  e.v3AirtimeMs = airtimeMs(e.v3Bytes);
+
+  packetEfficiencyTotals.packets++;
+  packetEfficiencyTotals.bytes += e.bytes;
+  packetEfficiencyTotals.v2Bytes += e.v2Bytes;
+  packetEfficiencyTotals.airtimeMs += e.airtimeMs;
+  packetEfficiencyTotals.v2AirtimeMs += e.v2AirtimeMs;
+}
+
+bool getPacketEfficiency(uint8_t sensorId, PacketEfficiency& out) {
+  out = packetEfficiency[sensorId];
+  return out.bytes != 0;
+}
+
+void getPacketEfficiencyTotals(PacketEfficiencyTotals& out) {
+  out = packetEfficiencyTotals;
+  out.v3ReferenceMisses = v3ReferenceMisses;
+  out.v3AcksSent = v3TelemetryAcksSent;
+}
+
+static void recordCommandAirtime(CommandAirtime& a, size_t frameSize) {
+  uint16_t fullMs = airtimeMs(sizeof(CommandPacket));
+  a.sent++;
+  a.lastBytes = frameSize;
+  a.lastAirtimeMs = airtimeMs(frameSize);
+  a.lastSavedMs = (fullMs > a.lastAirtimeMs) ? (fullMs - a.lastAirtimeMs) : 0;
+  a.totalSavedMs += a.lastSavedMs;
+}
+
+static void recordCommandSent(uint8_t sensorId, size_t frameSize) {
+  recordCommandAirtime(commandAirtime[sensorId], frameSize);
+  recordCommandAirtime(commandAirtimeTotals, frameSize);
+}
+
+bool getCommandAirtime(uint8_t sensorId, CommandAirtime& out) {
+  out = commandAirtime[sensorId];
+  return out.sent != 0;
+}
+
+void getCommandAirtimeTotals(CommandAirtime& out) {
+  out = commandAirtimeTotals;
+}
 #endif
 
 #ifdef SENSOR_NODE
@@ -41,6 +221,12 @@ static uint32_t forcedIntervalUntil = 0;  // Timestamp until which to use forced
 static const uint32_t FORCED_INTERVAL_MS = 10000;  // 10 seconds
 static const uint32_t FORCED_INTERVAL_DURATION = 30000;  // Keep forced interval for 30 seconds after command
 static uint32_t ackFieldsValidUntil = 0;  // keep lastCommandSeq/ackStatus valid for a short window
+
+// Compact v3 telemetry state
+static uint8_t v3FrameSeq = 0;
+static uint8_t v3FramesSinceKeyframe = 0;
+static TelemetryReferenceV3 v3AckedReference = {};   // Keyframe the base confirmed
+static TelemetryReferenceV3 v3PendingReference = {}; // Last keyframe sent, awaiting ACK
 #endif
 
 // Calculate LoRa sync word from network ID
@@ -53,11 +239,21 @@ uint8_t calculateSyncWord(uint16_t networkId) {
 #ifdef BASE_STATION
 void sendCommandNow(uint8_t sensorId);
 
+// Every reserved base station frame goes out through here, so a frame that
+// never reaches the air hands its airtime back to the budget
+static bool sendReservedFrame(const uint8_t* frame, size_t size, TxPriority priority) {
+  if (!sendFrame(frame, size)) {
+    txScheduler.refund(size + securityManager.getFrameOverhead(), priority);
+    return false;
+  }
+  return true;
+}
+
 // Broadcast wake ping: wakes all listening sensors and shows "Cmd Recv'd".
 // This is intentionally NOT queued/tracked for ACKs to avoid collisions.
 void sendBroadcastWakePing() {
   CommandPacket cmd;
-  cmd.syncWord = COMMAND_SYNC_WORD;
+  cmd.syncWord = txSyncWord(COMMAND_SYNC_WORD);
   cmd.commandType = CMD_PING;
   cmd.targetSensorId = 0xFF;  // broadcast
   cmd.sequenceNumber = 0;     // not tracked/acked
@@ -65,18 +261,223 @@ void sendBroadcastWakePing() {
   memset(cmd.data, 0, sizeof(cmd.data));
 
   extern RemoteConfigManager remoteConfigManager;
-  size_t checksumLength = sizeof(CommandPacket) - sizeof(uint16_t);
-  cmd.checksum = remoteConfigManager.calculateChecksum((const uint8_t*)&cmd, checksumLength);
+  uint8_t frame[sizeof(CommandPacket)];
+  size_t frameSize = remoteConfigManager.encodeCommandFrame(cmd, frame, sizeof(frame));
+
+  // Lowest priority: first thing to go when the channel budget runs low
+  if (!txScheduler.reserve(frameSize + securityManager.getFrameOverhead(), TX_PRIORITY_BROADCAST)) {
+    LOGW("CMD", "Broadcast wake ping skipped: airtime budget exhausted");
+    return;
+  }
 
   // Preempt RX and transmit immediately.
   Radio.Standby();
   delay(20);
-  Radio.Send((uint8_t*)&cmd, sizeof(CommandPacket));
+  if (!sendReservedFrame(frame, frameSize, TX_PRIORITY_BROADCAST)) {
+    return;
+  }
   lora_idle = false;
-  LOGI("CMD", "Broadcast wake ping sent (CMD_PING, target=0xFF)");
+  recordCommandSent(cmd.targetSensorId, frameSize + securityManager.getFrameOverhead());
+  LOGI("CMD", "Broadcast wake ping sent (CMD_PING, target=0xFF, %d bytes)", (int)frameSize);
+}
+
+// CMD_TIME_SYNC payload: UTC epoch seconds + timezone offset in minutes.
+// False until NTP has set our clock.
+static bool buildTimeSyncPayload(uint8_t* payload) {
+  time_t now = time(nullptr);
+  if (now < (time_t)TIME_VALID_EPOCH) {
+    return false;
+  }
+  uint32_t epoch = (uint32_t)now;
+  int16_t tz = configStorage.getNTPConfigRef().tzOffsetMinutes;
+  memcpy(&payload[0], &epoch, sizeof(uint32_t));
+  memcpy(&payload[4], &tz, sizeof(int16_t));
+  return true;
+}
+
+// Broadcast time beacon: one CMD_TIME_SYNC to 0xFF that every listening sensor
+// applies without an ACK. Sensors that miss it are caught by their next clock
+// report (checkSensorClock).
+bool sendTimeBeacon() {
+  CommandPacket cmd;
+  cmd.syncWord = txSyncWord(COMMAND_SYNC_WORD);
+  cmd.commandType = CMD_TIME_SYNC;
+  cmd.targetSensorId = 0xFF;  // broadcast
+  cmd.sequenceNumber = 0;     // not tracked/acked
+  cmd.dataLength = 6;
+  memset(cmd.data, 0, sizeof(cmd.data));
+  if (!buildTimeSyncPayload(cmd.data)) {
+    return false;
+  }
+  if (!isLoRaIdle()) {
+    return false;
+  }
+
+  extern RemoteConfigManager remoteConfigManager;
+  uint8_t frame[sizeof(CommandPacket)];
+  size_t frameSize = remoteConfigManager.encodeCommandFrame(cmd, frame, sizeof(frame));
+  if (!txScheduler.reserve(frameSize + securityManager.getFrameOverhead(), TX_PRIORITY_TIME_SYNC)) {
+    LOGW("TIME", "Time beacon deferred: airtime budget exhausted");
+    return false;
+  }
+
+  Radio.Standby();
+  if (!sendReservedFrame(frame, frameSize, TX_PRIORITY_TIME_SYNC)) {
+    return false;
+  }
+  lora_idle = false;
+  recordCommandSent(cmd.targetSensorId, frameSize + securityManager.getFrameOverhead());
+  resetAllClientClockReferences();
+  LOGI("TIME", "Time beacon sent (target=0xFF, %d bytes)", (int)frameSize);
+  return true;
+}
+
+// Queue an ACK-tracked CMD_TIME_SYNC for one sensor
+static bool queueTimeSync(uint8_t sensorId) {
+  extern RemoteConfigManager remoteConfigManager;
+  uint8_t payload[6];
+  return buildTimeSyncPayload(payload) &&
+         remoteConfigManager.queueCommand(sensorId, CMD_TIME_SYNC, payload, sizeof(payload));
+}
+
+// Clock report from a v3 keyframe: track the sensor's offset from our local time
+// and follow up with a unicast time sync if it missed the beacon or drifted
+static void checkSensorClock(uint8_t sensorId, uint32_t sensorClock) {
+  time_t now = time(nullptr);
+  if (now < (time_t)TIME_VALID_EPOCH) {
+    return;  // Nothing to compare against before NTP
+  }
+  const int32_t localNow = (int32_t)now + configStorage.getNTPConfigRef().tzOffsetMinutes * 60;
+  const bool synced = (sensorClock != 0);
+  const int32_t offsetS = synced ? (int32_t)(sensorClock - (uint32_t)localNow) : 0;
+  recordClientClock(sensorId, synced, offsetS);
+  if (synced && abs(offsetS) <= TIME_SYNC_DRIFT_LIMIT_S) {
+    return;
+  }
+
+  // Commands already queued (typically the time sync answering a boot announce)
+  // go first; the next keyframe shows whether a resync is still needed
+  extern RemoteConfigManager remoteConfigManager;
+  lockStats();
+  ClientInfo* client = getClientInfo(sensorId);
+  const bool tracked = (client != NULL);
+  const uint32_t followUpMs = tracked ? client->clock.followUpMs : 0;
+  unlockStats();
+  if (!tracked || remoteConfigManager.getQueuedCount(sensorId) > 0 ||
+      (followUpMs != 0 && millis() - followUpMs < TIME_SYNC_FOLLOWUP_HOLDOFF_MS)) {
+    return;
+  }
+  if (queueTimeSync(sensorId)) {
+    lockStats();
+    client = getClientInfo(sensorId);
+    if (client != NULL) {
+      client->clock.followUpMs = millis();
+      client->clock.refMs = 0;  // Clock is about to be set; restart the drift estimate
+    }
+    unlockStats();
+    if (synced) {
+      LOGI("TIME", "Sensor %d clock off by %ld s - queued time sync", sensorId, (long)offsetS);
+    } else {
+      LOGI("TIME", "Sensor %d clock not set - queued time sync", sensorId);
+    }
+  }
 }
 #endif
 
+// Mesh frames (own packets, relays, RREQ/RREP, beacons) leave through here.
+// Called from meshRouter.loop(); a busy radio just leaves the frame queued.
+static bool meshTransmit(void* context, const uint8_t* frame, size_t size) {
+  (void)context;
+  if (!lora_idle) {
+    return false;
+  }
+  #ifdef BASE_STATION
+    // Flooded frames (RREQ, beacons) are the first to shed; unicast relays and
+    // route replies keep discovery and delivery working on a busy channel
+    const uint8_t type = ((const MeshHeader*)frame)->packetType;
+    const TxPriority priority = (type == MESH_ROUTE_REQUEST || type == MESH_NEIGHBOR_BEACON)
+                                    ? TX_PRIORITY_BROADCAST : TX_PRIORITY_DATA;
+    if (!txScheduler.reserve(size + securityManager.getFrameOverhead(), priority)) {
+      return false;
+    }
+    Radio.Standby();
+    const bool sent = sendReservedFrame(frame, size, priority);
+  #else
+    Radio.Standby();
+    const bool sent = sendFrame(frame, size);
+  #endif
+  if (!sent) {
+    return false;
+  }
+  lora_idle = false;
+  return true;
+}
+
+// Every frame type goes on air through here. With encryption on, the frame is
+// sealed straight into the envelope (AES-CCM is length-preserving, so the only
+// cost is the fixed SECURE_FRAME_OVERHEAD bytes).
+bool sendFrame(const uint8_t* frame, size_t size) {
+  if (!securityManager.isEncryptionEnabled()) {
+    Radio.Send((uint8_t*)frame, size);
+    return true;
+  }
+
+  #ifdef BASE_STATION
+    const uint8_t senderId = SECURE_BASE_SENDER_ID;
+  #else
+    const uint8_t senderId = configStorage.getSensorConfigRef().sensorId;
+  #endif
+
+  EncryptedPacket sealed;
+  uint16_t sealedSize = 0;
+  if (size <= SECURE_MAX_PAYLOAD) {
+    sealedSize = securityManager.encryptPacket(frame, (uint16_t)size, &sealed, senderId, currentNetworkId);
+  }
+  if (sealedSize == 0) {
+    LOGE("TX", "Encryption failed for %d byte frame", (int)size);
+    return false;
+  }
+
+  LOGD("TX", "Encrypted frame: %d -> %d bytes", (int)size, sealedSize);
+  Radio.Send((uint8_t*)&sealed, sealedSize);
+  return true;
+}
+
+// Unwraps an encrypted envelope in place: on success payload/size describe the
+// plaintext inside the same buffer, so decoders never see a copy. While
+// encryption is on, cleartext frames are refused.
+static bool openSecureFrame(uint8_t*& payload, uint16_t& size) {
+  const bool sealed = (size >= SECURE_FRAME_OVERHEAD && payload[0] == ENCRYPTED_PACKET_TYPE);
+  if (!securityManager.isEncryptionEnabled()) {
+    if (sealed) {
+      LOGW("RX", "Encrypted frame dropped: encryption is disabled");
+      return false;
+    }
+    return true;
+  }
+  if (!sealed) {
+    LOGW("RX", "Cleartext %d byte frame dropped: encryption is enabled", size);
+    return false;
+  }
+
+  EncryptedPacket* envelope = (EncryptedPacket*)payload;
+  if (envelope->networkId != currentNetworkId) {
+    LOGD("RX", "Encrypted frame from other network (%d) ignored", envelope->networkId);
+    return false;
+  }
+
+  uint16_t plainSize = securityManager.decryptPacket(envelope, size, envelope->payload,
+                                                     sizeof(envelope->payload));
+  if (plainSize == 0) {
+    LOGW("RX", "Encrypted frame from %d rejected", envelope->sensorId);
+    return false;
+  }
+
+  payload = envelope->payload;
+  size = plainSize;
+  return true;
+}
+
 // Extern declarations
 
 void initLoRa() {
@@ -197,7 +598,29 @@ void initLoRa() {
     0, true, 0, 0, LORA_IQ_INVERSION_ON, true  // Max payload 0 = use variable length mode
   );
   
+  meshRouter.setTransmitter(meshTransmit);
+  
   #ifdef BASE_STATION
+    // Airtime budget follows the parameters actually applied above
+    static const uint32_t bwHz[] = {125000, 250000, 500000};
+    LoRaModemParams modem;
+    modem.spreadingFactor = spreadingFactor;
+    modem.bandwidthHz = (bwEnum < 3) ? bwHz[bwEnum] : LORA_BANDWIDTH;
+    modem.codingRate = codingRate;
+    modem.preambleLength = LORA_PREAMBLE_LENGTH;
+    modem.crcOn = true;
+    modem.implicitHeader = LORA_FIX_LENGTH_PAYLOAD_ON;
+    txScheduler.begin(modem);
+
+    // Start the RX decode task on the core not running loop()
+    if (rxDecodeTaskHandle == nullptr) {
+      BaseType_t ok = xTaskCreatePinnedToCore(rxDecodeTask, "rx_decode", RX_DECODE_TASK_STACK, nullptr,
+                                              RX_DECODE_TASK_PRIORITY, &rxDecodeTaskHandle, RX_DECODE_TASK_CORE);
+      if (ok != pdPASS) {
+        rxDecodeTaskHandle = nullptr;
+        LOGE("LORA", "Failed to start RX decode task; decoding inline");
+      }
+    }
     LOGI("LORA", "Base ready; listening for sensors");
     LOGI("LORA", "Frequency: %u Hz", frequency);
     LOGI("LORA", "BW: %d, SF: %d, CR: %d", bwEnum, spreadingFactor, codingRate);
@@ -225,31 +648,15 @@ void sendSensorData(const SensorData& data) {
   Radio.Sleep();
   delay(10);
   
-  // Check if encryption is enabled
-  if (securityManager.isEncryptionEnabled()) {
-    LOGD("TX", "Encrypting packet...");
-    EncryptedPacket encryptedPkt;
-    uint16_t encLen = securityManager.encryptPacket(
-      (const uint8_t*)&data, 
-      sizeof(SensorData),
-      &encryptedPkt,
-      data.sensorId,
-      data.networkId
-    );
-    
-    if (encLen > 0) {
-      LOGD("TX", "Encrypted packet size: %d bytes", encLen);
-      Radio.Send((uint8_t*)&encryptedPkt, encLen);
-    } else {
-      LOGE("TX", "Encryption failed");
+  LOGD("TX", "Packet size: %d bytes", sizeof(SensorData) + securityManager.getFrameOverhead());
+  #ifdef SENSOR_NODE
+    sendTelemetryFrame((const uint8_t*)&data, sizeof(SensorData));
+  #else
+    if (!sendFrame((const uint8_t*)&data, sizeof(SensorData))) {
       return;
     }
-  } else {
-    LOGD("TX", "Packet size: %d bytes (unencrypted)", sizeof(SensorData));
-    Radio.Send((uint8_t*)&data, sizeof(SensorData));
-  }
-  
-  lora_idle = false;
+    lora_idle = false;
+  #endif
 }
 
 void enterRxMode() {
@@ -290,595 +697,537 @@ void OnTxDone() {
   #endif
 }
 
-void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
-  // Check for null payload first
-  if (payload == nullptr) {
-    LOGE("RX", "OnRxDone called with null payload");
-    return;
+#ifdef BASE_STATION
+// Battery level feedback for a received frame. Decoding runs on the RX decode
+// task, so the blink is handed to the main loop instead of delaying here.
+static void showBatteryBlink(uint8_t batteryPercent) {
+  if (batteryPercent > 80) {
+    requestLEDBlink(getColorGreen(), 1, 200, getColorGreen());
+  } else if (batteryPercent > 50) {
+    requestLEDBlink(getColorYellow(), 1, 200, getColorGreen());
+  } else if (batteryPercent > 20) {
+    requestLEDBlink(getColorOrange(), 2, 200, getColorGreen());
+  } else {
+    requestLEDBlink(getColorRed(), 3, 200, getColorGreen());
   }
+}
+
+// Shared handling for validated multi-sensor telemetry (v2 and compact v3 formats):
+// statistics, MQTT publish, command ACK bookkeeping and pending-command scheduling.
+static void handleMultiSensorTelemetry(MultiSensorPacket& received, int16_t rssi, int8_t snr, const char* label) {
+  Serial.printf("\n=== %s ===\n", label);
+  Serial.printf("Sensor ID: %d, Battery: %d%%, Values: %d\n",
+               received.header.sensorId, received.header.batteryPercent, 
+               received.header.valueCount);
   
-  // Ignore 0-byte packets (CRC errors or sync word mismatches)
-  if (size == 0) {
-    LOGW("RX", "Received 0 bytes (CRC error or sync mismatch) - ignoring");
-    return;
+  // Create temporary SensorData for updateSensorInfo (backward compatibility)
+  SensorData legacyData;
+  legacyData.syncWord = SYNC_WORD;
+  legacyData.networkId = received.header.networkId;
+  legacyData.sensorId = received.header.sensorId;
+  legacyData.batteryVoltage = 0.0f;  // Not in multi-sensor header
+  legacyData.batteryPercent = received.header.batteryPercent;
+  legacyData.powerState = received.header.powerState;
+  legacyData.temperature = -127.0f;  // Initialize to invalid/no reading
+  // Copy location and zone from packet header
+  strncpy(legacyData.location, received.header.location, sizeof(legacyData.location) - 1);
+  legacyData.location[sizeof(legacyData.location) - 1] = '\0';
+  strncpy(legacyData.zone, received.header.zone, sizeof(legacyData.zone) - 1);
+  legacyData.zone[sizeof(legacyData.zone) - 1] = '\0';
+  
+  // Find temperature value for backward compatibility
+  for (int i = 0; i < received.header.valueCount; i++) {
+    if (received.values[i].type == VALUE_TEMPERATURE) {
+      legacyData.temperature = received.values[i].value;
+      break;
+    }
   }
   
-  #ifdef BASE_STATION
-    LOGI("RX", "Received %d bytes, RSSI: %d, SNR: %d", size, rssi, snr);
-    LOGD("RX", "Expected legacy size: %d bytes", sizeof(SensorData));
-  #elif defined(SENSOR_NODE)
-    LOGI("RX", "Received %d bytes, RSSI: %d, SNR: %d", size, rssi, snr);
-  #endif
+  updateSensorInfo(legacyData, rssi, snr);
+  
+  // Store individual sensor readings in PhysicalSensor structures
+  for (int i = 0; i < received.header.valueCount; i++) {
+    updateSensorReading(received.header.sensorId, i, 
+                      received.values[i].type, received.values[i].value);
+  }
+  
+  // Publish sensor data to MQTT
+  char location[sizeof(ClientInfo::location)];
+  if (copyClientLocation(received.header.sensorId, location, sizeof(location))) {
+    // Use new multi-sensor MQTT publish function
+    mqttClient.publishMultiSensorData(
+      received.header.sensorId,
+      location,
+      received.values,
+      received.header.valueCount,
+      received.header.batteryPercent,
+      rssi,
+      snr
+    );
+    
+    // Publish Home Assistant discovery on first packet (once the configured name is known)
+    static bool discoveryPublished[256] = {false};
+    if (!discoveryPublished[received.header.sensorId] && !isClientLocationPending(received.header.sensorId)) {
+      mqttClient.publishHomeAssistantMultiSensorDiscovery(
+        received.header.sensorId, 
+        location,
+        received.values,
+        received.header.valueCount
+      );
+      discoveryPublished[received.header.sensorId] = true;
+    }
+  }
+  
+  // Broadcast update to WebSocket clients
+  if (wifiPortal.isDashboardActive()) {
+    pendingWebSocketBroadcast = true;  // Set flag instead of calling from ISR
+  }
   
   #ifdef BASE_STATION
-    Radio.Sleep();
+  // Check if this multi-sensor telemetry packet contains an ACK for a previous command
+  extern RemoteConfigManager remoteConfigManager;
+  if (received.header.lastCommandSeq != 0) {
+    Serial.printf("ACK received from sensor %d (seq %d, status %d)\n",
+                 received.header.sensorId, received.header.lastCommandSeq, 
+                 received.header.ackStatus);
     
-    recordRxPacket(rssi);
+    // Clear the command from queue
+    remoteConfigManager.handleAck(received.header.sensorId, received.header.lastCommandSeq, 
+                                 received.header.ackStatus);
     
-    // Check if it's a command packet (sensor announcement)
-    if (size >= sizeof(CommandPacket)) {
-      CommandPacket* cmd = (CommandPacket*)payload;
-      if (cmd->syncWord == COMMAND_SYNC_WORD && cmd->commandType == CMD_SENSOR_ANNOUNCE) {
-        // Extract sensor ID from announcement payload
-        uint8_t announcingSensorId = (cmd->dataLength > 0) ? cmd->data[0] : cmd->targetSensorId;
-        LOGI("ANNOUNCE", "Sensor %d announced itself on startup", announcingSensorId);
-        
-        // Use existing time sync mechanism instead of direct send
-        time_t now = time(nullptr);
-        if (now > 1000000000) {  // Valid time
-          NTPConfig ntpConfig = configStorage.getNTPConfig();
-          uint8_t payload[6];
-          memcpy(&payload[0], &now, sizeof(uint32_t));
-          int16_t tz = ntpConfig.tzOffsetMinutes;
-          memcpy(&payload[4], &tz, sizeof(int16_t));
-          
-          // Queue time sync command using the existing reliable mechanism
-          extern RemoteConfigManager remoteConfigManager;
-          if (remoteConfigManager.queueCommand(announcingSensorId, CMD_TIME_SYNC, payload, 6)) {
-            LOGI("ANNOUNCE", "Queued time sync for sensor %d (epoch=%lu, tz=%d)", 
-                 announcingSensorId, (unsigned long)now, (int)tz);
-          } else {
-            LOGW("ANNOUNCE", "Failed to queue time sync for sensor %d", announcingSensorId);
-          }
-        } else {
-          LOGW("ANNOUNCE", "Cannot send time sync to sensor %d - NTP not synced", 
-               announcingSensorId);
-        }
-        
-        // Continue processing packet normally
-        // Don't return here - let it fall through to regular packet processing
+    // Diagnostics hook: record observed ACK with link stats
+    wifiPortal.diagnosticsRecordAck(received.header.sensorId, received.header.lastCommandSeq, rssi, snr);
+    
+    if (received.header.ackStatus == 0) {
+      Serial.println("✅ Command executed successfully!");
+      
+      // Check if this is a LoRa settings ACK and update tracking
+      extern void updateLoRaRebootTracking(uint8_t sensorId);
+      updateLoRaRebootTracking(received.header.sensorId);
+    } else {
+      Serial.printf("❌ Command failed with error code: %d\n", received.header.ackStatus);
+    }
+  }
+  
+  Serial.printf("DEBUG: Telemetry received from sensor %d\n", received.header.sensorId);
+  
+  // Schedule any pending commands shortly after RX completes.
+  // Do NOT transmit from inside this callback.
+  if (remoteConfigManager.getQueuedCount(received.header.sensorId) > 0) {
+    if (!pendingCommandSend) {
+      pendingCommandSend = true;
+      pendingCommandSensorId = received.header.sensorId;
+      pendingCommandReadyAtMs = millis() + BASE_RX_TO_TX_HOLDDOWN_MS;
+      Serial.printf("📬 Sensor %d has pending commands; scheduling send in %lu ms...\n",
+                   pendingCommandSensorId, (unsigned long)BASE_RX_TO_TX_HOLDDOWN_MS);
+    } else {
+      Serial.printf("📬 Pending command already scheduled; skipping schedule for sensor %d\n",
+                   received.header.sensorId);
+    }
+  }
+  #endif
+  
+  Serial.printf("Sensor ID: %d\n", received.header.sensorId);
+  Serial.printf("Value Count: %d\n", received.header.valueCount);
+  for (int i = 0; i < received.header.valueCount; i++) {
+    const char* typeName = "Unknown";
+    switch(received.values[i].type) {
+      case VALUE_TEMPERATURE: typeName = "Temperature"; break;
+      case VALUE_HUMIDITY: typeName = "Humidity"; break;
+      case VALUE_PRESSURE: typeName = "Pressure"; break;
+      case VALUE_LIGHT: typeName = "Light"; break;
+      case VALUE_VOLTAGE: typeName = "Voltage"; break;
+      case VALUE_CURRENT: typeName = "Current"; break;
+      case VALUE_POWER: typeName = "Power"; break;
+      case VALUE_ENERGY: typeName = "Energy"; break;
+      case VALUE_GAS_RESISTANCE: typeName = "Gas Resistance"; break;
+      case VALUE_BATTERY: typeName = "Battery"; break;
+      case VALUE_SIGNAL_STRENGTH: typeName = "Signal Strength"; break;
+      case VALUE_MOISTURE: typeName = "Moisture"; break;
+      case VALUE_GENERIC: typeName = "Generic"; break;
+    }
+    Serial.printf("  %s: %.2f\n", typeName, received.values[i].value);
+  }
+  Serial.printf("Battery Percent: %d%%\n", received.header.batteryPercent);
+  Serial.printf("Power State: %s\n", received.header.powerState ? "Charging" : "Discharging");
+  Serial.printf("RSSI: %d dBm\n", rssi);
+  Serial.printf("SNR: %d dB\n", snr);
+  Serial.println("====================\n");
+  
+  // LED feedback based on battery level
+  showBatteryBlink(received.header.batteryPercent);
+}
+
+// Compact v3 telemetry, either received directly or delivered over the mesh.
+// Returns false if the frame is not v3; true once it has been handled (or rejected).
+static bool handleV3Frame(const uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
+  const MultiSensorHeaderV3* v3Hdr = (const MultiSensorHeaderV3*)payload;
+  if (size >= sizeof(MultiSensorHeaderV3) + sizeof(uint16_t) &&
+      v3Hdr->syncWord == MULTI_SENSOR_SYNC_WORD && v3Hdr->packetType == PACKET_MULTI_SENSOR_V3) {
+    if (v3Hdr->networkId != currentNetworkId) {
+      recordRxInvalid();
+      Serial.printf("V3 packet from other network (%d) ignored\n", v3Hdr->networkId);
+      return true;
+    }
+    
+    MultiSensorPacket received;
+    uint8_t frameSeq = 0;
+    uint8_t flags = 0;
+    bool refMissing = false;
+    uint32_t sensorClock = 0;
+    TelemetryReferenceV3* ref = findTelemetryReference(v3Hdr->sensorId, false);
+    if (!decodeMultiSensorV3(payload, size, ref, &received, &frameSeq, &flags, &refMissing, &sensorClock)) {
+      recordRxInvalid();
+      if (refMissing) {
+        v3ReferenceMisses++;
+        Serial.printf("V3 delta from sensor %d references unknown keyframe - waiting for next keyframe\n",
+                      v3Hdr->sensorId);
+      } else {
+        Serial.println("Invalid v3 multi-sensor packet received");
+        requestLEDBlink(getColorRed(), 1, 100, getColorOff());
       }
+      return true;
     }
     
-    // Only check for mesh packets if mesh is enabled
-    BaseStationConfig baseConfig = configStorage.getBaseStationConfig();
-    LOGD("MESH", "Mesh enabled: %s", baseConfig.meshEnabled ? "YES" : "NO");
+    // Keyframe: remember it as the delta reference and ACK it so the sensor may send deltas
+    if (flags & V3_FLAG_ACK_REQ) {
+      TelemetryReferenceV3* newRef = findTelemetryReference(received.header.sensorId, true);
+      makeTelemetryReferenceV3(&received, frameSeq, newRef);
+      pendingTelemetryAckSensorId = received.header.sensorId;
+      pendingTelemetryAckSeq = frameSeq;
+      pendingTelemetryAckReadyAtMs = millis() + BASE_RX_TO_TX_HOLDDOWN_MS;
+      pendingTelemetryAck = true;
+    }
     
-    // Check if it's a mesh packet (first byte is MeshPacketType enum)
-    if (baseConfig.meshEnabled && size >= sizeof(MeshHeader)) {
-      MeshHeader* meshHdr = (MeshHeader*)payload;
-      if (meshHdr->packetType >= MESH_DATA && meshHdr->packetType <= MESH_NEIGHBOR_BEACON) {
-        LOGI("MESH", "Mesh packet detected, processing");
-        meshRouter.processReceivedPacket(payload, size, rssi);
-        
-        // If it's a data packet for us, extract and process the payload
-        if (meshHdr->packetType == MESH_DATA && 
-            (meshHdr->destId == 1 || meshHdr->destId == 255)) {  // Base station ID = 1
-          uint8_t* dataPayload = payload + sizeof(MeshHeader);
-          uint16_t dataSize = size - sizeof(MeshHeader);
-          
-          // Re-process as sensor data packet
-          if (dataSize >= sizeof(SensorData)) {
-            SensorData received;
-            memcpy(&received, dataPayload, sizeof(SensorData));
-            
-            if (received.syncWord == SYNC_WORD && 
-                received.networkId == currentNetworkId && 
-                validateChecksum(&received)) {
-              Serial.println("\n=== MESH-ROUTED LEGACY PACKET ===");
-              Serial.printf("Via %d hops from node %d\n", meshHdr->hopCount, meshHdr->sourceId);
-              updateSensorInfo(received, rssi, snr);
-              
-              // Continue with normal MQTT publishing...
-              SensorInfo* sensor = getSensorInfo(received.sensorId);
-              if (sensor != NULL) {
-                mqttClient.publishSensorData(
-                  received.sensorId,
-                  sensor->location,
-                  received.temperature,
-                  received.batteryPercent,
-                  rssi,
-                  snr
-                );
-                
-                static bool discoveryPublished[256] = {false};
-                if (!discoveryPublished[received.sensorId]) {
-                  mqttClient.publishHomeAssistantDiscovery(received.sensorId, sensor->location);
-                  discoveryPublished[received.sensorId] = true;
-                }
-              }
-              
-              if (wifiPortal.isDashboardActive()) {
-                pendingWebSocketBroadcast = true;
-              }
-              
-              Serial.printf("Sensor ID: %d\n", received.sensorId);
-              Serial.printf("Temperature: %.2f°C\n", received.temperature);
-              Serial.printf("Battery Voltage: %.2fV\n", received.batteryVoltage);
-              Serial.printf("Battery Percent: %d%%\n", received.batteryPercent);
-              Serial.printf("RSSI: %d dBm\n", rssi);
-              Serial.printf("SNR: %d dB\n", snr);
-              Serial.println("====================\n");
-              
-              if (received.batteryPercent > 80) {
-                blinkLED(getColorGreen(), 1, 200);
-              } else if (received.batteryPercent > 50) {
-                blinkLED(getColorYellow(), 1, 200);
-              } else if (received.batteryPercent > 20) {
-                blinkLED(getColorOrange(), 2, 200);
-              } else {
-                blinkLED(getColorRed(), 3, 200);
-              }
-              setLED(getColorGreen());
-            }
-          } else if (dataSize >= sizeof(MultiSensorHeader)) {
-            // Handle mesh-routed multi-sensor packets
-            MultiSensorPacket received;
-            memcpy(&received, dataPayload, dataSize);
-            
-            if (received.header.packetType == PACKET_MULTI_SENSOR && 
-                received.header.networkId == currentNetworkId && 
-                validateMultiSensorChecksum(&received)) {
-              Serial.println("\n=== MESH-ROUTED MULTI-SENSOR PACKET ===");
-              Serial.printf("Via %d hops from node %d\n", meshHdr->hopCount, meshHdr->sourceId);
-              
-              // Process as normal multi-sensor packet...
-              SensorData legacyData;
-              legacyData.syncWord = SYNC_WORD;
-              legacyData.networkId = received.header.networkId;
-              legacyData.sensorId = received.header.sensorId;
-              legacyData.batteryVoltage = 0.0f;
-              legacyData.batteryPercent = received.header.batteryPercent;
-              legacyData.powerState = received.header.powerState;
-              // Copy location and zone from packet header
-              strncpy(legacyData.location, received.header.location, sizeof(legacyData.location) - 1);
-              legacyData.location[sizeof(legacyData.location) - 1] = '\0';
-              strncpy(legacyData.zone, received.header.zone, sizeof(legacyData.zone) - 1);
-              legacyData.zone[sizeof(legacyData.zone) - 1] = '\0';
-              
-              for (int i = 0; i < received.header.valueCount; i++) {
-                if (received.values[i].type == VALUE_TEMPERATURE) {
-                  legacyData.temperature = received.values[i].value;
-                  break;
-                }
-              }
-              
-              updateSensorInfo(legacyData, rssi, snr);
-              
-              // Store individual sensor readings
-              for (int i = 0; i < received.header.valueCount; i++) {
-                updateSensorReading(received.header.sensorId, i, 
-                                  received.values[i].type, received.values[i].value);
-              }
-              
-              SensorInfo* sensor = getSensorInfo(received.header.sensorId);
-              if (sensor != NULL) {
-                // Use new multi-sensor MQTT publish function
-                mqttClient.publishMultiSensorData(
-                  received.header.sensorId,
-                  sensor->location,
-                  received.values,
-                  received.header.valueCount,
-                  received.header.batteryPercent,
-                  rssi,
-                  snr
-                );
-                
-                static bool discoveryPublished[256] = {false};
-                if (!discoveryPublished[received.header.sensorId]) {
-                  mqttClient.publishHomeAssistantMultiSensorDiscovery(
-                    received.header.sensorId,
-                    sensor->location,
-                    received.values,
-                    received.header.valueCount
-                  );
-                  discoveryPublished[received.header.sensorId] = true;
-                }
-              }
-              
-              if (wifiPortal.isDashboardActive()) {
-                pendingWebSocketBroadcast = true;  // Set flag instead of calling from ISR
-              }
-              
-              Serial.printf("Sensor ID: %d\n", received.header.sensorId);
-              Serial.printf("Value Count: %d\n", received.header.valueCount);
-              for (int i = 0; i < received.header.valueCount; i++) {
-                const char* typeName = "Unknown";
-                switch(received.values[i].type) {
-                  case VALUE_TEMPERATURE: typeName = "Temperature"; break;
-                  case VALUE_HUMIDITY: typeName = "Humidity"; break;
-                  case VALUE_PRESSURE: typeName = "Pressure"; break;
-                  case VALUE_LIGHT: typeName = "Light"; break;
-                  case VALUE_VOLTAGE: typeName = "Voltage"; break;
-                  case VALUE_CURRENT: typeName = "Current"; break;
-                  case VALUE_POWER: typeName = "Power"; break;
-                  case VALUE_ENERGY: typeName = "Energy"; break;
-                  case VALUE_GAS_RESISTANCE: typeName = "Gas Resistance"; break;
-                  case VALUE_BATTERY: typeName = "Battery"; break;
-                  case VALUE_SIGNAL_STRENGTH: typeName = "Signal Strength"; break;
-                  case VALUE_MOISTURE: typeName = "Moisture"; break;
-                  case VALUE_GENERIC: typeName = "Generic"; break;
-                }
-                Serial.printf("  %s: %.2f\n", typeName, received.values[i].value);
-              }
-              Serial.printf("Battery Percent: %d%%\n", received.header.batteryPercent);
-              Serial.printf("RSSI: %d dBm\n", rssi);
-              Serial.println("====================\n");
-              
-              if (received.header.batteryPercent > 80) {
-                blinkLED(getColorGreen(), 1, 200);
-              } else if (received.header.batteryPercent > 50) {
-                blinkLED(getColorYellow(), 1, 200);
-              } else if (received.header.batteryPercent > 20) {
-                blinkLED(getColorOrange(), 2, 200);
-              } else {
-                blinkLED(getColorRed(), 3, 200);
-              }
-              setLED(getColorGreen());
-            }
-          }
-        }
-        
-        lora_idle = true;
-        return;
-      }
+    recordPacketEfficiency(received.header.sensorId, PACKET_MULTI_SENSOR_V3, size, &received);
+    handleMultiSensorTelemetry(received, rssi, snr,
+                               (flags & V3_FLAG_DELTA) ? "V3 DELTA PACKET RECEIVED" : "V3 KEYFRAME RECEIVED");
+    if (flags & V3_FLAG_CLOCK) {
+      checkSensorClock(received.header.sensorId, sensorClock);
     }
+    return true;
+  }
+  return false;
+}
+
+// Validated legacy (single temperature) telemetry: statistics, MQTT publish
+static void handleLegacyTelemetry(SensorData& received, int16_t rssi, int8_t snr) {
+  Serial.println("\n=== LEGACY PACKET RECEIVED ===");
+  updateSensorInfo(received, rssi, snr);
+  
+  // Publish to MQTT
+  char location[sizeof(ClientInfo::location)];
+  if (copyClientLocation(received.sensorId, location, sizeof(location))) {
+    mqttClient.publishSensorData(
+      received.sensorId,
+      location,
+      received.temperature,
+      received.batteryPercent,
+      rssi,
+      snr
+    );
     
-    // Check if it's an encrypted packet first
-    if (size >= sizeof(EncryptedPacket) && payload[0] == 0xE0) {
-      Serial.println("🔐 Encrypted packet detected, decrypting...");
-      
-      EncryptedPacket* encPkt = (EncryptedPacket*)payload;
-      uint8_t decrypted[256];
-      uint16_t decLen = securityManager.decryptPacket(encPkt, decrypted, sizeof(decrypted));
-      
-      if (decLen > 0) {
-        Serial.printf("✅ Decryption successful! (%d bytes)\n", decLen);
-        
-        // Check if decrypted data is legacy SensorData
-        if (decLen == sizeof(SensorData)) {
-          SensorData received;
-          memcpy(&received, decrypted, sizeof(SensorData));
-          
-          // Validate decrypted packet
-          if (received.syncWord == SYNC_WORD && validateChecksum(&received)) {
-            Serial.println("\n=== ENCRYPTED LEGACY PACKET RECEIVED ===");
-            updateSensorInfo(received, rssi, snr);
-            
-            // Publish to MQTT
-            SensorInfo* sensor = getSensorInfo(received.sensorId);
-            if (sensor != NULL) {
-              mqttClient.publishSensorData(
-                received.sensorId,
-                sensor->location,
-                received.temperature,
-                received.batteryPercent,
-                rssi,
-                snr
-              );
-              
-              static bool discoveryPublished[256] = {false};
-              if (!discoveryPublished[received.sensorId]) {
-                mqttClient.publishHomeAssistantDiscovery(received.sensorId, sensor->location);
-                discoveryPublished[received.sensorId] = true;
-              }
-            }
-            
-            if (wifiPortal.isDashboardActive()) {
-              pendingWebSocketBroadcast = true;
-            }
-            
-            Serial.printf("Sensor ID: %d\n", received.sensorId);
-            Serial.printf("Temperature: %.2f°C\n", received.temperature);
-            Serial.printf("Battery Voltage: %.2fV\n", received.batteryVoltage);
-            Serial.printf("Battery Percent: %d%%\n", received.batteryPercent);
-            Serial.printf("RSSI: %d dBm, SNR: %d dB\n", rssi, snr);
-            Serial.println("====================\n");
-            
-            if (received.batteryPercent > 80) {
-              blinkLED(getColorGreen(), 1, 200);
-            } else if (received.batteryPercent > 50) {
-              blinkLED(getColorYellow(), 1, 200);
-            } else if (received.batteryPercent > 20) {
-              blinkLED(getColorOrange(), 2, 200);
-            } else {
-              blinkLED(getColorRed(), 3, 200);
-            }
-            setLED(getColorGreen());
-          } else {
-            Serial.println("❌ Decrypted packet validation failed!");
-          }
-        }
-      } else {
-        Serial.println("❌ Decryption failed or packet rejected!");
-      }
-      
-      Radio.Rx(0);
-      lora_idle = true;
-      return;
+    // Publish Home Assistant discovery on first packet
+    static bool discoveryPublished[256] = {false};
+    if (!discoveryPublished[received.sensorId] && !isClientLocationPending(received.sensorId)) {
+      mqttClient.publishHomeAssistantDiscovery(received.sensorId, location);
+      discoveryPublished[received.sensorId] = true;
+    }
+  }
+  
+  // Broadcast update to WebSocket clients for real-time dashboard updates
+  if (wifiPortal.isDashboardActive()) {
+    pendingWebSocketBroadcast = true;  // Set flag instead of calling from ISR
+  }
+  
+  Serial.printf("Sensor ID: %d\n", received.sensorId);
+  Serial.printf("Temperature: %.2f°C\n", received.temperature);
+  Serial.printf("Battery Voltage: %.2fV\n", received.batteryVoltage);
+  Serial.printf("Battery Percent: %d%%\n", received.batteryPercent);
+  Serial.printf("Power State: %s\n", received.powerState ? "Charging" : "Discharging");
+  Serial.printf("RSSI: %d dBm\n", rssi);
+  Serial.printf("SNR: %d dB\n", snr);
+  Serial.println("====================\n");
+  
+  // LED feedback based on battery level
+  showBatteryBlink(received.batteryPercent);
+}
+
+// Sensor telemetry (v3, legacy or v2 multi-sensor), either received directly or
+// delivered over the mesh
+static void processTelemetryFrame(const uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
+  // Check if it's a compact v3 multi-sensor packet
+  if (handleV3Frame(payload, size, rssi, snr)) {
+    return;
+  }
+  
+  // Check if it's a legacy packet
+  if (size == sizeof(SensorData)) {
+    SensorData received;
+    memcpy(&received, payload, sizeof(SensorData));
+    
+    // Validate legacy packet (sync word, network ID, and checksum)
+    if (isSyncWord(received.syncWord, SYNC_WORD) && 
+        received.networkId == currentNetworkId && 
+        validateChecksum(&received)) {
+      recordPacketEfficiency(received.sensorId, PACKET_LEGACY, size, nullptr);
+      handleLegacyTelemetry(received, rssi, snr);
+    } else {
+      recordRxInvalid();
+      Serial.println("Invalid legacy packet received");
+      requestLEDBlink(getColorRed(), 1, 100, getColorOff());
     }
+  } 
+  // Check if it's a multi-sensor packet
+  else if (size >= sizeof(MultiSensorHeader) + sizeof(uint16_t)) {
+    MultiSensorPacket received = {};
     
-    // Check if it's a legacy packet (unencrypted)
-    if (size == sizeof(SensorData)) {
-      SensorData received;
-      memcpy(&received, payload, sizeof(SensorData));
+    // Parse header
+    memcpy(&received.header, payload, sizeof(MultiSensorHeader));
+    
+    // Checksum sits right after the last value on air, not at the struct's fixed slot
+    const bool lengthOk = received.header.valueCount <= MAX_VALUES_PER_PACKET &&
+                          MULTI_SENSOR_V2_SIZE(received.header.valueCount) <= size;
+    uint16_t receivedChecksum = 0;
+    if (lengthOk) {
+      size_t headerSize = sizeof(MultiSensorHeader);
+      size_t valuesSize = received.header.valueCount * sizeof(SensorValuePacket);
+      memcpy(received.values, payload + headerSize, valuesSize);
+      memcpy(&receivedChecksum, payload + headerSize + valuesSize, sizeof(uint16_t));
+    }
+    
+    Serial.printf("Checking multi-sensor packet: syncWord=0x%04X, type=%d, sensorId=%d, valueCount=%d\n",
+                  received.header.syncWord, received.header.packetType, 
+                  received.header.sensorId, received.header.valueCount);
+    
+    // Debug checksum validation
+    uint16_t expectedChecksum = lengthOk ? calculateMultiSensorChecksum(&received) : 0;
+    Serial.printf("Checksum validation: received=0x%04X, expected=0x%04X, valid=%s\n",
+                  receivedChecksum, expectedChecksum, 
+                  (lengthOk && receivedChecksum == expectedChecksum) ? "YES" : "NO");
+    
+    // Validate multi-sensor packet
+    if (lengthOk &&
+        isSyncWord(received.header.syncWord, MULTI_SENSOR_SYNC_WORD) && 
+        received.header.networkId == currentNetworkId && 
+        received.header.packetType == PACKET_MULTI_SENSOR && 
+        receivedChecksum == expectedChecksum) {
+      recordPacketEfficiency(received.header.sensorId, PACKET_MULTI_SENSOR, size, &received);
+      handleMultiSensorTelemetry(received, rssi, snr, "MULTI-SENSOR PACKET RECEIVED");
+    } else {
+      recordRxInvalid();
+      Serial.println("Invalid multi-sensor packet received");
+      requestLEDBlink(getColorRed(), 1, 100, getColorOff());
+    }
+  } 
+  else {
+    recordRxInvalid();
+    Serial.printf("Received packet with unexpected size: %d bytes\n", size);
+  }
+}
+
+// Decode stage: validates, updates statistics, publishes. Runs on the RX decode task,
+// never inside the radio callback, so it may block on NVS/MQTT without costing RX time.
+static void processReceivedFrame(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
+  LOGI("RX", "Received %d bytes, RSSI: %d, SNR: %d", size, rssi, snr);
+  LOGD("RX", "Expected legacy size: %d bytes", sizeof(SensorData));
+  
+  recordRxPacket(rssi);
+  
+  // Encrypted envelope: decrypt in the ring slot and decode the inner frame
+  if (!openSecureFrame(payload, size)) {
+    recordRxInvalid();
+    return;
+  }
+  
+  // Check if it's a command packet (sensor announcement, short or full form)
+  extern RemoteConfigManager remoteConfigManager;
+  CommandPacket announce;
+  if (remoteConfigManager.parseCommandFrame(payload, size, announce)) {
+    CommandPacket* cmd = &announce;
+    // Pre-v2.19 sensors send announcements with a zero checksum
+    bool checksumOk = !isCrc16SyncWord(cmd->syncWord, COMMAND_SYNC_WORD) ||
+                      cmd->checksum == remoteConfigManager.calculateChecksum(payload, size - sizeof(uint16_t));
+    if (checksumOk && cmd->commandType == CMD_SENSOR_ANNOUNCE) {
+      // Extract sensor ID from announcement payload
+      uint8_t announcingSensorId = (cmd->dataLength > 0) ? cmd->data[0] : cmd->targetSensorId;
+      LOGI("ANNOUNCE", "Sensor %d announced itself on startup", announcingSensorId);
       
-      // Validate legacy packet (sync word, network ID, and checksum)
-      if (received.syncWord == SYNC_WORD && 
-          received.networkId == currentNetworkId && 
-          validateChecksum(&received)) {
-        Serial.println("\n=== LEGACY PACKET RECEIVED (UNENCRYPTED) ===");
-        updateSensorInfo(received, rssi, snr);
-        
-        // Publish to MQTT
-        SensorInfo* sensor = getSensorInfo(received.sensorId);
-        if (sensor != NULL) {
-          mqttClient.publishSensorData(
-            received.sensorId,
-            sensor->location,
-            received.temperature,
-            received.batteryPercent,
-            rssi,
-            snr
-          );
-          
-          // Publish Home Assistant discovery on first packet
-          static bool discoveryPublished[256] = {false};
-          if (!discoveryPublished[received.sensorId]) {
-            mqttClient.publishHomeAssistantDiscovery(received.sensorId, sensor->location);
-            discoveryPublished[received.sensorId] = true;
-          }
-        }
-        
-        // Broadcast update to WebSocket clients for real-time dashboard updates
-        if (wifiPortal.isDashboardActive()) {
-          pendingWebSocketBroadcast = true;  // Set flag instead of calling from ISR
-        }
-        
-        Serial.printf("Sensor ID: %d\n", received.sensorId);
-        Serial.printf("Temperature: %.2f°C\n", received.temperature);
-        Serial.printf("Battery Voltage: %.2fV\n", received.batteryVoltage);
-        Serial.printf("Battery Percent: %d%%\n", received.batteryPercent);
-        Serial.printf("Power State: %s\n", received.powerState ? "Charging" : "Discharging");
-        Serial.printf("RSSI: %d dBm\n", rssi);
-        Serial.printf("SNR: %d dB\n", snr);
-        Serial.println("====================\n");
-        
-        // LED feedback based on battery level
-        if (received.batteryPercent > 80) {
-          blinkLED(getColorGreen(), 1, 200);
-        } else if (received.batteryPercent > 50) {
-          blinkLED(getColorYellow(), 1, 200);
-        } else if (received.batteryPercent > 20) {
-          blinkLED(getColorOrange(), 2, 200);
+      // Use existing time sync mechanism instead of direct send
+      time_t now = time(nullptr);
+      if (now >= (time_t)TIME_VALID_EPOCH) {
+        // Queue time sync command using the existing reliable mechanism
+        if (queueTimeSync(announcingSensorId)) {
+          LOGI("ANNOUNCE", "Queued time sync for sensor %d (epoch=%lu)", 
+               announcingSensorId, (unsigned long)now);
         } else {
-          blinkLED(getColorRed(), 3, 200);
+          LOGW("ANNOUNCE", "Failed to queue time sync for sensor %d", announcingSensorId);
         }
-        setLED(getColorGreen());
       } else {
-        recordRxInvalid();
-        Serial.println("Invalid legacy packet received");
-        blinkLED(getColorRed(), 1, 100);
-      }
-    } 
-    // Check if it's a multi-sensor packet
-    else if (size >= sizeof(MultiSensorHeader) + sizeof(uint16_t)) {
-      MultiSensorPacket received;
-      
-      // Parse header
-      memcpy(&received.header, payload, sizeof(MultiSensorHeader));
-      
-      // Parse values (if any)
-      size_t headerSize = sizeof(MultiSensorHeader);
-      size_t valuesSize = received.header.valueCount * sizeof(SensorValuePacket);
-      if (received.header.valueCount > 0 && received.header.valueCount <= MAX_VALUES_PER_PACKET) {
-        memcpy(received.values, payload + headerSize, valuesSize);
+        LOGW("ANNOUNCE", "Cannot send time sync to sensor %d - NTP not synced", 
+             announcingSensorId);
       }
       
-      // Read checksum from correct dynamic position
-      uint16_t receivedChecksum;
-      memcpy(&receivedChecksum, payload + headerSize + valuesSize, sizeof(uint16_t));
-      
-      Serial.printf("Checking multi-sensor packet: syncWord=0x%04X, type=%d, sensorId=%d, valueCount=%d\n",
-                    received.header.syncWord, received.header.packetType, 
-                    received.header.sensorId, received.header.valueCount);
-      
-      // Debug checksum validation
-      uint16_t expectedChecksum = calculateMultiSensorChecksum(&received);
-      Serial.printf("Checksum validation: received=0x%04X, expected=0x%04X, valid=%s\n",
-                    receivedChecksum, expectedChecksum, 
-                    (receivedChecksum == expectedChecksum) ? "YES" : "NO");
+      // Continue processing packet normally
+      // Don't return here - let it fall through to regular packet processing
+    }
+  }
+  
+  // Only check for mesh packets if mesh is enabled
+  const BaseStationConfig& baseConfig = configStorage.getBaseStationConfigRef();
+  LOGD("MESH", "Mesh enabled: %s", baseConfig.meshEnabled ? "YES" : "NO");
+  
+  // Check if it's a mesh packet (first byte is MeshPacketType enum)
+  if (baseConfig.meshEnabled && size >= sizeof(MeshHeader)) {
+    MeshHeader* meshHdr = (MeshHeader*)payload;
+    if (meshHdr->packetType >= MESH_DATA && meshHdr->packetType <= MESH_NEIGHBOR_BEACON) {
+      LOGI("MESH", "Mesh packet detected, processing");
+      bool deliver = meshRouter.processReceivedPacket(payload, size, rssi, snr);
       
-      // Validate multi-sensor packet
-      if (received.header.syncWord == 0xABCD && 
-          received.header.networkId == currentNetworkId && 
-          received.header.packetType == PACKET_MULTI_SENSOR && 
-          receivedChecksum == expectedChecksum) {
-        Serial.println("\n=== MULTI-SENSOR PACKET RECEIVED ===");
-        Serial.printf("Sensor ID: %d, Battery: %d%%, Values: %d\n",
-                     received.header.sensorId, received.header.batteryPercent, 
-                     received.header.valueCount);
+      // If it's a data packet for us (and not a copy already handled), extract and process the payload
+      if (deliver && meshHdr->packetType == MESH_DATA && 
+          (meshHdr->destId == 1 || meshHdr->destId == 255)) {  // Base station ID = 1
+        uint8_t* dataPayload = payload + sizeof(MeshHeader);
+        uint16_t dataSize = size - sizeof(MeshHeader);
         
-        // Create temporary SensorData for updateSensorInfo (backward compatibility)
-        SensorData legacyData;
-        legacyData.syncWord = SYNC_WORD;
-        legacyData.networkId = received.header.networkId;
-        legacyData.sensorId = received.header.sensorId;
-        legacyData.batteryVoltage = 0.0f;  // Not in multi-sensor header
-        legacyData.batteryPercent = received.header.batteryPercent;
-        legacyData.powerState = received.header.powerState;
-        legacyData.temperature = -127.0f;  // Initialize to invalid/no reading
-        // Copy location and zone from packet header
-        strncpy(legacyData.location, received.header.location, sizeof(legacyData.location) - 1);
-        legacyData.location[sizeof(legacyData.location) - 1] = '\0';
-        strncpy(legacyData.zone, received.header.zone, sizeof(legacyData.zone) - 1);
-        legacyData.zone[sizeof(legacyData.zone) - 1] = '\0';
-        
-        // Find temperature value for backward compatibility
-        for (int i = 0; i < received.header.valueCount; i++) {
-          if (received.values[i].type == VALUE_TEMPERATURE) {
-            legacyData.temperature = received.values[i].value;
-            break;
-          }
-        }
-        
-        updateSensorInfo(legacyData, rssi, snr);
-        
-        // Store individual sensor readings in PhysicalSensor structures
-        for (int i = 0; i < received.header.valueCount; i++) {
-          updateSensorReading(received.header.sensorId, i, 
-                            received.values[i].type, received.values[i].value);
-        }
-        
-        // Publish sensor data to MQTT
-        SensorInfo* sensor = getSensorInfo(received.header.sensorId);
-        if (sensor != NULL) {
-          // Use new multi-sensor MQTT publish function
-          mqttClient.publishMultiSensorData(
-            received.header.sensorId,
-            sensor->location,
-            received.values,
-            received.header.valueCount,
-            received.header.batteryPercent,
-            rssi,
-            snr
-          );
-          
-          // Publish Home Assistant discovery on first packet
-          static bool discoveryPublished[256] = {false};
-          if (!discoveryPublished[received.header.sensorId]) {
-            mqttClient.publishHomeAssistantMultiSensorDiscovery(
-              received.header.sensorId, 
-              sensor->location,
-              received.values,
-              received.header.valueCount
-            );
-            discoveryPublished[received.header.sensorId] = true;
-          }
-        }
-        
-        // Broadcast update to WebSocket clients
-        if (wifiPortal.isDashboardActive()) {
-          pendingWebSocketBroadcast = true;  // Set flag instead of calling from ISR
-        }
-        
-        #ifdef BASE_STATION
-        // Check if this multi-sensor telemetry packet contains an ACK for a previous command
-        extern RemoteConfigManager remoteConfigManager;
-        if (received.header.lastCommandSeq != 0) {
-          Serial.printf("ACK received from sensor %d (seq %d, status %d)\n",
-                       received.header.sensorId, received.header.lastCommandSeq, 
-                       received.header.ackStatus);
-          
-          // Clear the command from queue
-          remoteConfigManager.handleAck(received.header.sensorId, received.header.lastCommandSeq, 
-                                       received.header.ackStatus);
-          
-          // Diagnostics hook: record observed ACK with link stats
-          wifiPortal.diagnosticsRecordAck(received.header.sensorId, received.header.lastCommandSeq, rssi, snr);
-          
-          if (received.header.ackStatus == 0) {
-            Serial.println("✅ Command executed successfully!");
-            
-            // Check if this is a LoRa settings ACK and update tracking
-            extern void updateLoRaRebootTracking(uint8_t sensorId);
-            updateLoRaRebootTracking(received.header.sensorId);
-          } else {
-            Serial.printf("❌ Command failed with error code: %d\n", received.header.ackStatus);
-          }
-        }
-        
-        Serial.printf("DEBUG: Telemetry received from sensor %d\n", received.header.sensorId);
-        
-        // Schedule any pending commands shortly after RX completes.
-        // Do NOT transmit from inside this callback.
-        if (remoteConfigManager.getQueuedCount(received.header.sensorId) > 0) {
-          if (!pendingCommandSend) {
-            pendingCommandSend = true;
-            pendingCommandSensorId = received.header.sensorId;
-            pendingCommandReadyAtMs = millis() + BASE_RX_TO_TX_HOLDDOWN_MS;
-            Serial.printf("📬 Sensor %d has pending commands; scheduling send in %lu ms...\n",
-                         pendingCommandSensorId, (unsigned long)BASE_RX_TO_TX_HOLDDOWN_MS);
-          } else {
-            Serial.printf("📬 Pending command already scheduled; skipping schedule for sensor %d\n",
-                         received.header.sensorId);
-          }
-        }
-        #endif
-        
-        Serial.printf("Sensor ID: %d\n", received.header.sensorId);
-        Serial.printf("Value Count: %d\n", received.header.valueCount);
-        for (int i = 0; i < received.header.valueCount; i++) {
-          const char* typeName = "Unknown";
-          switch(received.values[i].type) {
-            case VALUE_TEMPERATURE: typeName = "Temperature"; break;
-            case VALUE_HUMIDITY: typeName = "Humidity"; break;
-            case VALUE_PRESSURE: typeName = "Pressure"; break;
-            case VALUE_LIGHT: typeName = "Light"; break;
-            case VALUE_VOLTAGE: typeName = "Voltage"; break;
-            case VALUE_CURRENT: typeName = "Current"; break;
-            case VALUE_POWER: typeName = "Power"; break;
-            case VALUE_ENERGY: typeName = "Energy"; break;
-            case VALUE_GAS_RESISTANCE: typeName = "Gas Resistance"; break;
-            case VALUE_BATTERY: typeName = "Battery"; break;
-            case VALUE_SIGNAL_STRENGTH: typeName = "Signal Strength"; break;
-            case VALUE_MOISTURE: typeName = "Moisture"; break;
-            case VALUE_GENERIC: typeName = "Generic"; break;
-          }
-          Serial.printf("  %s: %.2f\n", typeName, received.values[i].value);
-        }
-        Serial.printf("Battery Percent: %d%%\n", received.header.batteryPercent);
-        Serial.printf("Power State: %s\n", received.header.powerState ? "Charging" : "Discharging");
-        Serial.printf("RSSI: %d dBm\n", rssi);
-        Serial.printf("SNR: %d dB\n", snr);
-        Serial.println("====================\n");
-        
-        // LED feedback based on battery level
-        if (received.header.batteryPercent > 80) {
-          blinkLED(getColorGreen(), 1, 200);
-        } else if (received.header.batteryPercent > 50) {
-          blinkLED(getColorYellow(), 1, 200);
-        } else if (received.header.batteryPercent > 20) {
-          blinkLED(getColorOrange(), 2, 200);
-        } else {
-          blinkLED(getColorRed(), 3, 200);
-        }
-        setLED(getColorGreen());
-      } else {
-        recordRxInvalid();
-        Serial.println("Invalid multi-sensor packet received");
-        blinkLED(getColorRed(), 1, 100);
+        // Same decoders as a frame heard directly
+        LOGI("MESH", "Data via %d hops from node %d", meshHdr->hopCount, meshHdr->sourceId);
+        processTelemetryFrame(dataPayload, dataSize, rssi, snr);
       }
-    } 
-    else {
-      recordRxInvalid();
-      Serial.printf("Received packet with unexpected size: %d bytes\n", size);
+      
+      return;
     }
-    
+  }
+  
+  processTelemetryFrame(payload, size, rssi, snr);
+}
+
+// Drains the RX ring; woken by OnRxDone via task notification
+static void rxDecodeTask(void *param) {
+  (void)param;
+  RxFrame* frame;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while ((frame = rxRingPeek()) != nullptr) {
+      processReceivedFrame(frame->data, frame->size, frame->rssi, frame->snr);
+      rxRingPop();
+    }
+  }
+}
+#endif
+
+#ifdef SENSOR_NODE
+// Set the clock from a CMD_TIME_SYNC payload (UTC epoch + timezone offset);
+// the sensor clock runs on local time
+static bool applyTimeSync(const CommandPacket* cmd) {
+  if (cmd->dataLength < 6) {
+    return false;
+  }
+  uint32_t epochSec;
+  int16_t tzOffsetMin;
+  memcpy(&epochSec, &cmd->data[0], sizeof(uint32_t));
+  memcpy(&tzOffsetMin, &cmd->data[4], sizeof(int16_t));
+  Serial.printf("Time sync received: epoch=%lu, tzOffset=%d min\n", (unsigned long)epochSec, (int)tzOffsetMin);
+  
+  // Apply timezone offset to convert UTC to local time
+  time_t localTime = epochSec + (tzOffsetMin * 60);
+  
+  // Apply system time
+  struct timeval tv;
+  tv.tv_sec = localTime;
+  tv.tv_usec = 0;
+  settimeofday(&tv, NULL);
+  setSensorLastTimeSyncEpoch(localTime);
+  
+  Serial.printf("System time updated via LoRa time sync (local=%lu)\n", (unsigned long)localTime);
+  return true;
+}
+#endif
+
+void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
+  // Check for null payload first
+  if (payload == nullptr) {
+    LOGE("RX", "OnRxDone called with null payload");
+    return;
+  }
+  
+  // Ignore 0-byte packets (CRC errors or sync word mismatches)
+  if (size == 0) {
+    LOGW("RX", "Received 0 bytes (CRC error or sync mismatch) - ignoring");
+    return;
+  }
+  
+  #ifdef BASE_STATION
+    // Only copy the raw frame out and get back to listening; decoding happens on the
+    // RX decode task so bursts from many sensors are not lost while we publish.
+    if (!rxRingPush(payload, size, rssi, snr)) {
+      LOGW("RX", "RX queue full - dropped %d byte frame", size);
+    }
+    Radio.Rx(0);
     lora_idle = true;
+    if (rxDecodeTaskHandle != nullptr) {
+      xTaskNotifyGive(rxDecodeTaskHandle);
+    } else {
+      // Decode task unavailable: fall back to decoding inline
+      RxFrame* frame;
+      while ((frame = rxRingPeek()) != nullptr) {
+        processReceivedFrame(frame->data, frame->size, frame->rssi, frame->snr);
+        rxRingPop();
+      }
+    }
   #elif defined(SENSOR_NODE)
+    LOGI("RX", "Received %d bytes, RSSI: %d, SNR: %d", size, rssi, snr);
+    
     // Sensor node - check for command packets from base station
     Serial.printf("RX: Received %d bytes\n", size);
     
-    // Check if it's a command packet (syncWord = 0xCDEF)
-    if (size >= sizeof(CommandPacket)) {
-      CommandPacket* cmd = (CommandPacket*)payload;
+    // Encrypted envelope: decrypt in the radio buffer and handle the inner frame
+    if (!openSecureFrame(payload, size)) {
+      Radio.Rx(0);
+      lora_idle = true;
+      return;
+    }
+    
+    // v3 keyframe ACK from the base: deltas against that keyframe are now safe
+    if (size == sizeof(TelemetryAckPacket)) {
+      TelemetryAckPacket ack;
+      memcpy(&ack, payload, sizeof(ack));
+      const SensorConfig& myConfig = configStorage.getSensorConfigRef();
+      if (ack.syncWord == MULTI_SENSOR_SYNC_WORD && ack.packetType == PACKET_ACK &&
+          ack.networkId == currentNetworkId && ack.sensorId == myConfig.sensorId &&
+          ack.checksum == calculateTelemetryAckChecksum(&ack)) {
+        if (v3PendingReference.valid && v3PendingReference.frameSeq == ack.frameSeq) {
+          v3AckedReference = v3PendingReference;
+          v3PendingReference.valid = false;
+          LOGD("RX", "V3 keyframe %d ACKed by base", ack.frameSeq);
+        }
+        Radio.Rx(0);
+        lora_idle = true;
+        return;
+      }
+    }
+    
+    // Mesh frames (first byte is a MeshPacketType; no sync word starts that low):
+    // relay, route discovery and beacons are handled by the router
+    if (size >= sizeof(MeshHeader) && payload[0] <= MESH_NEIGHBOR_BEACON &&
+        configStorage.getSensorConfigRef().meshEnabled) {
+      meshRouter.processReceivedPacket(payload, size, rssi, snr);
+      Radio.Rx(0);
+      lora_idle = true;
+      return;
+    }
+    
+    // Check if it's a command packet (syncWord = 0xCDEF, short or full form)
+    extern RemoteConfigManager remoteConfigManager;
+    CommandPacket received;
+    if (size >= COMMAND_FRAME_SIZE(0)) {
+      CommandPacket* cmd = &received;
       
-      if (cmd->syncWord == COMMAND_SYNC_WORD) {
+      if (remoteConfigManager.parseCommandFrame(payload, size, received)) {
         Serial.printf("Command received: type=%d, target=%d, seq=%d\n", cmd->commandType, cmd->targetSensorId, cmd->sequenceNumber);
         
         // Check if command is for this sensor
-        SensorConfig sensorConfig = configStorage.getSensorConfig();
+        const SensorConfig& sensorConfig = configStorage.getSensorConfigRef();
         const bool isBroadcast = (cmd->targetSensorId == 0xFF);
         if (!isBroadcast && cmd->targetSensorId != sensorConfig.sensorId) {
           Serial.printf("Command not for this sensor (target=%d, my_id=%d) - ignoring\n", cmd->targetSensorId, sensorConfig.sensorId);
@@ -887,7 +1236,6 @@ void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
         }
         
         // Validate checksum using the remote_config checksum function
-        extern RemoteConfigManager remoteConfigManager;
         size_t checksumLength = size - sizeof(uint16_t);
         uint16_t expectedChecksum = remoteConfigManager.calculateChecksum(payload, checksumLength);
         
@@ -911,6 +1259,17 @@ void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
             lora_idle = true;
             return;
           }
+
+          // Broadcast time beacon: apply it without an ACK. The base follows up
+          // with a unicast time sync if our next keyframe clock is still off.
+          if (isBroadcast && cmd->commandType == CMD_TIME_SYNC) {
+            if (applyTimeSync(cmd)) {
+              Serial.println("Time beacon applied (no ACK)");
+            }
+            Radio.Rx(0);
+            lora_idle = true;
+            return;
+          }
           
           switch (cmd->commandType) {
             case CMD_PING: {
@@ -955,28 +1314,7 @@ void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
             }
             
             case CMD_TIME_SYNC: {
-              if (cmd->dataLength >= 6) {
-                uint32_t epochSec;
-                int16_t tzOffsetMin;
-                memcpy(&epochSec, &cmd->data[0], sizeof(uint32_t));
-                memcpy(&tzOffsetMin, &cmd->data[4], sizeof(int16_t));
-                Serial.printf("Time sync received: epoch=%lu, tzOffset=%d min\n", (unsigned long)epochSec, (int)tzOffsetMin);
-                
-                // Apply timezone offset to convert UTC to local time
-                time_t localTime = epochSec + (tzOffsetMin * 60);
-                
-                // Apply system time
-                struct timeval tv;
-                tv.tv_sec = localTime;
-                tv.tv_usec = 0;
-                settimeofday(&tv, NULL);
-                #ifdef SENSOR_NODE
-                setSensorLastTimeSyncEpoch(localTime);
-                #endif
-                
-                success = true;
-                Serial.printf("System time updated via LoRa time sync (local=%lu)\n", (unsigned long)localTime);
-              }
+              success = applyTimeSync(cmd);
               break;
             }
             case CMD_SET_INTERVAL: {
@@ -1031,6 +1369,7 @@ void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
               lastProcessedCommandSeq = cmd->sequenceNumber;
               lastCommandAckStatus = 0;
               // Delay then restart (sensor won't send telemetry, but that's OK)
+              securityManager.checkpointReplayWindows();
               delay(1000);
               ESP.restart();
               break;
@@ -1076,11 +1415,8 @@ void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr) {
                 
                 // Schedule automatic reboot after sending ACK (5 second delay)
                 Serial.println("🔄 Scheduling automatic reboot in 5 seconds...");
-                // This will be handled in main loop by checking a reboot flag
-                extern bool loraRebootPending;
-                extern uint32_t loraRebootTime;
-                loraRebootPending = true;
-                loraRebootTime = millis() + 5000;  // 5 seconds from now
+                extern void scheduleLoRaReboot(uint32_t delayMs);
+                scheduleLoRaReboot(5000);
               }
               break;
             }
@@ -1180,7 +1516,7 @@ void OnRxTimeout() {
 void OnRxError() {
   Serial.println("RX Error");
   #ifdef BASE_STATION
-    blinkLED(getColorRed(), 1, 50);
+    requestLEDBlink(getColorRed(), 1, 50, getColorOff());
     lora_idle = true;
   #endif
   #ifdef SENSOR_NODE
@@ -1203,9 +1539,39 @@ void handlePendingWebSocketBroadcast() {
   }
 }
 
+// Send a v3 keyframe ACK (tiny fixed frame, not queued or retried)
+static void sendTelemetryAckNow(uint8_t sensorId, uint8_t frameSeq) {
+  TelemetryAckPacket ack;
+  ack.syncWord = MULTI_SENSOR_SYNC_WORD;
+  ack.networkId = currentNetworkId;
+  ack.packetType = PACKET_ACK;
+  ack.sensorId = sensorId;
+  ack.frameSeq = frameSeq;
+  ack.checksum = calculateTelemetryAckChecksum(&ack);
+
+  // If the budget says no, the sensor simply keeps sending keyframes
+  if (!txScheduler.reserve(sizeof(TelemetryAckPacket) + securityManager.getFrameOverhead(), TX_PRIORITY_ACK_CRITICAL)) {
+    LOGD("TX", "V3 keyframe ACK to sensor %d deferred: airtime budget exhausted", sensorId);
+    return;
+  }
+
+  Radio.Standby();
+  if (!sendReservedFrame((const uint8_t*)&ack, sizeof(TelemetryAckPacket), TX_PRIORITY_ACK_CRITICAL)) {
+    return;
+  }
+  lora_idle = false;
+  v3TelemetryAcksSent++;
+  LOGD("TX", "V3 keyframe ACK sent to sensor %d (frame %d)", sensorId, frameSeq);
+}
+
 // Send scheduled command after RX hold-down (main loop only)
 void handlePendingCommandSend() {
   if (!pendingCommandSend) {
+    // Nothing queued for the sensor; send a keyframe ACK if one is due
+    if (pendingTelemetryAck && (int32_t)(millis() - pendingTelemetryAckReadyAtMs) >= 0) {
+      pendingTelemetryAck = false;
+      sendTelemetryAckNow(pendingTelemetryAckSensorId, pendingTelemetryAckSeq);
+    }
     return;
   }
   // Wait for hold-down time
@@ -1215,6 +1581,8 @@ void handlePendingCommandSend() {
 
   uint8_t sensorId = pendingCommandSensorId;
   pendingCommandSend = false;
+  // Command wins the sensor's RX window; an unACKed keyframe is simply resent by the sensor
+  pendingTelemetryAck = false;
   pendingCommandSensorId = 0;
   pendingCommandReadyAtMs = 0;
 
@@ -1226,10 +1594,32 @@ void sendCommandNow(uint8_t sensorId) {
   extern RemoteConfigManager remoteConfigManager;
 
   CommandPacket cmd;
-  if (!remoteConfigManager.getPendingCommand(sensorId, cmd)) {
+  if (!remoteConfigManager.peekPendingCommand(sensorId, cmd)) {
     return;  // No command or still waiting for ACK
   }
   
+  // Header + dataLength bytes + CRC instead of the whole 200-byte struct
+  uint8_t frame[sizeof(CommandPacket)];
+  size_t cmdSize = remoteConfigManager.encodeCommandFrame(cmd, frame, sizeof(frame));
+  if (cmdSize == 0) {
+    LOGE("CMD", "Invalid command for sensor %d (dataLength=%d)", sensorId, cmd.dataLength);
+    return;
+  }
+
+  // Spend airtime before the queue marks the attempt, so a deferral costs no retry.
+  // The checkCommandRetries() kick reschedules deferred commands.
+  TxPriority priority = (cmd.commandType == CMD_TIME_SYNC) ? TX_PRIORITY_TIME_SYNC : TX_PRIORITY_ACK_CRITICAL;
+  if (!txScheduler.reserve(cmdSize + securityManager.getFrameOverhead(), priority)) {
+    LOGD("CMD", "Command type %d to sensor %d deferred: airtime budget exhausted", cmd.commandType, sensorId);
+    return;
+  }
+
+  // Marks the attempt; returns the same packet that was just encoded
+  if (!remoteConfigManager.getPendingCommand(sensorId, cmd)) {
+    txScheduler.refund(cmdSize + securityManager.getFrameOverhead(), priority);
+    return;
+  }
+  
   Serial.printf("🚀 Sending command type %d to sensor %d (seq %d, retry %d, targetSensorId=%d)\n", 
                cmd.commandType, sensorId, cmd.sequenceNumber,
                remoteConfigManager.getRetryCount(sensorId), cmd.targetSensorId);
@@ -1240,53 +1630,33 @@ void sendCommandNow(uint8_t sensorId) {
                  sensorId, cmd.targetSensorId);
   }
   
-  size_t cmdSize = sizeof(CommandPacket);
-  
   // Put radio in Standby if it's in RX mode
   Radio.Standby();
   
   // Diagnostics hook: record command send for link testing
   wifiPortal.diagnosticsRecordSent(sensorId, cmd.sequenceNumber);
   
-  Radio.Send((uint8_t*)&cmd, cmdSize);
+  if (!sendReservedFrame(frame, cmdSize, priority)) {
+    return;
+  }
   lora_idle = false;
+  recordCommandSent(sensorId, cmdSize + securityManager.getFrameOverhead());
 }
 
-// Check all sensors for commands that need retry
+// Check sensors with queued commands for one nobody picked up. ACK timeouts
+// run on the timer wheel; actual sends happen after we receive telemetry from a sensor
+// and schedule a send during its RX window.
 void checkCommandRetries() {
   extern RemoteConfigManager remoteConfigManager;
 
-  // Only update retry state (timeouts). Actual sends happen after we receive telemetry
-  // from a sensor and schedule a send during its RX window.
-  remoteConfigManager.processRetries();
-
   // Reliability kick: if a command has been queued but we haven't managed to schedule a send
-  // (e.g., missed RX scheduling), periodically schedule one attempt when the radio is idle.
-  static uint32_t lastKickMs = 0;
-  if (!pendingCommandSend && isLoRaIdle() && (millis() - lastKickMs) > 1000) {
-    extern ClientInfo* getAllClients();
-    ClientInfo* allClients = getAllClients();
-    for (uint8_t i = 0; i < 10; i++) {
-      const uint8_t clientId = allClients[i].clientId;
-      if (clientId == 0) {
-        continue;
-      }
-      if (remoteConfigManager.getQueuedCount(clientId) == 0) {
-        continue;
-      }
-
-      uint8_t cmdType, seqNum, retries;
-      bool waitingAck;
-      uint32_t ageMs;
-      if (remoteConfigManager.getCommandInfo(clientId, cmdType, seqNum, retries, waitingAck, ageMs) && !waitingAck) {
-        pendingCommandSend = true;
-        pendingCommandSensorId = clientId;
-        pendingCommandReadyAtMs = millis();
-        lastKickMs = millis();
-        Serial.printf("📬 Kick-scheduling pending command send for sensor %d\n", pendingCommandSensorId);
-        break;
-      }
-    }
+  // (e.g., missed RX scheduling), schedule one attempt when the radio is idle.
+  uint8_t sensorId;
+  if (!pendingCommandSend && isLoRaIdle() && remoteConfigManager.findUnsentCommand(sensorId)) {
+    pendingCommandSend = true;
+    pendingCommandSensorId = sensorId;
+    pendingCommandReadyAtMs = millis();
+    Serial.printf("📬 Kick-scheduling pending command send for sensor %d\n", pendingCommandSensorId);
   }
 }
 #endif
@@ -1301,6 +1671,55 @@ bool shouldSendImmediateAck() {
   return false;
 }
 
+// Build a compact v3 telemetry frame. A keyframe (absolute values, ACK requested) is sent
+// until the base ACKs one, every V3_KEYFRAME_INTERVAL frames, and whenever the value
+// layout changes; otherwise values are sent as deltas against the ACKed keyframe.
+size_t buildTelemetryFrameV3(const MultiSensorPacket& packet, uint8_t* out, size_t outSize) {
+  uint8_t frameSeq = ++v3FrameSeq;
+  bool keyframe = !v3AckedReference.valid || v3PendingReference.valid ||
+                  v3FramesSinceKeyframe >= V3_KEYFRAME_INTERVAL;
+
+  size_t len = 0;
+  if (!keyframe) {
+    len = encodeMultiSensorV3(&packet, frameSeq, false, &v3AckedReference, out, outSize);
+    if (len > 0 && !(((const MultiSensorHeaderV3*)out)->flags & V3_FLAG_DELTA)) {
+      keyframe = true;  // Layout no longer matches the reference
+    }
+  }
+
+  if (keyframe) {
+#if TELEMETRY_CLOCK_REPORT
+    // Let the base check our clock: 0 until a time sync has been applied
+    const uint32_t clock = getSensorLastTimeSyncEpoch() != 0 ? (uint32_t)time(nullptr) : 0;
+    len = encodeMultiSensorV3(&packet, frameSeq, true, nullptr, out, outSize, &clock);
+#else
+    len = encodeMultiSensorV3(&packet, frameSeq, true, nullptr, out, outSize);
+#endif
+    makeTelemetryReferenceV3(&packet, frameSeq, &v3PendingReference);
+    v3FramesSinceKeyframe = 0;
+  } else {
+    v3FramesSinceKeyframe++;
+  }
+  return len;
+}
+
+// With mesh enabled, telemetry is addressed to the base through the router, which
+// holds it during route discovery and hands it to meshTransmit() from loop().
+// A frame the router refuses (too large, no free slot) is sent directly instead.
+bool sendTelemetryFrame(const uint8_t* frame, size_t size) {
+  if (configStorage.getSensorConfigRef().meshEnabled) {
+    if (meshRouter.sendPacket(MESH_BASE_STATION_ID, frame, size)) {
+      return true;
+    }
+    LOGW("MESH", "Router refused %d byte telemetry frame - sending direct", (int)size);
+  }
+  if (!sendFrame(frame, size)) {
+    return false;
+  }
+  lora_idle = false;
+  return true;
+}
+
 // Get the effective transmit interval (may be forced to 10s after command reception)
 uint32_t getEffectiveTransmitInterval(uint32_t configuredInterval) {
   // Clear ACK fields and forced mode once the window expires
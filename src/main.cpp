@@ -2,6 +2,7 @@
 #include "LoRaWan_APP.h"
 #include "config.h"
 #include "data_types.h"
+#include "crc16.h"
 #include "led_control.h"
 #include "display_control.h"
 #include "sensor_readings.h"
@@ -13,12 +14,14 @@
 #include "mesh_routing.h"
 #include "security.h"
 #include "logger.h"
+#include "timer_wheel.h"
 #ifdef BASE_STATION
 #include "mqtt_client.h"
 #include "sensor_config.h"
 #include "remote_config.h"
 #include <time.h>
 #include "time_status.h"
+#include "timeseries_store.h"
 #endif
 #ifdef SENSOR_NODE
 #include "sensor_manager.h"
@@ -68,6 +71,131 @@ static void builtinPowerOnBlink() {
 #endif
 }
 
+// Sensor announcement (base replies with a time sync). Sent in the short
+// command frame form: 6-byte header + sensor ID + CRC.
+static void sendSensorAnnounce(uint8_t sensorId) {
+  CommandPacket announceCmd;
+  memset(&announceCmd, 0, sizeof(announceCmd));
+  announceCmd.syncWord = txSyncWord(COMMAND_SYNC_WORD);
+  announceCmd.commandType = CMD_SENSOR_ANNOUNCE;
+  announceCmd.targetSensorId = 1;  // Target base station (ID 1)
+  announceCmd.sequenceNumber = 1;
+  announceCmd.dataLength = 1;  // 1 byte payload with our sensor ID
+  announceCmd.data[0] = sensorId;  // Include our sensor ID
+
+  uint8_t frame[sizeof(CommandPacket)];
+  size_t frameSize = remoteConfigManager.encodeCommandFrame(announceCmd, frame, sizeof(frame));
+  sendFrame(frame, frameSize);
+}
+
+// ============================================================================
+// TIMERS
+// ============================================================================
+// Periodic main-loop jobs. Module-owned deadlines (ACK timeouts, offline
+// detection, checkpoints, history flushes) arm their own nodes.
+static TimerNode loraRebootTimer;
+static TimerNode wsCleanupTimer;
+#if defined(SENSOR_NODE) && !(TELEMETRY_PACKET_V3 && TELEMETRY_CLOCK_REPORT)
+static TimerNode timeSyncTimer;
+#endif
+#ifdef BASE_STATION
+static TimerNode timeBroadcastTimer;
+static TimerNode sensorTimeoutTimer;
+static TimerNode commandKickTimer;
+#endif
+
+static void onLoRaRebootDue(TimerNode* /*node*/, void* /*context*/) {
+  Serial.println("\n========================================");
+  Serial.println("🔄 REBOOTING TO APPLY NEW LORA SETTINGS");
+  Serial.println("========================================\n");
+  displayMessage("Rebooting...", "New LoRa", "Settings", 2000);
+  #ifdef BASE_STATION
+  sensorConfigManager.checkpointHealthScores();
+  timeSeriesStore.flush();
+  #endif
+  securityManager.checkpointReplayWindows();
+  delay(2000);
+  ESP.restart();
+}
+
+// Reboot to apply new LoRa settings once delayMs has passed
+void scheduleLoRaReboot(uint32_t delayMs) {
+  loraRebootTime = millis() + delayMs;
+  loraRebootPending = true;
+  timerWheel.schedule(&loraRebootTimer, delayMs, onLoRaRebootDue, nullptr);
+}
+
+static void onWsCleanupDue(TimerNode* /*node*/, void* /*context*/) {
+  if (wifiPortal.isDashboardActive()) {
+    wifiPortal.cleanupWebSocket();
+  }
+}
+
+#if defined(SENSOR_NODE) && !(TELEMETRY_PACKET_V3 && TELEMETRY_CLOCK_REPORT)
+static void onTimeSyncDue(TimerNode* /*node*/, void* /*context*/) {
+  LOGI("SYNC", "Requesting time sync (3 hour interval)");
+  // Send announcement packet to request time sync
+  sendSensorAnnounce(configStorage.getSensorConfigRef().sensorId);
+}
+#endif
+
+#ifdef BASE_STATION
+static uint32_t timeBroadcastIntervalMs() {
+  const NTPConfig& ntp = configStorage.getNTPConfigRef();
+  return (ntp.intervalSec < 60 ? 60 : ntp.intervalSec) * 1000UL;
+}
+
+// Periodic time beacon to sensors if NTP enabled. Re-armed on each run so
+// a changed interval takes effect after the current one.
+static void onTimeBroadcastDue(TimerNode* node, void* /*context*/) {
+  timerWheel.schedule(node, timeBroadcastIntervalMs(), onTimeBroadcastDue, nullptr);
+
+  const NTPConfig& ntp = configStorage.getNTPConfigRef();
+  if (!ntp.enabled) {
+    return;
+  }
+  time_t now = time(nullptr);
+  if (now > (time_t)TIME_VALID_EPOCH) {
+    setLastNtpSyncEpoch(now); // mark that base has valid NTP-derived time
+    // One broadcast frame for all sensors; checkSensorClock() follows up with a
+    // unicast sync for any sensor whose next keyframe shows it missed this
+    if (sendTimeBeacon()) {
+      setLastTimeBroadcastMs(millis());
+    } else {
+      timerWheel.schedule(node, TIME_BEACON_RETRY_MS, onTimeBroadcastDue, nullptr);
+    }
+  } else {
+    LOGW("TIME", "NTP not synced yet; skipping time broadcast");
+  }
+}
+
+static void onSensorTimeoutScanDue(TimerNode* /*node*/, void* /*context*/) {
+  // Release timed-out sensor slots
+  checkSensorTimeouts();
+}
+
+static void onCommandKickDue(TimerNode* /*node*/, void* /*context*/) {
+  checkCommandRetries();
+}
+#endif
+
+static void startTimers(DeviceMode mode) {
+  timerWheel.schedule(&wsCleanupTimer, 2000, onWsCleanupDue, nullptr, 2000);
+  // Sensors that report their clock in v3 keyframes are resynced by the base on demand
+  #if defined(SENSOR_NODE) && !(TELEMETRY_PACKET_V3 && TELEMETRY_CLOCK_REPORT)
+  if (mode == MODE_SENSOR) {
+    timerWheel.schedule(&timeSyncTimer, TIME_SYNC_INTERVAL_MS, onTimeSyncDue, nullptr, TIME_SYNC_INTERVAL_MS);
+  }
+  #endif
+  #ifdef BASE_STATION
+  if (mode == MODE_BASE_STATION) {
+    timerWheel.schedule(&timeBroadcastTimer, timeBroadcastIntervalMs(), onTimeBroadcastDue, nullptr);
+    timerWheel.schedule(&sensorTimeoutTimer, 30000, onSensorTimeoutScanDue, nullptr, 30000);
+    timerWheel.schedule(&commandKickTimer, 1000, onCommandKickDue, nullptr, 1000);
+  }
+  #endif
+}
+
 void setup() {
   Serial.begin(115200);
   delay(1000);
@@ -85,6 +213,13 @@ void setup() {
   logCfg.littlefsPath = "/logs.txt";
   logCfg.sdPath = "/logs.txt";
   loggerBegin(logCfg);
+
+  if (!crc16SelfTest()) {
+    LOGE("BOOT", "CRC-16 self-test failed - packet validation is unreliable");
+  }
+
+  // Shared deadline scheduler; modules arm their timers as they start
+  timerWheel.begin();
   
   // Initialize Heltec board hardware
   Mcu.begin(HELTEC_BOARD, SLOW_CLK_TPYE);
@@ -171,17 +306,9 @@ void setup() {
     // Announce sensor to base station on startup
     LOGI("SENSOR", "Announcing to base station...");
     displayMessage("Startup", "Announcing", "to base...", 1000);
-    CommandPacket announceCmd;
-    announceCmd.syncWord = COMMAND_SYNC_WORD;
-    announceCmd.commandType = CMD_SENSOR_ANNOUNCE;
-    announceCmd.targetSensorId = 1;  // Target base station (ID 1)
-    announceCmd.sequenceNumber = 1;
-    announceCmd.dataLength = 1;  // 1 byte payload with our sensor ID
-    announceCmd.data[0] = sensorConfig.sensorId;  // Include our sensor ID
-    announceCmd.checksum = 0;  // Calculate if needed
     
     // Send announcement packet
-    Radio.Send((uint8_t*)&announceCmd, sizeof(CommandPacket));
+    sendSensorAnnounce(sensorConfig.sensorId);
     LOGI("SENSOR", "Announcement sent from sensor %d, waiting for base station response...", sensorConfig.sensorId);
     
     setLED(getColorPurple());
@@ -247,6 +374,10 @@ void setup() {
     }
     
     initStats();
+    #ifdef BASE_STATION
+    sensorConfigManager.begin();  // Load RAM health table before RX starts
+    timeSeriesStore.begin();      // Flash history log (index load before RX starts)
+    #endif
     initLoRa();
     
     // Initialize mesh router (base station mode)
@@ -262,6 +393,7 @@ void setup() {
     while(1) delay(1000);
   }
   
+  startTimers(mode);
   setupComplete = true;
 }
 
@@ -269,43 +401,24 @@ void setup() {
 // MAIN LOOP
 // ============================================================================
 void loop() {
-  // Check for pending LoRa settings reboot
-  if (loraRebootPending && millis() >= loraRebootTime) {
-    Serial.println("\n========================================");
-    Serial.println("🔄 REBOOTING TO APPLY NEW LORA SETTINGS");
-    Serial.println("========================================\n");
-    displayMessage("Rebooting...", "New LoRa", "Settings", 2000);
-    delay(2000);
-    ESP.restart();
-  }
-
-  #ifdef SENSOR_NODE
-  #endif
-
-  #ifdef BASE_STATION
-  // Check for LoRa settings reboot timeout (if not all sensors ACKed within 20s)
-  extern void checkLoRaRebootTimeout();
-  checkLoRaRebootTimeout();
-  #endif
+  // Run whatever periodic or one-shot work is due (nothing, on most passes)
+  timerWheel.runDue();
   
   // Handle WiFi portal if active
   if (wifiPortal.isPortalActive()) {
     wifiPortal.handleClient();
   }
   
-  // Cleanup WebSocket clients periodically
-  static uint32_t lastWsCleanup = 0;
-  if (wifiPortal.isDashboardActive() && millis() - lastWsCleanup > 2000) {
-    wifiPortal.cleanupWebSocket();
-    lastWsCleanup = millis();
-  }
-  
   if (!setupComplete) {
     return;
   }
   
+  recordLoopIteration();
+  
   Radio.IrqProcess();
 
+  // Play LED blinks requested by the RX decode task
+  serviceLED();
   
   #ifdef BASE_STATION
   // Handle any pending WebSocket broadcasts from LoRa ISR
@@ -313,9 +426,6 @@ void loop() {
 
   // Send any scheduled command after RX hold-down
   handlePendingCommandSend();
-  
-  // Check for commands that need retry (every loop)
-  checkCommandRetries();
   #endif
   
   // Handle button with multi-click detection
@@ -332,38 +442,13 @@ void loop() {
   if (mode == MODE_SENSOR) {
     // Sensor mode: Read sensors and transmit periodically
     
-    SensorConfig sensorConfig = configStorage.getSensorConfig();
+    const SensorConfig& sensorConfig = configStorage.getSensorConfigRef();
     
     // Run mesh router loop only if mesh is enabled (for beacons and route maintenance)
     if (sensorConfig.meshEnabled) {
       meshRouter.loop();
     }
     
-    #ifdef SENSOR_NODE
-    // Sensor stays in RX mode continuously
-    
-    // Request time sync every 3 hours
-    static uint32_t lastTimeSyncRequest = 0;
-    const uint32_t TIME_SYNC_INTERVAL = 3 * 60 * 60 * 1000;  // 3 hours in milliseconds
-    
-    if (millis() - lastTimeSyncRequest >= TIME_SYNC_INTERVAL) {
-      LOGI("SYNC", "Requesting time sync (3 hour interval)");
-      
-      // Send announcement packet to request time sync
-      CommandPacket announceCmd;
-      announceCmd.syncWord = COMMAND_SYNC_WORD;
-      announceCmd.commandType = CMD_SENSOR_ANNOUNCE;
-      announceCmd.targetSensorId = 1;  // Target base station
-      announceCmd.sequenceNumber = 1;
-      announceCmd.dataLength = 1;
-      announceCmd.data[0] = sensorConfig.sensorId;
-      announceCmd.checksum = 0;
-      
-      Radio.Send((uint8_t*)&announceCmd, sizeof(CommandPacket));
-      lastTimeSyncRequest = millis();
-    }
-    #endif
-    
     // Get configured interval and apply forced interval if command was recently received
     uint32_t configuredInterval = sensorConfig.transmitInterval * 1000;
     #ifdef SENSOR_NODE
@@ -402,10 +487,15 @@ void loop() {
       // Read all sensors
       std::vector<SensorValue> readings = sensorManager.getAllValues();
       
-      // Determine packet type based on number of readings
-      if (readings.size() == 1 && readings[0].type == VALUE_TEMPERATURE) {
+      // Determine packet type based on number of readings.
+      // The compact v3 format replaces legacy frames too.
+      bool useLegacy = (readings.size() == 1 && readings[0].type == VALUE_TEMPERATURE);
+      #if TELEMETRY_PACKET_V3
+      useLegacy = false;
+      #endif
+      if (useLegacy) {
         // Legacy format for backward compatibility
-        sensorData.syncWord = SYNC_WORD;
+        sensorData.syncWord = txSyncWord(SYNC_WORD);
         sensorData.networkId = sensorConfig.networkId;
         sensorData.sensorId = sensorConfig.sensorId;
         sensorData.temperature = readings[0].value;
@@ -437,7 +527,7 @@ void loop() {
       } else {
         // Multi-sensor format
         MultiSensorPacket packet;
-        packet.header.syncWord = 0xABCD;  // Sync word for multi-sensor packets
+        packet.header.syncWord = txSyncWord(MULTI_SENSOR_SYNC_WORD);  // Sync word for multi-sensor packets
         packet.header.networkId = sensorConfig.networkId;
         packet.header.packetType = PACKET_MULTI_SENSOR;
         packet.header.sensorId = sensorConfig.sensorId;
@@ -458,11 +548,17 @@ void loop() {
           packet.values[i].value = readings[i].value;
         }
         
+        uint8_t buffer[255];
+        #if TELEMETRY_PACKET_V3
+        // Compact v3 frame (keyframe or delta against the last ACKed keyframe)
+        size_t packetSize = buildTelemetryFrameV3(packet, buffer, sizeof(buffer));
+        uint16_t checksum = 0;
+        memcpy(&checksum, buffer + packetSize - sizeof(uint16_t), sizeof(uint16_t));
+        #else
         // Calculate checksum and write it to the correct dynamic position
         uint16_t checksum = calculateMultiSensorChecksum(&packet);
         
         // Create buffer with exact packet size
-        uint8_t buffer[255];
         size_t headerSize = sizeof(MultiSensorHeader);
         size_t valuesSize = packet.header.valueCount * sizeof(SensorValuePacket);
         size_t packetSize = headerSize + valuesSize + sizeof(uint16_t);
@@ -477,6 +573,7 @@ void loop() {
         
         // Write checksum at correct position
         memcpy(buffer + headerSize + valuesSize, &checksum, sizeof(uint16_t));
+        #endif
         
         // Display readings
         LOGD("READ", "Multi Reading: sensor=%d values=%d", packet.header.sensorId, packet.header.valueCount);
@@ -499,13 +596,13 @@ void loop() {
         // Record TX attempt for statistics
         recordTxAttempt();
         
-        // Send multi-sensor packet
-        Radio.Send(buffer, packetSize);
+        // Send multi-sensor packet (mesh-routed when enabled, encrypted when enabled)
+        sendTelemetryFrame(buffer, packetSize);
         LOGI("TX", "Sending multi-sensor packet (%d bytes)", (int)packetSize);
       }
       #else
       // Legacy sensor reading for base station (shouldn't be reached)
-      sensorData.syncWord = SYNC_WORD;
+      sensorData.syncWord = txSyncWord(SYNC_WORD);
       sensorData.networkId = sensorConfig.networkId;
       sensorData.sensorId = sensorConfig.sensorId;
       sensorData.temperature = readThermistor();
@@ -516,6 +613,24 @@ void loop() {
       sendSensorData(sensorData);
       #endif // SENSOR_NODE
     }
+    
+    #ifdef SENSOR_NODE
+    // Nothing due: block until the next deadline (timer wheel or telemetry)
+    // instead of spinning, so the idle task can drop the CPU into light sleep.
+    // Capped because the radio IRQ flag and the button are polled.
+    if (isLoRaIdle() && !sendNow) {
+      uint32_t idleMs = timerWheel.msUntilNext(SENSOR_IDLE_SLEEP_MAX_MS);
+      uint32_t sinceSend = millis() - lastSendTime;
+      if (sinceSend >= interval) {
+        idleMs = 0;
+      } else if (interval - sinceSend < idleMs) {
+        idleMs = interval - sinceSend;
+      }
+      if (idleMs > 0) {
+        vTaskDelay(pdMS_TO_TICKS(idleMs));
+      }
+    }
+    #endif
   } else if (mode == MODE_BASE_STATION) {
     // Base station mode
     // Double-click ping: broadcast wake ping to all listening sensors
@@ -530,8 +645,7 @@ void loop() {
       enterRxMode();
     }
     
-    BaseStationConfig baseConfig = configStorage.getBaseStationConfig();
-    NTPConfig ntp = configStorage.getNTPConfig();
+    const BaseStationConfig& baseConfig = configStorage.getBaseStationConfigRef();
     
     // Run mesh router loop only if mesh is enabled
     if (baseConfig.meshEnabled) {
@@ -542,49 +656,5 @@ void loop() {
     #ifdef BASE_STATION
     mqttClient.loop();
     #endif
-    
-    // Periodic time broadcast to sensors if NTP enabled
-    static uint32_t lastTimeBroadcast = 0;
-    if (ntp.enabled) {
-      uint32_t intervalMs = (ntp.intervalSec < 60 ? 60 : ntp.intervalSec) * 1000UL;
-      if (millis() - lastTimeBroadcast >= intervalMs) {
-        lastTimeBroadcast = millis();
-        #ifdef BASE_STATION
-        setLastTimeBroadcastMs(lastTimeBroadcast);
-        #endif
-        time_t now = time(nullptr);
-        if (now > 1700000000) { // sanity check: after 2023-11
-          #ifdef BASE_STATION
-          setLastNtpSyncEpoch(now); // mark that base has valid NTP-derived time
-          #endif
-          // Broadcast to all active sensors
-          extern RemoteConfigManager remoteConfigManager;
-          uint8_t payload[6];
-          memcpy(&payload[0], &now, sizeof(uint32_t));
-          int16_t tz = ntp.tzOffsetMinutes;
-          memcpy(&payload[4], &tz, sizeof(int16_t));
-          int sent = 0;
-          for (int i = 0; i < 256; i++) {
-            SensorInfo* sensor = getSensorInfo(i);
-            if (sensor != NULL && !isSensorTimedOut(i)) {
-              if (remoteConfigManager.queueCommand(i, CMD_TIME_SYNC, payload, 6)) {
-                sent++;
-              }
-            }
-          }
-          LOGI("TIME", "Time broadcast sent to %d sensors (epoch=%lu, tz=%d)", sent, (unsigned long)now, (int)tz);
-        } else {
-          LOGW("TIME", "NTP not synced yet; skipping time broadcast");
-        }
-      }
-    }
-    
-    // Check for sensor timeouts and alerts every 30 seconds
-    static uint32_t lastTimeoutCheck = 0;
-    if (millis() - lastTimeoutCheck >= 30000) {
-      lastTimeoutCheck = millis();
-      checkSensorTimeouts();
-      alertManager.checkAllSensors();
-    }
   }
 }
@@ -14,6 +14,12 @@ MeshRouter meshRouter;
 // Timeout for duplicate packet detection (30 seconds)
 #define SEEN_PACKET_TIMEOUT_MS 30000
 
+// Saturating add for ETX x100 path costs
+static uint16_t addCost(uint16_t a, uint16_t b) {
+    uint32_t sum = (uint32_t)a + b;
+    return (sum >= MESH_COST_UNREACHABLE) ? MESH_COST_UNREACHABLE - 1 : (uint16_t)sum;
+}
+
 /**
  * @brief Constructor
  */
@@ -26,10 +32,19 @@ MeshRouter::MeshRouter() :
     lastBeaconTime(0),
     lastRouteCleanup(0),
     lastNeighborCleanup(0),
+    lastSeenCleanup(0),
     packetsForwarded(0),
     packetsDropped(0),
-    routeDiscoveries(0)
+    routeDiscoveries(0),
+    framesSent(0),
+    transmitter(nullptr),
+    transmitterContext(nullptr),
+    mutex(nullptr)
 {
+    memset(discoveries, 0, sizeof(discoveries));
+    memset(pending, 0, sizeof(pending));
+    memset(txQueue, 0, sizeof(txQueue));
+    memset(seenWindows, 0, sizeof(seenWindows));
 }
 
 /**
@@ -38,6 +53,9 @@ MeshRouter::MeshRouter() :
 void MeshRouter::begin(uint8_t id, bool isBase) {
     nodeId = id;
     isBaseStation = isBase;
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
     
     Serial.println("\n=== Mesh Router Initialized ===");
     Serial.printf("Node ID: %d\n", nodeId);
@@ -55,8 +73,14 @@ void MeshRouter::begin(uint8_t id, bool isBase) {
  * @brief Main loop - call periodically
  */
 void MeshRouter::loop() {
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;
+    }
     uint32_t now = millis();
     
+    // Retry or give up on outstanding route requests, release held packets
+    serviceDiscoveries(now);
+    
     // Send periodic neighbor beacons
     if (now - lastBeaconTime >= NEIGHBOR_BEACON_INTERVAL_MS) {
         sendNeighborBeacon();
@@ -76,42 +100,54 @@ void MeshRouter::loop() {
     }
     
     // Cleanup seen packets (every 30 seconds)
-    static uint32_t lastSeenCleanup = 0;
     if (now - lastSeenCleanup >= 30000) {
         cleanupSeenPackets();
         lastSeenCleanup = now;
     }
+    
+    // Hand at most one due frame to the radio
+    serviceTxQueue(now);
+    unlock();
 }
 
 /**
  * @brief Send a packet to destination
  */
-bool MeshRouter::sendPacket(uint8_t destId, uint8_t* payload, size_t payloadSize) {
+bool MeshRouter::sendPacket(uint8_t destId, const uint8_t* payload, size_t payloadSize) {
+    if (payloadSize > MESH_MAX_PAYLOAD) {
+        Serial.printf("Mesh payload too large (%d bytes)\n", payloadSize);
+        return false;
+    }
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return false;
+    }
+    
     // Check if we have a route
     RouteEntry* route = getRoute(destId);
     
-    if (!route || !route->isValid) {
-        // No route - try to discover one
-        Serial.printf("No route to %d, discovering...\n", destId);
-        if (!discoverRoute(destId)) {
-            Serial.println("Route discovery failed");
-            return false;
-        }
-        
-        // Wait for route discovery
-        uint32_t startTime = millis();
-        while (millis() - startTime < ROUTE_DISCOVERY_TIMEOUT_MS) {
-            route = getRoute(destId);
-            if (route && route->isValid) {
+    if (!route) {
+        // No route - hold the payload until discovery finishes (see loop())
+        PendingPacket* slot = nullptr;
+        for (auto& p : pending) {
+            if (!p.used) {
+                slot = &p;
                 break;
             }
-            delay(10);
         }
-        
-        if (!route || !route->isValid) {
-            Serial.println("Route discovery timeout");
+        if (!slot || !discoverRoute(destId)) {
+            Serial.printf("No room to hold packet for %d, dropping\n", destId);
+            packetsDropped++;
+            unlock();
             return false;
         }
+        
+        slot->used = true;
+        slot->destId = destId;
+        slot->size = payloadSize;
+        memcpy(slot->payload, payload, payloadSize);
+        Serial.printf("No route to %d, packet held during discovery\n", destId);
+        unlock();
+        return true;
     }
     
     // Build mesh header
@@ -125,13 +161,14 @@ bool MeshRouter::sendPacket(uint8_t destId, uint8_t* payload, size_t payloadSize
     header.ttl = MAX_HOPS;
     header.sequenceNum = getNextSequenceNumber();
     
-    // TODO: Send packet via LoRa
-    // For now, just log
-    Serial.printf("Sending packet to %d via %d (seq %d)\n", 
-                  destId, route->nextHop, header.sequenceNum);
-    
-    route->lastUsed = millis();
-    return true;
+    bool queued = queueFrame(&header, payload, payloadSize, 0);
+    if (queued) {
+        Serial.printf("Sending packet to %d via %d (seq %d)\n", 
+                      destId, route->nextHop, header.sequenceNum);
+        route->lastUsed = millis();
+    }
+    unlock();
+    return queued;
 }
 
 /**
@@ -176,10 +213,13 @@ bool MeshRouter::forwardPacket(MeshHeader* header, uint8_t* payload, size_t payl
     header->hopCount++;
     header->ttl--;
     
+    if (!queueFrame(header, payload, payloadSize, MESH_REBROADCAST_JITTER_MS)) {
+        return false;
+    }
+    
     Serial.printf("Forwarding packet from %d to %d via %d (hop %d)\n",
                   header->sourceId, header->destId, route->nextHop, header->hopCount);
     
-    // TODO: Send via LoRa
     packetsForwarded++;
     updateSeenPackets(header->sourceId, header->sequenceNum);
     route->lastUsed = millis();
@@ -190,24 +230,33 @@ bool MeshRouter::forwardPacket(MeshHeader* header, uint8_t* payload, size_t payl
 /**
  * @brief Process received packet
  */
-void MeshRouter::processReceivedPacket(uint8_t* packet, size_t packetSize, int16_t rssi) {
+bool MeshRouter::processReceivedPacket(uint8_t* packet, size_t packetSize, int16_t rssi, int8_t snr) {
     if (packetSize < sizeof(MeshHeader)) {
-        return;
+        return false;
     }
     
     MeshHeader* header = (MeshHeader*)packet;
+    if (packetSize > MESH_MAX_FRAME || !lock(pdMS_TO_TICKS(50))) {
+        return false;
+    }
+    bool deliver = false;
+    
+    // Every frame is a link sample for whoever transmitted it
+    observeLink(header->prevHop, rssi, snr);
     
     // Handle different packet types
     switch (header->packetType) {
         case MESH_DATA:
             // Check if packet is for us or needs forwarding
             if (header->destId == nodeId || header->destId == 255) {
-                // Packet is for us
-                uint8_t* payload = packet + sizeof(MeshHeader);
-                size_t payloadSize = packetSize - sizeof(MeshHeader);
-                // TODO: Process data packet
-            } else {
-                // Forward packet
+                // Packet is for us; the same frame can arrive both overheard
+                // from the source and relayed, so only the first copy counts
+                if (!isPacketDuplicate(header->sourceId, header->sequenceNum)) {
+                    updateSeenPackets(header->sourceId, header->sequenceNum);
+                    deliver = true;
+                }
+            } else if (header->nextHop == nodeId || header->nextHop == 255) {
+                // We are the chosen relay (other neighbours that overheard it stay quiet)
                 uint8_t* payload = packet + sizeof(MeshHeader);
                 size_t payloadSize = packetSize - sizeof(MeshHeader);
                 forwardPacket(header, payload, payloadSize);
@@ -215,21 +264,29 @@ void MeshRouter::processReceivedPacket(uint8_t* packet, size_t packetSize, int16
             break;
             
         case MESH_ROUTE_REQUEST:
-            processRouteRequest((RouteRequest*)packet, rssi);
+            if (packetSize >= sizeof(RouteRequest)) {
+                processRouteRequest((RouteRequest*)packet, snr);
+            }
             break;
             
         case MESH_ROUTE_REPLY:
-            processRouteReply((RouteReply*)packet);
+            if (packetSize >= sizeof(RouteReply)) {
+                processRouteReply((RouteReply*)packet, snr);
+            }
             break;
             
         case MESH_NEIGHBOR_BEACON:
-            processNeighborBeacon((NeighborBeacon*)packet, rssi);
+            if (packetSize >= sizeof(NeighborBeacon)) {
+                processNeighborBeacon((NeighborBeacon*)packet, rssi, snr);
+            }
             break;
             
         default:
             Serial.printf("Unknown mesh packet type: %d\n", header->packetType);
             break;
     }
+    unlock();
+    return deliver;
 }
 
 /**
@@ -255,16 +312,23 @@ RouteEntry* MeshRouter::getRoute(uint8_t destId) {
 /**
  * @brief Add new route
  */
-void MeshRouter::addRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount) {
+void MeshRouter::addRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount, uint16_t cost) {
     // Check if route already exists
     RouteEntry* existing = getRoute(destId);
     if (existing) {
-        // Update existing route if this one is better
-        if (hopCount < existing->hopCount) {
+        if (existing->nextHop == nextHop) {
+            // Same path: take the fresh cost
+            existing->hopCount = hopCount;
+            existing->cost = cost;
+            existing->lastUsed = millis();
+        } else if ((uint32_t)cost * 100 < (uint32_t)existing->cost * (100 - MESH_ROUTE_SWITCH_PERCENT)) {
+            // Switch only for a clearly cheaper path, so routes do not flap on noise
             existing->nextHop = nextHop;
             existing->hopCount = hopCount;
+            existing->cost = cost;
             existing->lastUsed = millis();
-            Serial.printf("Updated route to %d via %d (%d hops)\n", destId, nextHop, hopCount);
+            Serial.printf("Updated route to %d via %d (%d hops, cost %.2f)\n",
+                          destId, nextHop, hopCount, cost / (float)MESH_COST_SCALE);
         }
         return;
     }
@@ -292,10 +356,12 @@ void MeshRouter::addRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount) {
     newRoute.hopCount = hopCount;
     newRoute.lastUsed = millis();
     newRoute.linkQuality = 0;
+    newRoute.cost = cost;
     newRoute.isValid = true;
     
     routingTable.push_back(newRoute);
-    Serial.printf("Added route to %d via %d (%d hops)\n", destId, nextHop, hopCount);
+    Serial.printf("Added route to %d via %d (%d hops, cost %.2f)\n",
+                  destId, nextHop, hopCount, cost / (float)MESH_COST_SCALE);
 }
 
 /**
@@ -314,15 +380,16 @@ void MeshRouter::removeRoute(uint8_t destId) {
 /**
  * @brief Update existing route
  */
-void MeshRouter::updateRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount, int16_t rssi) {
+void MeshRouter::updateRoute(uint8_t destId, uint8_t nextHop, uint8_t hopCount, uint16_t cost, int16_t rssi) {
     RouteEntry* route = getRoute(destId);
     if (route) {
         route->nextHop = nextHop;
         route->hopCount = hopCount;
+        route->cost = cost;
         route->linkQuality = rssi;
         route->lastUsed = millis();
     } else {
-        addRoute(destId, nextHop, hopCount);
+        addRoute(destId, nextHop, hopCount, cost);
     }
 }
 
@@ -352,9 +419,178 @@ void MeshRouter::cleanupExpiredRoutes() {
  * @brief Discover route to destination
  */
 bool MeshRouter::discoverRoute(uint8_t destId) {
+    if (findDiscovery(destId)) {
+        return true;  // Already in flight
+    }
+    
+    Discovery* slot = nullptr;
+    for (auto& d : discoveries) {
+        if (!d.active) {
+            slot = &d;
+            break;
+        }
+    }
+    if (!slot) {
+        return false;
+    }
+    
+    slot->active = true;
+    slot->destId = destId;
+    slot->retries = 0;
+    slot->deadline = millis() + ROUTE_DISCOVERY_TIMEOUT_MS;
+    
     sendRouteRequest(destId);
     routeDiscoveries++;
-    return true;  // Async operation
+    return true;  // Async operation, advanced by loop()
+}
+
+/**
+ * @brief Find the discovery in flight for a destination
+ */
+MeshRouter::Discovery* MeshRouter::findDiscovery(uint8_t destId) {
+    for (auto& d : discoveries) {
+        if (d.active && d.destId == destId) {
+            return &d;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Advance route discoveries: release packets, retry or give up
+ */
+void MeshRouter::serviceDiscoveries(uint32_t now) {
+    for (auto& d : discoveries) {
+        if (!d.active) {
+            continue;
+        }
+        
+        if (getRoute(d.destId)) {
+            flushPending(d.destId);
+            d.active = false;
+            continue;
+        }
+        
+        if ((int32_t)(now - d.deadline) < 0) {
+            continue;
+        }
+        
+        if (d.retries < MESH_RREQ_RETRIES) {
+            d.retries++;
+            d.deadline = now + ((uint32_t)ROUTE_DISCOVERY_TIMEOUT_MS << d.retries);
+            Serial.printf("Route discovery for %d timed out, retry %d/%d\n",
+                          d.destId, d.retries, MESH_RREQ_RETRIES);
+            sendRouteRequest(d.destId);
+        } else {
+            Serial.printf("Route discovery for %d failed\n", d.destId);
+            dropPending(d.destId);
+            d.active = false;
+        }
+    }
+}
+
+/**
+ * @brief Queue held packets for a destination that now has a route
+ */
+void MeshRouter::flushPending(uint8_t destId) {
+    RouteEntry* route = getRoute(destId);
+    if (!route) {
+        return;
+    }
+    
+    for (auto& p : pending) {
+        if (!p.used || p.destId != destId) {
+            continue;
+        }
+        
+        MeshHeader header;
+        header.packetType = MESH_DATA;
+        header.sourceId = nodeId;
+        header.destId = destId;
+        header.nextHop = route->nextHop;
+        header.prevHop = nodeId;
+        header.hopCount = 0;
+        header.ttl = MAX_HOPS;
+        header.sequenceNum = getNextSequenceNumber();
+        
+        if (!queueFrame(&header, p.payload, p.size, 0)) {
+            return;  // TX queue full; the rest stay held until next loop()
+        }
+        p.used = false;
+        route->lastUsed = millis();
+        Serial.printf("Sending held packet to %d via %d (seq %d)\n",
+                      destId, route->nextHop, header.sequenceNum);
+    }
+}
+
+/**
+ * @brief Discard held packets for an unreachable destination
+ */
+void MeshRouter::dropPending(uint8_t destId) {
+    for (auto& p : pending) {
+        if (p.used && p.destId == destId) {
+            p.used = false;
+            packetsDropped++;
+        }
+    }
+}
+
+/**
+ * @brief Copy a frame into the TX queue
+ * @param jitterMs Random hold-off (0..jitterMs) before the frame may be sent
+ */
+bool MeshRouter::queueFrame(const MeshHeader* header, const uint8_t* payload, size_t payloadSize, uint16_t jitterMs) {
+    if (payloadSize > MESH_MAX_PAYLOAD) {
+        packetsDropped++;
+        return false;
+    }
+    
+    for (auto& f : txQueue) {
+        if (f.used) {
+            continue;
+        }
+        memcpy(f.data, header, sizeof(MeshHeader));
+        if (payloadSize > 0) {
+            memcpy(f.data + sizeof(MeshHeader), payload, payloadSize);
+        }
+        f.size = sizeof(MeshHeader) + payloadSize;
+        f.dueAt = millis() + (jitterMs > 0 ? esp_random() % (jitterMs + 1) : 0);
+        f.used = true;
+        return true;
+    }
+    
+    Serial.println("Mesh TX queue full, dropping frame");
+    packetsDropped++;
+    return false;
+}
+
+/**
+ * @brief Hand the oldest due frame to the radio
+ */
+void MeshRouter::serviceTxQueue(uint32_t now) {
+    TxFrame* next = nullptr;
+    for (auto& f : txQueue) {
+        if (!f.used || (int32_t)(now - f.dueAt) < 0) {
+            continue;
+        }
+        if ((int32_t)(now - f.dueAt) > MESH_TX_MAX_WAIT_MS) {
+            // Radio never came free; a late relay only adds collisions
+            f.used = false;
+            packetsDropped++;
+            continue;
+        }
+        if (!next || (int32_t)(f.dueAt - next->dueAt) < 0) {
+            next = &f;
+        }
+    }
+    
+    if (!next || !transmitter) {
+        return;
+    }
+    if (transmitter(transmitterContext, next->data, next->size)) {
+        next->used = false;
+        framesSent++;
+    }
 }
 
 /**
@@ -374,19 +610,30 @@ void MeshRouter::sendRouteRequest(uint8_t destId) {
     rreq.destId = destId;
     rreq.hopCount = 0;
     rreq.requestId = getNextRequestId();
+    rreq.pathCost = 0;
     
     Serial.printf("Sending RREQ for %d (reqID %d)\n", destId, rreq.requestId);
     
-    // TODO: Send via LoRa broadcast
+    // Ignore our own request when neighbours rebroadcast it
+    updateSeenPackets(nodeId, rreq.header.sequenceNum);
+    queueFrame(&rreq.header, (const uint8_t*)&rreq + sizeof(MeshHeader),
+               sizeof(RouteRequest) - sizeof(MeshHeader), 0);
 }
 
 /**
  * @brief Process route request
  */
-void MeshRouter::processRouteRequest(RouteRequest* rreq, int16_t rssi) {
+void MeshRouter::processRouteRequest(RouteRequest* rreq, int8_t snr) {
     Serial.printf("Received RREQ from %d for %d (hops %d)\n",
                   rreq->header.sourceId, rreq->destId, rreq->hopCount);
     
+    // Learn reverse route to source; a later copy over a cheaper path still
+    // improves it, even though only the first copy is rebroadcast
+    uint16_t reverseCost = addCost(rreq->pathCost, getLinkCost(rreq->header.prevHop, snr));
+    if (rreq->header.sourceId != nodeId) {
+        addRoute(rreq->header.sourceId, rreq->header.prevHop, rreq->hopCount + 1, reverseCost);
+    }
+    
     // Check for duplicate
     if (isPacketDuplicate(rreq->header.sourceId, rreq->header.sequenceNum)) {
         Serial.println("Duplicate RREQ, ignoring");
@@ -394,9 +641,6 @@ void MeshRouter::processRouteRequest(RouteRequest* rreq, int16_t rssi) {
     }
     updateSeenPackets(rreq->header.sourceId, rreq->header.sequenceNum);
     
-    // Learn reverse route to source
-    addRoute(rreq->header.sourceId, rreq->header.prevHop, rreq->hopCount + 1);
-    
     // Are we the destination?
     if (rreq->destId == nodeId) {
         // Send route reply
@@ -413,36 +657,42 @@ void MeshRouter::processRouteRequest(RouteRequest* rreq, int16_t rssi) {
         rrep.destId = rreq->destId;
         rrep.hopCount = 0;
         rrep.requestId = rreq->requestId;
+        rrep.pathCost = 0;
         
         Serial.printf("Sending RREP to %d\n", rreq->header.sourceId);
-        // TODO: Send via LoRa
+        queueFrame(&rrep.header, (const uint8_t*)&rrep + sizeof(MeshHeader),
+                   sizeof(RouteReply) - sizeof(MeshHeader), 0);
     } else if (forwardingEnabled && rreq->header.ttl > 0) {
         // Forward the request
         rreq->header.prevHop = nodeId;
         rreq->header.hopCount++;
         rreq->header.ttl--;
         rreq->hopCount++;
+        rreq->pathCost = reverseCost;
         
         Serial.println("Forwarding RREQ");
-        // TODO: Send via LoRa broadcast
+        queueFrame(&rreq->header, (const uint8_t*)rreq + sizeof(MeshHeader),
+                   sizeof(RouteRequest) - sizeof(MeshHeader), MESH_REBROADCAST_JITTER_MS);
     }
 }
 
 /**
  * @brief Process route reply
  */
-void MeshRouter::processRouteReply(RouteReply* rrep) {
+void MeshRouter::processRouteReply(RouteReply* rrep, int8_t snr) {
     Serial.printf("Received RREP from %d for %d (hops %d)\n",
                   rrep->header.sourceId, rrep->destId, rrep->hopCount);
     
     // Learn route to destination
-    addRoute(rrep->destId, rrep->header.prevHop, rrep->hopCount + 1);
+    uint16_t cost = addCost(rrep->pathCost, getLinkCost(rrep->header.prevHop, snr));
+    addRoute(rrep->destId, rrep->header.prevHop, rrep->hopCount + 1, cost);
     
     // Are we the original requester?
     if (rrep->header.destId == nodeId) {
         Serial.printf("Route discovery complete: %d hops to %d\n",
                       rrep->hopCount + 1, rrep->destId);
-    } else if (forwardingEnabled && rrep->header.ttl > 0) {
+        flushPending(rrep->destId);
+    } else if (forwardingEnabled && rrep->header.ttl > 0 && rrep->header.nextHop == nodeId) {
         // Forward the reply
         RouteEntry* route = getRoute(rrep->header.destId);
         if (route) {
@@ -451,9 +701,11 @@ void MeshRouter::processRouteReply(RouteReply* rrep) {
             rrep->header.hopCount++;
             rrep->header.ttl--;
             rrep->hopCount++;
+            rrep->pathCost = cost;
             
             Serial.println("Forwarding RREP");
-            // TODO: Send via LoRa
+            queueFrame(&rrep->header, (const uint8_t*)rrep + sizeof(MeshHeader),
+                       sizeof(RouteReply) - sizeof(MeshHeader), 0);
         }
     }
 }
@@ -475,22 +727,28 @@ void MeshRouter::sendNeighborBeacon() {
     beacon.neighborId = nodeId;
     beacon.rssi = 0;
     beacon.hopDistance = isBaseStation ? 0 : (hasRouteTo(1) ? getRoute(1)->hopCount : 255);
+    beacon.baseCost = isBaseStation ? 0 : (hasRouteTo(1) ? getRoute(1)->cost : MESH_COST_UNREACHABLE);
     
     Serial.printf("Sending neighbor beacon (hopDist %d)\n", beacon.hopDistance);
-    // TODO: Send via LoRa broadcast
+    queueFrame(&beacon.header, (const uint8_t*)&beacon + sizeof(MeshHeader),
+               sizeof(NeighborBeacon) - sizeof(MeshHeader), MESH_REBROADCAST_JITTER_MS);
 }
 
 /**
  * @brief Process neighbor beacon
  */
-void MeshRouter::processNeighborBeacon(NeighborBeacon* beacon, int16_t rssi) {
+void MeshRouter::processNeighborBeacon(NeighborBeacon* beacon, int16_t rssi, int8_t snr) {
     uint8_t neighborId = beacon->neighborId;
+    uint32_t now = millis();
     
     // Update or add neighbor
     Neighbor* neighbor = getNeighbor(neighborId);
     if (neighbor) {
+        // Beacons due since the last one that never arrived count as losses
+        neighbor->deliveryRatio = effectiveDeliveryRatio(*neighbor, now);
+        neighbor->deliveryRatio += MESH_LINK_EWMA_ALPHA * (1.0f - neighbor->deliveryRatio);
         neighbor->rssi = rssi;
-        neighbor->lastSeen = millis();
+        neighbor->lastSeen = now;
         neighbor->hopDistance = beacon->hopDistance;
         neighbor->isActive = true;
     } else {
@@ -507,24 +765,80 @@ void MeshRouter::processNeighborBeacon(NeighborBeacon* beacon, int16_t rssi) {
         Neighbor newNeighbor;
         newNeighbor.nodeId = neighborId;
         newNeighbor.rssi = rssi;
-        newNeighbor.lastSeen = millis();
+        newNeighbor.lastSeen = now;
         newNeighbor.hopDistance = beacon->hopDistance;
         newNeighbor.isActive = true;
+        newNeighbor.deliveryRatio = MESH_LINK_DEFAULT_RATIO + MESH_LINK_EWMA_ALPHA * (1.0f - MESH_LINK_DEFAULT_RATIO);
+        newNeighbor.snr = snr;
         
         neighbors.push_back(newNeighbor);
+        neighbor = &neighbors.back();
         Serial.printf("Discovered neighbor %d (RSSI %d, hopDist %d)\n",
                       neighborId, rssi, beacon->hopDistance);
-        
-        // If neighbor has route to base station, use it
-        if (!isBaseStation && beacon->hopDistance < 255) {
-            RouteEntry* baseRoute = getRoute(1);  // Base station ID = 1
-            if (!baseRoute || baseRoute->hopCount > beacon->hopDistance + 1) {
-                addRoute(1, neighborId, beacon->hopDistance + 1);
-            }
-        }
+    }
+    neighbor->lastBeacon = now;
+    neighbor->baseCost = beacon->baseCost;
+    
+    // Route to the base station through the neighbour with the cheapest total cost
+    if (!isBaseStation && beacon->hopDistance < 255 && beacon->baseCost != MESH_COST_UNREACHABLE) {
+        uint16_t cost = addCost(beacon->baseCost, getLinkCost(neighborId, snr));
+        addRoute(1, neighborId, beacon->hopDistance + 1, cost);  // Base station ID = 1
+    }
+}
+
+/**
+ * @brief Delivery ratio including beacons overdue as of now
+ */
+float MeshRouter::effectiveDeliveryRatio(const Neighbor& neighbor, uint32_t now) const {
+    float ratio = neighbor.deliveryRatio;
+    uint32_t missed = (now - neighbor.lastBeacon + NEIGHBOR_BEACON_INTERVAL_MS / 2) / NEIGHBOR_BEACON_INTERVAL_MS;
+    missed = (missed > 0) ? missed - 1 : 0;
+    for (uint32_t i = 0; i < missed && ratio > 0.01f; i++) {
+        ratio -= MESH_LINK_EWMA_ALPHA * ratio;
+    }
+    return ratio;
+}
+
+/**
+ * @brief Fold a received frame's SNR into its transmitter's link estimate
+ */
+void MeshRouter::observeLink(uint8_t neighborId, int16_t rssi, int8_t snr) {
+    Neighbor* neighbor = getNeighbor(neighborId);
+    if (neighbor && neighborId != nodeId) {
+        neighbor->snr += MESH_LINK_EWMA_ALPHA * (snr - neighbor->snr);
+        neighbor->rssi = rssi;
     }
 }
 
+/**
+ * @brief ETX x100 for the link to a neighbour
+ *
+ * ETX = 1 / (df * dr). Only the reverse ratio is measured (their beacons
+ * reaching us), so the link is assumed symmetric: 1 / ratio^2. Links close
+ * to the demodulation floor are scaled up by up to 2x.
+ *
+ * @param snrHint SNR of the frame just received, used until the neighbour
+ *                has a beacon history
+ */
+uint16_t MeshRouter::getLinkCost(uint8_t neighborId, int8_t snrHint) {
+    const Neighbor* neighbor = getNeighbor(neighborId);
+    float ratio = neighbor ? effectiveDeliveryRatio(*neighbor, millis()) : MESH_LINK_DEFAULT_RATIO;
+    float snr = neighbor ? neighbor->snr : snrHint;
+    
+    if (ratio < 0.05f) {
+        ratio = 0.05f;
+    }
+    float etx = 1.0f / (ratio * ratio);
+    
+    float margin = snr - MESH_SNR_FLOOR_DB;
+    if (margin < MESH_SNR_MARGIN_DB) {
+        etx *= 1.0f + (MESH_SNR_MARGIN_DB - (margin > 0 ? margin : 0)) / MESH_SNR_MARGIN_DB;
+    }
+    
+    float cost = etx * MESH_COST_SCALE;
+    return (cost >= MESH_COST_UNREACHABLE - 1) ? MESH_COST_UNREACHABLE - 1 : (uint16_t)cost;
+}
+
 /**
  * @brief Get neighbor info
  */
@@ -597,13 +911,13 @@ void MeshRouter::printRoutingTable() {
     Serial.printf("Routes: %d/%d\n", routingTable.size(), MAX_ROUTES);
     
     for (const auto& route : routingTable) {
-        Serial.printf("  Dest %d -> NextHop %d (%d hops, RSSI %d, age %lus)\n",
-                      route.destId, route.nextHop, route.hopCount,
+        Serial.printf("  Dest %d -> NextHop %d (%d hops, cost %.2f, RSSI %d, age %lus)\n",
+                      route.destId, route.nextHop, route.hopCount, route.cost / (float)MESH_COST_SCALE,
                       route.linkQuality, (millis() - route.lastUsed) / 1000);
     }
     
-    Serial.printf("Stats: Forwarded=%lu, Dropped=%lu, Discoveries=%lu\n",
-                  packetsForwarded, packetsDropped, routeDiscoveries);
+    Serial.printf("Stats: Forwarded=%lu, Dropped=%lu, Discoveries=%lu, Sent=%lu\n",
+                  packetsForwarded, packetsDropped, routeDiscoveries, framesSent);
 }
 
 /**
@@ -614,8 +928,9 @@ void MeshRouter::printNeighbors() {
     Serial.printf("Count: %d\n", neighbors.size());
     
     for (const auto& neighbor : neighbors) {
-        Serial.printf("  Node %d: RSSI %d, HopDist %d, Age %lus %s\n",
-                      neighbor.nodeId, neighbor.rssi, neighbor.hopDistance,
+        Serial.printf("  Node %d: RSSI %d, SNR %.1f, Delivery %.2f, HopDist %d, Age %lus %s\n",
+                      neighbor.nodeId, neighbor.rssi, neighbor.snr,
+                      effectiveDeliveryRatio(neighbor, millis()), neighbor.hopDistance,
                       (millis() - neighbor.lastSeen) / 1000,
                       neighbor.isActive ? "" : "[INACTIVE]");
     }
@@ -625,6 +940,17 @@ void MeshRouter::printNeighbors() {
  * @brief Get network topology as JSON
  */
 String MeshRouter::getNetworkTopologyJSON() {
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return "{}";
+    }
+    
+    uint8_t held = 0;
+    for (const auto& p : pending) {
+        if (p.used) {
+            held++;
+        }
+    }
+    
     String json = "{";
     json += "\"nodeId\":" + String(nodeId) + ",";
     json += "\"neighbors\":[";
@@ -635,6 +961,9 @@ String MeshRouter::getNetworkTopologyJSON() {
         json += ",\"rssi\":" + String(neighbors[i].rssi);
         json += ",\"hopDist\":" + String(neighbors[i].hopDistance);
         json += ",\"active\":" + String(neighbors[i].isActive ? "true" : "false");
+        json += ",\"snr\":" + String(neighbors[i].snr, 1);
+        json += ",\"delivery\":" + String(effectiveDeliveryRatio(neighbors[i], millis()), 2);
+        json += ",\"cost\":" + String(getLinkCost(neighbors[i].nodeId, 0) / (float)MESH_COST_SCALE, 2);
         json += "}";
     }
     
@@ -645,10 +974,17 @@ String MeshRouter::getNetworkTopologyJSON() {
         json += "{\"dest\":" + String(routingTable[i].destId);
         json += ",\"nextHop\":" + String(routingTable[i].nextHop);
         json += ",\"hops\":" + String(routingTable[i].hopCount);
+        json += ",\"cost\":" + String(routingTable[i].cost / (float)MESH_COST_SCALE, 2);
         json += "}";
     }
     
-    json += "]}";
+    json += "],\"stats\":{\"sent\":" + String(framesSent);
+    json += ",\"forwarded\":" + String(packetsForwarded);
+    json += ",\"dropped\":" + String(packetsDropped);
+    json += ",\"discoveries\":" + String(routeDiscoveries);
+    json += ",\"held\":" + String(held);
+    json += "}}";
+    unlock();
     return json;
 }
 
@@ -656,29 +992,46 @@ String MeshRouter::getNetworkTopologyJSON() {
  * @brief Check if packet is duplicate
  */
 bool MeshRouter::isPacketDuplicate(uint8_t sourceId, uint16_t seqNum) {
-    for (const auto& pkt : seenPackets) {
-        if (pkt.sourceId == sourceId && pkt.seqNum == seqNum) {
-            return true;
-        }
+    const SeenWindow& w = seenWindows[sourceId];
+    if (!w.active || millis() - w.lastSeen > SEEN_PACKET_TIMEOUT_MS) {
+        return false;
     }
-    return false;
+    
+    // Sequence numbers wrap; half the space ahead of the newest counts as new
+    uint16_t behind = (uint16_t)(w.newest - seqNum);
+    if (behind >= 0x8000) {
+        return false;
+    }
+    if (behind < 32) {
+        return (w.bitmap >> behind) & 1;
+    }
+    // Older than the window: a late copy, unless the source restarted its count
+    return behind < MESH_SEEN_RESTART_GAP;
 }
 
 /**
  * @brief Add packet to seen list
  */
 void MeshRouter::updateSeenPackets(uint8_t sourceId, uint16_t seqNum) {
-    PacketId pkt;
-    pkt.sourceId = sourceId;
-    pkt.seqNum = seqNum;
-    pkt.timestamp = millis();
-    
-    seenPackets.push_back(pkt);
+    SeenWindow& w = seenWindows[sourceId];
+    uint32_t now = millis();
+    uint16_t behind = (uint16_t)(w.newest - seqNum);
     
-    // Limit cache size
-    if (seenPackets.size() > 100) {
-        seenPackets.erase(seenPackets.begin());
+    if (!w.active || now - w.lastSeen > SEEN_PACKET_TIMEOUT_MS ||
+        (behind < 0x8000 && behind >= MESH_SEEN_RESTART_GAP)) {
+        // First frame, aged out, or source rebooted: start a fresh window
+        w.newest = seqNum;
+        w.bitmap = 1;
+        w.active = true;
+    } else if (behind >= 0x8000) {
+        // Newer than anything seen: slide the window forward
+        uint16_t ahead = (uint16_t)(seqNum - w.newest);
+        w.bitmap = (ahead < 32) ? ((w.bitmap << ahead) | 1) : 1;
+        w.newest = seqNum;
+    } else if (behind < 32) {
+        w.bitmap |= (1UL << behind);
     }
+    w.lastSeen = now;
 }
 
 /**
@@ -687,11 +1040,9 @@ void MeshRouter::updateSeenPackets(uint8_t sourceId, uint16_t seqNum) {
 void MeshRouter::cleanupSeenPackets() {
     uint32_t now = millis();
     
-    for (auto it = seenPackets.begin(); it != seenPackets.end(); ) {
-        if (now - it->timestamp > SEEN_PACKET_TIMEOUT_MS) {
-            it = seenPackets.erase(it);
-        } else {
-            ++it;
+    for (auto& w : seenWindows) {
+        if (w.active && now - w.lastSeen > SEEN_PACKET_TIMEOUT_MS) {
+            w.active = false;
         }
     }
 }
@@ -10,6 +10,8 @@
 #include "mqtt_client.h"
 #include "sensor_interface.h"
 #include "data_types.h"
+#include "config.h"
+#include "logger.h"
 #include <Preferences.h>
 #include <ArduinoJson.h>
 
@@ -37,6 +39,7 @@ MQTTClientManager::MQTTClientManager() :
     strcpy(config.topicPrefix, "lora");
     config.homeAssistantDiscovery = true;
     config.qos = 0;
+    config.publishMode = MQTT_PUBLISH_PER_VALUE;
 }
 
 /**
@@ -44,14 +47,38 @@ MQTTClientManager::MQTTClientManager() :
  */
 void MQTTClientManager::begin() {
     Serial.println("Initializing MQTT client...");
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    if (topicMutex == nullptr) {
+        topicMutex = xSemaphoreCreateMutex();
+    }
+    if (formatMutex == nullptr) {
+        formatMutex = xSemaphoreCreateMutex();
+    }
     loadConfig();
+    outbound.begin();
     
     if (config.enabled && strlen(config.broker) > 0) {
-        mqttClient.setServer(config.broker, config.port);
-        mqttClient.setBufferSize(512);  // Increase buffer for Home Assistant discovery
+        if (lock(pdMS_TO_TICKS(1000))) {
+            mqttClient.setServer(config.broker, config.port);
+            mqttClient.setBufferSize(MQTT_PAYLOAD_MAX);  // Increase buffer for Home Assistant discovery
+            unlock();
+        }
         initialized = true;
         Serial.printf("MQTT configured: %s:%d\n", config.broker, config.port);
+        
+        // The task owns the connection from here on; loop() becomes a no-op
+        if (taskHandle == nullptr) {
+            BaseType_t ok = xTaskCreatePinnedToCore(taskEntry, "mqtt", MQTT_TASK_STACK, this,
+                                                    MQTT_TASK_PRIORITY, &taskHandle, MQTT_TASK_CORE);
+            if (ok != pdPASS) {
+                taskHandle = nullptr;
+                LOGE("MQTT", "Failed to start MQTT task; publishing from loop()");
+            }
+        }
     } else {
+        initialized = false;
         Serial.println("MQTT disabled or not configured");
     }
 }
@@ -77,8 +104,10 @@ void MQTTClientManager::loadConfig() {
     prefs.getString("prefix", config.topicPrefix, sizeof(config.topicPrefix));
     config.homeAssistantDiscovery = prefs.getBool("haDiscovery", true);
     config.qos = prefs.getUChar("qos", 0);
+    config.publishMode = prefs.getUChar("pubMode", MQTT_PUBLISH_PER_VALUE);
     
     prefs.end();
+    invalidateTopics();  // Prefix may have changed
     
     Serial.printf("MQTT Config loaded - Enabled: %d, Broker: %s:%d\n", 
                   config.enabled, config.broker, config.port);
@@ -99,6 +128,7 @@ void MQTTClientManager::saveConfig() {
     prefs.putString("prefix", config.topicPrefix);
     prefs.putBool("haDiscovery", config.homeAssistantDiscovery);
     prefs.putUChar("qos", config.qos);
+    prefs.putUChar("pubMode", config.publishMode);
     
     prefs.end();
     
@@ -116,6 +146,18 @@ MQTTConfig* MQTTClientManager::getConfig() {
  * @brief Connect to MQTT broker
  */
 bool MQTTClientManager::connect() {
+    if (!lock(pdMS_TO_TICKS(1000))) {
+        return false;
+    }
+    bool result = connectLocked();
+    unlock();
+    return result;
+}
+
+/**
+ * @brief Connect with the client lock held
+ */
+bool MQTTClientManager::connectLocked() {
     if (!initialized || !config.enabled || WiFi.status() != WL_CONNECTED) {
         return false;
     }
@@ -168,12 +210,16 @@ bool MQTTClientManager::connect() {
  * @brief Disconnect from MQTT broker
  */
 void MQTTClientManager::disconnect() {
+    if (!lock(pdMS_TO_TICKS(1000))) {
+        return;
+    }
     if (mqttClient.connected()) {
         String statusTopic = buildTopic("status");
         mqttClient.publish(statusTopic.c_str(), "offline", true);
         mqttClient.disconnect();
         Serial.println("MQTT disconnected");
     }
+    unlock();
 }
 
 /**
@@ -185,17 +231,236 @@ bool MQTTClientManager::isConnected() {
 
 /**
  * @brief Maintain MQTT connection (call in loop)
+ *
+ * Only does work if the MQTT task could not be started.
  */
 void MQTTClientManager::loop() {
+    if (taskHandle != nullptr) {
+        return;
+    }
+    service();
+}
+
+/**
+ * @brief MQTT task: services the connection and drains the queue
+ */
+void MQTTClientManager::taskEntry(void* arg) {
+    MQTTClientManager* self = static_cast<MQTTClientManager*>(arg);
+    for (;;) {
+        self->service();
+        // Woken early by publish(); otherwise poll for keepalive/reconnect
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_TASK_IDLE_MS));
+    }
+}
+
+/**
+ * @brief One pass: keep the connection up, spill if the ring is filling, publish a batch
+ */
+void MQTTClientManager::service() {
     if (!initialized || !config.enabled) {
         return;
     }
     
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;  // Client busy (web request); try again next pass
+    }
     if (!mqttClient.connected()) {
-        connect();
+        connectLocked();
     } else {
         mqttClient.loop();
     }
+    unlock();
+    
+    outbound.spill();
+    drainQueue();
+}
+
+// ============================================================================
+// OUTBOUND QUEUE
+// ============================================================================
+
+/**
+ * @brief Queue a message for the MQTT task (safe from any task)
+ */
+bool MQTTClientManager::publish(const char* topic, const char* payload, bool retain) {
+    if (!initialized || !config.enabled) {
+        return false;
+    }
+    bool queued = outbound.push(topic, payload, retain);
+    if (queued && taskHandle != nullptr) {
+        xTaskNotifyGive(taskHandle);
+    }
+    return queued;
+}
+
+/**
+ * @brief Publish up to MQTT_DRAIN_BATCH messages, journal first (it is older)
+ *
+ * A message stays queued while the broker is unreachable. A publish that fails
+ * on a live connection (e.g. larger than the client buffer) is dropped so it
+ * cannot block the queue.
+ */
+void MQTTClientManager::drainQueue() {
+    if (outbound.empty()) {
+        return;
+    }
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;
+    }
+    bool up = mqttClient.connected();
+    unlock();
+    if (!up) {
+        return;
+    }
+    
+    for (int n = 0; n < MQTT_DRAIN_BATCH; n++) {
+        uint16_t size;
+        const uint8_t* record = outbound.peek(size);
+        if (record == nullptr) {
+            break;
+        }
+        
+        const MQTTRecordHeader* header = (const MQTTRecordHeader*)record;
+        memcpy(topicBuf, record + sizeof(MQTTRecordHeader), header->topicLen);
+        topicBuf[header->topicLen] = '\0';
+        
+        if (!lock(pdMS_TO_TICKS(1000))) {
+            break;
+        }
+        bool connected = mqttClient.connected();
+        const uint32_t sendStartUs = micros();
+        bool ok = connected && mqttClient.publish(topicBuf,
+                                                  record + sizeof(MQTTRecordHeader) + header->topicLen,
+                                                  header->payloadLen,
+                                                  (header->flags & MQTT_RECORD_RETAIN) != 0);
+        connected = mqttClient.connected();
+        unlock();
+        
+        if (ok) {
+            const uint32_t sendUs = micros() - sendStartUs;
+            sendTiming.count++;
+            sendTiming.lastUs = sendUs;
+            sendTiming.totalUs += sendUs;
+            if (sendUs > sendTiming.maxUs) {
+                sendTiming.maxUs = sendUs;
+            }
+            const uint32_t nowMs = millis();
+            if (nowMs - sendMinuteStartMs >= 60000) {
+                sentLastMinute = (nowMs - sendMinuteStartMs < 120000) ? sendMinuteCount : 0;
+                sendMinuteStartMs = nowMs;
+                sendMinuteCount = 0;
+            }
+            sendMinuteCount++;
+            publishCount++;
+        } else if (connected) {
+            Serial.printf("MQTT publish failed to %s\n", topicBuf);
+            failedPublishCount++;
+        } else {
+            break;  // Keep it for the next connection
+        }
+        outbound.pop(ok);
+    }
+    outbound.endBatch();
+}
+
+void MQTTClientManager::getQueueStats(MQTTQueueStats& out) {
+    memset(&out, 0, sizeof(out));
+    out.taskRunning = (taskHandle != nullptr);
+    outbound.getStats(out);
+}
+
+void MQTTClientManager::getPerfStats(MQTTPerfStats& out) {
+    memset(&out, 0, sizeof(out));
+    out.producer = producerTiming;
+    out.producerMessages = producerMessages;
+    out.send = sendTiming;
+    out.sentLastMinute = (millis() - sendMinuteStartMs < 120000) ? sentLastMinute : 0;
+    out.topicCacheHits = topicCacheHits;
+    out.topicCacheMisses = topicCacheMisses;
+    out.heapFree = ESP.getFreeHeap();
+    out.heapMinFree = ESP.getMinFreeHeap();
+    out.heapLargestBlock = ESP.getMaxAllocHeap();
+    // Share of free heap not usable as one block
+    out.heapFragmentationPct = (out.heapFree > 0)
+        ? (uint8_t)(100 - (uint64_t)out.heapLargestBlock * 100 / out.heapFree)
+        : 0;
+}
+
+// Topic suffix (and JSON key) per value type; NULL for types that are not published
+static const char* valueTopicSuffix(uint8_t type) {
+    switch (type) {
+        case VALUE_TEMPERATURE:     return "temperature";
+        case VALUE_HUMIDITY:        return "humidity";
+        case VALUE_PRESSURE:        return "pressure";
+        case VALUE_LIGHT:           return "light";
+        case VALUE_VOLTAGE:         return "voltage";
+        case VALUE_CURRENT:         return "current";
+        case VALUE_POWER:           return "power";
+        case VALUE_GAS_RESISTANCE:  return "gas_resistance";
+        case VALUE_MOISTURE:        return "moisture";
+        default:                    return NULL;
+    }
+}
+
+/**
+ * @brief Write "<prefix>/sensor/<id>/<suffix>" into out without touching the heap
+ *
+ * The "<prefix>/sensor/<id>/" part is cached per sensor (built when the sensor is
+ * first published, dropped when the prefix is reloaded).
+ */
+void MQTTClientManager::sensorTopic(uint8_t sensorId, const char* suffix, char* out, size_t outSize) {
+    if (topicMutex != nullptr) {
+        xSemaphoreTake(topicMutex, portMAX_DELAY);
+    }
+    uint8_t slot = topicSlot[sensorId];
+    if (slot == 0) {
+        // Claim the next slot round-robin, unlinking the sensor that held it
+        slot = topicNextSlot + 1;
+        topicNextSlot = (topicNextSlot + 1) % MQTT_TOPIC_CACHE_SIZE;
+        MQTTTopicBase& base = topicTable[slot - 1];
+        if (base.len > 0 && topicSlot[base.sensorId] == slot) {
+            topicSlot[base.sensorId] = 0;
+        }
+        base.sensorId = sensorId;
+        base.len = snprintf(base.topic, sizeof(base.topic), "%s/sensor/%u/", config.topicPrefix, sensorId);
+        topicSlot[sensorId] = slot;
+        topicCacheMisses++;
+    } else {
+        topicCacheHits++;
+    }
+    const MQTTTopicBase& base = topicTable[slot - 1];
+    size_t suffixLen = strlen(suffix);
+    if (base.len + suffixLen >= outSize) {
+        suffixLen = outSize - 1 - base.len;
+    }
+    memcpy(out, base.topic, base.len);
+    memcpy(out + base.len, suffix, suffixLen);
+    out[base.len + suffixLen] = '\0';
+    if (topicMutex != nullptr) {
+        xSemaphoreGive(topicMutex);
+    }
+}
+
+void MQTTClientManager::invalidateTopics() {
+    if (topicMutex != nullptr) {
+        xSemaphoreTake(topicMutex, portMAX_DELAY);
+    }
+    memset(topicSlot, 0, sizeof(topicSlot));
+    memset(topicTable, 0, sizeof(topicTable));
+    topicNextSlot = 0;
+    if (topicMutex != nullptr) {
+        xSemaphoreGive(topicMutex);
+    }
+}
+
+void MQTTClientManager::recordProducerTime(uint32_t elapsedUs, uint8_t messages) {
+    producerMessages += messages;
+    producerTiming.count++;
+    producerTiming.lastUs = elapsedUs;
+    producerTiming.totalUs += elapsedUs;
+    if (elapsedUs > producerTiming.maxUs) {
+        producerTiming.maxUs = elapsedUs;
+    }
 }
 
 /**
@@ -204,38 +469,44 @@ void MQTTClientManager::loop() {
 bool MQTTClientManager::publishSensorData(uint8_t sensorId, const char* location, 
                                          float temperature, uint8_t battery, 
                                          int16_t rssi, int8_t snr) {
-    if (!isConnected()) {
-        failedPublishCount++;
+    if (!initialized || !config.enabled) {
         return false;
     }
+    if (formatMutex != nullptr && xSemaphoreTake(formatMutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        outbound.countDropped();
+        return false;
+    }
+    const uint32_t startUs = micros();
     
-    // Publish individual topics
-    String tempTopic = buildSensorTopic(sensorId, "temperature");
-    String battTopic = buildSensorTopic(sensorId, "battery");
-    String rssiTopic = buildSensorTopic(sensorId, "rssi");
-    String snrTopic = buildSensorTopic(sensorId, "snr");
-    
+    char topic[MQTT_TOPIC_MAX + 1];
     char payload[16];
     bool success = true;
+    uint8_t messages = 1;  // JSON state
     
-    // Temperature
-    snprintf(payload, sizeof(payload), "%.1f", temperature);
-    success &= publish(tempTopic.c_str(), payload);
-    
-    // Battery
-    snprintf(payload, sizeof(payload), "%d", battery);
-    success &= publish(battTopic.c_str(), payload);
-    
-    // RSSI
-    snprintf(payload, sizeof(payload), "%d", rssi);
-    success &= publish(rssiTopic.c_str(), payload);
-    
-    // SNR
-    snprintf(payload, sizeof(payload), "%d", snr);
-    success &= publish(snrTopic.c_str(), payload);
+    if (config.publishMode == MQTT_PUBLISH_PER_VALUE) {
+        // Temperature
+        snprintf(payload, sizeof(payload), "%.1f", temperature);
+        sensorTopic(sensorId, "temperature", topic, sizeof(topic));
+        success &= publish(topic, payload);
+        
+        // Battery
+        snprintf(payload, sizeof(payload), "%d", battery);
+        sensorTopic(sensorId, "battery", topic, sizeof(topic));
+        success &= publish(topic, payload);
+        
+        // RSSI
+        snprintf(payload, sizeof(payload), "%d", rssi);
+        sensorTopic(sensorId, "rssi", topic, sizeof(topic));
+        success &= publish(topic, payload);
+        
+        // SNR
+        snprintf(payload, sizeof(payload), "%d", snr);
+        sensorTopic(sensorId, "snr", topic, sizeof(topic));
+        success &= publish(topic, payload);
+        messages += 4;
+    }
     
-    // Also publish combined JSON (for compatibility)
-    String jsonTopic = buildSensorTopic(sensorId, "state");
+    // Combined JSON (the only message in MQTT_PUBLISH_STATE_ONLY mode)
     StaticJsonDocument<256> doc;
     doc["sensor_id"] = sensorId;
     doc["location"] = location;
@@ -245,16 +516,14 @@ bool MQTTClientManager::publishSensorData(uint8_t sensorId, const char* location
     doc["snr"] = snr;
     doc["timestamp"] = millis() / 1000;
     
-    String jsonPayload;
-    serializeJson(doc, jsonPayload);
-    success &= publish(jsonTopic.c_str(), jsonPayload.c_str());
+    serializeJson(doc, stateBuf, sizeof(stateBuf));
+    sensorTopic(sensorId, "state", topic, sizeof(topic));
+    success &= publish(topic, stateBuf);
     
-    if (success) {
-        publishCount++;
-    } else {
-        failedPublishCount++;
+    recordProducerTime(micros() - startUs, messages);
+    if (formatMutex != nullptr) {
+        xSemaphoreGive(formatMutex);
     }
-    
     return success;
 }
 
@@ -264,69 +533,54 @@ bool MQTTClientManager::publishSensorData(uint8_t sensorId, const char* location
 bool MQTTClientManager::publishMultiSensorData(uint8_t sensorId, const char* location,
                                               const SensorValuePacket* values, uint8_t valueCount,
                                               uint8_t battery, int16_t rssi, int8_t snr) {
-    if (!isConnected()) {
-        failedPublishCount++;
+    if (!initialized || !config.enabled) {
+        return false;
+    }
+    if (formatMutex != nullptr && xSemaphoreTake(formatMutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        outbound.countDropped();
         return false;
     }
+    const uint32_t startUs = micros();
     
+    char topic[MQTT_TOPIC_MAX + 1];
     char payload[16];
     bool success = true;
-    
-    // Publish each sensor value to its own topic
-    for (uint8_t i = 0; i < valueCount; i++) {
-        String topic;
-        snprintf(payload, sizeof(payload), "%.2f", values[i].value);
-        
-        switch(values[i].type) {
-            case VALUE_TEMPERATURE:
-                topic = buildSensorTopic(sensorId, "temperature");
-                break;
-            case VALUE_HUMIDITY:
-                topic = buildSensorTopic(sensorId, "humidity");
-                break;
-            case VALUE_PRESSURE:
-                topic = buildSensorTopic(sensorId, "pressure");
-                break;
-            case VALUE_LIGHT:
-                topic = buildSensorTopic(sensorId, "light");
-                break;
-            case VALUE_VOLTAGE:
-                topic = buildSensorTopic(sensorId, "voltage");
-                break;
-            case VALUE_CURRENT:
-                topic = buildSensorTopic(sensorId, "current");
-                break;
-            case VALUE_POWER:
-                topic = buildSensorTopic(sensorId, "power");
-                break;
-            case VALUE_GAS_RESISTANCE:
+    uint8_t messages = 1;  // JSON state
+    
+    if (config.publishMode == MQTT_PUBLISH_PER_VALUE) {
+        // Queue each sensor value for its own topic
+        for (uint8_t i = 0; i < valueCount; i++) {
+            const char* suffix = valueTopicSuffix(values[i].type);
+            if (suffix == NULL) {
+                continue;  // Skip unknown value types
+            }
+            if (values[i].type == VALUE_GAS_RESISTANCE) {
                 // Convert ohms to kilo-ohms for display
                 snprintf(payload, sizeof(payload), "%.2f", values[i].value / 1000.0f);
-                topic = buildSensorTopic(sensorId, "gas_resistance");
-                break;
-            case VALUE_MOISTURE:
-                topic = buildSensorTopic(sensorId, "moisture");
-                break;
-            default:
-                // Skip unknown value types
-                continue;
+            } else {
+                snprintf(payload, sizeof(payload), "%.2f", values[i].value);
+            }
+            sensorTopic(sensorId, suffix, topic, sizeof(topic));
+            success &= publish(topic, payload);
+            messages++;
         }
         
-        success &= publish(topic.c_str(), payload);
+        // Publish battery and signal strength
+        snprintf(payload, sizeof(payload), "%d", battery);
+        sensorTopic(sensorId, "battery", topic, sizeof(topic));
+        success &= publish(topic, payload);
+        
+        snprintf(payload, sizeof(payload), "%d", rssi);
+        sensorTopic(sensorId, "rssi", topic, sizeof(topic));
+        success &= publish(topic, payload);
+        
+        snprintf(payload, sizeof(payload), "%d", snr);
+        sensorTopic(sensorId, "snr", topic, sizeof(topic));
+        success &= publish(topic, payload);
+        messages += 3;
     }
     
-    // Publish battery and signal strength
-    snprintf(payload, sizeof(payload), "%d", battery);
-    success &= publish(buildSensorTopic(sensorId, "battery").c_str(), payload);
-    
-    snprintf(payload, sizeof(payload), "%d", rssi);
-    success &= publish(buildSensorTopic(sensorId, "rssi").c_str(), payload);
-    
-    snprintf(payload, sizeof(payload), "%d", snr);
-    success &= publish(buildSensorTopic(sensorId, "snr").c_str(), payload);
-    
-    // Publish combined JSON state
-    String jsonTopic = buildSensorTopic(sensorId, "state");
+    // Publish combined JSON state (the only message in MQTT_PUBLISH_STATE_ONLY mode)
     StaticJsonDocument<512> doc;
     doc["sensor_id"] = sensorId;
     doc["location"] = location;
@@ -338,47 +592,25 @@ bool MQTTClientManager::publishMultiSensorData(uint8_t sensorId, const char* loc
     // Add all sensor values to JSON
     JsonObject readings = doc.createNestedObject("readings");
     for (uint8_t i = 0; i < valueCount; i++) {
-        switch(values[i].type) {
-            case VALUE_TEMPERATURE:
-                readings["temperature"] = values[i].value;
-                break;
-            case VALUE_HUMIDITY:
-                readings["humidity"] = values[i].value;
-                break;
-            case VALUE_PRESSURE:
-                readings["pressure"] = values[i].value;
-                break;
-            case VALUE_LIGHT:
-                readings["light"] = values[i].value;
-                break;
-            case VALUE_VOLTAGE:
-                readings["voltage"] = values[i].value;
-                break;
-            case VALUE_CURRENT:
-                readings["current"] = values[i].value;
-                break;
-            case VALUE_POWER:
-                readings["power"] = values[i].value;
-                break;
-            case VALUE_GAS_RESISTANCE:
-                readings["gas_resistance"] = values[i].value / 1000.0f;  // kΩ
-                break;
-            case VALUE_MOISTURE:
-                readings["moisture"] = values[i].value;
-                break;
+        const char* key = valueTopicSuffix(values[i].type);
+        if (key == NULL) {
+            continue;
+        }
+        if (values[i].type == VALUE_GAS_RESISTANCE) {
+            readings[key] = values[i].value / 1000.0f;  // kΩ
+        } else {
+            readings[key] = values[i].value;
         }
     }
     
-    String jsonPayload;
-    serializeJson(doc, jsonPayload);
-    success &= publish(jsonTopic.c_str(), jsonPayload.c_str());
+    serializeJson(doc, stateBuf, sizeof(stateBuf));
+    sensorTopic(sensorId, "state", topic, sizeof(topic));
+    success &= publish(topic, stateBuf);
     
-    if (success) {
-        publishCount++;
-    } else {
-        failedPublishCount++;
+    recordProducerTime(micros() - startUs, messages);
+    if (formatMutex != nullptr) {
+        xSemaphoreGive(formatMutex);
     }
-    
     return success;
 }
 
@@ -412,7 +644,7 @@ bool MQTTClientManager::publishBaseStationStatus(uint8_t activeSensors,
  * @brief Publish Home Assistant MQTT discovery config
  */
 void MQTTClientManager::publishHomeAssistantDiscovery(uint8_t sensorId, const char* location) {
-    if (!isConnected() || !config.homeAssistantDiscovery) {
+    if (!initialized || !config.homeAssistantDiscovery) {
         return;
     }
     
@@ -423,15 +655,18 @@ void MQTTClientManager::publishHomeAssistantDiscovery(uint8_t sensorId, const ch
     
     String deviceId = "lora_sensor_" + String(sensorId);
     
+    // Entities read the combined state message, which is sent in every publish mode
+    String stateTopic = buildSensorTopic(sensorId, "state");
+    
     // Temperature sensor
     String tempConfigTopic = "homeassistant/sensor/" + deviceId + "_temperature/config";
     StaticJsonDocument<512> tempDoc;
     tempDoc["name"] = deviceName + " Temperature";
     tempDoc["unique_id"] = deviceId + "_temp";
-    tempDoc["state_topic"] = buildSensorTopic(sensorId, "temperature");
+    tempDoc["state_topic"] = stateTopic;
     tempDoc["unit_of_measurement"] = "°C";
     tempDoc["device_class"] = "temperature";
-    tempDoc["value_template"] = "{{ value }}";
+    tempDoc["value_template"] = "{{ value_json.temperature }}";
     
     JsonObject device = tempDoc.createNestedObject("device");
     device["identifiers"][0] = deviceId;
@@ -448,10 +683,10 @@ void MQTTClientManager::publishHomeAssistantDiscovery(uint8_t sensorId, const ch
     StaticJsonDocument<512> battDoc;
     battDoc["name"] = deviceName + " Battery";
     battDoc["unique_id"] = deviceId + "_battery";
-    battDoc["state_topic"] = buildSensorTopic(sensorId, "battery");
+    battDoc["state_topic"] = stateTopic;
     battDoc["unit_of_measurement"] = "%";
     battDoc["device_class"] = "battery";
-    battDoc["value_template"] = "{{ value }}";
+    battDoc["value_template"] = "{{ value_json.battery }}";
     battDoc["device"] = device;
     
     String battPayload;
@@ -463,10 +698,10 @@ void MQTTClientManager::publishHomeAssistantDiscovery(uint8_t sensorId, const ch
     StaticJsonDocument<512> rssiDoc;
     rssiDoc["name"] = deviceName + " RSSI";
     rssiDoc["unique_id"] = deviceId + "_rssi";
-    rssiDoc["state_topic"] = buildSensorTopic(sensorId, "rssi");
+    rssiDoc["state_topic"] = stateTopic;
     rssiDoc["unit_of_measurement"] = "dBm";
     rssiDoc["device_class"] = "signal_strength";
-    rssiDoc["value_template"] = "{{ value }}";
+    rssiDoc["value_template"] = "{{ value_json.rssi }}";
     rssiDoc["device"] = device;
     
     String rssiPayload;
@@ -482,7 +717,7 @@ void MQTTClientManager::publishHomeAssistantDiscovery(uint8_t sensorId, const ch
 void MQTTClientManager::publishHomeAssistantMultiSensorDiscovery(uint8_t sensorId, const char* location,
                                                                 const SensorValuePacket* values, 
                                                                 uint8_t valueCount) {
-    if (!isConnected() || !config.homeAssistantDiscovery) {
+    if (!initialized || !config.homeAssistantDiscovery) {
         return;
     }
     
@@ -493,6 +728,10 @@ void MQTTClientManager::publishHomeAssistantMultiSensorDiscovery(uint8_t sensorI
     
     String deviceId = "lora_sensor_" + String(sensorId);
     
+    // Entities extract their value from the combined state message, which is
+    // sent in every publish mode
+    String stateTopic = buildSensorTopic(sensorId, "state");
+    
     // Create device info object once
     StaticJsonDocument<256> deviceDoc;
     JsonObject device = deviceDoc.to<JsonObject>();
@@ -574,12 +813,12 @@ void MQTTClientManager::publishHomeAssistantMultiSensorDiscovery(uint8_t sensorI
         
         doc["name"] = deviceName + " " + sensorName;
         doc["unique_id"] = deviceId + "_" + suffix;
-        doc["state_topic"] = buildSensorTopic(sensorId, suffix.c_str());
+        doc["state_topic"] = stateTopic;
         doc["unit_of_measurement"] = unit;
         if (deviceClass.length() > 0) {
             doc["device_class"] = deviceClass;
         }
-        doc["value_template"] = "{{ value }}";
+        doc["value_template"] = "{{ value_json.readings." + suffix + " }}";
         doc["device"] = device;
         
         String payload;
@@ -591,10 +830,10 @@ void MQTTClientManager::publishHomeAssistantMultiSensorDiscovery(uint8_t sensorI
     StaticJsonDocument<512> battDoc;
     battDoc["name"] = deviceName + " Battery";
     battDoc["unique_id"] = deviceId + "_battery";
-    battDoc["state_topic"] = buildSensorTopic(sensorId, "battery");
+    battDoc["state_topic"] = stateTopic;
     battDoc["unit_of_measurement"] = "%";
     battDoc["device_class"] = "battery";
-    battDoc["value_template"] = "{{ value }}";
+    battDoc["value_template"] = "{{ value_json.battery }}";
     battDoc["device"] = device;
     
     String battPayload;
@@ -605,10 +844,10 @@ void MQTTClientManager::publishHomeAssistantMultiSensorDiscovery(uint8_t sensorI
     StaticJsonDocument<512> rssiDoc;
     rssiDoc["name"] = deviceName + " RSSI";
     rssiDoc["unique_id"] = deviceId + "_rssi";
-    rssiDoc["state_topic"] = buildSensorTopic(sensorId, "rssi");
+    rssiDoc["state_topic"] = stateTopic;
     rssiDoc["unit_of_measurement"] = "dBm";
     rssiDoc["device_class"] = "signal_strength";
-    rssiDoc["value_template"] = "{{ value }}";
+    rssiDoc["value_template"] = "{{ value_json.rssi }}";
     rssiDoc["device"] = device;
     
     String rssiPayload;
@@ -624,7 +863,7 @@ void MQTTClientManager::publishHomeAssistantMultiSensorDiscovery(uint8_t sensorI
  * @brief Remove Home Assistant discovery config
  */
 void MQTTClientManager::removeHomeAssistantDiscovery(uint8_t sensorId) {
-    if (!isConnected()) {
+    if (!initialized) {
         return;
     }
     
@@ -660,21 +899,6 @@ uint32_t MQTTClientManager::getReconnectCount() {
     return reconnectCount;
 }
 
-/**
- * @brief Publish message to topic
- */
-bool MQTTClientManager::publish(const char* topic, const char* payload, bool retain) {
-    if (!isConnected()) {
-        return false;
-    }
-    
-    bool result = mqttClient.publish(topic, payload, retain);
-    if (!result) {
-        Serial.printf("MQTT publish failed to %s\n", topic);
-    }
-    return result;
-}
-
 /**
  * @brief Build topic with prefix
  */
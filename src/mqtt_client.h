@@ -11,6 +11,8 @@
  * - Home Assistant MQTT auto-discovery
  * - Configurable topic structure
  * - QoS support
+ * - Outbound queue drained by a dedicated task; spills to a LittleFS journal
+ *   while the broker is unreachable and replays in order after reconnect
  */
 
 #ifndef MQTT_CLIENT_H
@@ -19,6 +21,62 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <PubSubClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "mqtt_queue.h"
+
+// ============================================================================
+// OUTBOUND QUEUE CONFIGURATION (ring and journal sizes: mqtt_queue.h)
+// ============================================================================
+
+// Messages published per task pass (bounds the time the client lock is held)
+#ifndef MQTT_DRAIN_BATCH
+  #define MQTT_DRAIN_BATCH          16
+#endif
+
+// Task wakes at least this often to service the connection
+#ifndef MQTT_TASK_IDLE_MS
+  #define MQTT_TASK_IDLE_MS         100
+#endif
+
+// Sensors whose "<prefix>/sensor/<id>/" topic base is cached
+#ifndef MQTT_TOPIC_CACHE_SIZE
+  #define MQTT_TOPIC_CACHE_SIZE     32
+#endif
+#define MQTT_TOPIC_BASE_MAX         48      // 31-char prefix + "/sensor/255/"
+
+struct MQTTTopicBase {
+    uint8_t sensorId;
+    uint8_t len;            // 0 = unused
+    char topic[MQTT_TOPIC_BASE_MAX];
+};
+
+// Duration counters (microseconds)
+struct MQTTTiming {
+    uint32_t count;
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+};
+
+// Publish cost and heap health for /api/mqtt/stats
+struct MQTTPerfStats {
+    MQTTTiming producer;        // Formatting + queueing one packet (RX decode task)
+    uint32_t producerMessages;  // Messages queued by those packets
+    uint32_t sentLastMinute;    // Broker publishes in the last full minute
+    MQTTTiming send;            // One PubSubClient publish (MQTT task)
+    uint32_t topicCacheHits;
+    uint32_t topicCacheMisses;
+    uint32_t heapFree;
+    uint32_t heapMinFree;
+    uint32_t heapLargestBlock;
+    uint8_t heapFragmentationPct;
+};
+
+// Publish modes
+#define MQTT_PUBLISH_PER_VALUE      0       // One topic per value + battery/rssi/snr + JSON state
+#define MQTT_PUBLISH_STATE_ONLY     1       // Only the combined JSON state message
 
 // MQTT configuration structure
 struct MQTTConfig {
@@ -30,6 +88,7 @@ struct MQTTConfig {
     char topicPrefix[32];
     bool homeAssistantDiscovery;
     uint8_t qos;  // 0, 1, or 2
+    uint8_t publishMode;  // MQTT_PUBLISH_*
 };
 
 class MQTTClientManager {
@@ -68,6 +127,8 @@ public:
     uint32_t getPublishCount();
     uint32_t getFailedPublishCount();
     uint32_t getReconnectCount();
+    void getQueueStats(MQTTQueueStats& out);
+    void getPerfStats(MQTTPerfStats& out);
     
 private:
     WiFiClient wifiClient;
@@ -81,13 +142,58 @@ private:
     static const uint32_t MIN_RECONNECT_DELAY = 5000;    // 5 seconds
     static const uint32_t MAX_RECONNECT_DELAY = 300000;  // 5 minutes
     
-    // Statistics
+    // Statistics (per message, counted by the drain)
     uint32_t publishCount;
     uint32_t failedPublishCount;
     uint32_t reconnectCount;
     
+    // PubSubClient is not thread-safe: loop() runs on the main task while
+    // publishes come from the RX decode task
+    SemaphoreHandle_t mutex = nullptr;
+    inline bool lock(TickType_t ticksToWait) {
+        return (mutex == nullptr) || (xSemaphoreTake(mutex, ticksToWait) == pdTRUE);
+    }
+    inline void unlock() {
+        if (mutex != nullptr) {
+            xSemaphoreGive(mutex);
+        }
+    }
+    
+    // Outbound queue: producers push from any task, the MQTT task drains it
+    MQTTQueue outbound;
+    TaskHandle_t taskHandle = nullptr;
+    
+    char topicBuf[MQTT_TOPIC_MAX + 1];
+    
+    // Topic bases by sensor ID (slot + 1, 0 = not cached); guarded by topicMutex
+    SemaphoreHandle_t topicMutex = nullptr;
+    uint8_t topicSlot[256] = {0};
+    MQTTTopicBase topicTable[MQTT_TOPIC_CACHE_SIZE] = {};
+    uint8_t topicNextSlot = 0;
+    uint32_t topicCacheHits = 0;
+    uint32_t topicCacheMisses = 0;
+    
+    // JSON state payload is formatted here; guarded by formatMutex
+    SemaphoreHandle_t formatMutex = nullptr;
+    char stateBuf[MQTT_PAYLOAD_MAX + 1];
+    
+    MQTTTiming producerTiming = {};
+    MQTTTiming sendTiming = {};
+    uint32_t producerMessages = 0;
+    uint32_t sendMinuteStartMs = 0;
+    uint32_t sendMinuteCount = 0;
+    uint32_t sentLastMinute = 0;
+    
+    static void taskEntry(void* arg);
+    void service();
+    bool connectLocked();
+    void drainQueue();
+    void sensorTopic(uint8_t sensorId, const char* suffix, char* out, size_t outSize);
+    void invalidateTopics();
+    void recordProducerTime(uint32_t elapsedUs, uint8_t messages);
+    
     // Internal helpers
-    bool publish(const char* topic, const char* payload, bool retain = false);
+    bool publish(const char* topic, const char* payload, bool retain = false);  // Queues the message
     String buildTopic(const char* suffix);
     String buildSensorTopic(uint8_t sensorId, const char* suffix);
     void reconnect();
@@ -0,0 +1,387 @@
+/**
+ * @file mqtt_queue.cpp
+ * @brief Outbound MQTT queue: RAM ring with a LittleFS spill journal
+ */
+
+#include "mqtt_queue.h"
+#include "logger.h"
+#include <LittleFS.h>
+
+void MQTTQueue::begin() {
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    if (!journalReady) {
+        loadJournal();
+    }
+}
+
+// ============================================================================
+// RAM RING
+// ============================================================================
+
+void MQTTQueue::ringCopyOut(uint16_t offset, uint8_t* out, uint16_t len) {
+    uint16_t first = min((uint16_t)(MQTT_QUEUE_BYTES - offset), len);
+    memcpy(out, &ring[offset], first);
+    if (first < len) {
+        memcpy(out + first, &ring[0], len - first);
+    }
+}
+
+void MQTTQueue::ringCopyIn(uint16_t offset, const uint8_t* data, uint16_t len) {
+    uint16_t first = min((uint16_t)(MQTT_QUEUE_BYTES - offset), len);
+    memcpy(&ring[offset], data, first);
+    if (first < len) {
+        memcpy(&ring[0], data + first, len - first);
+    }
+}
+
+uint16_t MQTTQueue::ringRecordSize(uint16_t offset) {
+    MQTTRecordHeader header;
+    ringCopyOut(offset, (uint8_t*)&header, sizeof(header));
+    return sizeof(header) + header.topicLen + header.payloadLen;
+}
+
+/**
+ * @brief Queue a message (safe from any task)
+ *
+ * When the ring has no room (broker down and the journal full or unavailable)
+ * the oldest records are dropped: a fresh reading is worth more than a stale one.
+ */
+bool MQTTQueue::push(const char* topic, const char* payload, bool retain) {
+    size_t topicLen = strlen(topic);
+    size_t payloadLen = strlen(payload);
+    if (topicLen == 0 || topicLen > MQTT_TOPIC_MAX || payloadLen > MQTT_PAYLOAD_MAX) {
+        droppedCount++;
+        LOGW("MQTT", "Message to %s too large (%u bytes), dropped", topic, (unsigned)payloadLen);
+        return false;
+    }
+
+    MQTTRecordHeader header;
+    header.enqueuedMs = millis();
+    header.payloadLen = payloadLen;
+    header.topicLen = topicLen;
+    header.flags = retain ? MQTT_RECORD_RETAIN : 0;
+    const uint16_t size = sizeof(header) + topicLen + payloadLen;
+
+    if (mutex != nullptr && xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        droppedCount++;
+        return false;
+    }
+    while (MQTT_QUEUE_BYTES - ringUsed < size) {
+        const uint16_t oldest = ringRecordSize(ringHead);
+        ringHead = (ringHead + oldest) % MQTT_QUEUE_BYTES;
+        ringUsed -= oldest;
+        ringCount--;
+        if (ringPeeked && !ringPeekEvicted) {
+            // The MQTT task holds a copy and is sending it; counted if that fails
+            ringPeekEvicted = true;
+        } else {
+            droppedCount++;
+        }
+    }
+    uint16_t tail = (ringHead + ringUsed) % MQTT_QUEUE_BYTES;
+    ringCopyIn(tail, (const uint8_t*)&header, sizeof(header));
+    tail = (tail + sizeof(header)) % MQTT_QUEUE_BYTES;
+    ringCopyIn(tail, (const uint8_t*)topic, topicLen);
+    tail = (tail + topicLen) % MQTT_QUEUE_BYTES;
+    ringCopyIn(tail, (const uint8_t*)payload, payloadLen);
+    ringUsed += size;
+    ringCount++;
+    if (ringUsed > ringHighWater) {
+        ringHighWater = ringUsed;
+    }
+    enqueuedCount++;
+    unlock();
+    return true;
+}
+
+uint16_t MQTTQueue::peekRing() {
+    uint16_t size = 0;
+    lock();
+    if (ringCount > 0) {
+        size = ringRecordSize(ringHead);
+        ringCopyOut(ringHead, recordBuf, size);
+        ringPeeked = true;
+        ringPeekEvicted = false;
+    }
+    unlock();
+    return size;
+}
+
+void MQTTQueue::popRing() {
+    lock();
+    if (ringPeeked && !ringPeekEvicted) {
+        const uint16_t size = ringRecordSize(ringHead);
+        ringHead = (ringHead + size) % MQTT_QUEUE_BYTES;
+        ringUsed -= size;
+        ringCount--;
+    }
+    ringPeeked = false;
+    ringPeekEvicted = false;
+    unlock();
+}
+
+// ============================================================================
+// JOURNAL
+// ============================================================================
+
+/**
+ * @brief Pick up a journal left by the previous boot (validated record by record)
+ */
+void MQTTQueue::loadJournal() {
+    if (!LittleFS.begin(true)) {
+        LOGE("MQTT", "LittleFS mount failed - no store-and-forward journal");
+        return;
+    }
+    journalReady = true;
+    journalSize = 0;
+    journalReadOffset = 0;
+    journalRecords = 0;
+
+    if (!LittleFS.exists(MQTT_JOURNAL_PATH)) {
+        return;
+    }
+    File f = LittleFS.open(MQTT_JOURNAL_PATH, FILE_READ);
+    if (!f) {
+        return;
+    }
+    const uint32_t fileSize = f.size();
+    while (journalSize < fileSize) {
+        uint16_t size = readJournalRecord(f);
+        if (size == 0) {
+            break;
+        }
+        journalSize += size;
+        journalRecords++;
+    }
+    f.close();
+
+    if (journalSize == 0) {
+        LittleFS.remove(MQTT_JOURNAL_PATH);
+        return;
+    }
+    if (journalSize < fileSize) {
+        // Torn write at power loss: keep the valid prefix
+        LOGW("MQTT", "Journal truncated at %lu of %lu bytes", (unsigned long)journalSize, (unsigned long)fileSize);
+        File in = LittleFS.open(MQTT_JOURNAL_PATH, FILE_READ);
+        File out = LittleFS.open(MQTT_JOURNAL_PATH ".tmp", FILE_WRITE);
+        uint32_t copied = 0;
+        while (in && out && copied < journalSize) {
+            size_t n = in.read(recordBuf, min((uint32_t)sizeof(recordBuf), journalSize - copied));
+            if (n == 0 || out.write(recordBuf, n) != n) {
+                break;
+            }
+            copied += n;
+        }
+        in.close();
+        out.close();
+        LittleFS.remove(MQTT_JOURNAL_PATH);
+        if (copied == journalSize) {
+            LittleFS.rename(MQTT_JOURNAL_PATH ".tmp", MQTT_JOURNAL_PATH);
+        } else {
+            LittleFS.remove(MQTT_JOURNAL_PATH ".tmp");
+            journalSize = 0;
+            journalRecords = 0;
+            return;
+        }
+    }
+    journalPrevBootEnd = journalSize;
+    journalHeadMs = millis();
+    LOGI("MQTT", "Journal holds %u messages (%lu bytes) from before boot; replaying after connect",
+         journalRecords, (unsigned long)journalSize);
+}
+
+/**
+ * @brief Read the record at the file position into recordBuf
+ * @return Record size, or 0 at end of file or on a malformed record
+ */
+uint16_t MQTTQueue::readJournalRecord(File& f) {
+    MQTTRecordHeader header;
+    if (f.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+        return 0;
+    }
+    if (header.topicLen == 0 || header.topicLen > MQTT_TOPIC_MAX || header.payloadLen > MQTT_PAYLOAD_MAX) {
+        return 0;
+    }
+    const uint16_t body = header.topicLen + header.payloadLen;
+    memcpy(recordBuf, &header, sizeof(header));
+    if (f.read(recordBuf + sizeof(header), body) != body) {
+        return 0;
+    }
+    return sizeof(header) + body;
+}
+
+void MQTTQueue::resetJournal() {
+    if (journal) {
+        journal.close();
+    }
+    LittleFS.remove(MQTT_JOURNAL_PATH);
+    journalSize = 0;
+    journalReadOffset = 0;
+    journalRecords = 0;
+    journalPrevBootEnd = 0;
+}
+
+/**
+ * @brief Move the oldest RAM records to the journal once the ring passes MQTT_SPILL_PERCENT
+ *
+ * The ring always holds the newest messages, so appending its head to the
+ * journal keeps the overall order.
+ */
+void MQTTQueue::spill() {
+    const uint16_t threshold = (uint32_t)MQTT_QUEUE_BYTES * MQTT_SPILL_PERCENT / 100;
+    if (!journalReady || ringUsed <= threshold) {
+        return;
+    }
+
+    File f = LittleFS.open(MQTT_JOURNAL_PATH, FILE_APPEND);
+    if (!f) {
+        return;
+    }
+    // Spill down to half the threshold so writes happen in batches
+    bool torn = false;
+    while (ringUsed > threshold / 2) {
+        uint16_t size = peekRing();
+        if (size == 0 || journalSize + size > MQTT_JOURNAL_MAX_BYTES) {
+            break;
+        }
+        if (f.write(recordBuf, size) != size) {
+            LOGW("MQTT", "Journal write failed");
+            torn = true;
+            break;
+        }
+        if (journalReadOffset == journalSize) {
+            journalHeadMs = ((MQTTRecordHeader*)recordBuf)->enqueuedMs;
+        }
+        popRing();
+        journalSize += size;
+        journalRecords++;
+        spilledCount++;
+    }
+    f.close();
+    endBatch();
+
+    // Whatever part of the record reached the file would misalign every later
+    // append; start a fresh journal once the valid records have been replayed
+    if (torn) {
+        if (journalRecords == 0) {
+            resetJournal();
+        } else {
+            journalReady = false;
+        }
+    }
+}
+
+// ============================================================================
+// CONSUMER
+// ============================================================================
+
+/**
+ * @brief Next record to publish, journal first (it is older)
+ * @return recordBuf, or nullptr when nothing is queued or the journal cannot be read
+ */
+const uint8_t* MQTTQueue::peek(uint16_t& size) {
+    size = 0;
+    if (journalReadOffset < journalSize) {
+        if (!journal) {
+            journal = LittleFS.open(MQTT_JOURNAL_PATH, FILE_READ);
+        }
+        if (!journal || !journal.seek(journalReadOffset)) {
+            return nullptr;
+        }
+        size = readJournalRecord(journal);
+        if (size > 0) {
+            peekFromJournal = true;
+            return recordBuf;
+        }
+        // Unreadable tail; drop the rest of the journal
+        LOGW("MQTT", "Journal unreadable at %lu, discarding %u messages",
+             (unsigned long)journalReadOffset, journalRecords);
+        droppedCount += journalRecords;
+        resetJournal();
+    }
+
+    peekFromJournal = false;
+    size = peekRing();
+    return (size > 0) ? recordBuf : nullptr;
+}
+
+/**
+ * @brief Remove the record returned by the last peek()
+ * @param published  False when the broker refused it; it is removed either way
+ */
+void MQTTQueue::pop(bool published) {
+    if (!peekFromJournal) {
+        popRing();
+        return;
+    }
+
+    const MQTTRecordHeader* header = (const MQTTRecordHeader*)recordBuf;
+    journalReadOffset += sizeof(MQTTRecordHeader) + header->topicLen + header->payloadLen;
+    journalRecords--;
+    peekFromJournal = false;
+    if (published) {
+        replayedCount++;
+    }
+
+    if (journalReadOffset >= journalSize) {
+        resetJournal();
+        if (!journalReady) {
+            journalReady = LittleFS.begin(true);
+        }
+    } else if (journalReadOffset >= journalPrevBootEnd) {
+        MQTTRecordHeader next;
+        if (journal.read((uint8_t*)&next, sizeof(next)) == sizeof(next)) {
+            journalHeadMs = next.enqueuedMs;
+        }
+    }
+}
+
+/**
+ * @brief Close the journal and settle a peeked record that was never popped
+ */
+void MQTTQueue::endBatch() {
+    if (journal) {
+        journal.close();
+    }
+    peekFromJournal = false;
+
+    lock();
+    if (ringPeekEvicted) {
+        droppedCount++;     // Evicted while held, and never sent
+    }
+    ringPeeked = false;
+    ringPeekEvicted = false;
+    unlock();
+}
+
+void MQTTQueue::getStats(MQTTQueueStats& out) {
+    out.enqueued = enqueuedCount;
+    out.dropped = droppedCount;
+    out.spilled = spilledCount;
+    out.replayed = replayedCount;
+
+    uint32_t now = millis();
+    uint32_t oldestMs = now;
+    if (mutex != nullptr && xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return;
+    }
+    out.ramMessages = ringCount;
+    out.ramBytes = ringUsed;
+    out.ramHighWater = ringHighWater;
+    if (ringCount > 0) {
+        MQTTRecordHeader header;
+        ringCopyOut(ringHead, (uint8_t*)&header, sizeof(header));
+        oldestMs = header.enqueuedMs;
+    }
+    unlock();
+
+    out.spillMessages = journalRecords;
+    out.spillBytes = journalSize - journalReadOffset;
+    if (journalRecords > 0) {
+        oldestMs = journalHeadMs;
+    }
+    out.depth = out.ramMessages + out.spillMessages;
+    out.oldestAgeMs = (out.depth > 0) ? now - oldestMs : 0;
+}
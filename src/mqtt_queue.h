@@ -0,0 +1,142 @@
+/**
+ * @file mqtt_queue.h
+ * @brief Outbound MQTT queue: RAM ring with a LittleFS spill journal
+ *
+ * Producers push() from any task. A single consumer (the MQTT task) spills,
+ * peeks and pops, so it can publish a peeked record without holding the lock.
+ * The journal always holds messages older than everything in the ring; the
+ * consumer reads it first, so messages go out in the order they were queued.
+ */
+
+#ifndef MQTT_QUEUE_H
+#define MQTT_QUEUE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// ============================================================================
+// OUTBOUND QUEUE CONFIGURATION
+// ============================================================================
+
+// RAM ring for queued messages (variable-length records)
+#ifndef MQTT_QUEUE_BYTES
+  #define MQTT_QUEUE_BYTES          8192
+#endif
+
+// The task moves the oldest RAM records to the journal above this fill level
+#ifndef MQTT_SPILL_PERCENT
+  #define MQTT_SPILL_PERCENT        50
+#endif
+
+#ifndef MQTT_JOURNAL_PATH
+  #define MQTT_JOURNAL_PATH         "/mqtt_journal.bin"
+#endif
+
+// Journal cap; once reached the RAM ring fills and its oldest messages are dropped
+#ifndef MQTT_JOURNAL_MAX_BYTES
+  #define MQTT_JOURNAL_MAX_BYTES    (64UL * 1024UL)
+#endif
+
+#define MQTT_TOPIC_MAX              128
+#define MQTT_PAYLOAD_MAX            512     // Matches the PubSubClient buffer size
+
+#define MQTT_RECORD_RETAIN          0x01
+
+// Queue record header; topic and payload bytes follow (no terminators)
+struct __attribute__((packed)) MQTTRecordHeader {
+    uint32_t enqueuedMs;
+    uint16_t payloadLen;
+    uint8_t topicLen;
+    uint8_t flags;          // MQTT_RECORD_*
+};
+
+#define MQTT_RECORD_MAX (sizeof(MQTTRecordHeader) + MQTT_TOPIC_MAX + MQTT_PAYLOAD_MAX)
+
+// Outbound queue snapshot for /api/mqtt/stats
+struct MQTTQueueStats {
+    bool taskRunning;
+    uint16_t depth;             // Messages waiting (RAM + journal)
+    uint16_t ramMessages;
+    uint16_t ramBytes;
+    uint16_t ramHighWater;
+    uint32_t spillBytes;        // Journal bytes not yet replayed
+    uint16_t spillMessages;
+    uint32_t oldestAgeMs;       // Age of the next message to publish (0 when empty)
+    uint32_t enqueued;
+    uint32_t dropped;           // Evicted from a full queue, too large, or not queued in time
+    uint32_t spilled;           // Messages written to the journal
+    uint32_t replayed;          // Journal messages published
+};
+
+class MQTTQueue {
+public:
+    // Creates the lock and picks up a journal left by the previous boot
+    void begin();
+
+    // Any task. A full ring drops its oldest record to make room.
+    bool push(const char* topic, const char* payload, bool retain);
+    void countDropped(uint32_t messages = 1) { droppedCount += messages; }
+
+    // MQTT task only
+    void spill();                                 // Ring past MQTT_SPILL_PERCENT -> journal
+    const uint8_t* peek(uint16_t& size);          // Next record (journal first), nullptr when empty
+    void pop(bool published);                     // Removes the peeked record
+    void endBatch();                              // After the last peek/pop of a pass
+
+    bool empty() const { return ringCount == 0 && journalRecords == 0; }
+    void getStats(MQTTQueueStats& out);
+
+private:
+    SemaphoreHandle_t mutex = nullptr;
+    inline void lock() {
+        if (mutex != nullptr) {
+            xSemaphoreTake(mutex, portMAX_DELAY);
+        }
+    }
+    inline void unlock() {
+        if (mutex != nullptr) {
+            xSemaphoreGive(mutex);
+        }
+    }
+
+    uint8_t ring[MQTT_QUEUE_BYTES];
+    uint16_t ringHead = 0;
+    uint16_t ringUsed = 0;
+    uint16_t ringCount = 0;
+    uint16_t ringHighWater = 0;
+
+    // The record handed out by peek(); a producer may evict it from the ring
+    // while it is being published, in which case pop() has nothing to remove
+    bool peekFromJournal = false;
+    bool ringPeeked = false;
+    bool ringPeekEvicted = false;
+
+    bool journalReady = false;
+    uint32_t journalSize = 0;
+    uint32_t journalReadOffset = 0;
+    uint16_t journalRecords = 0;
+    uint32_t journalPrevBootEnd = 0;    // Records before this offset were queued before boot
+    uint32_t journalHeadMs = 0;
+    File journal;                       // Open for reading during a drain pass
+
+    uint32_t enqueuedCount = 0;                 // Under the lock
+    std::atomic<uint32_t> droppedCount{0};      // From any task, sometimes without the lock
+    uint32_t spilledCount = 0;                  // MQTT task only
+    uint32_t replayedCount = 0;                 // MQTT task only
+
+    uint8_t recordBuf[MQTT_RECORD_MAX];         // MQTT task only
+
+    void ringCopyOut(uint16_t offset, uint8_t* out, uint16_t len);
+    void ringCopyIn(uint16_t offset, const uint8_t* data, uint16_t len);
+    uint16_t ringRecordSize(uint16_t offset);
+    uint16_t peekRing();        // Copies the head record to recordBuf; returns its size
+    void popRing();
+    void loadJournal();
+    uint16_t readJournalRecord(File& f);
+    void resetJournal();
+};
+
+#endif // MQTT_QUEUE_H
@@ -1,9 +1,14 @@
 #include "remote_config.h"
+#include "data_types.h"
+#include "crc16.h"
 #include "logger.h"
 #include <cstring>
 
 static RemoteConfigManager* instance = nullptr;
 
+static_assert(COMMAND_POOL_SIZE < COMMAND_NONE && COMMAND_CHUNK_COUNT < COMMAND_NONE &&
+              COMMAND_SENSOR_SLOTS < COMMAND_NONE, "command pool indices are 8-bit");
+
 void RemoteConfigManager::init() {
     if (mutex == nullptr) {
         mutex = xSemaphoreCreateMutex();
@@ -14,30 +19,237 @@ void RemoteConfigManager::init() {
 
     nextSequenceNumber = 1;
     instance = this;
-    
-    // Clear failed command tracking
-    memset(lastFailedCommand, 0, sizeof(lastFailedCommand));
 
-    // Clear last command event tracking
-    memset(lastSentCommand, 0, sizeof(lastSentCommand));
-    memset(lastAckedCommand, 0, sizeof(lastAckedCommand));
+    // Thread every command and payload chunk onto its free list
+    for (uint8_t i = 0; i < COMMAND_POOL_SIZE; i++) {
+        commands[i].next = (i + 1 < COMMAND_POOL_SIZE) ? i + 1 : COMMAND_NONE;
+    }
+    for (uint8_t i = 0; i < COMMAND_CHUNK_COUNT; i++) {
+        chunkNext[i] = (i + 1 < COMMAND_CHUNK_COUNT) ? i + 1 : COMMAND_NONE;
+    }
+    freeCommand = 0;
+    freeChunk = 0;
+    commandsUsed = 0;
+    chunksUsed = 0;
+    rejectedCount = 0;
+
+    // No sensor holds a slot until a command is queued for it
+    for (uint8_t i = 0; i < COMMAND_SENSOR_SLOTS; i++) {
+        timerWheel.cancel(&slots[i].ackTimer);
+        slots[i] = SensorSlot();
+    }
+    memset(slotOf, 0, sizeof(slotOf));
+    slotsUsed = 0;
+    activeHead = COMMAND_NONE;
 }
 
 uint16_t RemoteConfigManager::calculateChecksum(const uint8_t* data, size_t length) {
-    uint16_t crc = 0xFFFF;
-    
-    for (size_t i = 0; i < length; i++) {
-        crc ^= data[i];
-        for (uint8_t j = 0; j < 8; j++) {
-            if (crc & 0x0001) {
-                crc = (crc >> 1) ^ 0xA001;
-            } else {
-                crc >>= 1;
+    // Command and ACK frames start with their sync word; its version bit selects the CRC
+    uint16_t syncWord = 0;
+    if (length >= sizeof(syncWord)) {
+        memcpy(&syncWord, data, sizeof(syncWord));
+    }
+    if (isCrc16SyncWord(syncWord, COMMAND_SYNC_WORD)) {
+        return crc16CcittSlice4(data, length);
+    }
+    return crc16Modbus(data, length);
+}
+
+size_t RemoteConfigManager::encodeCommandFrame(CommandPacket& cmd, uint8_t* out, size_t outSize) {
+    if (cmd.dataLength > sizeof(cmd.data)) {
+        return 0;
+    }
+
+    const bool shortForm = isCrc16SyncWord(cmd.syncWord, COMMAND_SYNC_WORD);
+    const size_t frameSize = shortForm ? COMMAND_FRAME_SIZE(cmd.dataLength) : sizeof(CommandPacket);
+    if (outSize < frameSize) {
+        return 0;
+    }
+
+    const size_t bodySize = frameSize - sizeof(uint16_t);
+    memcpy(out, &cmd, bodySize);
+    cmd.checksum = calculateChecksum(out, bodySize);
+    memcpy(out + bodySize, &cmd.checksum, sizeof(uint16_t));
+    return frameSize;
+}
+
+bool RemoteConfigManager::parseCommandFrame(const uint8_t* frame, size_t size, CommandPacket& cmd) {
+    if (size < COMMAND_FRAME_SIZE(0)) {
+        return false;
+    }
+
+    memset(&cmd, 0, sizeof(cmd));
+    memcpy(&cmd, frame, COMMAND_HEADER_SIZE);
+    if (!isSyncWord(cmd.syncWord, COMMAND_SYNC_WORD) || cmd.dataLength > sizeof(cmd.data)) {
+        return false;
+    }
+
+    // Legacy senders always transmit the whole struct; everyone else sends the short form
+    if (size != sizeof(CommandPacket) && size != COMMAND_FRAME_SIZE(cmd.dataLength)) {
+        return false;
+    }
+
+    memcpy(cmd.data, frame + COMMAND_HEADER_SIZE, cmd.dataLength);
+    memcpy(&cmd.checksum, frame + size - sizeof(uint16_t), sizeof(uint16_t));
+    return true;
+}
+
+RemoteConfigManager::SensorSlot* RemoteConfigManager::findSlot(uint8_t sensorId) {
+    return slotOf[sensorId] != 0 ? &slots[slotOf[sensorId] - 1] : nullptr;
+}
+
+// Slot for a sensor that is about to get a command. Once every slot is taken,
+// the idle sensor (nothing queued) with the oldest command activity gives up
+// its slot and its last sent/ACKed/failed history.
+RemoteConfigManager::SensorSlot* RemoteConfigManager::claimSlot(uint8_t sensorId) {
+    SensorSlot* existing = findSlot(sensorId);
+    if (existing != nullptr) {
+        return existing;
+    }
+
+    uint8_t index = COMMAND_NONE;
+    if (slotsUsed < COMMAND_SENSOR_SLOTS) {
+        index = slotsUsed++;
+    } else {
+        const uint32_t now = millis();
+        uint32_t oldestIdleMs = 0;
+        for (uint8_t i = 0; i < COMMAND_SENSOR_SLOTS; i++) {
+            const SensorSlot& candidate = slots[i];
+            if (candidate.count > 0) {
+                continue;
+            }
+            const uint32_t events[3] = {candidate.lastSent.atMs, candidate.lastAcked.atMs,
+                                        candidate.lastFailed.failedAtMs};
+            uint32_t idleMs = UINT32_MAX;
+            for (uint32_t atMs : events) {
+                if (atMs != 0 && now - atMs < idleMs) {
+                    idleMs = now - atMs;
+                }
+            }
+            if (index == COMMAND_NONE || idleMs > oldestIdleMs) {
+                index = i;
+                oldestIdleMs = idleMs;
             }
         }
+        if (index == COMMAND_NONE) {
+            return nullptr;  // Every tracked sensor has commands queued
+        }
+        slotOf[slots[index].sensorId] = 0;
+        timerWheel.cancel(&slots[index].ackTimer);
+    }
+
+    slots[index] = SensorSlot();
+    slots[index].sensorId = sensorId;
+    slotOf[sensorId] = index + 1;
+    return &slots[index];
+}
+
+// Take a command and enough chunks for its payload off the free lists
+uint8_t RemoteConfigManager::allocCommand(const uint8_t* data, uint8_t dataLen) {
+    const uint8_t chunkCount = (dataLen + COMMAND_CHUNK_SIZE - 1) / COMMAND_CHUNK_SIZE;
+    if (freeCommand == COMMAND_NONE || chunksUsed + chunkCount > COMMAND_CHUNK_COUNT) {
+        return COMMAND_NONE;
+    }
+
+    const uint8_t index = freeCommand;
+    QueuedCommand& cmd = commands[index];
+    freeCommand = cmd.next;
+    commandsUsed++;
+
+    uint8_t* link = &cmd.firstChunk;
+    for (size_t offset = 0; offset < dataLen; offset += COMMAND_CHUNK_SIZE) {
+        const uint8_t chunk = freeChunk;
+        freeChunk = chunkNext[chunk];
+        chunksUsed++;
+
+        const size_t length = (dataLen - offset < COMMAND_CHUNK_SIZE) ? dataLen - offset : COMMAND_CHUNK_SIZE;
+        if (data != nullptr) {
+            memcpy(chunks[chunk], data + offset, length);
+        } else {
+            memset(chunks[chunk], 0, length);
+        }
+        *link = chunk;
+        link = &chunkNext[chunk];
+    }
+    *link = COMMAND_NONE;
+
+    cmd.dataLength = dataLen;
+    cmd.next = COMMAND_NONE;
+    return index;
+}
+
+void RemoteConfigManager::releaseCommand(uint8_t index) {
+    QueuedCommand& cmd = commands[index];
+    uint8_t chunk = cmd.firstChunk;
+    while (chunk != COMMAND_NONE) {
+        const uint8_t next = chunkNext[chunk];
+        chunkNext[chunk] = freeChunk;
+        freeChunk = chunk;
+        chunksUsed--;
+        chunk = next;
+    }
+    cmd.firstChunk = COMMAND_NONE;
+    cmd.next = freeCommand;
+    freeCommand = index;
+    commandsUsed--;
+}
+
+// Append to the sensor's queue; its first command puts it on the active list
+void RemoteConfigManager::pushCommand(SensorSlot& slot, uint8_t index) {
+    if (slot.count == 0) {
+        const uint8_t slotIndex = (uint8_t)(&slot - slots);
+        slot.head = index;
+        slot.activePrev = COMMAND_NONE;
+        slot.activeNext = activeHead;
+        if (activeHead != COMMAND_NONE) {
+            slots[activeHead].activePrev = slotIndex;
+        }
+        activeHead = slotIndex;
+    } else {
+        commands[slot.tail].next = index;
+    }
+    slot.tail = index;
+    slot.count++;
+}
+
+// Drop the sensor's oldest command; an emptied queue leaves the active list
+void RemoteConfigManager::popCommand(SensorSlot& slot) {
+    const uint8_t index = slot.head;
+    slot.head = commands[index].next;
+    slot.count--;
+    releaseCommand(index);
+
+    if (slot.count == 0) {
+        slot.head = COMMAND_NONE;
+        slot.tail = COMMAND_NONE;
+        if (slot.activePrev != COMMAND_NONE) {
+            slots[slot.activePrev].activeNext = slot.activeNext;
+        } else {
+            activeHead = slot.activeNext;
+        }
+        if (slot.activeNext != COMMAND_NONE) {
+            slots[slot.activeNext].activePrev = slot.activePrev;
+        }
+        slot.activeNext = COMMAND_NONE;
+        slot.activePrev = COMMAND_NONE;
+    }
+}
+
+// Rebuild the full packet; the checksum is filled in by encodeCommandFrame()
+void RemoteConfigManager::copyPacket(const SensorSlot& slot, const QueuedCommand& cmd, CommandPacket& out) {
+    memset(&out, 0, sizeof(out));
+    out.syncWord = txSyncWord(COMMAND_SYNC_WORD);
+    out.commandType = cmd.commandType;
+    out.targetSensorId = slot.sensorId;
+    out.sequenceNumber = cmd.sequenceNumber;
+    out.dataLength = cmd.dataLength;
+
+    size_t offset = 0;
+    for (uint8_t chunk = cmd.firstChunk; chunk != COMMAND_NONE; chunk = chunkNext[chunk]) {
+        const size_t length = (cmd.dataLength - offset < COMMAND_CHUNK_SIZE) ? cmd.dataLength - offset : COMMAND_CHUNK_SIZE;
+        memcpy(out.data + offset, chunks[chunk], length);
+        offset += length;
     }
-    
-    return crc;
 }
 
 bool RemoteConfigManager::queueCommand(uint8_t sensorId, CommandType cmdType, const uint8_t* data, uint8_t dataLen) {
@@ -46,37 +258,35 @@ bool RemoteConfigManager::queueCommand(uint8_t sensorId, CommandType cmdType, co
         return false;
     }
 
-    if (dataLen > 248) {
+    if (dataLen > sizeof(CommandPacket::data)) {
         LOGE("CMD", "Command data too large: %d bytes", dataLen);
         if (mutex != nullptr) unlock();
         return false;
     }
-    
-    QueuedCommand cmd;
-    cmd.packet.syncWord = COMMAND_SYNC_WORD;
-    cmd.packet.commandType = cmdType;
-    cmd.packet.targetSensorId = sensorId;
-    cmd.packet.sequenceNumber = nextSequenceNumber++;
-    cmd.packet.dataLength = dataLen;
-    
-    if (data != nullptr && dataLen > 0) {
-        memcpy(cmd.packet.data, data, dataLen);
+
+    SensorSlot* slot = claimSlot(sensorId);
+    const uint8_t index = (slot != nullptr) ? allocCommand(data, dataLen) : COMMAND_NONE;
+    if (index == COMMAND_NONE) {
+        rejectedCount++;
+        LOGW("CMD", "Command store full (%d/%d commands, %d/%d chunks), dropping type %d for sensor %d",
+             commandsUsed, COMMAND_POOL_SIZE, chunksUsed, COMMAND_CHUNK_COUNT, cmdType, sensorId);
+        if (mutex != nullptr) unlock();
+        return false;
     }
-    
-    // Calculate checksum over header + data (excluding checksum field itself)
-    size_t checksumLength = sizeof(CommandPacket) - sizeof(uint16_t);
-    cmd.packet.checksum = calculateChecksum((const uint8_t*)&cmd.packet, checksumLength);
-    
+
+    QueuedCommand& cmd = commands[index];
+    cmd.commandType = cmdType;
+    cmd.sequenceNumber = nextSequenceNumber++;
     cmd.retryCount = 0;
     cmd.queuedAt = millis();
     cmd.lastAttempt = 0;
     cmd.timeout = COMMAND_TIMEOUT_MS;
     cmd.waitingForAck = false;
-    
-    commandQueues[sensorId].push(cmd);
+
+    pushCommand(*slot, index);
     
     LOGI("CMD", "Queued command type %d for sensor %d (seq %d)", 
-                  cmdType, sensorId, cmd.packet.sequenceNumber);
+                  cmdType, sensorId, cmd.sequenceNumber);
     
     // Don't send immediately - wait for next telemetry from sensor
     // Commands will be sent when sensor is in RX window (after telemetry)
@@ -90,44 +300,27 @@ bool RemoteConfigManager::getPendingCommand(uint8_t sensorId, CommandPacket& out
         return false;
     }
 
-    if (commandQueues[sensorId].empty()) {
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot == nullptr || slot->count == 0) {
         if (mutex != nullptr) unlock();
         return false;
     }
     
-    QueuedCommand& cmd = commandQueues[sensorId].front();
+    QueuedCommand& cmd = commands[slot->head];
     
-    // Check if we're already waiting for ACK
+    // Check if we're already waiting for ACK (the timer normally expires the wait first)
     if (cmd.waitingForAck) {
-        // Check timeout
-        if (millis() - cmd.lastAttempt > cmd.timeout) {
-            LOGW("CMD", "Command timeout for sensor %d (seq %d), retry %d/%d", 
-                         sensorId, cmd.packet.sequenceNumber, cmd.retryCount + 1, MAX_RETRY_COUNT);
-            cmd.waitingForAck = false;
-            cmd.retryCount++;
-            
-            if (cmd.retryCount >= MAX_RETRY_COUNT) {
-                LOGE("CMD", "COMMAND FAILED: Max retries (%d) reached for sensor %d (seq %d)", 
-                             MAX_RETRY_COUNT, sensorId, cmd.packet.sequenceNumber);
-                LOGW("CMD", "Command dropped - sensor may be out of range or offline");
-                
-                // Track this failure
-                lastFailedCommand[sensorId].commandType = cmd.packet.commandType;
-                lastFailedCommand[sensorId].sequenceNumber = cmd.packet.sequenceNumber;
-                lastFailedCommand[sensorId].failedAtMs = millis();
-                lastFailedCommand[sensorId].reason = 0;  // timeout
-                
-                commandQueues[sensorId].pop();
-                if (mutex != nullptr) unlock();
-                return false;
-            }
-            
-            LOGI("CMD", "Retrying command to sensor %d...", sensorId);
-        } else {
+        if (millis() - cmd.lastAttempt <= cmd.timeout) {
             // Still waiting, don't send yet
             if (mutex != nullptr) unlock();
             return false;
         }
+        timerWheel.cancel(&slot->ackTimer);
+        if (expireAckWait(*slot)) {
+            if (mutex != nullptr) unlock();
+            return false;
+        }
+        LOGI("CMD", "Retrying command to sensor %d...", sensorId);
     }
     
     // Mark as sent and waiting for ACK
@@ -135,70 +328,94 @@ bool RemoteConfigManager::getPendingCommand(uint8_t sensorId, CommandPacket& out
     cmd.waitingForAck = true;
 
     // Record last send attempt (includes retries)
-    lastSentCommand[sensorId].commandType = cmd.packet.commandType;
-    lastSentCommand[sensorId].sequenceNumber = cmd.packet.sequenceNumber;
-    lastSentCommand[sensorId].statusCode = 0;
-    lastSentCommand[sensorId].atMs = cmd.lastAttempt;
-
-    // Copy packet out so callers don't hold a pointer into the queue.
-    outPacket = cmd.packet;
+    slot->lastSent.commandType = cmd.commandType;
+    slot->lastSent.sequenceNumber = cmd.sequenceNumber;
+    slot->lastSent.statusCode = 0;
+    slot->lastSent.atMs = cmd.lastAttempt;
+    timerWheel.schedule(&slot->ackTimer, cmd.timeout, onAckTimeout, this);
+
+    // Copy packet out so callers don't hold a pointer into the pool.
+    copyPacket(*slot, cmd, outPacket);
     if (mutex != nullptr) unlock();
     return true;
 }
 
+bool RemoteConfigManager::peekPendingCommand(uint8_t sensorId, CommandPacket& outPacket) {
+    if (mutex != nullptr && !lock(portMAX_DELAY)) {
+        return false;
+    }
+
+    // Timeouts are advanced by the ACK timer; a command still awaiting its ACK is not sendable
+    SensorSlot* slot = findSlot(sensorId);
+    bool available = slot != nullptr && slot->count > 0 && !commands[slot->head].waitingForAck;
+    if (available) {
+        copyPacket(*slot, commands[slot->head], outPacket);
+    }
+    if (mutex != nullptr) unlock();
+    return available;
+}
+
 void RemoteConfigManager::markCommandAcked(uint8_t sensorId, uint8_t sequenceNumber) {
     if (mutex != nullptr && !lock(portMAX_DELAY)) {
         return;
     }
-    if (commandQueues[sensorId].empty()) {
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot == nullptr || slot->count == 0) {
         if (mutex != nullptr) unlock();
         return;
     }
     
-    QueuedCommand& cmd = commandQueues[sensorId].front();
-    if (cmd.packet.sequenceNumber == sequenceNumber) {
+    bool timeSyncAcked = false;
+    QueuedCommand& cmd = commands[slot->head];
+    if (cmd.sequenceNumber == sequenceNumber) {
         LOGI("CMD", "Command ACKed for sensor %d (seq %d)", sensorId, sequenceNumber);
 
         // Record last ACK observed
-        lastAckedCommand[sensorId].commandType = cmd.packet.commandType;
-        lastAckedCommand[sensorId].sequenceNumber = sequenceNumber;
-        lastAckedCommand[sensorId].statusCode = 0;
-        lastAckedCommand[sensorId].atMs = millis();
+        slot->lastAcked.commandType = cmd.commandType;
+        slot->lastAcked.sequenceNumber = sequenceNumber;
+        slot->lastAcked.statusCode = 0;
+        slot->lastAcked.atMs = millis();
         
         // Clear any failed command state on success
-        lastFailedCommand[sensorId].failedAtMs = 0;
+        slot->lastFailed.failedAtMs = 0;
         
-        // Record time-sync ACKs for display if applicable
-        if (cmd.packet.commandType == CMD_TIME_SYNC) {
-            extern void recordClientTimeSync(uint8_t clientId);
-            recordClientTimeSync(sensorId);
-            LOGD("CMD", "Recorded client %d time sync", sensorId);
-        }
-        commandQueues[sensorId].pop();
+        timeSyncAcked = (cmd.commandType == CMD_TIME_SYNC);
+        timerWheel.cancel(&slot->ackTimer);
+        popCommand(*slot);
     }
 
     if (mutex != nullptr) unlock();
+    
+    // Record time-sync ACKs for display; outside our lock since callers may hold
+    // the stats lock while querying the queue
+    if (timeSyncAcked) {
+        extern void recordClientTimeSync(uint8_t clientId);
+        recordClientTimeSync(sensorId);
+        LOGD("CMD", "Recorded client %d time sync", sensorId);
+    }
 }
 
 void RemoteConfigManager::markCommandFailed(uint8_t sensorId, uint8_t sequenceNumber, uint8_t statusCode) {
     if (mutex != nullptr && !lock(portMAX_DELAY)) {
         return;
     }
-    if (commandQueues[sensorId].empty()) {
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot == nullptr || slot->count == 0) {
         if (mutex != nullptr) unlock();
         return;
     }
     
-    QueuedCommand& cmd = commandQueues[sensorId].front();
-    if (cmd.packet.sequenceNumber == sequenceNumber) {
+    QueuedCommand& cmd = commands[slot->head];
+    if (cmd.sequenceNumber == sequenceNumber) {
         LOGW("CMD", "Command NACK/failure for sensor %d (seq %d, status=%d)", sensorId, sequenceNumber, statusCode);
 
         // Record last NACK/failure observed (only when we actually got a response)
-        lastAckedCommand[sensorId].commandType = cmd.packet.commandType;
-        lastAckedCommand[sensorId].sequenceNumber = sequenceNumber;
-        lastAckedCommand[sensorId].statusCode = statusCode;
-        lastAckedCommand[sensorId].atMs = millis();
+        slot->lastAcked.commandType = cmd.commandType;
+        slot->lastAcked.sequenceNumber = sequenceNumber;
+        slot->lastAcked.statusCode = statusCode;
+        slot->lastAcked.atMs = millis();
 
+        timerWheel.cancel(&slot->ackTimer);
         cmd.waitingForAck = false;
         cmd.retryCount++;
         
@@ -206,12 +423,12 @@ void RemoteConfigManager::markCommandFailed(uint8_t sensorId, uint8_t sequenceNu
             LOGW("CMD", "Max retries after NACK, dropping command");
             
             // Track this failure
-            lastFailedCommand[sensorId].commandType = cmd.packet.commandType;
-            lastFailedCommand[sensorId].sequenceNumber = cmd.packet.sequenceNumber;
-            lastFailedCommand[sensorId].failedAtMs = millis();
-            lastFailedCommand[sensorId].reason = 1;  // NACK
+            slot->lastFailed.commandType = cmd.commandType;
+            slot->lastFailed.sequenceNumber = cmd.sequenceNumber;
+            slot->lastFailed.failedAtMs = millis();
+            slot->lastFailed.reason = 1;  // NACK
             
-            commandQueues[sensorId].pop();
+            popCommand(*slot);
         }
     }
 
@@ -262,58 +479,59 @@ void RemoteConfigManager::handleAck(uint8_t sensorId, uint8_t sequenceNumber, ui
     }
 }
 
-void RemoteConfigManager::processRetries() {
-    if (mutex != nullptr && !lock(portMAX_DELAY)) {
-        return;
-    }
-    // Check all queues for commands that need retry due to timeout.
-    // NOTE: This is critical because getPendingCommand() is not called while we're waiting for ACK,
-    // so timeouts must be advanced here.
-    const uint32_t now = millis();
-    for (int sensorId = 0; sensorId < 256; sensorId++) {
-        if (commandQueues[sensorId].empty()) {
-            continue;
-        }
-
-        QueuedCommand& cmd = commandQueues[sensorId].front();
-        if (!cmd.waitingForAck) {
-            continue;
-        }
+bool RemoteConfigManager::expireAckWait(SensorSlot& slot) {
+    QueuedCommand& cmd = commands[slot.head];
+    LOGW("CMD", "Command timeout for sensor %d (seq %d), retry %d/%d",
+         slot.sensorId, cmd.sequenceNumber, cmd.retryCount + 1, MAX_RETRY_COUNT);
 
-        if ((uint32_t)(now - cmd.lastAttempt) <= cmd.timeout) {
-            continue;
-        }
+    cmd.waitingForAck = false;
+    cmd.retryCount++;
 
-        LOGW("CMD", "Command timeout for sensor %d (seq %d), retry %d/%d",
-             sensorId, cmd.packet.sequenceNumber, cmd.retryCount + 1, MAX_RETRY_COUNT);
+    if (cmd.retryCount >= MAX_RETRY_COUNT) {
+        LOGE("CMD", "COMMAND FAILED: Max retries (%d) reached for sensor %d (seq %d)",
+             MAX_RETRY_COUNT, slot.sensorId, cmd.sequenceNumber);
+        LOGW("CMD", "Command dropped - sensor may be out of range or offline");
 
-        cmd.waitingForAck = false;
-        cmd.retryCount++;
+        // Track this failure
+        slot.lastFailed.commandType = cmd.commandType;
+        slot.lastFailed.sequenceNumber = cmd.sequenceNumber;
+        slot.lastFailed.failedAtMs = millis();
+        slot.lastFailed.reason = 0;  // timeout
 
-        if (cmd.retryCount >= MAX_RETRY_COUNT) {
-            LOGE("CMD", "COMMAND FAILED: Max retries (%d) reached for sensor %d (seq %d)",
-                 MAX_RETRY_COUNT, sensorId, cmd.packet.sequenceNumber);
-            LOGW("CMD", "Command dropped - sensor may be out of range or offline");
+        popCommand(slot);
+        return true;
+    }
+    return false;
+}
 
-            // Track this failure
-            lastFailedCommand[sensorId].commandType = cmd.packet.commandType;
-            lastFailedCommand[sensorId].sequenceNumber = cmd.packet.sequenceNumber;
-            lastFailedCommand[sensorId].failedAtMs = now;
-            lastFailedCommand[sensorId].reason = 0;  // timeout
+// Timer callback: the in-flight command of one sensor went unanswered.
+// getPendingCommand() is not called while waiting for an ACK, so this is
+// what makes the command sendable again.
+void RemoteConfigManager::onAckTimeout(TimerNode* node, void* context) {
+    RemoteConfigManager* self = static_cast<RemoteConfigManager*>(context);
+    SensorSlot* slot = reinterpret_cast<SensorSlot*>(
+        reinterpret_cast<uint8_t*>(node) - offsetof(SensorSlot, ackTimer));
 
-            commandQueues[sensorId].pop();
-        }
+    if (self->mutex != nullptr && !self->lock(portMAX_DELAY)) {
+        return;
     }
-
-    if (mutex != nullptr) unlock();
+    // Skip if the ACK won the race or a resend re-armed the timer
+    if (!timerWheel.isArmed(node) && slot->count > 0 && self->commands[slot->head].waitingForAck) {
+        self->expireAckWait(*slot);
+    }
+    if (self->mutex != nullptr) self->unlock();
 }
 
 void RemoteConfigManager::clearCommands(uint8_t sensorId) {
     if (mutex != nullptr && !lock(portMAX_DELAY)) {
         return;
     }
-    while (!commandQueues[sensorId].empty()) {
-        commandQueues[sensorId].pop();
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot != nullptr) {
+        timerWheel.cancel(&slot->ackTimer);
+        while (slot->count > 0) {
+            popCommand(*slot);
+        }
     }
     LOGI("CMD", "Cleared command queue for sensor %d", sensorId);
 
@@ -325,7 +543,8 @@ uint8_t RemoteConfigManager::getQueuedCount(uint8_t sensorId) {
     if (mutex != nullptr && !lock(pdMS_TO_TICKS(5))) {
         return 0;
     }
-    uint8_t count = commandQueues[sensorId].size();
+    SensorSlot* slot = findSlot(sensorId);
+    uint8_t count = (slot != nullptr) ? slot->count : 0;
     if (mutex != nullptr) unlock();
     return count;
 }
@@ -334,11 +553,12 @@ uint8_t RemoteConfigManager::getRetryCount(uint8_t sensorId) {
     if (mutex != nullptr && !lock(pdMS_TO_TICKS(5))) {
         return 0;
     }
-    if (commandQueues[sensorId].empty()) {
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot == nullptr || slot->count == 0) {
         if (mutex != nullptr) unlock();
         return 0;
     }
-    uint8_t retries = commandQueues[sensorId].front().retryCount;
+    uint8_t retries = commands[slot->head].retryCount;
     if (mutex != nullptr) unlock();
     return retries;
 }
@@ -348,14 +568,15 @@ bool RemoteConfigManager::getCommandInfo(uint8_t sensorId, uint8_t& commandType,
     if (mutex != nullptr && !lock(pdMS_TO_TICKS(5))) {
         return false;
     }
-    if (commandQueues[sensorId].empty()) {
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot == nullptr || slot->count == 0) {
         if (mutex != nullptr) unlock();
         return false;
     }
     
-    const QueuedCommand& cmd = commandQueues[sensorId].front();
-    commandType = cmd.packet.commandType;
-    seqNum = cmd.packet.sequenceNumber;
+    const QueuedCommand& cmd = commands[slot->head];
+    commandType = cmd.commandType;
+    seqNum = cmd.sequenceNumber;
     retries = cmd.retryCount;
     waitingAck = cmd.waitingForAck;
     // If the command has never been sent, report how long it's been queued.
@@ -374,15 +595,16 @@ bool RemoteConfigManager::getLastFailedCommand(uint8_t sensorId, uint8_t& comman
         return false;
     }
     // Check if there's a recorded failure (failedAtMs > 0 means it's valid)
-    if (lastFailedCommand[sensorId].failedAtMs == 0) {
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot == nullptr || slot->lastFailed.failedAtMs == 0) {
         if (mutex != nullptr) unlock();
         return false;
     }
     
-    commandType = lastFailedCommand[sensorId].commandType;
-    seqNum = lastFailedCommand[sensorId].sequenceNumber;
-    ageMs = millis() - lastFailedCommand[sensorId].failedAtMs;
-    reason = lastFailedCommand[sensorId].reason;
+    commandType = slot->lastFailed.commandType;
+    seqNum = slot->lastFailed.sequenceNumber;
+    ageMs = millis() - slot->lastFailed.failedAtMs;
+    reason = slot->lastFailed.reason;
 
     if (mutex != nullptr) unlock();
     return true;
@@ -392,13 +614,14 @@ bool RemoteConfigManager::getLastSentCommand(uint8_t sensorId, uint8_t& commandT
     if (mutex != nullptr && !lock(pdMS_TO_TICKS(5))) {
         return false;
     }
-    if (lastSentCommand[sensorId].atMs == 0) {
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot == nullptr || slot->lastSent.atMs == 0) {
         if (mutex != nullptr) unlock();
         return false;
     }
-    commandType = lastSentCommand[sensorId].commandType;
-    seqNum = lastSentCommand[sensorId].sequenceNumber;
-    ageMs = millis() - lastSentCommand[sensorId].atMs;
+    commandType = slot->lastSent.commandType;
+    seqNum = slot->lastSent.sequenceNumber;
+    ageMs = millis() - slot->lastSent.atMs;
 
     if (mutex != nullptr) unlock();
     return true;
@@ -408,19 +631,53 @@ bool RemoteConfigManager::getLastAckedCommand(uint8_t sensorId, uint8_t& command
     if (mutex != nullptr && !lock(pdMS_TO_TICKS(5))) {
         return false;
     }
-    if (lastAckedCommand[sensorId].atMs == 0) {
+    SensorSlot* slot = findSlot(sensorId);
+    if (slot == nullptr || slot->lastAcked.atMs == 0) {
         if (mutex != nullptr) unlock();
         return false;
     }
-    commandType = lastAckedCommand[sensorId].commandType;
-    seqNum = lastAckedCommand[sensorId].sequenceNumber;
-    statusCode = lastAckedCommand[sensorId].statusCode;
-    ageMs = millis() - lastAckedCommand[sensorId].atMs;
+    commandType = slot->lastAcked.commandType;
+    seqNum = slot->lastAcked.sequenceNumber;
+    statusCode = slot->lastAcked.statusCode;
+    ageMs = millis() - slot->lastAcked.atMs;
 
     if (mutex != nullptr) unlock();
     return true;
 }
 
+bool RemoteConfigManager::findUnsentCommand(uint8_t& sensorId) {
+    if (mutex != nullptr && !lock(pdMS_TO_TICKS(5))) {
+        return false;
+    }
+    bool found = false;
+    for (uint8_t i = activeHead; i != COMMAND_NONE; i = slots[i].activeNext) {
+        if (!commands[slots[i].head].waitingForAck) {
+            sensorId = slots[i].sensorId;
+            found = true;
+            break;
+        }
+    }
+    if (mutex != nullptr) unlock();
+    return found;
+}
+
+void RemoteConfigManager::getPoolStats(CommandPoolStats& out) {
+    memset(&out, 0, sizeof(out));
+    if (mutex != nullptr && !lock(pdMS_TO_TICKS(5))) {
+        return;
+    }
+    out.queued = commandsUsed;
+    out.capacity = COMMAND_POOL_SIZE;
+    out.payloadBytes = chunksUsed * COMMAND_CHUNK_SIZE;
+    out.payloadCapacity = COMMAND_CHUNK_COUNT * COMMAND_CHUNK_SIZE;
+    for (uint8_t i = activeHead; i != COMMAND_NONE; i = slots[i].activeNext) {
+        out.activeSensors++;
+    }
+    out.trackedSensors = slotsUsed;
+    out.rejected = rejectedCount;
+    if (mutex != nullptr) unlock();
+}
+
 // Command builder implementations
 namespace CommandBuilder {
     CommandPacket createSetInterval(uint8_t sensorId, uint16_t intervalSeconds) {
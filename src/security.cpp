@@ -5,8 +5,7 @@
 
 #include "security.h"
 #include "config_storage.h"
-#include "mbedtls/aes.h"
-#include "mbedtls/md.h"
+#include "mbedtls/ccm.h"
 #include <Preferences.h>
 #include <esp_random.h>
 
@@ -19,6 +18,15 @@ SecurityManager::SecurityManager() {
     config.whitelistEnabled = false;
     config.whitelistCount = 0;
     config.sequenceNumber = 0;
+    sequenceReserved = 0;
+    
+    memset(replayWindows, 0, sizeof(replayWindows));
+    replayDirty = false;
+    
+    mbedtls_ccm_init(&ccm);
+    ccmReady = false;
+    keyChanged = true;
+    mutex = nullptr;
     
     // Generate random default key
     generateKey();
@@ -27,12 +35,22 @@ SecurityManager::SecurityManager() {
 bool SecurityManager::begin() {
     Serial.println("🔒 Initializing security manager...");
     
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    
     if (!loadConfig()) {
         Serial.println("⚠️ No security config found, using defaults");
         generateKey();
         saveConfig();
     }
     
+    loadReplayWindows();
+    if (REPLAY_CHECKPOINT_INTERVAL_SEC > 0) {
+        const uint32_t intervalMs = REPLAY_CHECKPOINT_INTERVAL_SEC * 1000UL;
+        timerWheel.schedule(&replayCheckpointTimer, intervalMs, onReplayCheckpointDue, this, intervalMs);
+    }
+    
     Serial.printf("🔒 Encryption: %s\n", config.encryptionEnabled ? "ENABLED" : "DISABLED");
     Serial.printf("🔒 Whitelist: %s (%d devices)\n", 
                   config.whitelistEnabled ? "ENABLED" : "DISABLED",
@@ -48,6 +66,8 @@ void SecurityManager::generateKey() {
     for (int i = 0; i < LORA_AES_KEY_SIZE; i++) {
         config.encryptionKey[i] = (uint8_t)esp_random();
     }
+    keyChanged = true;
+    resetReplayWindows();
     
     Serial.print("🔑 Key: ");
     for (int i = 0; i < LORA_AES_KEY_SIZE; i++) {
@@ -57,7 +77,12 @@ void SecurityManager::generateKey() {
 }
 
 void SecurityManager::setKey(const uint8_t* key) {
+    if (memcmp(config.encryptionKey, key, LORA_AES_KEY_SIZE) == 0) {
+        return;  // Same key: keep the replay windows
+    }
     memcpy(config.encryptionKey, key, LORA_AES_KEY_SIZE);
+    keyChanged = true;
+    resetReplayWindows();
     Serial.println("🔑 Encryption key updated");
 }
 
@@ -65,69 +90,158 @@ void SecurityManager::getKey(uint8_t* key) {
     memcpy(key, config.encryptionKey, LORA_AES_KEY_SIZE);
 }
 
-void SecurityManager::generateIV(uint8_t* iv) {
-    // Generate random IV using hardware RNG
-    for (int i = 0; i < LORA_AES_BLOCK_SIZE; i++) {
-        iv[i] = (uint8_t)esp_random();
+void SecurityManager::buildNonce(const EncryptedPacket* packet, uint8_t* nonce) {
+    // Sender, network and sequence as sent; the remaining bytes stay zero.
+    // Unique as long as no sender reuses a sequence number under one key.
+    memset(nonce, 0, SECURE_NONCE_SIZE);
+    memcpy(nonce, (const uint8_t*)packet + 1, 7);
+}
+
+bool SecurityManager::prepareKey() {
+    if (ccmReady && !keyChanged) {
+        return true;
+    }
+    
+    // Expanding the key costs more than a whole short packet, so it is
+    // done once per key instead of once per frame
+    int ret = mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, config.encryptionKey, LORA_AES_KEY_SIZE * 8);
+    if (ret != 0) {
+        Serial.printf("❌ CCM key setup failed: %d\n", ret);
+        ccmReady = false;
+        return false;
     }
+    
+    ccmReady = true;
+    keyChanged = false;
+    return true;
 }
 
-void SecurityManager::calculateHMAC(const uint8_t* data, uint16_t length, uint8_t* hmac) {
-    // Simple HMAC using key XOR with data
-    // For production, use proper HMAC-SHA256 (truncated)
-    uint8_t hash[LORA_AES_BLOCK_SIZE] = {0};
-    
-    // Defensive check (should never happen with compile-time constants)
-    if (LORA_AES_BLOCK_SIZE == 0 || LORA_AES_KEY_SIZE == 0) {
-        Serial.println("❌ CRITICAL: AES constants are zero!");
-        memset(hmac, 0, HMAC_SIZE);
-        return;
+bool SecurityManager::validateSequence(uint8_t senderId, uint32_t sequence) {
+    // Sliding window as in IPsec/DTLS anti-replay: anything newer than the
+    // highest accepted number slides the window, anything inside it is
+    // accepted once, anything older than the window is rejected
+    ReplayWindow& window = replayWindows[senderId];
+    
+    if (sequence == 0) {
+        return false;  // Never sent; the first frame of a sender is 1
+    }
+    
+    if (sequence > window.highest) {
+        uint32_t shift = sequence - window.highest;
+        window.seen = (shift < REPLAY_WINDOW_SIZE) ? (window.seen << shift) : 0;
+        window.seen |= 1;
+        window.highest = sequence;
+        replayDirty = true;
+        return true;
     }
     
-    // XOR data with key repeatedly
-    for (uint16_t i = 0; i < length; i++) {
-        hash[i % LORA_AES_BLOCK_SIZE] ^= data[i];
+    uint32_t offset = window.highest - sequence;
+    if (offset >= REPLAY_WINDOW_SIZE) {
+        Serial.printf("⚠️ Stale frame from %d: seq=%u, window starts at %u\n",
+                      senderId, sequence, window.highest - REPLAY_WINDOW_SIZE + 1);
+        return false;
     }
     
-    // XOR with key again
-    for (int i = 0; i < LORA_AES_BLOCK_SIZE; i++) {
-        hash[i] ^= config.encryptionKey[i % LORA_AES_KEY_SIZE];
+    uint64_t bit = 1ULL << offset;
+    if (window.seen & bit) {
+        Serial.printf("⚠️ Replay detected from %d: seq=%u\n", senderId, sequence);
+        return false;
     }
     
-    // Copy first HMAC_SIZE bytes
-    memcpy(hmac, hash, HMAC_SIZE);
+    window.seen |= bit;
+    return true;
+}
+
+void SecurityManager::resetReplayWindows() {
+    // Frames under the old key no longer authenticate, so their history can go
+    if (!lock(portMAX_DELAY)) {
+        return;
+    }
+    memset(replayWindows, 0, sizeof(replayWindows));
+    replayDirty = true;
+    unlock();
 }
 
-bool SecurityManager::verifyHMAC(const uint8_t* data, uint16_t length, const uint8_t* hmac) {
-    uint8_t calculated[HMAC_SIZE];
-    calculateHMAC(data, length, calculated);
+void SecurityManager::loadReplayWindows() {
+    Preferences prefs;
+    if (!prefs.begin("security", true)) {
+        return;
+    }
     
-    // Constant-time comparison
-    uint8_t diff = 0;
-    for (int i = 0; i < HMAC_SIZE; i++) {
-        diff |= (calculated[i] ^ hmac[i]);
+    uint32_t highest[REPLAY_SENDER_COUNT];
+    size_t len = prefs.getBytesLength("replay");
+    if (len == sizeof(highest) && prefs.getBytes("replay", highest, sizeof(highest)) == sizeof(highest)) {
+        uint16_t senders = 0;
+        for (int id = 0; id < REPLAY_SENDER_COUNT; id++) {
+            // Anything at or below the checkpoint counts as already seen
+            replayWindows[id].highest = highest[id];
+            replayWindows[id].seen = highest[id] ? ~0ULL : 0;
+            if (highest[id]) {
+                senders++;
+            }
+        }
+        Serial.printf("✓ Replay windows restored for %d senders\n", senders);
     }
+    replayDirty = false;
     
-    return (diff == 0);
+    prefs.end();
 }
 
-bool SecurityManager::validateSequence(uint32_t sequence) {
-    // Accept sequence if it's greater than last seen
-    // Allow some window for out-of-order packets
-    const uint32_t SEQUENCE_WINDOW = 100;
-    
-    if (sequence > config.sequenceNumber) {
-        config.sequenceNumber = sequence;
+bool SecurityManager::checkpointReplayWindows() {
+    if (!replayDirty) {
         return true;
     }
     
-    // Allow recent packets within window
-    if (config.sequenceNumber - sequence < SEQUENCE_WINDOW) {
-        return true;
+    // Copy out under the lock; the flash write happens without holding it
+    uint32_t highest[REPLAY_SENDER_COUNT];
+    if (!lock(pdMS_TO_TICKS(100))) {
+        return false;
+    }
+    for (int id = 0; id < REPLAY_SENDER_COUNT; id++) {
+        highest[id] = replayWindows[id].highest;
     }
+    replayDirty = false;
+    unlock();
     
-    Serial.printf("⚠️ Replay detected: seq=%u, expected>%u\n", sequence, config.sequenceNumber);
-    return false;
+    Preferences prefs;
+    if (!prefs.begin("security", false)) {
+        replayDirty = true;
+        return false;
+    }
+    bool ok = (prefs.putBytes("replay", highest, sizeof(highest)) == sizeof(highest));
+    prefs.end();
+    
+    if (!ok) {
+        replayDirty = true;  // Retry next checkpoint
+    }
+    return ok;
+}
+
+bool SecurityManager::resetReplayWindow(uint8_t senderId) {
+    if (!lock(portMAX_DELAY)) {
+        return false;
+    }
+    replayWindows[senderId].highest = 0;
+    replayWindows[senderId].seen = 0;
+    replayDirty = true;
+    unlock();
+    
+    Serial.printf("🔒 Replay window cleared for sender %d\n", senderId);
+    return checkpointReplayWindows();
+}
+
+void SecurityManager::onReplayCheckpointDue(TimerNode* /*node*/, void* context) {
+    static_cast<SecurityManager*>(context)->checkpointReplayWindows();
+}
+
+void SecurityManager::reserveSequenceBlock(uint32_t reserveUntil) {
+    Preferences prefs;
+    if (!prefs.begin("security", false)) {
+        Serial.println("⚠️ Failed to reserve sequence numbers");
+        return;
+    }
+    prefs.putUInt("seqNum", reserveUntil);
+    prefs.end();
 }
 
 uint16_t SecurityManager::encryptPacket(const uint8_t* plaintext, uint16_t length,
@@ -136,157 +250,118 @@ uint16_t SecurityManager::encryptPacket(const uint8_t* plaintext, uint16_t lengt
         return 0;
     }
     
-    // Set header fields
-    encrypted->packetType = 0xE0;  // Encrypted packet marker
-    encrypted->sensorId = sensorId;
-    encrypted->networkId = networkId;
-    encrypted->sequenceNumber = ++config.sequenceNumber;
+    if (length > SECURE_MAX_PAYLOAD) {
+        Serial.printf("⚠️ Packet too large to encrypt: %d > %d bytes\n", length, SECURE_MAX_PAYLOAD);
+        return 0;
+    }
     
-    // Generate random IV
-    generateIV(encrypted->iv);
+    if (!lock(pdMS_TO_TICKS(100))) {
+        return 0;
+    }
     
-    // Defensive check
-    if (LORA_AES_BLOCK_SIZE == 0) {
-        Serial.println("❌ CRITICAL: AES_BLOCK_SIZE is zero!");
+    if (!prepareKey()) {
+        unlock();
         return 0;
     }
     
-    // Pad plaintext to AES block size
-    uint16_t paddedLength = ((length + LORA_AES_BLOCK_SIZE - 1) / LORA_AES_BLOCK_SIZE) * LORA_AES_BLOCK_SIZE;
-    uint8_t paddedData[256];
-    memcpy(paddedData, plaintext, length);
+    // Set header fields
+    encrypted->packetType = ENCRYPTED_PACKET_TYPE;
+    encrypted->sensorId = sensorId;
+    encrypted->networkId = networkId;
+    encrypted->sequenceNumber = ++config.sequenceNumber;
     
-    // PKCS7 padding
-    uint8_t padValue = paddedLength - length;
-    for (uint16_t i = length; i < paddedLength; i++) {
-        paddedData[i] = padValue;
+    // Receivers reject anything at or below what they have seen from us, so
+    // the counter must never restart lower after a reboot
+    uint32_t reserveUntil = 0;
+    if (config.sequenceNumber > sequenceReserved) {
+        sequenceReserved = config.sequenceNumber + SEQUENCE_RESERVE_BLOCK - 1;
+        reserveUntil = sequenceReserved;
     }
     
-    // Initialize mbedTLS AES context
-    mbedtls_aes_context aes_ctx;
-    mbedtls_aes_init(&aes_ctx);
-    mbedtls_aes_setkey_enc(&aes_ctx, config.encryptionKey, LORA_AES_KEY_SIZE * 8);
+    encrypted->length = (uint8_t)length;
     
-    // Encrypt data using AES-128-CBC
-    uint8_t iv_copy[LORA_AES_BLOCK_SIZE];
-    memcpy(iv_copy, encrypted->iv, LORA_AES_BLOCK_SIZE);
+    uint8_t nonce[SECURE_NONCE_SIZE];
+    buildNonce(encrypted, nonce);
     
-    int ret = mbedtls_aes_crypt_cbc(&aes_ctx, MBEDTLS_AES_ENCRYPT, paddedLength,
-                                     iv_copy, paddedData, encrypted->payload);
+    // CCM is a stream mode: ciphertext is as long as the plaintext, and
+    // plaintext may already sit in encrypted->payload (encrypted in place).
+    // The tag covers the header up to the length byte as associated data.
+    int ret = mbedtls_ccm_encrypt_and_tag(&ccm, length, nonce, SECURE_NONCE_SIZE,
+                                          (const uint8_t*)encrypted, SECURE_AAD_SIZE,
+                                          plaintext, encrypted->payload,
+                                          encrypted->tag, HMAC_SIZE);
+    unlock();
     
-    mbedtls_aes_free(&aes_ctx);
+    if (reserveUntil != 0) {
+        reserveSequenceBlock(reserveUntil);
+    }
     
     if (ret != 0) {
-        Serial.printf("❌ AES encryption failed: %d\n", ret);
+        Serial.printf("❌ AES-CCM encryption failed: %d\n", ret);
         return 0;
     }
     
-    encrypted->payloadSize = paddedLength;
-    
-    // Calculate HMAC over header + encrypted payload
-    uint8_t hmacData[256];
-    uint16_t hmacLen = 0;
-    hmacData[hmacLen++] = encrypted->packetType;
-    hmacData[hmacLen++] = encrypted->sensorId;
-    hmacData[hmacLen++] = (encrypted->networkId >> 8) & 0xFF;
-    hmacData[hmacLen++] = encrypted->networkId & 0xFF;
-    hmacData[hmacLen++] = (encrypted->sequenceNumber >> 24) & 0xFF;
-    hmacData[hmacLen++] = (encrypted->sequenceNumber >> 16) & 0xFF;
-    hmacData[hmacLen++] = (encrypted->sequenceNumber >> 8) & 0xFF;
-    hmacData[hmacLen++] = encrypted->sequenceNumber & 0xFF;
-    memcpy(&hmacData[hmacLen], encrypted->payload, paddedLength);
-    hmacLen += paddedLength;
-    
-    calculateHMAC(hmacData, hmacLen, encrypted->hmac);
-    
-    Serial.printf("🔒 Encrypted packet: seq=%u, len=%d->%d bytes\n", 
-                  encrypted->sequenceNumber, length, paddedLength);
-    
-    // Total size = header(16) + payload + IV(16)
-    return 16 + paddedLength + LORA_AES_BLOCK_SIZE;
+    return length + SECURE_FRAME_OVERHEAD;
 }
 
-uint16_t SecurityManager::decryptPacket(const EncryptedPacket* encrypted, uint8_t* plaintext, uint16_t maxLength) {
+uint16_t SecurityManager::decryptPacket(const EncryptedPacket* encrypted, uint16_t frameSize,
+                                        uint8_t* plaintext, uint16_t maxLength) {
     if (!config.encryptionEnabled || encrypted == nullptr) {
         return 0;
     }
     
     // Verify packet type
-    if (encrypted->packetType != 0xE0) {
+    if (encrypted->packetType != ENCRYPTED_PACKET_TYPE) {
         Serial.println("⚠️ Invalid encrypted packet type");
         return 0;
     }
     
-    // Check whitelist if enabled
-    if (config.whitelistEnabled && !isWhitelisted(encrypted->sensorId)) {
-        Serial.printf("⚠️ Sensor %d not in whitelist\n", encrypted->sensorId);
+    // The length prefix must fit the frame; trailing bytes are ignored
+    if (frameSize < SECURE_FRAME_OVERHEAD || encrypted->length > frameSize - SECURE_FRAME_OVERHEAD) {
+        Serial.printf("⚠️ Invalid encrypted frame size: %d bytes\n", frameSize);
         return 0;
     }
     
-    // Verify sequence number (replay prevention)
-    if (!validateSequence(encrypted->sequenceNumber)) {
+    uint16_t plaintextLen = encrypted->length;
+    if (plaintextLen > maxLength) {
+        Serial.println("⚠️ Decrypted data too large for buffer");
         return 0;
     }
     
-    // Verify HMAC
-    uint8_t hmacData[256];
-    uint16_t hmacLen = 0;
-    hmacData[hmacLen++] = encrypted->packetType;
-    hmacData[hmacLen++] = encrypted->sensorId;
-    hmacData[hmacLen++] = (encrypted->networkId >> 8) & 0xFF;
-    hmacData[hmacLen++] = encrypted->networkId & 0xFF;
-    hmacData[hmacLen++] = (encrypted->sequenceNumber >> 24) & 0xFF;
-    hmacData[hmacLen++] = (encrypted->sequenceNumber >> 16) & 0xFF;
-    hmacData[hmacLen++] = (encrypted->sequenceNumber >> 8) & 0xFF;
-    hmacData[hmacLen++] = encrypted->sequenceNumber & 0xFF;
-    memcpy(&hmacData[hmacLen], encrypted->payload, encrypted->payloadSize);
-    hmacLen += encrypted->payloadSize;
-    
-    if (!verifyHMAC(hmacData, hmacLen, encrypted->hmac)) {
-        Serial.println("⚠️ HMAC verification failed - packet tampered or wrong key");
+    // Check whitelist if enabled
+    if (config.whitelistEnabled && !isWhitelisted(encrypted->sensorId)) {
+        Serial.printf("⚠️ Sensor %d not in whitelist\n", encrypted->sensorId);
         return 0;
     }
     
-    // Initialize mbedTLS AES context
-    mbedtls_aes_context aes_ctx;
-    mbedtls_aes_init(&aes_ctx);
-    mbedtls_aes_setkey_dec(&aes_ctx, config.encryptionKey, LORA_AES_KEY_SIZE * 8);
-    
-    // Decrypt data using AES-128-CBC
-    uint8_t iv_copy[LORA_AES_BLOCK_SIZE];
-    memcpy(iv_copy, encrypted->iv, LORA_AES_BLOCK_SIZE);
-    
-    uint8_t decrypted[256];
-    int ret = mbedtls_aes_crypt_cbc(&aes_ctx, MBEDTLS_AES_DECRYPT, encrypted->payloadSize,
-                                     iv_copy, encrypted->payload, decrypted);
-    
-    mbedtls_aes_free(&aes_ctx);
-    
-    if (ret != 0) {
-        Serial.printf("❌ AES decryption failed: %d\n", ret);
+    if (!lock(pdMS_TO_TICKS(100))) {
         return 0;
     }
     
-    // Remove PKCS7 padding
-    uint8_t padValue = decrypted[encrypted->payloadSize - 1];
-    if (padValue > LORA_AES_BLOCK_SIZE || padValue == 0) {
-        Serial.println("⚠️ Invalid padding");
+    if (!prepareKey()) {
+        unlock();
         return 0;
     }
     
-    uint16_t plaintextLen = encrypted->payloadSize - padValue;
-    
-    if (plaintextLen > maxLength) {
-        Serial.println("⚠️ Decrypted data too large for buffer");
+    // Authenticate before trusting any header field; a forged frame must
+    // not be able to move the replay window
+    uint8_t nonce[SECURE_NONCE_SIZE];
+    buildNonce(encrypted, nonce);
+    int ret = mbedtls_ccm_auth_decrypt(&ccm, plaintextLen, nonce, SECURE_NONCE_SIZE,
+                                       (const uint8_t*)encrypted, SECURE_AAD_SIZE,
+                                       encrypted->payload, plaintext,
+                                       encrypted->tag, HMAC_SIZE);
+    if (ret != 0) {
+        unlock();
+        Serial.println("⚠️ Authentication failed - packet tampered or wrong key");
         return 0;
     }
     
-    memcpy(plaintext, decrypted, plaintextLen);
-    
-    Serial.printf("🔓 Decrypted packet: seq=%u, len=%d bytes\n", 
-                  encrypted->sequenceNumber, plaintextLen);
+    // Verify sequence number (replay prevention)
+    bool fresh = validateSequence(encrypted->sensorId, encrypted->sequenceNumber);
+    unlock();
     
-    return plaintextLen;
+    return fresh ? plaintextLen : 0;
 }
 
 bool SecurityManager::addToWhitelist(uint8_t sensorId) {
@@ -309,6 +384,8 @@ bool SecurityManager::addToWhitelist(uint8_t sensorId) {
     Serial.printf("✓ Added sensor %d to whitelist (%d/%d)\n", 
                   sensorId, config.whitelistCount, MAX_WHITELIST_SIZE);
     
+    // A (re)paired sensor starts counting from 1
+    resetReplayWindow(sensorId);
     return saveConfig();
 }
 
@@ -323,6 +400,7 @@ bool SecurityManager::removeFromWhitelist(uint8_t sensorId) {
             config.whitelistCount--;
             
             Serial.printf("✓ Removed sensor %d from whitelist\n", sensorId);
+            resetReplayWindow(sensorId);
             return saveConfig();
         }
     }
@@ -381,7 +459,7 @@ bool SecurityManager::saveConfig() {
     prefs.putBytes("key", config.encryptionKey, LORA_AES_KEY_SIZE);
     prefs.putUChar("wlCount", config.whitelistCount);
     prefs.putBytes("wlList", config.whitelist, config.whitelistCount);
-    prefs.putUInt("seqNum", config.sequenceNumber);
+    prefs.putUInt("seqNum", sequenceReserved);
     
     prefs.end();
     
@@ -434,7 +512,10 @@ bool SecurityManager::loadConfig() {
         prefs.getBytes("wlList", config.whitelist, config.whitelistCount);
     }
     
+    // Resume past the last reservation; numbers up to it may already be on air
     config.sequenceNumber = prefs.getUInt("seqNum", 0);
+    sequenceReserved = config.sequenceNumber;
+    keyChanged = true;
     
     prefs.end();
     
@@ -6,11 +6,13 @@
  * Part of Network Pairing Phase 2.
  * 
  * Features:
- * - AES-128-CBC encryption for packet payloads
+ * - AES-128-CCM authenticated encryption of every radio frame (no padding,
+ *   no IV on air: the nonce is derived from sender and sequence number,
+ *   8-byte tag over header and payload, key schedule cached between frames)
  * - Device whitelist with NVS persistence
  * - 128-bit encryption key management
- * - HMAC-based message authentication
- * - Replay attack prevention with sequence numbers
+ * - Replay attack prevention: 64-frame sliding window per sender ID,
+ *   checkpointed to NVS
  * 
  * @version 2.13.0
  * @date December 14, 2025
@@ -20,14 +22,46 @@
 #define SECURITY_H
 
 #include <Arduino.h>
-#include "mbedtls/aes.h"
-#include "mbedtls/md.h"
+#include "mbedtls/ccm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "timer_wheel.h"
 
 // Security configuration
 #define LORA_AES_KEY_SIZE 16     // 128-bit key
 #define LORA_AES_BLOCK_SIZE 16   // 128-bit blocks
 #define MAX_WHITELIST_SIZE 32    // Maximum whitelisted devices
-#define HMAC_SIZE 8              // Truncated HMAC for space efficiency
+#define HMAC_SIZE 8              // CCM tag length (truncated for space efficiency)
+#define SECURE_NONCE_SIZE 13     // CCM nonce (sender, network, sequence, zero fill)
+
+#define ENCRYPTED_PACKET_TYPE 0xE0
+
+// Sender ID the base station puts in its envelopes (sensor IDs start at 1)
+#define SECURE_BASE_SENDER_ID 0
+
+// Header bytes covered by the tag as associated data (type .. length)
+#define SECURE_AAD_SIZE 9
+
+// Fixed envelope bytes: header + tag; the ciphertext is as long as the frame
+#define SECURE_FRAME_OVERHEAD (SECURE_AAD_SIZE + HMAC_SIZE)
+
+// Largest frame that still fits a 255-byte LoRa payload once wrapped
+#define SECURE_MAX_PAYLOAD (255 - SECURE_FRAME_OVERHEAD)
+
+// Anti-replay: each sender ID gets a window of the last 64 sequence numbers
+#define REPLAY_WINDOW_SIZE 64
+#define REPLAY_SENDER_COUNT 256
+
+// How often the replay windows are written to NVS (0 = only on reboot)
+#ifndef REPLAY_CHECKPOINT_INTERVAL_SEC
+#define REPLAY_CHECKPOINT_INTERVAL_SEC 300
+#endif
+
+// Transmit sequence numbers are reserved in NVS this many at a time, so a
+// reboot resumes above anything already sent without a flash write per frame
+#ifndef SEQUENCE_RESERVE_BLOCK
+#define SEQUENCE_RESERVE_BLOCK 256
+#endif
 
 /**
  * @brief Security configuration stored in NVS
@@ -38,24 +72,37 @@ struct SecurityConfig {
     uint8_t encryptionKey[LORA_AES_KEY_SIZE];   // 128-bit AES key
     uint8_t whitelistCount;                      // Number of whitelisted devices
     uint8_t whitelist[MAX_WHITELIST_SIZE];       // Whitelisted sensor IDs
-    uint32_t sequenceNumber;                     // Replay prevention counter
+    uint32_t sequenceNumber;                     // Transmit sequence counter
 };
 
 /**
- * @brief Encrypted packet structure
+ * @brief Encrypted packet structure (on-air layout)
  * 
  * Format:
- * [1B packetType][1B sensorId][2B networkId][4B sequence][8B HMAC][NB encrypted payload][16B IV]
+ * [1B packetType][1B sensorId][2B networkId][4B sequence][1B length][8B CCM tag][length B ciphertext]
+ *
+ * The on-air size is SECURE_FRAME_OVERHEAD + length. The nonce is built from
+ * sensorId, networkId and sequence, so (key, sender, sequence) must never
+ * repeat; the NVS sequence reservation guarantees that across reboots.
  */
-struct EncryptedPacket {
-    uint8_t packetType;
-    uint8_t sensorId;
+struct __attribute__((packed)) EncryptedPacket {
+    uint8_t packetType;         // ENCRYPTED_PACKET_TYPE
+    uint8_t sensorId;           // Sender (SECURE_BASE_SENDER_ID for the base)
     uint16_t networkId;
     uint32_t sequenceNumber;
-    uint8_t hmac[HMAC_SIZE];
-    uint8_t payload[200];  // Maximum encrypted payload
-    uint16_t payloadSize;
-    uint8_t iv[LORA_AES_BLOCK_SIZE];  // Initialization vector
+    uint8_t length;             // Ciphertext bytes
+    uint8_t tag[HMAC_SIZE];     // CCM authentication tag
+    uint8_t payload[SECURE_MAX_PAYLOAD];
+};
+
+/**
+ * @brief Anti-replay state for one sender
+ *
+ * Bit i of seen is set once sequence (highest - i) has been accepted.
+ */
+struct ReplayWindow {
+    uint32_t highest;       // Highest sequence accepted (0 = nothing yet)
+    uint64_t seen;
 };
 
 /**
@@ -89,24 +136,31 @@ public:
     
     /**
      * @brief Encrypt packet payload
-     * @param plaintext Raw packet data
-     * @param length Plaintext length
+     * @param plaintext Raw packet data (may be encrypted->payload to encrypt in place)
+     * @param length Plaintext length (at most SECURE_MAX_PAYLOAD)
      * @param encrypted Output buffer for encrypted packet
      * @param sensorId Sender ID
      * @param networkId Network ID
-     * @return Encrypted packet size, or 0 on failure
+     * @return On-air size (length + SECURE_FRAME_OVERHEAD), or 0 on failure
      */
     uint16_t encryptPacket(const uint8_t* plaintext, uint16_t length, 
                            EncryptedPacket* encrypted, uint8_t sensorId, uint16_t networkId);
     
     /**
      * @brief Decrypt packet payload
-     * @param encrypted Encrypted packet
-     * @param plaintext Output buffer for decrypted data
+     * @param encrypted Encrypted packet as received
+     * @param frameSize Received frame size
+     * @param plaintext Output buffer for decrypted data (may be encrypted->payload)
      * @param maxLength Maximum plaintext buffer size
      * @return Decrypted length, or 0 on failure/authentication error
      */
-    uint16_t decryptPacket(const EncryptedPacket* encrypted, uint8_t* plaintext, uint16_t maxLength);
+    uint16_t decryptPacket(const EncryptedPacket* encrypted, uint16_t frameSize,
+                           uint8_t* plaintext, uint16_t maxLength);
+    
+    /**
+     * @brief Bytes encryption adds to every frame (0 when disabled)
+     */
+    uint16_t getFrameOverhead() const { return config.encryptionEnabled ? SECURE_FRAME_OVERHEAD : 0; }
     
     /**
      * @brief Add device to whitelist
@@ -176,29 +230,76 @@ public:
      * @brief Get current configuration
      */
     SecurityConfig getConfig() const { return config; }
+    
+    // Replay windows are checkpointed on a timer every REPLAY_CHECKPOINT_INTERVAL_SEC;
+    // call checkpointReplayWindows() before an orderly restart
+    bool checkpointReplayWindows();
+    
+    // A replaced or re-flashed sensor that reuses an ID starts its counter at 1
+    // again and would be rejected until it passed the restored checkpoint. Clears
+    // that sender's window and checkpoints at once so the reset survives a reboot.
+    // Called when a sensor is forgotten or (re)added to / removed from the whitelist,
+    // and from DELETE /api/security/replay/<id>.
+    bool resetReplayWindow(uint8_t senderId);
 
 private:
     SecurityConfig config;
     
+    // Highest transmit sequence number covered by the NVS reservation
+    uint32_t sequenceReserved;
+    
+    // Per-sender anti-replay windows (RAM; checkpointed to NVS)
+    ReplayWindow replayWindows[REPLAY_SENDER_COUNT];
+    bool replayDirty;
+    TimerNode replayCheckpointTimer;
+    static void onReplayCheckpointDue(TimerNode* node, void* context);
+    
+    // Expanded key, rebuilt only when the key changes
+    mbedtls_ccm_context ccm;
+    bool ccmReady;
+    bool keyChanged;
+    
+    // Guards the CCM context (RX decode task and main loop on the base)
+    SemaphoreHandle_t mutex;
+    inline bool lock(TickType_t ticksToWait) {
+        return (mutex == nullptr) || (xSemaphoreTake(mutex, ticksToWait) == pdTRUE);
+    }
+    inline void unlock() {
+        if (mutex != nullptr) {
+            xSemaphoreGive(mutex);
+        }
+    }
+    
+    /**
+     * @brief Expand the key into the CCM context if it changed (call locked)
+     */
+    bool prepareKey();
+    
+    /**
+     * @brief Build the CCM nonce for a packet from its header
+     */
+    static void buildNonce(const EncryptedPacket* packet, uint8_t* nonce);
+    
     /**
-     * @brief Generate random IV for encryption
+     * @brief Check and record a sender's sequence number (call locked)
+     * @return false if the frame is a replay or too old for the window
      */
-    void generateIV(uint8_t* iv);
+    bool validateSequence(uint8_t senderId, uint32_t sequence);
     
     /**
-     * @brief Calculate HMAC for authentication
+     * @brief Forget all replay state (after a key change)
      */
-    void calculateHMAC(const uint8_t* data, uint16_t length, uint8_t* hmac);
+    void resetReplayWindows();
     
     /**
-     * @brief Verify HMAC
+     * @brief Restore replay windows from the last checkpoint
      */
-    bool verifyHMAC(const uint8_t* data, uint16_t length, const uint8_t* hmac);
+    void loadReplayWindows();
     
     /**
-     * @brief Check and update sequence number (replay prevention)
+     * @brief Persist the next block of transmit sequence numbers
      */
-    bool validateSequence(uint32_t sequence);
+    void reserveSequenceBlock(uint32_t reserveUntil);
 };
 
 // Global security manager instance
@@ -1,9 +1,21 @@
 #include "sensor_config.h"
 
-SensorConfigManager::SensorConfigManager() {
+SensorConfigManager::SensorConfigManager() :
+    healthCheckpointIntervalSec(HEALTH_CHECKPOINT_INTERVAL_SEC)
+{
+    memset(healthTable, 0, sizeof(healthTable));
+    memset(healthFirstSeen, 0, sizeof(healthFirstSeen));
+    memset(healthDirty, 0, sizeof(healthDirty));
+    memset(priorityTable, PRIORITY_MEDIUM, sizeof(priorityTable));
 }
 
 bool SensorConfigManager::begin() {
+    if (healthMutex == nullptr) {
+        healthMutex = xSemaphoreCreateMutex();
+    }
+    loadPriorities();
+    loadHealthTable();
+    armHealthCheckpoint();
     return true;
 }
 
@@ -14,9 +26,11 @@ String SensorConfigManager::getSensorKey(uint8_t sensorId, const char* field) {
 }
 
 SensorMetadata SensorConfigManager::getSensorMetadata(uint8_t sensorId) {
+    Preferences prefs;
     SensorMetadata metadata;
     metadata.sensorId = sensorId;
     metadata.configured = false;
+    metadata.priority = getSensorPriority(sensorId);
     
     if (!prefs.begin("sensor-meta", true)) {  // Read-only
         // Initialize namespace if missing, then provide defaults
@@ -65,9 +79,6 @@ SensorMetadata SensorConfigManager::getSensorMetadata(uint8_t sensorId) {
     String intervalKey = getSensorKey(sensorId, "int");
     metadata.transmitInterval = prefs.getUShort(intervalKey.c_str(), 15);
     
-    String priorityKey = getSensorKey(sensorId, "prio");
-    metadata.priority = (SensorPriority)prefs.getUChar(priorityKey.c_str(), PRIORITY_MEDIUM);
-    
     String minKey = getSensorKey(sensorId, "tmin");
     metadata.tempThresholdMin = prefs.getFloat(minKey.c_str(), -40.0);
     
@@ -85,6 +96,7 @@ SensorMetadata SensorConfigManager::getSensorMetadata(uint8_t sensorId) {
 }
 
 bool SensorConfigManager::setSensorMetadata(uint8_t sensorId, const SensorMetadata& metadata) {
+    Preferences prefs;
     if (!prefs.begin("sensor-meta", false)) {  // Read-write
         // Try creating the namespace
         prefs.begin("sensor-meta", false);
@@ -112,6 +124,7 @@ bool SensorConfigManager::setSensorMetadata(uint8_t sensorId, const SensorMetada
     
     String priorityKey = getSensorKey(sensorId, "prio");
     prefs.putUChar(priorityKey.c_str(), metadata.priority);
+    priorityTable[sensorId] = metadata.priority;
     
     String minKey = getSensorKey(sensorId, "tmin");
     prefs.putFloat(minKey.c_str(), metadata.tempThresholdMin);
@@ -129,6 +142,7 @@ bool SensorConfigManager::setSensorMetadata(uint8_t sensorId, const SensorMetada
 }
 
 bool SensorConfigManager::hasSensorMetadata(uint8_t sensorId) {
+    Preferences prefs;
     if (!prefs.begin("sensor-meta", true)) {
         // Initialize namespace if missing, then reopen read-only
         prefs.begin("sensor-meta", false);
@@ -166,6 +180,7 @@ void SensorConfigManager::listConfiguredSensors() {
 }
 
 bool SensorConfigManager::clearSensorMetadata(uint8_t sensorId) {
+    Preferences prefs;
     if (!prefs.begin("sensor-meta", false)) {
         return false;
     }
@@ -202,47 +217,76 @@ bool SensorConfigManager::clearSensorMetadata(uint8_t sensorId) {
 // HEALTH SCORING IMPLEMENTATION
 // ============================================================================
 
-void SensorConfigManager::updateHealthScore(uint8_t sensorId, bool packetSuccess, float batteryVoltage, float temperature) {
-    if (!prefs.begin("sensor-health", false)) {
+void SensorConfigManager::loadHealthTable() {
+    Preferences prefs;
+    if (!prefs.begin("sensor-health", true)) {
+        // Initialize namespace if missing; nothing to load yet
+        prefs.begin("sensor-health", false);
+        prefs.end();
         return;
     }
     
-    // Load current health data
-    String totalKey = getSensorKey(sensorId, "htot");
-    String failKey = getSensorKey(sensorId, "hfail");
-    String uptimeKey = getSensorKey(sensorId, "hupt");
-    String lastSeenKey = getSensorKey(sensorId, "hlast");
-    String firstSeenKey = getSensorKey(sensorId, "hfirst");
+    healthCheckpointIntervalSec = prefs.getUInt("ckpt_int", HEALTH_CHECKPOINT_INTERVAL_SEC);
     
-    uint16_t totalPackets = prefs.getUShort(totalKey.c_str(), 0);
-    uint16_t failedPackets = prefs.getUShort(failKey.c_str(), 0);
-    uint32_t firstSeen = prefs.getUInt(firstSeenKey.c_str(), millis());
+    uint32_t now = millis();
+    uint8_t loaded = 0;
+    uint8_t migrated = 0;
+    for (int id = 1; id < 256; id++) {
+        SensorHealthRecord& rec = healthTable[id];
+        char key[16];
+        snprintf(key, sizeof(key), "s%d_h", id);
+        if (prefs.getBytesLength(key) == sizeof(SensorHealthRecord)) {
+            prefs.getBytes(key, &rec, sizeof(SensorHealthRecord));
+            loaded++;
+        } else {
+            // Pre-checkpoint firmware stored one key per field
+            snprintf(key, sizeof(key), "s%d_htot", id);
+            if (!prefs.isKey(key)) {
+                continue;
+            }
+            rec.totalPackets = prefs.getUShort(key, 0);
+            rec.failedPackets = prefs.getUShort(getSensorKey(id, "hfail").c_str(), 0);
+            rec.uptimeSeconds = prefs.getUInt(getSensorKey(id, "hupt").c_str(), 0);
+            rec.lastSeen = prefs.getUInt(getSensorKey(id, "hlast").c_str(), 0);
+            rec.batteryVoltage = prefs.getFloat(getSensorKey(id, "hbatt").c_str(), 4.2);
+            rec.temperature = prefs.getFloat(getSensorKey(id, "htemp").c_str(), 0.0);
+            setHealthDirty(id, true);  // Rewrite as a blob on the next checkpoint
+            migrated++;
+        }
+        // Carry accumulated uptime across reboots
+        healthFirstSeen[id] = now - rec.uptimeSeconds * 1000UL;
+    }
+    prefs.end();
     
-    // Update counters
-    totalPackets++;
-    if (!packetSuccess) {
-        failedPackets++;
+    Serial.printf("Health table loaded: %d sensors (%d migrated), checkpoint every %lus\n",
+                  loaded + migrated, migrated, (unsigned long)healthCheckpointIntervalSec);
+}
+
+void SensorConfigManager::updateHealthScore(uint8_t sensorId, bool packetSuccess, float batteryVoltage, float temperature) {
+    if (!lockHealth()) {
+        return;
     }
     
+    SensorHealthRecord& rec = healthTable[sensorId];
     uint32_t now = millis();
-    uint32_t uptimeSeconds = (now - firstSeen) / 1000;
-    
-    // Save updated counters
-    prefs.putUShort(totalKey.c_str(), totalPackets);
-    prefs.putUShort(failKey.c_str(), failedPackets);
-    prefs.putUInt(uptimeKey.c_str(), uptimeSeconds);
-    prefs.putUInt(lastSeenKey.c_str(), now);
-    if (totalPackets == 1) {
-        prefs.putUInt(firstSeenKey.c_str(), now);
+    if (rec.totalPackets == 0 && healthFirstSeen[sensorId] == 0) {
+        healthFirstSeen[sensorId] = now;
+    }
+    
+    // Update counters
+    rec.totalPackets++;
+    if (!packetSuccess) {
+        rec.failedPackets++;
     }
+    rec.uptimeSeconds = (now - healthFirstSeen[sensorId]) / 1000;
+    rec.lastSeen = now;
     
     // Store battery and temperature for quality analysis
-    String battKey = getSensorKey(sensorId, "hbatt");
-    String tempKey = getSensorKey(sensorId, "htemp");
-    prefs.putFloat(battKey.c_str(), batteryVoltage);
-    prefs.putFloat(tempKey.c_str(), temperature);
+    rec.batteryVoltage = batteryVoltage;
+    rec.temperature = temperature;
     
-    prefs.end();
+    setHealthDirty(sensorId, true);
+    unlockHealth();
 }
 
 SensorHealthScore SensorConfigManager::getHealthScore(uint8_t sensorId) {
@@ -256,24 +300,18 @@ SensorHealthScore SensorConfigManager::getHealthScore(uint8_t sensorId) {
     score.totalPackets = 0;
     score.failedPackets = 0;
     
-    if (!prefs.begin("sensor-health", true)) {
+    SensorHealthRecord rec;
+    if (!lockHealth()) {
         return score;
     }
+    rec = healthTable[sensorId];
+    unlockHealth();
     
-    // Load health data
-    String totalKey = getSensorKey(sensorId, "htot");
-    String failKey = getSensorKey(sensorId, "hfail");
-    String uptimeKey = getSensorKey(sensorId, "hupt");
-    String lastSeenKey = getSensorKey(sensorId, "hlast");
-    String battKey = getSensorKey(sensorId, "hbatt");
-    
-    score.totalPackets = prefs.getUShort(totalKey.c_str(), 0);
-    score.failedPackets = prefs.getUShort(failKey.c_str(), 0);
-    score.uptimeSeconds = prefs.getUInt(uptimeKey.c_str(), 0);
-    score.lastSeenTimestamp = prefs.getUInt(lastSeenKey.c_str(), 0);
-    float batteryVoltage = prefs.getFloat(battKey.c_str(), 4.2);
-    
-    prefs.end();
+    score.totalPackets = rec.totalPackets;
+    score.failedPackets = rec.failedPackets;
+    score.uptimeSeconds = rec.uptimeSeconds;
+    score.lastSeenTimestamp = rec.lastSeen;
+    float batteryVoltage = (rec.totalPackets > 0) ? rec.batteryVoltage : 4.2;
     
     // Calculate component scores
     score.communicationReliability = calculateCommunicationReliability(score.totalPackets, score.failedPackets);
@@ -287,6 +325,72 @@ SensorHealthScore SensorConfigManager::getHealthScore(uint8_t sensorId) {
     return score;
 }
 
+void SensorConfigManager::armHealthCheckpoint() {
+    if (healthCheckpointIntervalSec == 0) {
+        timerWheel.cancel(&healthCheckpointTimer);  // Periodic checkpointing disabled (reboot checkpoint still applies)
+        return;
+    }
+    const uint32_t intervalMs = healthCheckpointIntervalSec * 1000UL;
+    timerWheel.schedule(&healthCheckpointTimer, intervalMs, onHealthCheckpointDue, this, intervalMs);
+}
+
+void SensorConfigManager::onHealthCheckpointDue(TimerNode* /*node*/, void* context) {
+    static_cast<SensorConfigManager*>(context)->checkpointHealthScores();
+}
+
+uint8_t SensorConfigManager::checkpointHealthScores() {
+    Preferences prefs;
+    uint8_t written = 0;
+    bool opened = false;
+    
+    for (int id = 1; id < 256; id++) {
+        if (!isHealthDirty(id)) {
+            continue;
+        }
+        
+        // Copy out under the lock; the flash write happens without holding it
+        SensorHealthRecord rec;
+        if (!lockHealth()) {
+            continue;
+        }
+        rec = healthTable[id];
+        setHealthDirty(id, false);
+        unlockHealth();
+        
+        if (!opened) {
+            if (!prefs.begin("sensor-health", false)) {
+                requeueHealth(id);
+                return written;
+            }
+            opened = true;
+        }
+        
+        char key[16];
+        snprintf(key, sizeof(key), "s%d_h", id);
+        if (prefs.putBytes(key, &rec, sizeof(SensorHealthRecord)) == sizeof(SensorHealthRecord)) {
+            written++;
+        } else {
+            requeueHealth(id);  // Retry next checkpoint
+        }
+    }
+    
+    if (opened) {
+        prefs.end();
+        Serial.printf("Health checkpoint: %d sensors written to NVS\n", written);
+    }
+    return written;
+}
+
+void SensorConfigManager::setHealthCheckpointInterval(uint32_t seconds) {
+    Preferences prefs;
+    healthCheckpointIntervalSec = seconds;
+    armHealthCheckpoint();
+    if (prefs.begin("sensor-health", false)) {
+        prefs.putUInt("ckpt_int", seconds);
+        prefs.end();
+    }
+}
+
 float SensorConfigManager::calculateCommunicationReliability(uint16_t totalPackets, uint16_t failedPackets) {
     if (totalPackets == 0) {
         return 0.0;
@@ -357,6 +461,7 @@ String SensorConfigManager::getSensorZone(uint8_t sensorId) {
 }
 
 bool SensorConfigManager::setSensorZone(uint8_t sensorId, const char* zone) {
+    Preferences prefs;
     if (!prefs.begin("sensor-meta", false)) {
         return false;
     }
@@ -374,12 +479,22 @@ bool SensorConfigManager::setSensorZone(uint8_t sensorId, const char* zone) {
 // PRIORITY MANAGEMENT
 // ============================================================================
 
-SensorPriority SensorConfigManager::getSensorPriority(uint8_t sensorId) {
-    SensorMetadata metadata = getSensorMetadata(sensorId);
-    return metadata.priority;
+void SensorConfigManager::loadPriorities() {
+    Preferences prefs;
+    if (!prefs.begin("sensor-meta", true)) {
+        return;  // Nothing stored yet; every sensor stays PRIORITY_MEDIUM
+    }
+    for (int id = 1; id < 256; id++) {
+        String priorityKey = getSensorKey(id, "prio");
+        if (prefs.isKey(priorityKey.c_str())) {
+            priorityTable[id] = prefs.getUChar(priorityKey.c_str(), PRIORITY_MEDIUM);
+        }
+    }
+    prefs.end();
 }
 
 bool SensorConfigManager::setSensorPriority(uint8_t sensorId, SensorPriority priority) {
+    Preferences prefs;
     if (!prefs.begin("sensor-meta", false)) {
         return false;
     }
@@ -388,6 +503,7 @@ bool SensorConfigManager::setSensorPriority(uint8_t sensorId, SensorPriority pri
     prefs.putUChar(priorityKey.c_str(), priority);
     
     prefs.end();
+    priorityTable[sensorId] = priority;
     
     const char* priorityStr = (priority == PRIORITY_HIGH) ? "HIGH" : 
                               (priority == PRIORITY_MEDIUM) ? "MEDIUM" : "LOW";
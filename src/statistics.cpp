@@ -1,25 +1,111 @@
 #include "statistics.h"
 #include "config.h"
 #include <Arduino.h>
+#include <math.h>
+#include <time.h>
+#include <Preferences.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #ifdef BASE_STATION
 #include "sensor_config.h"
+#include "timeseries_store.h"
+#include "alerts.h"
+#include "timer_wheel.h"
 extern SensorConfigManager sensorConfigManager;
 #endif
 
-#define MAX_CLIENTS 10
+static SystemStats stats;
 
-// Reuse MAX_SENSORS from config.h, but expand it for physical sensor storage
-#undef MAX_SENSORS
-#define MAX_SENSORS 40  // Max 10 clients * 4 sensors each (adjustable)
+// Guards the client/sensor tables, their ID indexes and the rollups: the RX decode
+// task writes them while the loop and web handlers read, time out and forget slots
+static SemaphoreHandle_t statsMutex = NULL;
 
-static SystemStats stats;
-static ClientInfo clients[MAX_CLIENTS];
-static PhysicalSensor sensors[MAX_SENSORS];
+// Client and sensor tables are sized at boot from the stored capacities
+static ClientInfo* clients = NULL;
+static PhysicalSensor* sensors = NULL;
+static uint8_t clientCapacity = 0;
+static uint16_t sensorCapacity = 0;
+
+// Direct lookup: slot + 1 for each client ID / (client ID, sensor index), 0 = not tracked
+static uint8_t clientSlot[256];
+static uint8_t sensorSlot[256][MAX_VALUES_PER_PACKET];
+#ifdef BASE_STATION
+static SeriesRollups* rollups = NULL;
+static uint16_t rollupCapacity = 0;
+static void recordRollup(uint8_t clientId, uint8_t channel, uint8_t type, float value);
+static void forgetRollups(uint8_t clientId);
+static void forgetRollupSeries(uint8_t clientId, uint8_t channel);
+
+// One series per sensor slot plus battery and RSSI per client, capped so that
+// ROLLUP_HEAP_RESERVE stays free; halved until the allocation succeeds
+static void allocateRollups(uint8_t maxClients, uint16_t maxSensors) {
+  free(rollups);
+  uint16_t wanted = (uint16_t)maxClients * 2 + maxSensors;
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t budget = (freeHeap > ROLLUP_HEAP_RESERVE) ? freeHeap - ROLLUP_HEAP_RESERVE : 0;
+  uint16_t count = min((uint32_t)wanted, (uint32_t)(budget / sizeof(SeriesRollups)));
+  rollups = (SeriesRollups*)calloc(count, sizeof(SeriesRollups));
+  while (rollups == NULL && count > 1) {
+    count /= 2;
+    rollups = (SeriesRollups*)calloc(count, sizeof(SeriesRollups));
+  }
+  rollupCapacity = (rollups != NULL) ? count : 0;
+  if (rollupCapacity < wanted) {
+    Serial.printf("⚠️ Rollups for %d series do not fit, using %d\n", wanted, rollupCapacity);
+  }
+}
+#endif
+
+static void allocateTables(uint8_t maxClients, uint16_t maxSensors) {
+  free(clients);
+  free(sensors);
+  clients = (ClientInfo*)calloc(maxClients, sizeof(ClientInfo));
+  sensors = (PhysicalSensor*)calloc(maxSensors, sizeof(PhysicalSensor));
+  if (clients == NULL || sensors == NULL) {
+    // Not enough heap for the configured size; fall back to the defaults
+    Serial.printf("⚠️ Stats tables for %d clients / %d sensors do not fit, using defaults\n", maxClients, maxSensors);
+    free(clients);
+    free(sensors);
+    maxClients = STATS_DEFAULT_MAX_CLIENTS;
+    maxSensors = STATS_DEFAULT_MAX_SENSORS;
+    clients = (ClientInfo*)calloc(maxClients, sizeof(ClientInfo));
+    sensors = (PhysicalSensor*)calloc(maxSensors, sizeof(PhysicalSensor));
+  }
+  clientCapacity = (clients != NULL) ? maxClients : 0;
+  sensorCapacity = (sensors != NULL) ? maxSensors : 0;
+}
+
+bool lockStats() {
+  return (statsMutex == NULL) || (xSemaphoreTakeRecursive(statsMutex, portMAX_DELAY) == pdTRUE);
+}
+
+void unlockStats() {
+  if (statsMutex != NULL) {
+    xSemaphoreGiveRecursive(statsMutex);
+  }
+}
 
 void initStats() {
+  if (statsMutex == NULL) {
+    statsMutex = xSemaphoreCreateRecursiveMutex();
+  }
   memset(&stats, 0, sizeof(SystemStats));
-  memset(clients, 0, sizeof(clients));
-  memset(sensors, 0, sizeof(sensors));
+  memset(clientSlot, 0, sizeof(clientSlot));
+  memset(sensorSlot, 0, sizeof(sensorSlot));
+  
+  uint8_t maxClients;
+  uint16_t maxSensors;
+  getStoredStatsCapacity(maxClients, maxSensors);
+  maxClients = constrain(maxClients, 1, STATS_MAX_CLIENTS_LIMIT);
+  maxSensors = constrain(maxSensors, 1, STATS_MAX_SENSORS_LIMIT);
+  allocateTables(maxClients, maxSensors);
+  #ifdef BASE_STATION
+  allocateRollups(clientCapacity, sensorCapacity);
+  Serial.printf("📊 Stats capacity: %d clients, %d sensors, %d rollup series\n",
+                clientCapacity, sensorCapacity, rollupCapacity);
+  #else
+  Serial.printf("📊 Stats capacity: %d clients, %d sensors\n", clientCapacity, sensorCapacity);
+  #endif
   
   // Initialize RSSI history with mid-range values
   for (int i = 0; i < 32; i++) {
@@ -56,46 +142,88 @@ void recordRxInvalid() {
   stats.totalRxInvalid++;
 }
 
+void recordLoopIteration() {
+  static uint32_t windowStart = 0;
+  static uint32_t iterations = 0;
+  iterations++;
+  uint32_t now = millis();
+  if (now - windowStart >= 1000) {
+    stats.loopIterationsPerSec = (uint32_t)((uint64_t)iterations * 1000 / (now - windowStart));
+    iterations = 0;
+    windowStart = now;
+  }
+}
+
 // ============================================================================
 // CLIENT TRACKING
 // ============================================================================
 
-void updateClientInfo(uint8_t clientId, uint8_t batteryPercent, bool powerState, int16_t rssi, int8_t snr) {
-  ClientInfo* client = NULL;
-  
-  // Look for existing client
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (clients[i].active && clients[i].clientId == clientId) {
-      client = &clients[i];
-      break;
+#ifdef BASE_STATION
+// Configured names live in NVS; they are looked up on the loop task when a client
+// (re)appears rather than on every packet in the decode task
+static bool locationPending[STATS_MAX_CLIENTS_LIMIT];
+static TimerNode locationTimer;
+
+static void onResolveLocationsDue(TimerNode* /*node*/, void* /*context*/) {
+  for (int i = 0; i < clientCapacity; i++) {
+    lockStats();
+    const bool pending = locationPending[i];
+    const uint8_t clientId = clients[i].clientId;
+    unlockStats();
+    if (!pending) {
+      continue;
     }
+    
+    String configuredName = sensorConfigManager.getSensorLocation(clientId);
+    lockStats();
+    // Skip if the slot changed hands or a frame carried its own location meanwhile
+    if (locationPending[i] && clients[i].clientId == clientId) {
+      snprintf(clients[i].location, sizeof(clients[i].location), "%s", configuredName.c_str());
+      locationPending[i] = false;
+    }
+    unlockStats();
   }
+}
+#endif
+
+void updateClientInfo(uint8_t clientId, uint8_t batteryPercent, bool powerState, int16_t rssi, int8_t snr) {
+  bool appeared = false;
+  bool tracked = false;
+  uint8_t idx = 0;
+  uint8_t count = 0;
+  
+  lockStats();
+  ClientInfo* client = getClientInfo(clientId);
   
-  // If not found, find empty slot
+  // If not found, take a free slot: the one this client held before it timed
+  // out (keeps its history), otherwise the first inactive one
   if (client == NULL) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    int slot = -1;
+    for (int i = 0; i < clientCapacity; i++) {
       if (!clients[i].active) {
-        client = &clients[i];
-        client->clientId = clientId;
-        
-        // Try to get configured location name
-        #ifdef BASE_STATION
-        String configuredName = sensorConfigManager.getSensorLocation(clientId);
-        snprintf(client->location, sizeof(client->location), "%s", configuredName.c_str());
-        #else
+        if (clients[i].clientId == clientId) {
+          slot = i;
+          break;
+        }
+        if (slot < 0) {
+          slot = i;
+        }
+      }
+    }
+    if (slot >= 0) {
+      client = &clients[slot];
+      if (client->clientId != clientId) {
+        memset(&client->clock, 0, sizeof(client->clock));
         snprintf(client->location, sizeof(client->location), "Client %d", clientId);
-        #endif
-        
-        client->active = true;
-        break;
       }
+      client->clientId = clientId;
+      client->active = true;
+      clientSlot[clientId] = slot + 1;
+      #ifdef BASE_STATION
+      locationPending[slot] = true;  // Configured name is filled in from the loop task
+      #endif
+      appeared = true;
     }
-  } else {
-    // Update location if configured name changed
-    #ifdef BASE_STATION
-    String configuredName = sensorConfigManager.getSensorLocation(clientId);
-    snprintf(client->location, sizeof(client->location), "%s", configuredName.c_str());
-    #endif
   }
   
   if (client != NULL) {
@@ -108,115 +236,250 @@ void updateClientInfo(uint8_t clientId, uint8_t batteryPercent, bool powerState,
     // Keep lastTimeSyncMs intact; only updated via recordClientTimeSync
     
     // Store client telemetry history
-    uint8_t idx = client->history.index;
+    idx = client->history.index;
     client->history.data[idx].timestamp = millis() / 1000;
     client->history.data[idx].battery = batteryPercent;
     client->history.data[idx].rssi = rssi;
     client->history.data[idx].charging = powerState;
+    count = client->history.count;
     
-    Serial.printf("📊 CLIENT HISTORY: Client %d stored at idx %d (count=%d): batt=%d%%, rssi=%d dBm, charging=%s\n",
-                  clientId, idx, client->history.count, 
-                  batteryPercent, rssi, powerState ? "YES" : "NO");
+    #ifdef BASE_STATION
+    recordRollup(clientId, ROLLUP_CHANNEL_BATTERY, VALUE_BATTERY, batteryPercent);
+    recordRollup(clientId, ROLLUP_CHANNEL_RSSI, VALUE_SIGNAL_STRENGTH, rssi);
+    #endif
     
     client->history.index = (idx + 1) % HISTORY_SIZE;
     if (client->history.count < HISTORY_SIZE) {
       client->history.count++;
     }
+    tracked = true;
   }
+  unlockStats();
+  
+  if (tracked) {
+    #ifdef BASE_STATION
+    timeSeriesStore.appendClient(clientId, batteryPercent, rssi, powerState);
+    #endif
+    Serial.printf("📊 CLIENT HISTORY: Client %d stored at idx %d (count=%d): batt=%d%%, rssi=%d dBm, charging=%s\n",
+                  clientId, idx, count, 
+                  batteryPercent, rssi, powerState ? "YES" : "NO");
+  }
+  
+  // Offline deadline and battery rules (also for clients that found no table slot)
+  #ifdef BASE_STATION
+  if (appeared) {
+    timerWheel.schedule(&locationTimer, 0, onResolveLocationsDue, nullptr);
+  }
+  alertManager.onClientSeen(clientId);
+  alertManager.onReading(clientId, ALERT_CHANNEL_CLIENT_BATTERY, VALUE_BATTERY, batteryPercent);
+  #endif
 }
 
 uint8_t getActiveClientCount() {
   uint8_t count = 0;
-  for (int i = 0; i < MAX_CLIENTS; i++) {
+  lockStats();
+  for (int i = 0; i < clientCapacity; i++) {
     if (clients[i].active) {
       count++;
     }
   }
+  unlockStats();
   return count;
 }
 
 ClientInfo* getClientInfo(uint8_t clientId) {
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (clients[i].active && clients[i].clientId == clientId) {
-      return &clients[i];
-    }
+  ClientInfo* client = NULL;
+  lockStats();
+  uint8_t slot = clientSlot[clientId];
+  if (slot != 0 && clients[slot - 1].active) {
+    client = &clients[slot - 1];
   }
-  return NULL;
+  unlockStats();
+  return client;
 }
 
 ClientInfo* getClientByIndex(uint8_t index) {
-  if (index < MAX_CLIENTS && clients[index].active) {
-    return &clients[index];
+  ClientInfo* client = NULL;
+  lockStats();
+  if (index < clientCapacity && clients[index].active) {
+    client = &clients[index];
   }
-  return NULL;
+  unlockStats();
+  return client;
 }
 
 ClientInfo* getAllClients() {
   return clients;
 }
 
+uint8_t getClientCapacity() {
+  return clientCapacity;
+}
+
+uint16_t getSensorCapacity() {
+  return sensorCapacity;
+}
+
+bool setStatsCapacity(uint8_t maxClients, uint16_t maxSensors) {
+  if (maxClients < 1 || maxClients > STATS_MAX_CLIENTS_LIMIT ||
+      maxSensors < 1 || maxSensors > STATS_MAX_SENSORS_LIMIT) {
+    return false;
+  }
+  Preferences prefs;
+  if (!prefs.begin("stats", false)) {
+    return false;
+  }
+  prefs.putUChar("max_clients", maxClients);
+  prefs.putUShort("max_sensors", maxSensors);
+  prefs.end();
+  return true;
+}
+
+void getStoredStatsCapacity(uint8_t& maxClients, uint16_t& maxSensors) {
+  maxClients = STATS_DEFAULT_MAX_CLIENTS;
+  maxSensors = STATS_DEFAULT_MAX_SENSORS;
+  Preferences prefs;
+  if (prefs.begin("stats", true)) {
+    maxClients = prefs.getUChar("max_clients", STATS_DEFAULT_MAX_CLIENTS);
+    maxSensors = prefs.getUShort("max_sensors", STATS_DEFAULT_MAX_SENSORS);
+    prefs.end();
+  }
+}
+
+// Drop a sensor slot and its index entry (caller holds the stats lock)
+static void releaseSensor(int i) {
+  if (sensors[i].sensorIndex < MAX_VALUES_PER_PACKET &&
+      sensorSlot[sensors[i].clientId][sensors[i].sensorIndex] == i + 1) {
+    sensorSlot[sensors[i].clientId][sensors[i].sensorIndex] = 0;
+  }
+  sensors[i].active = false;
+}
+
 void checkClientTimeouts() {
+  lockStats();
   uint32_t currentTime = millis();
-  for (int i = 0; i < MAX_CLIENTS; i++) {
+  for (int i = 0; i < clientCapacity; i++) {
     if (clients[i].active) {
       uint32_t ageSeconds = (currentTime - clients[i].lastSeen) / 1000;
       if (ageSeconds > 600) {  // 10 minutes timeout
         clients[i].active = false;
+        clientSlot[clients[i].clientId] = 0;
+        #ifdef BASE_STATION
+        forgetRollupSeries(clients[i].clientId, ROLLUP_CHANNEL_BATTERY);
+        forgetRollupSeries(clients[i].clientId, ROLLUP_CHANNEL_RSSI);
+        #endif
       }
     }
   }
+  unlockStats();
 }
 
 bool isClientTimedOut(uint8_t clientId) {
+  bool timedOut = true;
+  lockStats();
   ClientInfo* client = getClientInfo(clientId);
-  if (client == NULL) return true;
-  
-  uint32_t ageSeconds = (millis() - client->lastSeen) / 1000;
-  return ageSeconds > 600;
+  if (client != NULL) {
+    timedOut = (millis() - client->lastSeen) / 1000 > 600;
+  }
+  unlockStats();
+  return timedOut;
 }
 
 void setClientLocation(uint8_t clientId, const char* location) {
+  if (location == NULL) {
+    return;
+  }
+  lockStats();
   ClientInfo* client = getClientInfo(clientId);
-  if (client != NULL && location != NULL) {
+  if (client != NULL) {
     strncpy(client->location, location, sizeof(client->location) - 1);
     client->location[sizeof(client->location) - 1] = '\0';
+    #ifdef BASE_STATION
+    locationPending[client - clients] = false;
+    #endif
   }
+  unlockStats();
 }
 
 const char* getClientLocation(uint8_t clientId) {
+  const char* location = "Unknown";
+  lockStats();
+  ClientInfo* client = getClientInfo(clientId);
+  if (client != NULL) {
+    location = client->location;
+  }
+  unlockStats();
+  return location;
+}
+
+bool copyClientLocation(uint8_t clientId, char* out, size_t outSize) {
+  bool found = false;
+  lockStats();
+  ClientInfo* client = getClientInfo(clientId);
+  if (client != NULL) {
+    snprintf(out, outSize, "%s", client->location);
+    found = true;
+  }
+  unlockStats();
+  return found;
+}
+
+bool isClientLocationPending(uint8_t clientId) {
+  bool pending = false;
+  #ifdef BASE_STATION
+  lockStats();
   ClientInfo* client = getClientInfo(clientId);
   if (client != NULL) {
-    return client->location;
+    pending = locationPending[client - clients];
   }
-  return "Unknown";
+  unlockStats();
+  #endif
+  return pending;
 }
 
 ClientHistory* getClientHistory(uint8_t clientId) {
+  ClientHistory* history = NULL;
+  lockStats();
   ClientInfo* client = getClientInfo(clientId);
   if (client != NULL) {
-    return &client->history;
+    history = &client->history;
   }
-  return NULL;
+  unlockStats();
+  return history;
 }
 
 bool forgetClient(uint8_t clientId) {
+  lockStats();
   ClientInfo* client = getClientInfo(clientId);
-  if (client != NULL) {
-    // Mark client as inactive and clear data
-    client->active = false;
-    memset(client, 0, sizeof(ClientInfo));
-    
-    // Also clear all sensors associated with this client
-    for (int i = 0; i < MAX_SENSORS; i++) {
-      if (sensors[i].active && sensors[i].clientId == clientId) {
-        sensors[i].active = false;
-        memset(&sensors[i], 0, sizeof(PhysicalSensor));
-      }
+  if (client == NULL) {
+    unlockStats();
+    return false;
+  }
+  
+  // Drop the index entry and clear the slot in one go
+  clientSlot[clientId] = 0;
+  #ifdef BASE_STATION
+  locationPending[client - clients] = false;
+  #endif
+  memset(client, 0, sizeof(ClientInfo));
+  
+  // Also clear all sensors associated with this client
+  for (int i = 0; i < sensorCapacity; i++) {
+    if (sensors[i].active && sensors[i].clientId == clientId) {
+      releaseSensor(i);
+      memset(&sensors[i], 0, sizeof(PhysicalSensor));
     }
-    
-    return true;
   }
-  return false;
+  
+  #ifdef BASE_STATION
+  forgetRollups(clientId);
+  #endif
+  unlockStats();
+  
+  #ifdef BASE_STATION
+  alertManager.onClientForgotten(clientId);
+  #endif
+  return true;
 }
 
 // ============================================================================
@@ -224,30 +487,38 @@ bool forgetClient(uint8_t clientId) {
 // ============================================================================
 
 void updateSensorReading(uint8_t clientId, uint8_t sensorIndex, uint8_t type, float value) {
-  PhysicalSensor* sensor = NULL;
-  
-  // Look for existing sensor
-  for (int i = 0; i < MAX_SENSORS; i++) {
-    if (sensors[i].active && 
-        sensors[i].clientId == clientId && 
-        sensors[i].sensorIndex == sensorIndex) {
-      sensor = &sensors[i];
-      break;
-    }
+  if (sensorIndex >= MAX_VALUES_PER_PACKET) {
+    return;
   }
+  bool tracked = false;
+  uint8_t idx = 0;
+  uint8_t count = 0;
   
-  // If not found, find empty slot
+  lockStats();
+  PhysicalSensor* sensor = getSensor(clientId, sensorIndex);
+  
+  // If not found, take a free slot (preferring the one this sensor held before it timed out)
   if (sensor == NULL) {
-    for (int i = 0; i < MAX_SENSORS; i++) {
+    int slot = -1;
+    for (int i = 0; i < sensorCapacity; i++) {
       if (!sensors[i].active) {
-        sensor = &sensors[i];
-        sensor->clientId = clientId;
-        sensor->sensorIndex = sensorIndex;
-        sensor->type = type;
-        sensor->active = true;
-        break;
+        if (sensors[i].clientId == clientId && sensors[i].sensorIndex == sensorIndex) {
+          slot = i;
+          break;
+        }
+        if (slot < 0) {
+          slot = i;
+        }
       }
     }
+    if (slot >= 0) {
+      sensor = &sensors[slot];
+      sensor->clientId = clientId;
+      sensor->sensorIndex = sensorIndex;
+      sensor->type = type;
+      sensor->active = true;
+      sensorSlot[clientId][sensorIndex] = slot + 1;
+    }
   }
   
   if (sensor != NULL) {
@@ -256,46 +527,71 @@ void updateSensorReading(uint8_t clientId, uint8_t sensorIndex, uint8_t type, fl
     sensor->type = type;  // Update type in case it changed
     
     // Store sensor reading history
-    uint8_t idx = sensor->history.index;
+    idx = sensor->history.index;
     sensor->history.data[idx].timestamp = millis() / 1000;
     sensor->history.data[idx].value = value;
+    count = sensor->history.count;
     
-    Serial.printf("📊 SENSOR HISTORY: Client %d Sensor %d stored at idx %d (count=%d): type=%d, value=%.2f\n",
-                  clientId, sensorIndex, idx, sensor->history.count, type, value);
+    #ifdef BASE_STATION
+    recordRollup(clientId, sensorIndex, type, value);
+    #endif
     
     sensor->history.index = (idx + 1) % HISTORY_SIZE;
     if (sensor->history.count < HISTORY_SIZE) {
       sensor->history.count++;
     }
+    tracked = true;
+  }
+  unlockStats();
+  
+  if (tracked) {
+    #ifdef BASE_STATION
+    timeSeriesStore.appendSensor(clientId, sensorIndex, type, value);
+    #endif
+    Serial.printf("📊 SENSOR HISTORY: Client %d Sensor %d stored at idx %d (count=%d): type=%d, value=%.2f\n",
+                  clientId, sensorIndex, idx, count, type, value);
   }
+  
+  // Threshold and rate-of-change rules for this value type
+  #ifdef BASE_STATION
+  alertManager.onReading(clientId, sensorIndex, type, value);
+  #endif
 }
 
 uint8_t getActiveSensorCount() {
   uint8_t count = 0;
-  for (int i = 0; i < MAX_SENSORS; i++) {
+  lockStats();
+  for (int i = 0; i < sensorCapacity; i++) {
     if (sensors[i].active) {
       count++;
     }
   }
+  unlockStats();
   return count;
 }
 
 PhysicalSensor* getSensor(uint8_t clientId, uint8_t sensorIndex) {
-  for (int i = 0; i < MAX_SENSORS; i++) {
-    if (sensors[i].active && 
-        sensors[i].clientId == clientId && 
-        sensors[i].sensorIndex == sensorIndex) {
-      return &sensors[i];
-    }
+  if (sensorIndex >= MAX_VALUES_PER_PACKET) {
+    return NULL;
+  }
+  PhysicalSensor* sensor = NULL;
+  lockStats();
+  uint8_t slot = sensorSlot[clientId][sensorIndex];
+  if (slot != 0 && sensors[slot - 1].active) {
+    sensor = &sensors[slot - 1];
   }
-  return NULL;
+  unlockStats();
+  return sensor;
 }
 
 PhysicalSensor* getSensorByGlobalIndex(uint8_t index) {
-  if (index < MAX_SENSORS && sensors[index].active) {
-    return &sensors[index];
+  PhysicalSensor* sensor = NULL;
+  lockStats();
+  if (index < sensorCapacity && sensors[index].active) {
+    sensor = &sensors[index];
   }
-  return NULL;
+  unlockStats();
+  return sensor;
 }
 
 PhysicalSensor* getAllPhysicalSensors() {
@@ -303,25 +599,194 @@ PhysicalSensor* getAllPhysicalSensors() {
 }
 
 void checkSensorTimeouts() {
+  lockStats();
   uint32_t currentTime = millis();
-  for (int i = 0; i < MAX_SENSORS; i++) {
+  for (int i = 0; i < sensorCapacity; i++) {
     if (sensors[i].active) {
       uint32_t ageSeconds = (currentTime - sensors[i].lastSeen) / 1000;
       if (ageSeconds > 600) {  // 10 minutes timeout
-        sensors[i].active = false;
+        releaseSensor(i);
+        #ifdef BASE_STATION
+        forgetRollupSeries(sensors[i].clientId, sensors[i].sensorIndex);  // Free the slot for live series
+        #endif
       }
     }
   }
+  unlockStats();
 }
 
 SensorHistory* getSensorHistory(uint8_t clientId, uint8_t sensorIndex) {
+  SensorHistory* history = NULL;
+  lockStats();
   PhysicalSensor* sensor = getSensor(clientId, sensorIndex);
   if (sensor != NULL) {
-    return &sensor->history;
+    history = &sensor->history;
+  }
+  unlockStats();
+  return history;
+}
+
+// ============================================================================
+// MULTI-RESOLUTION ROLLUPS
+// ============================================================================
+
+#ifdef BASE_STATION
+
+static const uint32_t rollupResolution[ROLLUP_TIER_COUNT] = { 60, 900, 3600 };
+static const uint16_t rollupBuckets[ROLLUP_TIER_COUNT] = { ROLLUP_1M_BUCKETS, ROLLUP_15M_BUCKETS, ROLLUP_1H_BUCKETS };
+static const uint16_t rollupOffset[ROLLUP_TIER_COUNT] = { 0, ROLLUP_1M_BUCKETS, ROLLUP_1M_BUCKETS + ROLLUP_15M_BUCKETS };
+
+static void clearRollupBucket(RollupBucket& bucket) {
+  bucket.minValue = NAN;
+  bucket.mean = NAN;
+  bucket.maxValue = NAN;
+}
+
+static SeriesRollups* findRollupSeries(uint8_t clientId, uint8_t channel) {
+  SeriesRollups* freeSlot = NULL;
+  for (int i = 0; i < rollupCapacity; i++) {
+    if (rollups[i].active) {
+      if (rollups[i].clientId == clientId && rollups[i].channel == channel) {
+        return &rollups[i];
+      }
+    } else if (freeSlot == NULL) {
+      freeSlot = &rollups[i];
+    }
+  }
+  
+  if (freeSlot != NULL) {
+    memset(freeSlot, 0, sizeof(SeriesRollups));
+    for (int b = 0; b < ROLLUP_TOTAL_BUCKETS; b++) {
+      clearRollupBucket(freeSlot->buckets[b]);
+    }
+    freeSlot->clientId = clientId;
+    freeSlot->channel = channel;
+    freeSlot->active = true;
+  }
+  return freeSlot;
+}
+
+// O(tiers) per reading: merge into the newest bucket of each tier, opening a new
+// bucket (and emptying any skipped ones) when the reading falls past it. Caller holds the stats lock.
+static void recordRollup(uint8_t clientId, uint8_t channel, uint8_t type, float value) {
+  if (isnan(value)) {
+    return;
+  }
+  SeriesRollups* series = findRollupSeries(clientId, channel);
+  if (series == NULL) {
+    return;
+  }
+  series->type = type;
+  
+  const uint32_t now = historyTimestamp();
+  for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+    const uint32_t bucketNumber = now / rollupResolution[t];
+    const uint16_t size = rollupBuckets[t];
+    RollupBucket* ring = &series->buckets[rollupOffset[t]];
+    
+    if (series->newestCount[t] == 0 || bucketNumber > series->newestBucket[t]) {
+      uint32_t skipped = (series->newestCount[t] == 0) ? size : bucketNumber - series->newestBucket[t];
+      if (skipped > size) {
+        skipped = size;
+      }
+      for (uint32_t k = 0; k < skipped; k++) {
+        clearRollupBucket(ring[(bucketNumber - k) % size]);
+      }
+      series->newestBucket[t] = bucketNumber;
+      series->newestCount[t] = 0;
+    }
+    
+    // A reading from before the newest bucket (clock stepped back) is merged into it
+    RollupBucket& bucket = ring[series->newestBucket[t] % size];
+    uint16_t count = series->newestCount[t];
+    if (count == 0) {
+      bucket.minValue = value;
+      bucket.mean = value;
+      bucket.maxValue = value;
+    } else {
+      bucket.mean += (value - bucket.mean) / (count + 1);
+      if (value < bucket.minValue) bucket.minValue = value;
+      if (value > bucket.maxValue) bucket.maxValue = value;
+    }
+    if (count < 0xFFFF) {
+      series->newestCount[t] = count + 1;
+    }
+  }
+}
+
+static void forgetRollups(uint8_t clientId) {
+  for (int i = 0; i < rollupCapacity; i++) {
+    if (rollups[i].active && rollups[i].clientId == clientId) {
+      rollups[i].active = false;
+    }
+  }
+}
+
+static void forgetRollupSeries(uint8_t clientId, uint8_t channel) {
+  for (int i = 0; i < rollupCapacity; i++) {
+    if (rollups[i].active && rollups[i].clientId == clientId && rollups[i].channel == channel) {
+      rollups[i].active = false;
+      return;
+    }
   }
-  return NULL;
 }
 
+uint32_t historyTimestamp() {
+  time_t now = time(nullptr);
+  if (now > 1700000000) {  // Same sanity check as the time broadcast
+    return (uint32_t)now;
+  }
+  return millis() / 1000;
+}
+
+uint32_t getRollupResolution(uint8_t tier) {
+  return (tier < ROLLUP_TIER_COUNT) ? rollupResolution[tier] : 0;
+}
+
+uint16_t getRollupBucketCount(uint8_t tier) {
+  return (tier < ROLLUP_TIER_COUNT) ? rollupBuckets[tier] : 0;
+}
+
+uint8_t getRollupSeriesForClient(uint8_t clientId, uint16_t* slots, uint8_t maxSlots) {
+  uint8_t count = 0;
+  lockStats();
+  for (int i = 0; i < rollupCapacity && count < maxSlots; i++) {
+    if (rollups[i].active && rollups[i].clientId == clientId) {
+      slots[count++] = i;
+    }
+  }
+  unlockStats();
+  return count;
+}
+
+const SeriesRollups* getRollupSeries(uint16_t slot) {
+  const SeriesRollups* series = NULL;
+  lockStats();
+  if (slot < rollupCapacity && rollups[slot].active) {
+    series = &rollups[slot];
+  }
+  unlockStats();
+  return series;
+}
+
+bool getRollupBucket(const SeriesRollups* series, uint8_t tier, uint32_t bucketNumber, RollupBucket& out) {
+  if (series == NULL || tier >= ROLLUP_TIER_COUNT) {
+    return false;
+  }
+  bool found = false;
+  lockStats();
+  const uint32_t newest = series->newestBucket[tier];
+  if (series->active && series->newestCount[tier] != 0 &&
+      bucketNumber <= newest && newest - bucketNumber < rollupBuckets[tier]) {
+    out = series->buckets[rollupOffset[tier] + bucketNumber % rollupBuckets[tier]];
+    found = !isnan(out.mean);
+  }
+  unlockStats();
+  return found;
+}
+
+#endif // BASE_STATION
+
 // ============================================================================
 // LEGACY COMPATIBILITY
 // ============================================================================
@@ -333,17 +798,27 @@ void updateSensorInfo(const SensorData& data, int16_t rssi, int8_t snr) {
   updateClientInfo(data.sensorId, data.batteryPercent, data.powerState, rssi, snr);
   
   // Update legacy compatibility fields
+  lockStats();
   ClientInfo* client = getClientInfo(data.sensorId);
   if (client != NULL) {
     client->sensorId = data.sensorId;  // Populate legacy alias
     client->lastTemperature = data.temperature;  // Populate legacy field
     
-    // Store location and zone from packet
-    strncpy(client->location, data.location, sizeof(client->location) - 1);
-    client->location[sizeof(client->location) - 1] = '\0';
-    strncpy(client->zone, data.zone, sizeof(client->zone) - 1);
-    client->zone[sizeof(client->zone) - 1] = '\0';
+    // Store location and zone from packet (compact v3 packets carry neither;
+    // keep the configured values in that case)
+    if (data.location[0] != '\0') {
+      strncpy(client->location, data.location, sizeof(client->location) - 1);
+      client->location[sizeof(client->location) - 1] = '\0';
+      #ifdef BASE_STATION
+      locationPending[client - clients] = false;
+      #endif
+    }
+    if (data.zone[0] != '\0') {
+      strncpy(client->zone, data.zone, sizeof(client->zone) - 1);
+      client->zone[sizeof(client->zone) - 1] = '\0';
+    }
   }
+  unlockStats();
   
   // Update health score tracking
   #ifdef BASE_STATION
@@ -371,26 +846,79 @@ SystemStats* getStats() {
 // ============================================================================
 
 void recordClientTimeSync(uint8_t clientId) {
+  lockStats();
   ClientInfo* c = getClientInfo(clientId);
   if (c != NULL) {
     c->lastTimeSyncMs = millis();
   }
+  unlockStats();
 }
 
 uint8_t countClientsWithTimeSync() {
   uint8_t n = 0;
-  for (int i = 0; i < MAX_CLIENTS; i++) {
+  lockStats();
+  for (int i = 0; i < clientCapacity; i++) {
     if (clients[i].active && clients[i].lastTimeSyncMs > 0) n++;
   }
+  unlockStats();
   return n;
 }
 
 uint32_t getMostRecentClientTimeSyncMs() {
   uint32_t latest = 0;
-  for (int i = 0; i < MAX_CLIENTS; i++) {
+  lockStats();
+  for (int i = 0; i < clientCapacity; i++) {
     if (clients[i].active && clients[i].lastTimeSyncMs > latest) {
       latest = clients[i].lastTimeSyncMs;
     }
   }
+  unlockStats();
   return latest;
 }
+
+// Clock report from a keyframe. Drift is the offset change since the first
+// report after the clock was last set, once the two are far enough apart for
+// one-second readings to mean something.
+void recordClientClock(uint8_t clientId, bool synced, int32_t offsetS) {
+  lockStats();
+  ClientInfo* c = getClientInfo(clientId);
+  if (c == NULL) {
+    unlockStats();
+    return;
+  }
+  ClientClock& clock = c->clock;
+  const uint32_t now = millis();
+  clock.reportMs = now;
+  clock.offsetS = offsetS;
+  clock.synced = synced;
+  if (!synced) {
+    clock.refMs = 0;
+  } else if (clock.refMs == 0) {
+    clock.refMs = now;
+    clock.refOffsetS = offsetS;
+  } else {
+    const uint32_t spanMs = now - clock.refMs;
+    if (spanMs >= CLOCK_DRIFT_MIN_SPAN_MS) {
+      clock.driftPpm = (int32_t)((int64_t)(offsetS - clock.refOffsetS) * 1000000000LL / spanMs);
+      clock.driftValid = true;
+    }
+  }
+  unlockStats();
+}
+
+void resetClientClockReference(uint8_t clientId) {
+  lockStats();
+  ClientInfo* c = getClientInfo(clientId);
+  if (c != NULL) {
+    c->clock.refMs = 0;
+  }
+  unlockStats();
+}
+
+void resetAllClientClockReferences() {
+  lockStats();
+  for (int i = 0; i < clientCapacity; i++) {
+    clients[i].clock.refMs = 0;
+  }
+  unlockStats();
+}
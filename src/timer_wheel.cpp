@@ -0,0 +1,303 @@
+/**
+ * @file timer_wheel.cpp
+ * @brief Hierarchical timer wheel (cascading, 4 x 64 slots)
+ * @version 1.0.0
+ * @date 2026-10-16
+ */
+
+#include "timer_wheel.h"
+
+// Global instance
+TimerWheel timerWheel;
+
+static const uint32_t lagBoundsMs[TIMER_LAG_BUCKETS - 1] = TIMER_LAG_BOUNDS_MS;
+
+// Ticks covered by one slot at each level, and by the whole wheel
+static inline uint32_t levelSpan(uint8_t level) {
+    return 1UL << (TIMER_WHEEL_SLOT_BITS * level);
+}
+static const uint32_t WHEEL_MAX_DELTA = (1UL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+void TimerWheel::begin() {
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    if (!lock(portMAX_DELAY)) {
+        return;
+    }
+    if (armedCount == 0) {
+        tickStartMs = millis();
+    }
+    unlock();
+}
+
+// Place a node by its distance from currentTick. Called with the lock held.
+void TimerWheel::link(TimerNode* node) {
+    uint32_t delta = node->expiresTick - currentTick;
+    uint32_t placeTick = node->expiresTick;
+    if (delta > WHEEL_MAX_DELTA) {
+        // Beyond the wheel: park in the furthest slot, re-placed when it cascades
+        delta = WHEEL_MAX_DELTA;
+        placeTick = currentTick + WHEEL_MAX_DELTA;
+    }
+
+    uint8_t level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= levelSpan(level + 1)) {
+        level++;
+    }
+    uint8_t slot = (placeTick >> (TIMER_WHEEL_SLOT_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+
+    node->level = level;
+    node->slot = slot;
+    node->prev = nullptr;
+    node->next = slots[level][slot];
+    if (node->next != nullptr) {
+        node->next->prev = node;
+    }
+    slots[level][slot] = node;
+}
+
+void TimerWheel::unlink(TimerNode* node) {
+    if (node->prev != nullptr) {
+        node->prev->next = node->next;
+    } else {
+        slots[node->level][node->slot] = node->next;
+    }
+    if (node->next != nullptr) {
+        node->next->prev = node->prev;
+    }
+    node->next = nullptr;
+    node->prev = nullptr;
+}
+
+// Move every node of a higher-level slot down to where it now belongs
+void TimerWheel::cascade(uint8_t level, uint8_t slot) {
+    TimerNode* node = slots[level][slot];
+    slots[level][slot] = nullptr;
+    while (node != nullptr) {
+        TimerNode* next = node->next;
+        link(node);
+        node = next;
+    }
+}
+
+bool TimerWheel::schedule(TimerNode* node, uint32_t delayMs, TimerCallback callback, void* context, uint32_t periodMs) {
+    if (node == nullptr || callback == nullptr) {
+        return false;
+    }
+    // Critical sections are O(1) apart from a cascade, so waiting is bounded;
+    // failing here would silently drop an ACK or alert deadline
+    lock(portMAX_DELAY);
+
+    if (node->state == TIMER_ARMED) {
+        unlink(node);
+    } else if (node->state == TIMER_IDLE) {
+        armedCount++;
+    }
+    // A FIRING node is already off the wheel; re-arming it skips the pending callback
+
+    const uint32_t now = millis();
+    uint32_t ticks = ((now - tickStartMs) + delayMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    node->expiresTick = currentTick + (ticks == 0 ? 1 : ticks);
+    node->dueMs = now + delayMs;
+    node->periodMs = periodMs;
+    node->callback = callback;
+    node->context = context;
+    node->state = TIMER_ARMED;
+    link(node);
+
+    unlock();
+    return true;
+}
+
+bool TimerWheel::cancel(TimerNode* node) {
+    if (node == nullptr) {
+        return false;
+    }
+    lock(portMAX_DELAY);
+    bool wasArmed = (node->state != TIMER_IDLE);
+    if (node->state == TIMER_ARMED) {
+        unlink(node);
+    }
+    if (wasArmed) {
+        node->state = TIMER_IDLE;
+        armedCount--;
+    }
+    unlock();
+    return wasArmed;
+}
+
+void TimerWheel::recordLag(uint32_t lagMs) {
+    fired++;
+    lagLastMs = lagMs;
+    lagTotalMs += lagMs;
+    if (lagMs > lagMaxMs) {
+        lagMaxMs = lagMs;
+    }
+    uint8_t bucket = 0;
+    while (bucket < TIMER_LAG_BUCKETS - 1 && lagMs > lagBoundsMs[bucket]) {
+        bucket++;
+    }
+    lagHistogram[bucket]++;
+}
+
+uint8_t TimerWheel::runDue() {
+    TimerNode* batch[TIMER_WHEEL_BATCH];
+    uint8_t count = 0;
+
+    if (!lock(0)) {
+        return 0;  // Someone is arming a timer; catch up next pass
+    }
+    passes++;
+
+    const uint32_t now = millis();
+    uint32_t elapsed = (now - tickStartMs) / TIMER_WHEEL_TICK_MS;
+    if (armedCount == 0) {
+        // Nothing to cascade or fire: jump straight to now
+        currentTick += elapsed;
+        tickStartMs += elapsed * TIMER_WHEEL_TICK_MS;
+        elapsed = 0;
+    }
+
+    while (elapsed > 0) {
+        // Cascaded nodes are placed relative to the tick being run, so one
+        // due on this tick lands in the level-0 slot drained below
+        const uint32_t tick = ++currentTick;
+        const uint8_t index = tick & (TIMER_WHEEL_SLOTS - 1);
+
+        // Entering a new lap of a level pulls the matching slot of the level above down
+        if (index == 0) {
+            for (uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                uint8_t slot = (tick >> (TIMER_WHEEL_SLOT_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+                cascade(level, slot);
+                if (slot != 0) {
+                    break;
+                }
+            }
+        }
+
+        TimerNode* node = slots[0][index];
+        while (node != nullptr && count < TIMER_WHEEL_BATCH) {
+            TimerNode* next = node->next;
+            unlink(node);
+            node->state = TIMER_FIRING;
+            batch[count++] = node;
+            node = next;
+        }
+        if (node != nullptr) {
+            currentTick--;  // Batch full; the rest of this tick runs next pass
+            break;
+        }
+
+        tickStartMs += TIMER_WHEEL_TICK_MS;
+        elapsed--;
+    }
+
+    if (count > 0) {
+        busyPasses++;
+    }
+    unlock();
+
+    uint8_t ran = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        TimerNode* node = batch[i];
+        lock(portMAX_DELAY);  // Skipping would strand the node in TIMER_FIRING
+        if (node->state != TIMER_FIRING) {
+            unlock();  // Cancelled or re-armed since it was collected
+            continue;
+        }
+
+        const uint32_t firedMs = millis();
+        const int32_t late = (int32_t)(firedMs - node->dueMs);
+        recordLag(late > 0 ? (uint32_t)late : 0);
+
+        TimerCallback callback = node->callback;
+        void* context = node->context;
+        if (node->periodMs > 0) {
+            // Re-arm from the scheduled time so the period does not drift;
+            // runs the loop already missed are dropped, not replayed
+            uint32_t nextDue = node->dueMs + node->periodMs;
+            if ((int32_t)(firedMs - nextDue) >= 0) {
+                uint32_t missed = (firedMs - nextDue) / node->periodMs + 1;
+                skipped += missed;
+                nextDue += missed * node->periodMs;
+            }
+            uint32_t ticks = ((firedMs - tickStartMs) + (nextDue - firedMs) + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+            node->expiresTick = currentTick + (ticks == 0 ? 1 : ticks);
+            node->dueMs = nextDue;
+            node->state = TIMER_ARMED;
+            link(node);
+        } else {
+            node->state = TIMER_IDLE;
+            armedCount--;
+        }
+        unlock();
+
+        callback(node, context);
+        ran++;
+    }
+    return ran;
+}
+
+uint32_t TimerWheel::msUntilNext(uint32_t limitMs) {
+    if (!lock(pdMS_TO_TICKS(5))) {
+        return 0;
+    }
+    if (armedCount == 0) {
+        unlock();
+        return limitMs;
+    }
+
+    // The first occupied slot after the current position on each level holds
+    // that level's earliest deadline
+    bool found = false;
+    uint32_t nearest = 0;
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        const uint8_t shift = TIMER_WHEEL_SLOT_BITS * level;
+        const uint8_t position = (currentTick >> shift) & (TIMER_WHEEL_SLOTS - 1);
+        for (uint8_t step = 1; step <= TIMER_WHEEL_SLOTS; step++) {
+            TimerNode* node = slots[level][(position + step) & (TIMER_WHEEL_SLOTS - 1)];
+            if (node == nullptr) {
+                continue;
+            }
+            for (; node != nullptr; node = node->next) {
+                uint32_t delta = node->expiresTick - currentTick;
+                if (!found || delta < nearest) {
+                    nearest = delta;
+                    found = true;
+                }
+            }
+            break;
+        }
+    }
+
+    uint32_t result = limitMs;
+    if (found) {
+        const uint32_t sinceTick = millis() - tickStartMs;
+        const uint64_t untilMs = (uint64_t)nearest * TIMER_WHEEL_TICK_MS;
+        if (untilMs <= sinceTick) {
+            result = 0;
+        } else if (untilMs - sinceTick < limitMs) {
+            result = (uint32_t)(untilMs - sinceTick);
+        }
+    }
+    unlock();
+    return result;
+}
+
+void TimerWheel::getStats(TimerWheelStats& out) {
+    memset(&out, 0, sizeof(out));
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;
+    }
+    out.armed = armedCount;
+    out.fired = fired;
+    out.skipped = skipped;
+    out.passes = passes;
+    out.busyPasses = busyPasses;
+    out.lagLastMs = lagLastMs;
+    out.lagMaxMs = lagMaxMs;
+    out.lagAvgMs = fired ? (uint32_t)(lagTotalMs / fired) : 0;
+    memcpy(out.lagHistogram, lagHistogram, sizeof(lagHistogram));
+    unlock();
+}
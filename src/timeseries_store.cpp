@@ -0,0 +1,762 @@
+/**
+ * @file timeseries_store.cpp
+ * @brief Append-only sensor history log on LittleFS
+ * @version 1.0.0
+ * @date 2026-10-16
+ */
+
+#include "timeseries_store.h"
+#include "crc16.h"
+#include "sensor_interface.h"
+#include "logger.h"
+#include <LittleFS.h>
+#include <time.h>
+#include <vector>
+
+// Global instance
+TimeSeriesStore timeSeriesStore;
+
+#define TS_INDEX_PATH       TS_DIR "/index.bin"
+#define TS_INDEX_TMP_PATH   TS_DIR "/index.tmp"
+#define TS_INDEX_MAGIC      0x31495354UL    // "TSI1"
+
+struct __attribute__((packed)) TimeSeriesIndexHeader {
+    uint32_t magic;
+    uint16_t entrySize;
+    uint16_t count;
+    uint32_t nextSeq;
+};
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static size_t recordSize(uint8_t level) {
+    return (level == TS_LEVEL_RAW) ? sizeof(TimeSeriesSample) : sizeof(TimeSeriesPoint);
+}
+
+static uint16_t blockCapacity(uint8_t level) {
+    return (uint16_t)(TS_BLOCK_BYTES / recordSize(level));
+}
+
+// r<seq>.dat for raw blocks, h<seq>.dat for hourly rollups
+static void blockPath(char* out, size_t outSize, uint8_t level, uint32_t seq) {
+    snprintf(out, outSize, "%s/%c%lu.dat", TS_DIR, (level == TS_LEVEL_RAW) ? 'r' : 'h', (unsigned long)seq);
+}
+
+static TimeSeriesPoint toPoint(const TimeSeriesSample& sample) {
+    TimeSeriesPoint point;
+    point.timestamp = sample.timestamp;
+    point.clientId = sample.clientId;
+    point.channel = sample.channel;
+    point.type = sample.type;
+    point.flags = sample.flags;
+    point.samples = 1;
+    point.mean = sample.value;
+    point.minValue = sample.value;
+    point.maxValue = sample.value;
+    return point;
+}
+
+// Both record layouts start with timestamp and clientId
+static void noteRecord(TimeSeriesBlockInfo& info, const uint8_t* record) {
+    uint32_t timestamp;
+    memcpy(&timestamp, record, sizeof(timestamp));
+    uint8_t clientId = record[sizeof(timestamp)];
+    if (info.firstTime == 0 || timestamp < info.firstTime) {
+        info.firstTime = timestamp;
+    }
+    if (timestamp > info.lastTime) {
+        info.lastTime = timestamp;
+    }
+    info.clientMask[clientId >> 5] |= (1UL << (clientId & 31));
+}
+
+static bool hasClient(const TimeSeriesBlockInfo& info, uint8_t clientId) {
+    return (info.clientMask[clientId >> 5] & (1UL << (clientId & 31))) != 0;
+}
+
+// ============================================================================
+// CURSOR
+// ============================================================================
+
+bool TimeSeriesCursor::fillChunk() {
+    const uint8_t level = blockLevel[blockPos];
+    const size_t recSize = recordSize(level);
+    char path[32];
+    blockPath(path, sizeof(path), level, blockSeq[blockPos]);
+
+    // Open per chunk: the block may be compacted away between two reads
+    File f = LittleFS.open(path, FILE_READ);
+    if (!f) {
+        return false;
+    }
+    size_t n = 0;
+    if (f.seek(fileOffset)) {
+        n = f.read(chunk, TS_CURSOR_CHUNK);
+    }
+    f.close();
+
+    n -= n % recSize;
+    if (n == 0) {
+        return false;
+    }
+    chunkLen = (uint16_t)n;
+    chunkPos = 0;
+    fileOffset += n;
+    return true;
+}
+
+bool TimeSeriesCursor::next(TimeSeriesPoint& out) {
+    while (true) {
+        if (chunkPos < chunkLen) {
+            const uint8_t* record = chunk + chunkPos;
+            if (blockLevel[blockPos] == TS_LEVEL_RAW) {
+                TimeSeriesSample sample;
+                memcpy(&sample, record, sizeof(sample));
+                chunkPos += sizeof(sample);
+                out = toPoint(sample);
+            } else {
+                memcpy(&out, record, sizeof(out));
+                chunkPos += sizeof(out);
+            }
+            if (out.clientId == clientId && out.timestamp >= fromTime && out.timestamp <= toTime) {
+                return true;
+            }
+            continue;
+        }
+
+        if (blockPos < blockCount) {
+            if (!fillChunk()) {
+                blockPos++;
+                fileOffset = 0;
+                chunkLen = 0;
+                chunkPos = 0;
+            }
+            continue;
+        }
+
+        // Readings not yet flushed (already filtered when the cursor was opened)
+        if (pendingPos < pendingCount) {
+            out = toPoint(pending[pendingPos++]);
+            return true;
+        }
+        return false;
+    }
+}
+
+// ============================================================================
+// STARTUP AND INDEX
+// ============================================================================
+
+bool TimeSeriesStore::begin() {
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+
+    if (!LittleFS.begin(true)) {
+        LOGE("HIST", "LittleFS mount failed - history kept in RAM only");
+        return false;
+    }
+    if (!LittleFS.exists(TS_DIR)) {
+        LittleFS.mkdir(TS_DIR);
+    }
+
+    if (!loadIndex()) {
+        LOGW("HIST", "History index missing or damaged - rebuilding from block files");
+        blockCount = 0;
+        nextSeq = 1;
+    }
+    reconcileIndex();
+    saveIndex();
+
+    ready = true;
+    timerWheel.schedule(&flushTimer, TS_FLUSH_INTERVAL_MS, onFlushDue, this, TS_FLUSH_INTERVAL_MS);
+    timerWheel.schedule(&compactTimer, TS_COMPACT_INTERVAL_MS, onCompactDue, this, TS_COMPACT_INTERVAL_MS);
+
+    uint32_t bytes = 0;
+    for (uint8_t i = 0; i < blockCount; i++) {
+        bytes += blocks[i].records * recordSize(blocks[i].level);
+    }
+    LOGI("HIST", "History store: %u blocks, %lu bytes (budget %lu)",
+         blockCount, (unsigned long)bytes, (unsigned long)TS_MAX_BLOCKS * TS_BLOCK_BYTES);
+    return true;
+}
+
+bool TimeSeriesStore::loadIndex() {
+    File f = LittleFS.open(TS_INDEX_PATH, FILE_READ);
+    if (!f) {
+        return false;
+    }
+
+    TimeSeriesIndexHeader header;
+    bool ok = f.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == TS_INDEX_MAGIC &&
+              header.entrySize == sizeof(TimeSeriesBlockInfo) &&
+              header.count <= TS_MAX_BLOCKS &&
+              f.size() == sizeof(header) + header.count * sizeof(TimeSeriesBlockInfo) + sizeof(uint16_t);
+    if (ok) {
+        const size_t entriesSize = header.count * sizeof(TimeSeriesBlockInfo);
+        uint16_t storedCrc = 0;
+        ok = f.read((uint8_t*)blocks, entriesSize) == entriesSize &&
+             f.read((uint8_t*)&storedCrc, sizeof(storedCrc)) == sizeof(storedCrc);
+        uint16_t crc = crc16CcittSlice4((const uint8_t*)&header, sizeof(header));
+        crc = crc16CcittSlice4((const uint8_t*)blocks, entriesSize, crc);
+        ok = ok && (crc == storedCrc);
+    }
+    f.close();
+
+    if (!ok) {
+        return false;
+    }
+    blockCount = (uint8_t)header.count;
+    nextSeq = header.nextSeq;
+    return true;
+}
+
+bool TimeSeriesStore::saveIndex() {
+    TimeSeriesIndexHeader header;
+    header.magic = TS_INDEX_MAGIC;
+    header.entrySize = sizeof(TimeSeriesBlockInfo);
+    header.count = blockCount;
+    header.nextSeq = nextSeq;
+
+    const size_t entriesSize = blockCount * sizeof(TimeSeriesBlockInfo);
+    uint16_t crc = crc16CcittSlice4((const uint8_t*)&header, sizeof(header));
+    crc = crc16CcittSlice4((const uint8_t*)blocks, entriesSize, crc);
+
+    // Write a temporary file and rename, so a reset never leaves half an index
+    File f = LittleFS.open(TS_INDEX_TMP_PATH, FILE_WRITE);
+    if (!f) {
+        LOGE("HIST", "Cannot write history index");
+        return false;
+    }
+    bool ok = f.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              f.write((const uint8_t*)blocks, entriesSize) == entriesSize &&
+              f.write((const uint8_t*)&crc, sizeof(crc)) == sizeof(crc);
+    f.close();
+
+    if (ok && !LittleFS.rename(TS_INDEX_TMP_PATH, TS_INDEX_PATH)) {
+        LittleFS.remove(TS_INDEX_PATH);
+        ok = LittleFS.rename(TS_INDEX_TMP_PATH, TS_INDEX_PATH);
+    }
+    if (ok) {
+        indexDirty = false;
+    }
+    return ok;
+}
+
+void TimeSeriesStore::scanBlock(TimeSeriesBlockInfo& info, size_t fileSize) {
+    const size_t recSize = recordSize(info.level);
+    const uint16_t capacity = blockCapacity(info.level);
+
+    info.firstTime = 0;
+    info.lastTime = 0;
+    memset(info.clientMask, 0, sizeof(info.clientMask));
+    info.records = (uint16_t)min(fileSize / recSize, (size_t)capacity);
+    // A torn trailing record would misalign later appends; stop writing to this block
+    info.sealed = (info.records >= capacity || (fileSize % recSize) != 0) ? 1 : 0;
+
+    char path[32];
+    blockPath(path, sizeof(path), info.level, info.seq);
+    File f = LittleFS.open(path, FILE_READ);
+    if (!f) {
+        return;
+    }
+    uint8_t buffer[TS_CURSOR_CHUNK];
+    size_t remaining = info.records * recSize;
+    while (remaining > 0) {
+        size_t n = f.read(buffer, min(remaining, sizeof(buffer)));
+        n -= n % recSize;
+        if (n == 0) {
+            break;
+        }
+        for (size_t offset = 0; offset < n; offset += recSize) {
+            noteRecord(info, buffer + offset);
+        }
+        remaining -= n;
+    }
+    f.close();
+}
+
+void TimeSeriesStore::reconcileIndex() {
+    // Drop entries whose file is gone; rescan blocks with appends made after the last index save
+    for (int i = 0; i < blockCount; i++) {
+        char path[32];
+        blockPath(path, sizeof(path), blocks[i].level, blocks[i].seq);
+        File f = LittleFS.open(path, FILE_READ);
+        if (!f) {
+            removeBlock(i);
+            i--;
+            continue;
+        }
+        size_t size = f.size();
+        f.close();
+        if (size != blocks[i].records * recordSize(blocks[i].level)) {
+            scanBlock(blocks[i], size);
+        }
+    }
+
+    // Adopt block files the index does not know about (created after the last save)
+    File dir = LittleFS.open(TS_DIR);
+    if (dir && dir.isDirectory()) {
+        File f = dir.openNextFile();
+        while (f) {
+            const char* name = f.name();
+            const char* slash = strrchr(name, '/');
+            const char* base = slash ? slash + 1 : name;
+            char* end = nullptr;
+            uint32_t seq = 0;
+            uint8_t level = TS_LEVEL_RAW;
+            bool isBlock = (base[0] == 'r' || base[0] == 'h') && isdigit((unsigned char)base[1]);
+            if (isBlock) {
+                level = (base[0] == 'r') ? TS_LEVEL_RAW : TS_LEVEL_HOURLY;
+                seq = strtoul(base + 1, &end, 10);
+                isBlock = (strcmp(end, ".dat") == 0);
+            }
+            size_t size = f.size();
+            f.close();
+
+            if (isBlock) {
+                bool known = false;
+                for (uint8_t i = 0; i < blockCount && !known; i++) {
+                    known = (blocks[i].seq == seq);
+                }
+                if (!known && blockCount < TS_MAX_BLOCKS) {
+                    TimeSeriesBlockInfo& info = blocks[blockCount++];
+                    memset(&info, 0, sizeof(info));
+                    info.seq = seq;
+                    info.level = level;
+                    scanBlock(info, size);
+                } else if (!known) {
+                    char path[32];
+                    blockPath(path, sizeof(path), level, seq);
+                    LittleFS.remove(path);
+                }
+            }
+            f = dir.openNextFile();
+        }
+        dir.close();
+    }
+
+    // Keep the index in seq order and continue numbering after the newest block
+    for (uint8_t i = 1; i < blockCount; i++) {
+        TimeSeriesBlockInfo entry = blocks[i];
+        int j = i - 1;
+        while (j >= 0 && blocks[j].seq > entry.seq) {
+            blocks[j + 1] = blocks[j];
+            j--;
+        }
+        blocks[j + 1] = entry;
+    }
+    for (uint8_t i = 0; i < blockCount; i++) {
+        if (blocks[i].seq >= nextSeq) {
+            nextSeq = blocks[i].seq + 1;
+        }
+    }
+}
+
+// ============================================================================
+// WRITE PATH
+// ============================================================================
+
+void TimeSeriesStore::append(const TimeSeriesSample& sample) {
+    if (!ready) {
+        return;
+    }
+    // Called from the RX task: never wait on a flush in progress for long
+    if (!lock(pdMS_TO_TICKS(10))) {
+        dropped++;
+        return;
+    }
+    if (pendingCount < TS_WRITE_BUFFER) {
+        pending[pendingCount++] = sample;
+        appended++;
+    } else {
+        dropped++;
+    }
+    const bool nearlyFull = (pendingCount == (TS_WRITE_BUFFER * 3) / 4);
+    unlock();
+
+    if (nearlyFull) {
+        // Pull the next flush forward to the main loop's next pass
+        timerWheel.schedule(&flushTimer, 0, onFlushDue, this, TS_FLUSH_INTERVAL_MS);
+    }
+}
+
+void TimeSeriesStore::appendClient(uint8_t clientId, uint8_t batteryPercent, int16_t rssi, bool charging) {
+    time_t now = time(nullptr);
+    if (now < (time_t)TS_MIN_VALID_EPOCH) {
+        return;
+    }
+
+    TimeSeriesSample sample;
+    sample.timestamp = (uint32_t)now;
+    sample.clientId = clientId;
+    sample.channel = TS_CHANNEL_BATTERY;
+    sample.type = VALUE_BATTERY;
+    sample.flags = charging ? TS_FLAG_CHARGING : 0;
+    sample.value = batteryPercent;
+    append(sample);
+
+    sample.channel = TS_CHANNEL_RSSI;
+    sample.type = VALUE_SIGNAL_STRENGTH;
+    sample.flags = 0;
+    sample.value = rssi;
+    append(sample);
+}
+
+void TimeSeriesStore::appendSensor(uint8_t clientId, uint8_t sensorIndex, uint8_t type, float value) {
+    time_t now = time(nullptr);
+    if (now < (time_t)TS_MIN_VALID_EPOCH || sensorIndex >= TS_CHANNEL_BATTERY) {
+        return;
+    }
+
+    TimeSeriesSample sample;
+    sample.timestamp = (uint32_t)now;
+    sample.clientId = clientId;
+    sample.channel = sensorIndex;
+    sample.type = type;
+    sample.flags = 0;
+    sample.value = value;
+    append(sample);
+}
+
+int TimeSeriesStore::findActiveBlock(uint8_t level) {
+    for (int i = blockCount - 1; i >= 0; i--) {
+        if (blocks[i].level == level && !blocks[i].sealed) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Caller holds the lock
+int TimeSeriesStore::createBlock(uint8_t level) {
+    if (blockCount >= TS_MAX_BLOCKS && !evictOldestBlock()) {
+        return -1;
+    }
+    // Leave room for the logger and web assets sharing the partition
+    while (LittleFS.totalBytes() - LittleFS.usedBytes() < 2 * TS_BLOCK_BYTES) {
+        if (!evictOldestBlock()) {
+            return -1;  // Nothing of ours left to drop; the space is held by other files
+        }
+    }
+
+    TimeSeriesBlockInfo& info = blocks[blockCount];
+    memset(&info, 0, sizeof(info));
+    info.seq = nextSeq++;
+    info.level = level;
+    indexDirty = true;
+    return blockCount++;
+}
+
+// Caller holds the lock
+void TimeSeriesStore::removeBlock(int index) {
+    for (int i = index; i < blockCount - 1; i++) {
+        blocks[i] = blocks[i + 1];
+    }
+    blockCount--;
+    indexDirty = true;
+}
+
+// Caller holds the lock; returns false when there was nothing to evict
+bool TimeSeriesStore::evictOldestBlock() {
+    int oldest = -1;
+    for (int i = 0; i < blockCount; i++) {
+        if (blocks[i].records == 0 && !blocks[i].sealed) {
+            continue;   // Freshly created active block
+        }
+        if (oldest < 0 || blocks[i].firstTime < blocks[oldest].firstTime) {
+            oldest = i;
+        }
+    }
+    if (oldest < 0) {
+        return false;
+    }
+
+    char path[32];
+    blockPath(path, sizeof(path), blocks[oldest].level, blocks[oldest].seq);
+    LittleFS.remove(path);
+    LOGI("HIST", "History full - dropped block %s (%u records)", path, blocks[oldest].records);
+    removeBlock(oldest);
+    blocksEvicted++;
+    return true;
+}
+
+// Only the loop task changes the index; the lock protects it from concurrent queries
+bool TimeSeriesStore::appendRecords(uint8_t level, const uint8_t* records, size_t count) {
+    const size_t recSize = recordSize(level);
+    const uint16_t capacity = blockCapacity(level);
+
+    while (count > 0) {
+        if (!lock(portMAX_DELAY)) {
+            return false;
+        }
+        int index = findActiveBlock(level);
+        if (index < 0) {
+            index = createBlock(level);
+        }
+        if (index < 0) {
+            unlock();
+            return false;
+        }
+        const uint32_t seq = blocks[index].seq;
+        const size_t n = min(count, (size_t)(capacity - blocks[index].records));
+        unlock();
+
+        char path[32];
+        blockPath(path, sizeof(path), level, seq);
+        File f = LittleFS.open(path, FILE_APPEND);
+        size_t written = 0;
+        if (f) {
+            written = f.write(records, n * recSize);
+            f.close();
+        }
+
+        lock(portMAX_DELAY);
+        TimeSeriesBlockInfo& info = blocks[index];
+        const size_t whole = written / recSize;
+        for (size_t i = 0; i < whole; i++) {
+            noteRecord(info, records + i * recSize);
+        }
+        info.records += whole;
+        if (written != n * recSize && info.records == 0) {
+            // Nothing usable landed; drop the block rather than leave an empty sealed one behind
+            LittleFS.remove(path);
+            removeBlock(index);
+        } else if (written != n * recSize || info.records >= capacity) {
+            info.sealed = 1;
+            indexDirty = true;
+        }
+        unlock();
+
+        if (written != n * recSize) {
+            LOGE("HIST", "Short write to %s (%u of %u bytes)", path, (unsigned)written, (unsigned)(n * recSize));
+            return false;
+        }
+        records += n * recSize;
+        count -= n;
+    }
+    return true;
+}
+
+void TimeSeriesStore::flush() {
+    if (!ready) {
+        return;
+    }
+
+    TimeSeriesSample batch[TS_WRITE_BUFFER];
+    uint8_t count = 0;
+    if (lock(pdMS_TO_TICKS(50))) {
+        count = pendingCount;
+        memcpy(batch, pending, count * sizeof(TimeSeriesSample));
+        pendingCount = 0;
+        unlock();
+    }
+    if (count == 0) {
+        return;
+    }
+
+    if (appendRecords(TS_LEVEL_RAW, (const uint8_t*)batch, count)) {
+        flushes++;
+    } else {
+        dropped += count;
+    }
+    // The active block's record count is recovered from its file size at boot,
+    // so the index only needs rewriting when blocks are created, sealed or removed
+    if (indexDirty) {
+        saveIndex();
+    }
+}
+
+// ============================================================================
+// COMPACTION
+// ============================================================================
+
+void TimeSeriesStore::compact() {
+    time_t now = time(nullptr);
+    if (now < (time_t)TS_MIN_VALID_EPOCH) {
+        return;
+    }
+    const uint32_t cutoff = (uint32_t)now - TS_RAW_RETENTION_SEC;
+
+    // Oldest sealed raw blocks past retention; any sealed raw block when space runs low
+    uint32_t seqs[TS_COMPACT_BATCH];
+    uint8_t count = 0;
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;
+    }
+    const bool lowSpace = blockCount >= TS_MAX_BLOCKS - 2;
+    for (uint8_t i = 0; i < blockCount && count < TS_COMPACT_BATCH; i++) {
+        const TimeSeriesBlockInfo& info = blocks[i];
+        if (info.level == TS_LEVEL_RAW && info.sealed && (info.lastTime < cutoff || lowSpace)) {
+            seqs[count++] = info.seq;
+        }
+    }
+    unlock();
+    if (count == 0) {
+        return;
+    }
+
+    // Samples within a block are in arrival order, so open buckets are always
+    // near the end of the list and the backward search stays short
+    std::vector<TimeSeriesPoint> rollups;
+    uint32_t merged = 0;
+    for (uint8_t b = 0; b < count; b++) {
+        char path[32];
+        blockPath(path, sizeof(path), TS_LEVEL_RAW, seqs[b]);
+        File f = LittleFS.open(path, FILE_READ);
+        if (!f) {
+            continue;
+        }
+        TimeSeriesSample samples[TS_CURSOR_CHUNK / sizeof(TimeSeriesSample)];
+        size_t n;
+        while ((n = f.read((uint8_t*)samples, sizeof(samples)) / sizeof(TimeSeriesSample)) > 0) {
+            for (size_t s = 0; s < n; s++) {
+                const TimeSeriesSample& sample = samples[s];
+                const float value = sample.value;
+                const uint32_t bucket = sample.timestamp - (sample.timestamp % TS_ROLLUP_SEC);
+                TimeSeriesPoint* point = nullptr;
+                for (size_t j = rollups.size(); j-- > 0 && rollups[j].timestamp >= bucket;) {
+                    if (rollups[j].timestamp == bucket && rollups[j].clientId == sample.clientId &&
+                        rollups[j].channel == sample.channel) {
+                        point = &rollups[j];
+                        break;
+                    }
+                }
+                if (point == nullptr) {
+                    rollups.push_back(toPoint(sample));
+                    rollups.back().timestamp = bucket;
+                } else if (point->samples < 0xFFFF) {
+                    point->samples++;
+                    point->mean += (value - point->mean) / point->samples;
+                    if (value < point->minValue) point->minValue = value;
+                    if (value > point->maxValue) point->maxValue = value;
+                    point->flags |= sample.flags;
+                }
+                merged++;
+            }
+        }
+        f.close();
+    }
+
+    // Write the rollups before deleting the sources: a reset in between
+    // duplicates an hour rather than losing it
+    if (!rollups.empty() &&
+        !appendRecords(TS_LEVEL_HOURLY, (const uint8_t*)rollups.data(), rollups.size())) {
+        return;
+    }
+
+    lock(portMAX_DELAY);
+    for (uint8_t b = 0; b < count; b++) {
+        for (int i = 0; i < blockCount; i++) {
+            if (blocks[i].seq == seqs[b] && blocks[i].level == TS_LEVEL_RAW) {
+                char path[32];
+                blockPath(path, sizeof(path), TS_LEVEL_RAW, seqs[b]);
+                LittleFS.remove(path);
+                removeBlock(i);
+                break;
+            }
+        }
+    }
+    compactions++;
+    unlock();
+    saveIndex();
+
+    LOGI("HIST", "Compacted %u raw blocks: %lu readings -> %u hourly rollups",
+         count, (unsigned long)merged, (unsigned)rollups.size());
+}
+
+void TimeSeriesStore::onFlushDue(TimerNode* /*node*/, void* context) {
+    static_cast<TimeSeriesStore*>(context)->flush();
+}
+
+void TimeSeriesStore::onCompactDue(TimerNode* /*node*/, void* context) {
+    static_cast<TimeSeriesStore*>(context)->compact();
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+bool TimeSeriesStore::openCursor(uint8_t clientId, uint32_t fromTime, uint32_t toTime, TimeSeriesCursor& cursor) {
+    cursor.clientId = clientId;
+    cursor.fromTime = fromTime;
+    cursor.toTime = toTime;
+    cursor.blockCount = 0;
+    cursor.blockPos = 0;
+    cursor.fileOffset = 0;
+    cursor.chunkLen = 0;
+    cursor.chunkPos = 0;
+    cursor.pendingCount = 0;
+    cursor.pendingPos = 0;
+
+    if (!ready || !lock(pdMS_TO_TICKS(100))) {
+        return false;
+    }
+
+    // Blocks that may hold the client in range, oldest first (rollups sort before raw)
+    uint8_t order[TS_MAX_BLOCKS];
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < blockCount; i++) {
+        const TimeSeriesBlockInfo& info = blocks[i];
+        if (info.records == 0 || !hasClient(info, clientId) ||
+            info.lastTime < fromTime || info.firstTime > toTime) {
+            continue;
+        }
+        int j = count - 1;
+        while (j >= 0 && blocks[order[j]].firstTime > info.firstTime) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = i;
+        count++;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        cursor.blockSeq[i] = blocks[order[i]].seq;
+        cursor.blockLevel[i] = blocks[order[i]].level;
+    }
+    cursor.blockCount = count;
+
+    for (uint8_t i = 0; i < pendingCount; i++) {
+        const TimeSeriesSample& sample = pending[i];
+        if (sample.clientId == clientId && sample.timestamp >= fromTime && sample.timestamp <= toTime) {
+            cursor.pending[cursor.pendingCount++] = sample;
+        }
+    }
+    unlock();
+
+    return cursor.blockCount > 0 || cursor.pendingCount > 0;
+}
+
+void TimeSeriesStore::getStats(TimeSeriesStats& out) {
+    memset(&out, 0, sizeof(out));
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;
+    }
+    out.ready = ready;
+    out.blocks = blockCount;
+    for (uint8_t i = 0; i < blockCount; i++) {
+        const TimeSeriesBlockInfo& info = blocks[i];
+        if (info.level == TS_LEVEL_RAW) {
+            out.rawBlocks++;
+        } else {
+            out.rollupBlocks++;
+        }
+        out.bytesUsed += info.records * recordSize(info.level);
+        if (info.records > 0 && (out.oldestTime == 0 || info.firstTime < out.oldestTime)) {
+            out.oldestTime = info.firstTime;
+        }
+        if (info.lastTime > out.newestTime) {
+            out.newestTime = info.lastTime;
+        }
+    }
+    out.pending = pendingCount;
+    out.appended = appended;
+    out.dropped = dropped;
+    out.flushes = flushes;
+    out.compactions = compactions;
+    out.blocksEvicted = blocksEvicted;
+    unlock();
+}
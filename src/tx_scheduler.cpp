@@ -0,0 +1,164 @@
+/**
+ * @file tx_scheduler.cpp
+ * @brief LoRa time-on-air calculator and token-bucket TX budget
+ * @version 1.0.0
+ * @date 2026-10-16
+ */
+
+#include "tx_scheduler.h"
+#include "logger.h"
+
+// Global instance
+TxScheduler txScheduler;
+
+// Share of the bucket each priority must leave untouched
+static const uint8_t reservePercent[TX_PRIORITY_COUNT] = {
+    0,      // ACK-critical may drain the bucket
+    25,     // Time sync
+    40,     // Unicast mesh traffic
+    50      // Broadcast ping
+};
+
+uint32_t loraTimeOnAirUs(const LoRaModemParams& params, size_t payloadBytes) {
+    const int32_t sf = params.spreadingFactor;
+    const uint64_t symbolUs = ((uint64_t)1000000 << sf) / params.bandwidthHz;
+    const int32_t de = (symbolUs >= 16000) ? 1 : 0;  // Low data rate optimisation
+
+    // Payload symbols: 8 + max(ceil((8PL - 4SF + 28 + 16CRC - 20IH) / (4(SF - 2DE))) * (CR + 4), 0)
+    int32_t num = 8 * (int32_t)payloadBytes - 4 * sf + 28 + (params.crcOn ? 16 : 0) - (params.implicitHeader ? 20 : 0);
+    int32_t den = 4 * (sf - 2 * de);
+    int32_t blocks = (num > 0) ? (num + den - 1) / den : 0;
+    uint32_t payloadSymbols = 8 + blocks * (params.codingRate + 4);
+
+    // Preamble: n + 4.25 symbols (kept in quarter symbols to stay integer)
+    uint64_t quarterSymbols = (uint64_t)params.preambleLength * 4 + 17 + (uint64_t)payloadSymbols * 4;
+    return (uint32_t)((quarterSymbols * symbolUs) / 4);
+}
+
+void TxScheduler::begin(const LoRaModemParams& modemParams, uint8_t dutyPercent) {
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    if (!lock(portMAX_DELAY)) {
+        return;
+    }
+
+    params = modemParams;
+    dutyCyclePercent = dutyPercent;
+    capacityUs = (uint64_t)TX_BUDGET_WINDOW_SEC * 1000000ULL * dutyCyclePercent / 100;
+    if (!started) {
+        tokensUs = capacityUs;  // Start with a full bucket
+        lastRefillMs = millis();
+        currentMinute = lastRefillMs / 60000;
+        started = true;
+    } else if (tokensUs > capacityUs) {
+        tokensUs = capacityUs;
+    }
+    unlock();
+
+    LOGI("TX", "Airtime budget: %d%% duty cycle, %lu ms burst; 10-byte frame = %lu us",
+         dutyCyclePercent, (unsigned long)(capacityUs / 1000), (unsigned long)loraTimeOnAirUs(params, 10));
+}
+
+uint32_t TxScheduler::timeOnAirUs(size_t payloadBytes) const {
+    return loraTimeOnAirUs(params, payloadBytes);
+}
+
+uint16_t TxScheduler::timeOnAirMs(size_t payloadBytes) const {
+    return (uint16_t)((loraTimeOnAirUs(params, payloadBytes) + 999) / 1000);
+}
+
+void TxScheduler::refill(uint32_t nowMs) {
+    uint32_t elapsedMs = nowMs - lastRefillMs;
+    lastRefillMs = nowMs;
+    tokensUs += (uint64_t)elapsedMs * 1000ULL * dutyCyclePercent / 100;
+    if (tokensUs > capacityUs) {
+        tokensUs = capacityUs;
+    }
+}
+
+void TxScheduler::rollMinutes(uint32_t nowMs) {
+    uint32_t minute = nowMs / 60000;
+    // Clear the slots of minutes that passed without a transmission
+    for (uint32_t m = currentMinute + 1; m <= minute && m <= currentMinute + 60; m++) {
+        memset(minuteUsedMs[m % 60], 0, sizeof(minuteUsedMs[0]));
+    }
+    currentMinute = minute;
+}
+
+bool TxScheduler::reserve(size_t payloadBytes, TxPriority priority) {
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return false;
+    }
+
+    const uint32_t nowMs = millis();
+    if (!started) {
+        capacityUs = (uint64_t)TX_BUDGET_WINDOW_SEC * 1000000ULL * dutyCyclePercent / 100;
+        tokensUs = capacityUs;
+        lastRefillMs = nowMs;
+        currentMinute = nowMs / 60000;
+        started = true;
+    }
+    refill(nowMs);
+    rollMinutes(nowMs);
+
+    const uint64_t costUs = loraTimeOnAirUs(params, payloadBytes);
+    const uint64_t floorUs = capacityUs * reservePercent[priority] / 100;
+    if (tokensUs < costUs + floorUs) {
+        deferred[priority]++;
+        unlock();
+        return false;
+    }
+
+    tokensUs -= costUs;
+    sent[priority]++;
+    minuteUsedMs[currentMinute % 60][priority] += (uint32_t)((costUs + 999) / 1000);
+    unlock();
+    return true;
+}
+
+void TxScheduler::refund(size_t payloadBytes, TxPriority priority) {
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;
+    }
+
+    const uint64_t costUs = loraTimeOnAirUs(params, payloadBytes);
+    tokensUs += costUs;
+    if (tokensUs > capacityUs) {
+        tokensUs = capacityUs;
+    }
+    if (sent[priority] > 0) {
+        sent[priority]--;
+    }
+    uint32_t& used = minuteUsedMs[currentMinute % 60][priority];
+    const uint32_t costMs = (uint32_t)((costUs + 999) / 1000);
+    used = (used > costMs) ? used - costMs : 0;
+    unlock();
+}
+
+void TxScheduler::getStats(TxBudgetStats& out) {
+    memset(&out, 0, sizeof(out));
+    if (!lock(pdMS_TO_TICKS(50))) {
+        return;
+    }
+
+    const uint32_t nowMs = millis();
+    if (started) {
+        refill(nowMs);
+        rollMinutes(nowMs);
+    }
+
+    out.dutyCyclePercent = dutyCyclePercent;
+    out.budgetPerHourMs = 3600UL * 1000UL * dutyCyclePercent / 100;
+    out.availableMs = (uint32_t)(tokensUs / 1000);
+    out.capacityMs = (uint32_t)(capacityUs / 1000);
+    for (int p = 0; p < TX_PRIORITY_COUNT; p++) {
+        out.sent[p] = sent[p];
+        out.deferred[p] = deferred[p];
+        for (int m = 0; m < 60; m++) {
+            out.usedLastHourByPriorityMs[p] += minuteUsedMs[m][p];
+        }
+        out.usedLastHourMs += out.usedLastHourByPriorityMs[p];
+    }
+    unlock();
+}
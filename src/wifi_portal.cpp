@@ -4,10 +4,16 @@
 #include "alerts.h"
 #include "security.h"
 #include "logger.h"
+#include "timer_wheel.h"
 #ifdef BASE_STATION
 #include "mqtt_client.h"
 #include "sensor_config.h"
 #include "remote_config.h"
+#include "lora_comm.h"
+#include "tx_scheduler.h"
+#include "timeseries_store.h"
+#include <memory>
+#include <time.h>
 #endif
 #include <AsyncWebSocket.h>
 #include <LittleFS.h>
@@ -33,6 +39,221 @@ struct LoRaRebootTracker {
     uint8_t totalSensors = 0;
 };
 static LoRaRebootTracker loraRebootTracker;
+
+// Reboot anyway if not every sensor has ACKed the new settings by then
+#define LORA_REBOOT_ACK_TIMEOUT_MS 20000
+static TimerNode loraRebootAckTimer;
+static void onLoRaRebootAckTimeout(TimerNode* node, void* context);
+extern void scheduleLoRaReboot(uint32_t delayMs);
+
+// Default point budget for /api/history (override with &points=N)
+#ifndef HISTORY_MAX_POINTS
+  #define HISTORY_MAX_POINTS 240
+#endif
+
+static_assert(ROLLUP_CHANNEL_BATTERY == TS_CHANNEL_BATTERY && ROLLUP_CHANNEL_RSSI == TS_CHANNEL_RSSI,
+              "RAM rollups and the flash store must number client series alike");
+
+// /api/history streaming: one JSON point per bucket, produced on demand as the
+// web server asks for the next chunk. Records come from the RAM rollups when
+// one of their tiers covers the window, otherwise from the flash store.
+struct HistoryStream {
+    TimeSeriesCursor cursor;
+    TimeSeriesPoint next;
+    bool haveNext = false;
+    bool first = true;
+    uint8_t sensorId = 0;
+    uint32_t resolution = 0;    // Bucket width in seconds (0 = exact timestamps)
+    bool extremes = false;      // Add <field>_min / <field>_max
+    uint8_t stage = 0;          // 0 = header, 1 = points, 2 = footer queued
+    String text;                // Serialised but not yet handed to the server
+    size_t textPos = 0;
+
+    // RAM rollup source (rollupTier == ROLLUP_TIER_COUNT means flash)
+    uint8_t rollupTier = ROLLUP_TIER_COUNT;
+    uint16_t rollupSlots[ROLLUP_SERIES_PER_CLIENT];
+    uint8_t rollupSlotCount = 0;
+    uint8_t rollupSlotPos = 0;
+    uint32_t rollupBucket = 0;
+    uint32_t rollupLastBucket = 0;
+};
+
+// Smallest of 1 min / 15 min / whole hours that keeps the window within maxPoints
+static uint32_t pickHistoryResolution(uint32_t span, uint16_t maxPoints) {
+    static const uint32_t steps[] = { 60, 900, 3600 };
+    for (uint8_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        if (span / steps[i] <= maxPoints) {
+            return steps[i];
+        }
+    }
+    return ((span / maxPoints + 3599) / 3600) * 3600;
+}
+
+// JSON key for a stored series (the keys dashboard.js charts)
+static const char* historyFieldName(const TimeSeriesPoint& point) {
+    if (point.channel == TS_CHANNEL_BATTERY) return "batt";
+    if (point.channel == TS_CHANNEL_RSSI) return "rssi";
+    switch (point.type) {
+        case VALUE_TEMPERATURE: return "temp";
+        case VALUE_HUMIDITY: return "humidity";
+        case VALUE_PRESSURE: return "pressure";
+        case VALUE_LIGHT: return "light";
+        case VALUE_VOLTAGE: return "voltage";
+        case VALUE_CURRENT: return "current";
+        case VALUE_POWER: return "power";
+        case VALUE_ENERGY: return "energy";
+        case VALUE_GAS_RESISTANCE: return "gas";
+        case VALUE_BATTERY: return "batt";
+        case VALUE_SIGNAL_STRENGTH: return "rssi";
+        case VALUE_MOISTURE: return "moisture";
+        default: return "value";
+    }
+}
+
+// Next record in time order from whichever source the stream was opened on
+static bool nextHistoryRecord(HistoryStream& s, TimeSeriesPoint& out) {
+    if (s.rollupTier >= ROLLUP_TIER_COUNT) {
+        return s.cursor.next(out);
+    }
+    while (s.rollupBucket <= s.rollupLastBucket) {
+        while (s.rollupSlotPos < s.rollupSlotCount) {
+            // The slot may be released and reused by the decode task between calls
+            lockStats();
+            const SeriesRollups* series = getRollupSeries(s.rollupSlots[s.rollupSlotPos++]);
+            RollupBucket bucket;
+            if (series != NULL && series->clientId == s.sensorId &&
+                getRollupBucket(series, s.rollupTier, s.rollupBucket, bucket)) {
+                out.timestamp = s.rollupBucket * s.resolution;
+                out.clientId = series->clientId;
+                out.channel = series->channel;
+                out.type = series->type;
+                unlockStats();
+                out.flags = 0;
+                out.samples = 1;
+                out.mean = bucket.mean;
+                out.minValue = bucket.minValue;
+                out.maxValue = bucket.maxValue;
+                return true;
+            }
+            unlockStats();
+        }
+        s.rollupSlotPos = 0;
+        s.rollupBucket++;
+    }
+    return false;
+}
+
+// Serialise every record in the next bucket into one point. Records of the same
+// series in one bucket (raw samples, or an hour split across two compaction
+// passes) are merged by sample count.
+static bool appendHistoryPoint(HistoryStream& s) {
+    if (!s.haveNext) {
+        s.haveNext = nextHistoryRecord(s, s.next);
+    }
+    if (!s.haveNext) {
+        return false;
+    }
+
+    struct Field {
+        const char* name;
+        uint8_t channel;
+        float sum;
+        uint32_t samples;
+        float minValue;
+        float maxValue;
+        uint8_t flags;
+    };
+    Field fields[16];
+    uint8_t fieldCount = 0;
+    const uint32_t r = s.resolution;
+    const uint32_t t = r ? s.next.timestamp - s.next.timestamp % r : s.next.timestamp;
+    do {
+        Field* field = nullptr;
+        for (uint8_t i = 0; i < fieldCount && field == nullptr; i++) {
+            if (fields[i].channel == s.next.channel) field = &fields[i];
+        }
+        if (field == nullptr && fieldCount < 16) {
+            field = &fields[fieldCount++];
+            field->name = historyFieldName(s.next);
+            field->channel = s.next.channel;
+            field->sum = 0;
+            field->samples = 0;
+            field->minValue = s.next.minValue;
+            field->maxValue = s.next.maxValue;
+            field->flags = 0;
+        }
+        if (field != nullptr) {
+            field->sum += s.next.mean * s.next.samples;
+            field->samples += s.next.samples;
+            field->minValue = min(field->minValue, s.next.minValue);
+            field->maxValue = max(field->maxValue, s.next.maxValue);
+            field->flags |= s.next.flags;
+        }
+        s.haveNext = nextHistoryRecord(s, s.next);
+    } while (s.haveNext && (r ? s.next.timestamp - s.next.timestamp % r : s.next.timestamp) == t);
+
+    s.text = s.first ? "{\"t\":" : ",{\"t\":";
+    s.first = false;
+    s.text += t;
+    for (uint8_t i = 0; i < fieldCount; i++) {
+        // A second sensor of the same type on one client gets its index appended
+        bool duplicate = false;
+        for (uint8_t j = 0; j < i && !duplicate; j++) {
+            duplicate = (strcmp(fields[j].name, fields[i].name) == 0);
+        }
+        String key = fields[i].name;
+        if (duplicate) {
+            key += "_";
+            key += fields[i].channel;
+        }
+        s.text += ",\"" + key + "\":";
+        s.text += String(fields[i].sum / fields[i].samples, 2);
+        if (s.extremes) {
+            s.text += ",\"" + key + "_min\":" + String(fields[i].minValue, 2);
+            s.text += ",\"" + key + "_max\":" + String(fields[i].maxValue, 2);
+        }
+        // Rollup buckets do not track the charging flag
+        if (fields[i].channel == TS_CHANNEL_BATTERY && s.rollupTier >= ROLLUP_TIER_COUNT) {
+            s.text += ",\"charging\":";
+            s.text += (fields[i].flags & TS_FLAG_CHARGING) ? "true" : "false";
+        }
+    }
+    s.text += "}";
+    return true;
+}
+
+static size_t fillHistoryChunk(HistoryStream& s, uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (s.textPos < s.text.length()) {
+            size_t n = min(maxLen - written, (size_t)(s.text.length() - s.textPos));
+            memcpy(buffer + written, s.text.c_str() + s.textPos, n);
+            s.textPos += n;
+            written += n;
+            continue;
+        }
+        s.textPos = 0;
+        if (s.stage == 0) {
+            s.text = "{\"sensorId\":";
+            s.text += s.sensorId;
+            s.text += ",\"source\":\"";
+            s.text += (s.rollupTier < ROLLUP_TIER_COUNT) ? "rollup" : "flash";
+            s.text += "\",\"resolution\":";
+            s.text += s.resolution;
+            s.text += ",\"data\":[";
+            s.stage = 1;
+        } else if (s.stage == 1) {
+            if (!appendHistoryPoint(s)) {
+                s.text = "]}";
+                s.stage = 2;
+            }
+        } else {
+            s.text = "";
+            break;      // Nothing left: the next call returns 0 and ends the response
+        }
+    }
+    return written;
+}
 #endif
 
 // DNS server port
@@ -592,8 +813,10 @@ void WiFiPortal::setupDashboard() {
         auto *response = request->beginResponseStream("application/json");
         response->print("[");
 
+        // Hold the stats lock so slots are not updated or released mid-row
+        lockStats();
         bool first = true;
-        for (int i = 0; i < 10; i++) {
+        for (int i = 0; i < getClientCapacity(); i++) {
             SensorInfo* sensor = getSensorByIndex(i);
             if (sensor == NULL) continue;
 
@@ -665,6 +888,7 @@ void WiFiPortal::setupDashboard() {
 
             response->print("}");
         }
+        unlockStats();
 
         response->print("]");
         request->send(response);
@@ -676,6 +900,10 @@ void WiFiPortal::setupDashboard() {
         uint8_t clientId = clientIdStr.toInt();
         
         bool success = forgetClient(clientId);
+        if (success) {
+            // A sensor that later takes this ID starts its counter from 1
+            securityManager.resetReplayWindow(clientId);
+        }
         
         String response = success ? 
             "{\"success\":true,\"message\":\"Client forgotten\"}" : 
@@ -684,6 +912,50 @@ void WiFiPortal::setupDashboard() {
         request->send(success ? 200 : 404, "application/json", response);
     });
     
+    // Client/sensor table capacities (stored values apply at next boot).
+    // Registered before /api/stats, which would otherwise match this URL as a prefix.
+    webServer.on("/api/stats/capacity", HTTP_GET, [](AsyncWebServerRequest *request) {
+        uint8_t storedClients;
+        uint16_t storedSensors;
+        getStoredStatsCapacity(storedClients, storedSensors);
+
+        auto *response = request->beginResponseStream("application/json");
+        StaticJsonDocument<256> doc;
+        doc["maxClients"] = getClientCapacity();
+        doc["maxSensors"] = getSensorCapacity();
+        doc["storedMaxClients"] = storedClients;
+        doc["storedMaxSensors"] = storedSensors;
+        doc["clientLimit"] = STATS_MAX_CLIENTS_LIMIT;
+        doc["sensorLimit"] = STATS_MAX_SENSORS_LIMIT;
+        doc["restartRequired"] = (storedClients != getClientCapacity() || storedSensors != getSensorCapacity());
+        serializeJson(doc, *response);
+        request->send(response);
+    });
+
+    webServer.on("/api/stats/capacity", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            String body = String((char*)data).substring(0, len);
+
+            StaticJsonDocument<128> doc;
+            DeserializationError error = deserializeJson(doc, body);
+            if (error) {
+                request->send(400, "application/json", "{\"success\":false,\"error\":\"Invalid JSON\"}");
+                return;
+            }
+
+            int maxClients = doc["maxClients"] | (int)getClientCapacity();
+            int maxSensors = doc["maxSensors"] | (int)getSensorCapacity();
+            if (maxClients < 1 || maxClients > STATS_MAX_CLIENTS_LIMIT ||
+                maxSensors < 1 || maxSensors > STATS_MAX_SENSORS_LIMIT ||
+                !setStatsCapacity((uint8_t)maxClients, (uint16_t)maxSensors)) {
+                request->send(400, "application/json", "{\"success\":false,\"error\":\"Capacity out of range\"}");
+                return;
+            }
+
+            Serial.printf("📊 Stats capacity set to %d clients, %d sensors (applies after restart)\n", maxClients, maxSensors);
+            request->send(200, "application/json", "{\"success\":true,\"restartRequired\":true}");
+        });
+
     webServer.on("/api/stats", HTTP_GET, [](AsyncWebServerRequest *request) {
         SystemStats* stats = getStats();
         uint8_t activeClients = getActiveClientCount();
@@ -704,10 +976,210 @@ void WiFiPortal::setupDashboard() {
         response->print(successRate);
         response->print(",\"uptime\":");
         response->print(millis() / 1000);
+        response->print(",\"loopRate\":");
+        response->print(stats->loopIterationsPerSec);
+
+        // Timer wheel: how late callbacks ran and how many loop passes had work
+        TimerWheelStats timers;
+        timerWheel.getStats(timers);
+        response->print(",\"timers\":{\"armed\":");
+        response->print(timers.armed);
+        response->print(",\"fired\":");
+        response->print(timers.fired);
+        response->print(",\"skipped\":");
+        response->print(timers.skipped);
+        response->print(",\"passes\":");
+        response->print(timers.passes);
+        response->print(",\"busyPasses\":");
+        response->print(timers.busyPasses);
+        response->print(",\"lagLastMs\":");
+        response->print(timers.lagLastMs);
+        response->print(",\"lagAvgMs\":");
+        response->print(timers.lagAvgMs);
+        response->print(",\"lagMaxMs\":");
+        response->print(timers.lagMaxMs);
+        response->print(",\"lagHistogram\":[");
+        for (int b = 0; b < TIMER_LAG_BUCKETS; b++) {
+            if (b > 0) response->print(",");
+            response->print(timers.lagHistogram[b]);
+        }
+        response->print("]}");
+#ifdef BASE_STATION
+        RxQueueStats rxq;
+        getRxQueueStats(rxq);
+        response->print(",\"rxQueue\":{\"depth\":");
+        response->print(rxq.depth);
+        response->print(",\"capacity\":");
+        response->print(rxq.capacity);
+        response->print(",\"highWater\":");
+        response->print(rxq.highWater);
+        response->print(",\"drops\":");
+        response->print(rxq.drops);
+        response->print(",\"processed\":");
+        response->print(rxq.processed);
+        response->print("}");
+
+        // Remote-config command store
+        extern RemoteConfigManager remoteConfigManager;
+        CommandPoolStats commandPool;
+        remoteConfigManager.getPoolStats(commandPool);
+        response->print(",\"commandPool\":{\"queued\":");
+        response->print(commandPool.queued);
+        response->print(",\"capacity\":");
+        response->print(commandPool.capacity);
+        response->print(",\"payloadBytes\":");
+        response->print(commandPool.payloadBytes);
+        response->print(",\"payloadCapacity\":");
+        response->print(commandPool.payloadCapacity);
+        response->print(",\"activeSensors\":");
+        response->print(commandPool.activeSensors);
+        response->print(",\"trackedSensors\":");
+        response->print(commandPool.trackedSensors);
+        response->print(",\"rejected\":");
+        response->print(commandPool.rejected);
+        response->print("}");
+
+        // TX airtime budget (rolling 60 minutes)
+        static const char* const priorityNames[TX_PRIORITY_COUNT] = {"ackCritical", "timeSync", "data", "broadcast"};
+        TxBudgetStats airtime;
+        txScheduler.getStats(airtime);
+        response->print(",\"airtime\":{\"dutyCyclePercent\":");
+        response->print(airtime.dutyCyclePercent);
+        response->print(",\"budgetPerHourMs\":");
+        response->print(airtime.budgetPerHourMs);
+        response->print(",\"usedLastHourMs\":");
+        response->print(airtime.usedLastHourMs);
+        response->print(",\"availableMs\":");
+        response->print(airtime.availableMs);
+        response->print(",\"capacityMs\":");
+        response->print(airtime.capacityMs);
+        response->print(",\"byPriority\":{");
+        for (int p = 0; p < TX_PRIORITY_COUNT; p++) {
+            if (p > 0) response->print(",");
+            response->print("\"");
+            response->print(priorityNames[p]);
+            response->print("\":{\"sent\":");
+            response->print(airtime.sent[p]);
+            response->print(",\"deferred\":");
+            response->print(airtime.deferred[p]);
+            response->print(",\"usedLastHourMs\":");
+            response->print(airtime.usedLastHourByPriorityMs[p]);
+            response->print("}");
+        }
+        response->print("}}");
+
+        // Flash history store
+        TimeSeriesStats history;
+        timeSeriesStore.getStats(history);
+        response->print(",\"history\":{\"ready\":");
+        response->print(history.ready ? "true" : "false");
+        response->print(",\"blocks\":");
+        response->print(history.blocks);
+        response->print(",\"rawBlocks\":");
+        response->print(history.rawBlocks);
+        response->print(",\"rollupBlocks\":");
+        response->print(history.rollupBlocks);
+        response->print(",\"bytesUsed\":");
+        response->print(history.bytesUsed);
+        response->print(",\"oldest\":");
+        response->print(history.oldestTime);
+        response->print(",\"newest\":");
+        response->print(history.newestTime);
+        response->print(",\"pending\":");
+        response->print(history.pending);
+        response->print(",\"appended\":");
+        response->print(history.appended);
+        response->print(",\"dropped\":");
+        response->print(history.dropped);
+        response->print(",\"compactions\":");
+        response->print(history.compactions);
+        response->print(",\"blocksEvicted\":");
+        response->print(history.blocksEvicted);
+        response->print("}");
+
+        // Alert dispatch queue
+        AlertQueueStats alerts;
+        alertManager.getQueueStats(alerts);
+        response->print(",\"alerts\":{\"pending\":");
+        response->print(alerts.pending);
+        response->print(",\"capacity\":");
+        response->print(alerts.capacity);
+        response->print(",\"queued\":");
+        response->print(alerts.queued);
+        response->print(",\"coalesced\":");
+        response->print(alerts.coalesced);
+        response->print(",\"delivered\":");
+        response->print(alerts.delivered);
+        response->print(",\"retries\":");
+        response->print(alerts.retries);
+        response->print(",\"failed\":");
+        response->print(alerts.failed);
+        response->print(",\"dropped\":");
+        response->print(alerts.dropped);
+        response->print("}");
+#endif
         response->print("}");
         request->send(response);
     });
     
+#ifdef BASE_STATION
+    // Telemetry size/airtime comparison: what each sensor's last frame cost on air
+    // versus the same readings in the v2 and v3 formats
+    webServer.on("/api/diagnostics/packet-efficiency", HTTP_GET, [](AsyncWebServerRequest *request) {
+        PacketEfficiencyTotals totals;
+        getPacketEfficiencyTotals(totals);
+
+        auto *response = request->beginResponseStream("application/json");
+        response->print("{\"totals\":{\"packets\":");
+        response->print(totals.packets);
+        response->print(",\"bytes\":");
+        response->print(totals.bytes);
+        response->print(",\"v2Bytes\":");
+        response->print(totals.v2Bytes);
+        response->print(",\"airtimeMs\":");
+        response->print(totals.airtimeMs);
+        response->print(",\"v2AirtimeMs\":");
+        response->print(totals.v2AirtimeMs);
+        response->print(",\"v3ReferenceMisses\":");
+        response->print(totals.v3ReferenceMisses);
+        response->print(",\"v3AcksSent\":");
+        response->print(totals.v3AcksSent);
+        response->print("},\"sensors\":[");
+
+        bool first = true;
+        for (int id = 1; id < 256; id++) {
+            PacketEfficiency e;
+            if (!getPacketEfficiency(id, e)) {
+                continue;
+            }
+            if (!first) response->print(",");
+            first = false;
+            response->print("{\"sensorId\":");
+            response->print(id);
+            response->print(",\"format\":\"");
+            response->print(e.format == PACKET_MULTI_SENSOR_V3 ? "v3" :
+                            e.format == PACKET_MULTI_SENSOR ? "v2" : "legacy");
+            response->print("\",\"values\":");
+            response->print(e.valueCount);
+            response->print(",\"bytes\":");
+            response->print(e.bytes);
+            response->print(",\"v2Bytes\":");
+            response->print(e.v2Bytes);
+            response->print(",\"v3Bytes\":");
+            response->print(e.v3Bytes);
+            response->print(",\"airtimeMs\":");
+            response->print(e.airtimeMs);
+            response->print(",\"v2AirtimeMs\":");
+            response->print(e.v2AirtimeMs);
+            response->print(",\"v3AirtimeMs\":");
+            response->print(e.v3AirtimeMs);
+            response->print("}");
+        }
+        response->print("]}");
+        request->send(response);
+    });
+#endif
+    
     // Historical data endpoint
     webServer.on("/api/history", HTTP_GET, [](AsyncWebServerRequest *request) {
         if (!request->hasParam("sensorId")) {
@@ -723,11 +1195,72 @@ void WiFiPortal::setupDashboard() {
             if (range == "1h") timeRange = 3600;
             else if (range == "6h") timeRange = 21600;
             else if (range == "24h") timeRange = 86400;
+            else if (range == "7d") timeRange = 7 * 86400;
+            else if (range == "30d") timeRange = 30 * 86400;
         }
         
-        // Stream response (no huge String build)
+#ifdef BASE_STATION
+        uint16_t maxPoints = HISTORY_MAX_POINTS;
+        if (request->hasParam("points")) {
+            maxPoints = constrain(request->getParam("points")->value().toInt(), 10, 1000);
+        }
+
+        std::shared_ptr<HistoryStream> stream = std::make_shared<HistoryStream>();
+        stream->sensorId = sensorId;
+        stream->extremes = request->hasParam("extremes") && request->getParam("extremes")->value() == "1";
+        const uint32_t now = historyTimestamp();
+        bool opened = false;
+
+        // RAM rollups: the tier at the chosen resolution, if it reaches back far enough
+        if (timeRange > 0) {
+            const uint32_t resolution = pickHistoryResolution(timeRange, maxPoints);
+            for (uint8_t tier = 0; tier < ROLLUP_TIER_COUNT && !opened; tier++) {
+                if (getRollupResolution(tier) != resolution ||
+                    timeRange > resolution * getRollupBucketCount(tier)) {
+                    continue;
+                }
+                stream->rollupSlotCount = getRollupSeriesForClient(sensorId, stream->rollupSlots, ROLLUP_SERIES_PER_CLIENT);
+                if (stream->rollupSlotCount > 0) {
+                    stream->rollupTier = tier;
+                    stream->resolution = resolution;
+                    stream->rollupBucket = (now > timeRange) ? (now - timeRange) / resolution + 1 : 0;
+                    stream->rollupLastBucket = now / resolution;
+                    opened = true;
+                }
+            }
+        }
+
+        // Flash store: days of history, grouped to fit the point budget
+        if (!opened && timeSeriesStore.isReady() && now >= TS_MIN_VALID_EPOCH) {
+            uint32_t fromTime = (timeRange > 0) ? now - timeRange : 0;
+            if (timeSeriesStore.openCursor(sensorId, fromTime, now, stream->cursor)) {
+                uint32_t span = timeRange;
+                if (span == 0) {
+                    TimeSeriesStats storeStats;
+                    timeSeriesStore.getStats(storeStats);
+                    span = (storeStats.oldestTime > 0 && storeStats.oldestTime < now) ? now - storeStats.oldestTime : 0;
+                }
+                stream->resolution = pickHistoryResolution(span, maxPoints);
+                opened = true;
+            }
+        }
+
+        if (opened) {
+            AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+                [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                    return fillHistoryChunk(*stream, buffer, maxLen);
+                });
+            request->send(response);
+            return;
+        }
+#endif
+
+        // RAM history (uptime timestamps): no NTP yet, or nothing on flash for this client
+        lockStats();
         ClientHistory* history = getClientHistory(sensorId);
+
         if (history == NULL || history->count == 0) {
+            unlockStats();
             request->send(200, "application/json", "{\"error\":\"No data available\",\"data\":[]}");
             return;
         }
@@ -764,6 +1297,7 @@ void WiFiPortal::setupDashboard() {
             response->print(point->charging ? "true" : "false");
             response->print("}");
         }
+        unlockStats();
 
         response->print("]}");
         request->send(response);
@@ -773,7 +1307,8 @@ void WiFiPortal::setupDashboard() {
     webServer.on("/export/csv", HTTP_GET, [this](AsyncWebServerRequest *request) {
         String csv = "Sensor ID,Location,Temperature,Battery,RSSI,Last Seen\n";
         
-        for (int i = 0; i < 10; i++) {
+        lockStats();
+        for (int i = 0; i < getClientCapacity(); i++) {
             SensorInfo* sensor = getSensorByIndex(i);
             if (sensor != NULL) {
                 uint32_t ageSeconds = (millis() - sensor->lastSeen) / 1000;
@@ -785,6 +1320,7 @@ void WiFiPortal::setupDashboard() {
                 csv += String(ageSeconds) + "s ago\n";
             }
         }
+        unlockStats();
         
         request->send(200, "text/csv", csv);
     });
@@ -907,6 +1443,7 @@ void WiFiPortal::setupDashboard() {
             int commandsSent = 0;
             
             Serial.println("\n=== Broadcasting to Sensor Nodes ===");
+            lockStats();
             for (int i = 0; i < 256; i++) {
                 SensorInfo* sensor = getSensorInfo(i);
                 if (sensor != NULL && !isSensorTimedOut(i)) {
@@ -935,6 +1472,7 @@ void WiFiPortal::setupDashboard() {
                     }
                 }
             }
+            unlockStats();
             
             Serial.println("===================================");
             Serial.printf("Commands sent to %d of %d active sensors\n", commandsSent, sensorCount);
@@ -944,8 +1482,12 @@ void WiFiPortal::setupDashboard() {
             loraRebootTracker.totalSensors = commandsSent;
             loraRebootTracker.commandStartTime = millis();
             loraRebootTracker.trackingActive = (commandsSent > 0);
+            if (loraRebootTracker.trackingActive) {
+                timerWheel.schedule(&loraRebootAckTimer, LORA_REBOOT_ACK_TIMEOUT_MS, onLoRaRebootAckTimeout, nullptr);
+            }
             
             // Record which sensors we're waiting for
+            lockStats();
             for (int i = 0; i < 256; i++) {
                 SensorInfo* sensor = getSensorInfo(i);
                 if (sensor != NULL && !isSensorTimedOut(i)) {
@@ -953,6 +1495,7 @@ void WiFiPortal::setupDashboard() {
                     Serial.printf("Tracking ACK from sensor %d (%s)\n", i, sensor->location);
                 }
             }
+            unlockStats();
             
             Serial.println("\n⚠️  COORDINATION PROTOCOL:");
             Serial.println("1. Waiting for all sensors to ACK (max 20s)");
@@ -991,6 +1534,7 @@ void WiFiPortal::setupDashboard() {
         // Count ACKs
         uint8_t ackedCount = 0;
         JsonArray sensors = doc.createNestedArray("sensors");
+        lockStats();
         for (auto& pair : loraRebootTracker.sensorAcks) {
             JsonObject sensor = sensors.createNestedObject();
             sensor["id"] = pair.first;
@@ -1002,12 +1546,13 @@ void WiFiPortal::setupDashboard() {
                 sensor["name"] = info->location;
             }
         }
+        unlockStats();
         
         doc["ackedCount"] = ackedCount;
         doc["allAcked"] = (ackedCount == loraRebootTracker.totalSensors) && (loraRebootTracker.totalSensors > 0);
         
         // Check if we've timed out (20 seconds)
-        bool timedOut = loraRebootTracker.trackingActive && (millis() - loraRebootTracker.commandStartTime > 20000);
+        bool timedOut = loraRebootTracker.trackingActive && (millis() - loraRebootTracker.commandStartTime > LORA_REBOOT_ACK_TIMEOUT_MS);
         doc["timedOut"] = timedOut;
         
         // Check if base station reboot is scheduled
@@ -1069,6 +1614,75 @@ void WiFiPortal::setupDashboard() {
             handleAlertsConfigUpdate(request, data, len);
         });
     
+    // User rules for any value type (threshold above/below, rate of change)
+    webServer.on("/api/alerts/rules", HTTP_GET, [](AsyncWebServerRequest *request) {
+        static const char* const kindNames[] = {"above", "below", "rate"};
+        AlertConfig* config = alertManager.getConfig();
+
+        auto *response = request->beginResponseStream("application/json");
+        StaticJsonDocument<1536> doc;
+        doc["capacity"] = ALERT_CUSTOM_RULES;
+        JsonArray rules = doc.createNestedArray("rules");
+        for (int i = 0; i < ALERT_CUSTOM_RULES; i++) {
+            const AlertRuleConfig& rc = config->rules[i];
+            if (!rc.used) {
+                continue;
+            }
+            JsonObject rule = rules.createNestedObject();
+            rule["enabled"] = rc.enabled;
+            rule["type"] = rc.valueType;
+            rule["kind"] = kindNames[rc.kind <= ALERT_RULE_RATE ? rc.kind : 0];
+            rule["threshold"] = rc.threshold;
+            rule["hysteresis"] = rc.hysteresis;
+        }
+        serializeJson(doc, *response);
+        request->send(response);
+    });
+    
+    webServer.on("/api/alerts/rules", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            String body = String((char*)data).substring(0, len);
+            
+            StaticJsonDocument<1536> doc;
+            DeserializationError error = deserializeJson(doc, body);
+            if (error || !doc["rules"].is<JsonArray>()) {
+                request->send(400, "application/json", "{\"success\":false,\"error\":\"Invalid JSON\"}");
+                return;
+            }
+            
+            JsonArray rules = doc["rules"].as<JsonArray>();
+            if (rules.size() > ALERT_CUSTOM_RULES) {
+                request->send(400, "application/json", "{\"success\":false,\"error\":\"Too many rules\"}");
+                return;
+            }
+            
+            AlertRuleConfig parsed[ALERT_CUSTOM_RULES];
+            memset(parsed, 0, sizeof(parsed));
+            int count = 0;
+            for (JsonObject rule : rules) {
+                int type = rule["type"] | -1;
+                const char* kind = rule["kind"] | "above";
+                if (type < 0 || type >= ALERT_VALUE_TYPES) {
+                    request->send(400, "application/json", "{\"success\":false,\"error\":\"Invalid value type\"}");
+                    return;
+                }
+                parsed[count].used = true;
+                parsed[count].enabled = rule["enabled"] | true;
+                parsed[count].valueType = (uint8_t)type;
+                parsed[count].kind = (strcmp(kind, "below") == 0) ? ALERT_RULE_BELOW :
+                                     (strcmp(kind, "rate") == 0) ? ALERT_RULE_RATE : ALERT_RULE_ABOVE;
+                parsed[count].threshold = rule["threshold"] | 0.0f;
+                parsed[count].hysteresis = rule["hysteresis"] | 0.0f;
+                count++;
+            }
+            
+            AlertConfig* config = alertManager.getConfig();
+            memcpy(config->rules, parsed, sizeof(parsed));
+            alertManager.saveConfig();
+            
+            request->send(200, "application/json", "{\"success\":true}");
+        });
+    
     webServer.on("/api/alerts/test", HTTP_POST, [this](AsyncWebServerRequest *request) {
         bool success = testTeamsWebhook();
         String response = success ? "{\"success\":true,\"message\":\"Test alert sent!\"}" : "{\"success\":false,\"message\":\"Failed to send test alert\"}";
@@ -1101,6 +1715,7 @@ void WiFiPortal::setupDashboard() {
         doc["topicPrefix"] = config->topicPrefix;
         doc["haDiscovery"] = config->homeAssistantDiscovery;
         doc["qos"] = config->qos;
+        doc["publishMode"] = config->publishMode;
 
         serializeJson(doc, *response);
         request->send(response);
@@ -1122,11 +1737,45 @@ void WiFiPortal::setupDashboard() {
     
     webServer.on("/api/mqtt/stats", HTTP_GET, [](AsyncWebServerRequest *request) {
         auto *response = request->beginResponseStream("application/json");
-        StaticJsonDocument<192> doc;
+        MQTTQueueStats queue;
+        mqttClient.getQueueStats(queue);
+        StaticJsonDocument<1024> doc;
         doc["connected"] = mqttClient.isConnected();
         doc["publishes"] = mqttClient.getPublishCount();
         doc["failures"] = mqttClient.getFailedPublishCount();
         doc["reconnects"] = mqttClient.getReconnectCount();
+        JsonObject q = doc.createNestedObject("queue");
+        q["taskRunning"] = queue.taskRunning;
+        q["depth"] = queue.depth;
+        q["ramMessages"] = queue.ramMessages;
+        q["ramBytes"] = queue.ramBytes;
+        q["ramCapacity"] = MQTT_QUEUE_BYTES;
+        q["ramHighWater"] = queue.ramHighWater;
+        q["spillMessages"] = queue.spillMessages;
+        q["spillBytes"] = queue.spillBytes;
+        q["oldestAgeMs"] = queue.oldestAgeMs;
+        q["enqueued"] = queue.enqueued;
+        q["dropped"] = queue.dropped;
+        q["spilled"] = queue.spilled;
+        q["replayed"] = queue.replayed;
+        MQTTPerfStats perf;
+        mqttClient.getPerfStats(perf);
+        JsonObject p = doc.createNestedObject("perf");
+        p["packets"] = perf.producer.count;
+        p["messagesPerPacket"] = perf.producer.count ? (float)perf.producerMessages / perf.producer.count : 0.0f;
+        p["sentLastMinute"] = perf.sentLastMinute;
+        p["packetLastUs"] = perf.producer.lastUs;
+        p["packetMaxUs"] = perf.producer.maxUs;
+        p["packetAvgUs"] = perf.producer.count ? (uint32_t)(perf.producer.totalUs / perf.producer.count) : 0;
+        p["sendLastUs"] = perf.send.lastUs;
+        p["sendMaxUs"] = perf.send.maxUs;
+        p["sendAvgUs"] = perf.send.count ? (uint32_t)(perf.send.totalUs / perf.send.count) : 0;
+        p["topicCacheHits"] = perf.topicCacheHits;
+        p["topicCacheMisses"] = perf.topicCacheMisses;
+        p["heapFree"] = perf.heapFree;
+        p["heapMinFree"] = perf.heapMinFree;
+        p["heapLargestBlock"] = perf.heapLargestBlock;
+        p["heapFragmentationPct"] = perf.heapFragmentationPct;
         serializeJson(doc, *response);
         request->send(response);
     });
@@ -1172,11 +1821,13 @@ void WiFiPortal::setupDashboard() {
         auto *response = request->beginResponseStream("application/json");
         response->print("{\"clients\":[");
         
+        // Held for the whole walk: slots can be forgotten or reused by the decode task
+        lockStats();
         ClientInfo* allClients = getAllClients();
         bool first = true;
         
-        // Iterate through all possible client slots (MAX_CLIENTS = 10)
-        for (uint8_t i = 0; i < 10; i++) {
+        // Iterate through all client slots
+        for (uint8_t i = 0; i < getClientCapacity(); i++) {
             if (allClients[i].clientId != 0) {  // Client exists
                 if (!first) response->print(",");
                 first = false;
@@ -1215,6 +1866,21 @@ void WiFiPortal::setupDashboard() {
                     response->print(",\"lastTimeSync\":");
                     response->print(syncAge);
                 }
+
+                // Clock offset from the last keyframe clock report
+                if (client.clock.reportMs > 0) {
+                    response->print(",\"clock\":{\"synced\":");
+                    response->print(client.clock.synced ? "true" : "false");
+                    response->print(",\"offsetSeconds\":");
+                    response->print(client.clock.offsetS);
+                    response->print(",\"reportAgeSeconds\":");
+                    response->print((millis() - client.clock.reportMs) / 1000);
+                    if (client.clock.driftValid) {
+                        response->print(",\"driftPpm\":");
+                        response->print(client.clock.driftPpm);
+                    }
+                    response->print("}");
+                }
                 
                 // Pending commands
                 uint8_t queuedCount = remoteConfigManager.getQueuedCount(client.clientId);
@@ -1321,6 +1987,7 @@ void WiFiPortal::setupDashboard() {
                 response->print("]}");  // End sensors array + client object
             }
         }
+        unlockStats();
 
         response->print("]}");  // End clients array and root object
         request->send(response);
@@ -1407,8 +2074,9 @@ void WiFiPortal::setupDashboard() {
             int sent = 0;
             int targets = 0;
 
+            lockStats();
             ClientInfo* allClients = getAllClients();
-            for (uint8_t i = 0; i < 10; i++) {  // MAX_CLIENTS = 10
+            for (uint8_t i = 0; i < getClientCapacity(); i++) {
                 const uint8_t cid = allClients[i].clientId;
                 if (cid == 0) continue;
 
@@ -1424,6 +2092,7 @@ void WiFiPortal::setupDashboard() {
                     LOGW("TIME", "Time sync: failed to queue command for sensor %d", cid);
                 }
             }
+            unlockStats();
 
             if (targets == 0) {
                 String msg = (sensorIdReq >= 0 && !all)
@@ -1680,6 +2349,22 @@ void WiFiPortal::setupDashboard() {
         }
     });
     
+    // Clear one sender's replay window (sensor replaced or re-flashed under the same ID)
+    webServer.on("^\\/api\\/security\\/replay\\/([0-9]+)$", HTTP_DELETE, [](AsyncWebServerRequest *request) {
+        String deviceIdStr = request->pathArg(0);
+        int deviceId = deviceIdStr.toInt();
+        if (deviceId < 0 || deviceId > 255) {
+            request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"Invalid device ID\"}");
+            return;
+        }
+        
+        if (securityManager.resetReplayWindow((uint8_t)deviceId)) {
+            request->send(200, "application/json", "{\"status\":\"success\"}");
+        } else {
+            request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to save\"}");
+        }
+    });
+    
     // Get encryption key
     webServer.on("/api/security/key", HTTP_GET, [](AsyncWebServerRequest *request) {
         uint8_t key[16];
@@ -1849,7 +2534,8 @@ String WiFiPortal::generateSensorsJSON() {
     String json = "[";
     bool first = true;
     
-    for (int i = 0; i < 10; i++) {
+    lockStats();
+    for (int i = 0; i < getClientCapacity(); i++) {
         SensorInfo* sensor = getSensorByIndex(i);
         if (sensor != NULL) {
             if (!first) json += ",";
@@ -1910,6 +2596,7 @@ String WiFiPortal::generateSensorsJSON() {
             json += "}";
         }
     }
+    unlockStats();
     
     json += "]";
     return json;
@@ -2093,6 +2780,13 @@ void WiFiPortal::handleMQTTConfigUpdate(AsyncWebServerRequest *request, uint8_t
     int qosStart = body.indexOf("\"qos\":") + 6;
     config->qos = body.substring(qosStart).toInt();
     
+    // Parse publish mode (optional; older pages do not send it)
+    int modeStart = body.indexOf("\"publishMode\":");
+    if (modeStart >= 0) {
+        int mode = body.substring(modeStart + 14).toInt();
+        config->publishMode = (mode == MQTT_PUBLISH_STATE_ONLY) ? MQTT_PUBLISH_STATE_ONLY : MQTT_PUBLISH_PER_VALUE;
+    }
+    
     // Save configuration
     mqttClient.saveConfig();
     
@@ -2228,6 +2922,7 @@ void WiFiPortal::handleRemoteSetLocation(AsyncWebServerRequest *request, uint8_t
     strncpy(metadata.location, location.c_str(), sizeof(metadata.location) - 1);
     metadata.location[sizeof(metadata.location) - 1] = '\0';
     sensorConfigManager.setSensorMetadata(sensorId, metadata);
+    setClientLocation(sensorId, metadata.location);  // Tracked clients pick up the name without an NVS read
     Serial.printf("Updated base station metadata for sensor %d\n", sensorId);
     #endif
     
@@ -2266,7 +2961,8 @@ String WiFiPortal::generateCommandQueueJSON() {
     bool first = true;
     
     // Check queue status for all active sensors
-    for (int i = 0; i < 10; i++) {
+    lockStats();
+    for (int i = 0; i < getClientCapacity(); i++) {
         SensorInfo* sensor = getSensorByIndex(i);
         if (sensor != NULL) {
             uint8_t queuedCount = remoteConfigManager.getQueuedCount(sensor->sensorId);
@@ -2277,9 +2973,21 @@ String WiFiPortal::generateCommandQueueJSON() {
             json += "{";
             json += "\"sensorId\":" + String(sensor->sensorId) + ",";
             json += "\"queuedCommands\":" + String(queuedCount);
+
+            // Airtime of the last command frame and what the short form saved
+            // versus sending the whole CommandPacket struct
+            CommandAirtime airtime;
+            if (getCommandAirtime(sensor->sensorId, airtime)) {
+                json += ",\"commandsSent\":" + String(airtime.sent);
+                json += ",\"lastCommandBytes\":" + String(airtime.lastBytes);
+                json += ",\"lastCommandAirtimeMs\":" + String(airtime.lastAirtimeMs);
+                json += ",\"lastCommandAirtimeSavedMs\":" + String(airtime.lastSavedMs);
+                json += ",\"totalAirtimeSavedMs\":" + String(airtime.totalSavedMs);
+            }
             json += "}";
         }
     }
+    unlockStats();
     
     json += "]";
     return json;
@@ -2310,40 +3018,32 @@ void updateLoRaRebootTracking(uint8_t sensorId) {
             Serial.println("Scheduling base station reboot in 8 seconds...");
             Serial.println("========================================\n");
             
-            extern bool loraRebootPending;
-            extern uint32_t loraRebootTime;
-            loraRebootPending = true;
-            loraRebootTime = millis() + 8000;  // 8 seconds (sensors reboot at 5s)
+            timerWheel.cancel(&loraRebootAckTimer);
+            scheduleLoRaReboot(8000);  // 8 seconds (sensors reboot at 5s)
             loraRebootTracker.trackingActive = false;
         }
     }
 }
 
-// Check if we've timed out waiting for sensor ACKs (20 seconds)
-void checkLoRaRebootTimeout() {
+// Timer callback: not every sensor ACKed within LORA_REBOOT_ACK_TIMEOUT_MS
+static void onLoRaRebootAckTimeout(TimerNode* /*node*/, void* /*context*/) {
     if (!loraRebootTracker.trackingActive) return;
     
-    // Check if 20 seconds have elapsed
-    if (millis() - loraRebootTracker.commandStartTime > 20000) {
-        // Count how many ACKed
-        uint8_t ackedCount = 0;
-        for (auto& pair : loraRebootTracker.sensorAcks) {
-            if (pair.second) ackedCount++;
-        }
-        
-        Serial.println("\n========================================");
-        Serial.println("⚠️  TIMEOUT WAITING FOR SENSOR ACKS");
-        Serial.printf("Received ACKs from %d/%d sensors\n", ackedCount, loraRebootTracker.totalSensors);
-        Serial.println("Proceeding with base station reboot anyway...");
-        Serial.println("========================================\n");
-        
-        // Schedule reboot even though not all sensors ACKed
-        extern bool loraRebootPending;
-        extern uint32_t loraRebootTime;
-        loraRebootPending = true;
-        loraRebootTime = millis() + 5000;  // 5 second grace period
-        loraRebootTracker.trackingActive = false;
+    // Count how many ACKed
+    uint8_t ackedCount = 0;
+    for (auto& pair : loraRebootTracker.sensorAcks) {
+        if (pair.second) ackedCount++;
     }
+    
+    Serial.println("\n========================================");
+    Serial.println("⚠️  TIMEOUT WAITING FOR SENSOR ACKS");
+    Serial.printf("Received ACKs from %d/%d sensors\n", ackedCount, loraRebootTracker.totalSensors);
+    Serial.println("Proceeding with base station reboot anyway...");
+    Serial.println("========================================\n");
+    
+    // Schedule reboot even though not all sensors ACKed
+    scheduleLoRaReboot(5000);  // 5 second grace period
+    loraRebootTracker.trackingActive = false;
 }
 #endif // BASE_STATION
 
@@ -0,0 +1,103 @@
+/**
+ * @file Arduino.h
+ * @brief Minimal Arduino core for the native test environment
+ *
+ * Only what the modules under test use. Time is simulated: millis() returns
+ * nativeMillis, which tests advance themselves (delay() does the same).
+ */
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+// Simulated clock
+inline uint32_t nativeMillis = 0;
+inline uint32_t millis() { return nativeMillis; }
+inline uint32_t micros() { return nativeMillis * 1000UL; }
+inline void delay(uint32_t ms) { nativeMillis += ms; }
+inline void yield() {}
+
+// Deterministic esp_random() (xorshift32) so runs are reproducible
+inline uint32_t nativeRandomState = 0x12345678;
+inline void nativeRandomSeed(uint32_t seed) { nativeRandomState = seed ? seed : 1; }
+inline uint32_t esp_random() {
+    uint32_t x = nativeRandomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    nativeRandomState = x;
+    return x;
+}
+
+class String {
+public:
+    String() {}
+    String(const char* c) : s(c ? c : "") {}
+    String(const std::string& str) : s(str) {}
+    String(char c) : s(1, c) {}
+    String(int v) : s(std::to_string(v)) {}
+    String(unsigned int v) : s(std::to_string(v)) {}
+    String(long v) : s(std::to_string(v)) {}
+    String(unsigned long v) : s(std::to_string(v)) {}
+    String(double v, int decimals = 2) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        s = buf;
+    }
+    
+    const char* c_str() const { return s.c_str(); }
+    size_t length() const { return s.size(); }
+    void reserve(size_t n) { s.reserve(n); }
+    String& operator+=(const String& o) { s += o.s; return *this; }
+    String& operator+=(const char* o) { s += o; return *this; }
+    String& operator+=(char o) { s += o; return *this; }
+    bool operator==(const String& o) const { return s == o.s; }
+    bool operator==(const char* o) const { return s == o; }
+    friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+    friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.s); }
+    
+private:
+    std::string s;
+};
+
+// Serial output is dropped unless a test turns it on (routers log every frame)
+inline bool nativeSerialEcho = false;
+
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    size_t printf(const char* fmt, ...) {
+        if (!nativeSerialEcho) return 0;
+        va_list args;
+        va_start(args, fmt);
+        int n = vprintf(fmt, args);
+        va_end(args);
+        return n > 0 ? n : 0;
+    }
+    size_t print(const char* str) { return nativeSerialEcho ? fputs(str, stdout), strlen(str) : 0; }
+    size_t print(const String& str) { return print(str.c_str()); }
+    size_t println(const char* str = "") { size_t n = print(str); return n + print("\n"); }
+    size_t println(const String& str) { return println(str.c_str()); }
+};
+
+inline HardwareSerial Serial;
+
+// Firmware functions the native modules call into but whose modules are not
+// built natively (statistics.cpp keeps display state only)
+inline void recordClientTimeSync(uint8_t /*clientId*/) {}
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,117 @@
+/**
+ * @file FS.h
+ * @brief File API for the native test environment (in-memory filesystem)
+ *
+ * Files live in nativeFiles until the test erases them, so a "reboot" is a
+ * second object reopening the same paths. A test can refuse the mount with
+ * nativeFsMountFails, or simulate a full flash with nativeFsFailWrites.
+ */
+
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+typedef std::vector<uint8_t> NativeFileData;
+
+inline std::map<std::string, std::shared_ptr<NativeFileData>> nativeFiles;
+inline bool nativeFsMountFails = false;
+inline bool nativeFsFailWrites = false;
+
+inline void nativeFsErase() {
+    nativeFiles.clear();
+    nativeFsMountFails = false;
+    nativeFsFailWrites = false;
+}
+
+class File {
+public:
+    File() {}
+    File(std::shared_ptr<NativeFileData> data, size_t start) : data(data), offset(start) {}
+
+    explicit operator bool() const { return data != nullptr; }
+    size_t size() const { return data ? data->size() : 0; }
+
+    bool seek(uint32_t to) {
+        if (!data || to > data->size()) {
+            return false;
+        }
+        offset = to;
+        return true;
+    }
+
+    size_t read(uint8_t* buf, size_t len) {
+        if (!data) {
+            return 0;
+        }
+        size_t n = min(len, data->size() - offset);
+        memcpy(buf, data->data() + offset, n);
+        offset += n;
+        return n;
+    }
+
+    size_t write(const uint8_t* buf, size_t len) {
+        if (!data || nativeFsFailWrites) {
+            return 0;
+        }
+        if (offset + len > data->size()) {
+            data->resize(offset + len);
+        }
+        memcpy(data->data() + offset, buf, len);
+        offset += len;
+        return len;
+    }
+
+    size_t println(const String& line) {
+        size_t n = write((const uint8_t*)line.c_str(), line.length());
+        return n + write((const uint8_t*)"\n", 1);
+    }
+
+    void close() { data.reset(); }
+
+private:
+    std::shared_ptr<NativeFileData> data;
+    size_t offset = 0;
+};
+
+namespace fs {
+class FS {
+public:
+    bool begin(bool formatOnFail = false) { (void)formatOnFail; return !nativeFsMountFails; }
+    void end() {}
+
+    File open(const char* path, const char* mode = FILE_READ) {
+        auto it = nativeFiles.find(path);
+        if (mode[0] == 'r') {
+            return (it == nativeFiles.end()) ? File() : File(it->second, 0);
+        }
+        if (it == nativeFiles.end() || mode[0] == 'w') {
+            nativeFiles[path] = std::make_shared<NativeFileData>();
+        }
+        std::shared_ptr<NativeFileData> data = nativeFiles[path];
+        return File(data, (mode[0] == 'a') ? data->size() : 0);
+    }
+
+    bool exists(const char* path) { return nativeFiles.count(path) > 0; }
+    bool remove(const char* path) { return nativeFiles.erase(path) > 0; }
+
+    bool rename(const char* from, const char* to) {
+        auto it = nativeFiles.find(from);
+        if (it == nativeFiles.end()) {
+            return false;
+        }
+        nativeFiles[to] = it->second;
+        nativeFiles.erase(from);
+        return true;
+    }
+};
+}
+
+#endif // NATIVE_FS_H
@@ -0,0 +1,13 @@
+/**
+ * @file LittleFS.h
+ * @brief LittleFS for the native test environment (in-memory, see FS.h)
+ */
+
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+#include "FS.h"
+
+inline fs::FS LittleFS;
+
+#endif // NATIVE_LITTLEFS_H
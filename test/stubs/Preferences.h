@@ -0,0 +1,99 @@
+/**
+ * @file Preferences.h
+ * @brief In-memory NVS for the native test environment
+ *
+ * Namespaces persist across Preferences objects (and across re-created
+ * managers, which is how tests simulate a reboot) until nativeNvsErase().
+ */
+
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> NativeNvsNamespace;
+inline std::map<std::string, NativeNvsNamespace> nativeNvs;
+
+// Fails every write while set (flash full, worn out, ...)
+inline bool nativeNvsFailWrites = false;
+
+inline void nativeNvsErase() {
+    nativeNvs.clear();
+    nativeNvsFailWrites = false;
+}
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        // As on the ESP32, a read-only open of a namespace never written fails
+        if (readOnly && nativeNvs.find(name) == nativeNvs.end()) {
+            return false;
+        }
+        ns = &nativeNvs[name];
+        this->readOnly = readOnly;
+        return true;
+    }
+    void end() { ns = nullptr; }
+    
+    bool isKey(const char* key) { return ns && ns->count(key); }
+    bool remove(const char* key) { return writable() && ns->erase(key) > 0; }
+    bool clear() {
+        if (!writable()) return false;
+        ns->clear();
+        return true;
+    }
+    
+    size_t putBytes(const char* key, const void* value, size_t len) {
+        if (!writable()) return 0;
+        const uint8_t* bytes = (const uint8_t*)value;
+        (*ns)[key].assign(bytes, bytes + len);
+        return len;
+    }
+    size_t getBytesLength(const char* key) {
+        const std::vector<uint8_t>* v = find(key);
+        return v ? v->size() : 0;
+    }
+    size_t getBytes(const char* key, void* buffer, size_t maxLen) {
+        const std::vector<uint8_t>* v = find(key);
+        if (!v || v->size() > maxLen) return 0;
+        memcpy(buffer, v->data(), v->size());
+        return v->size();
+    }
+    
+    size_t putBool(const char* key, bool value) { return putValue(key, (uint8_t)value); }
+    bool getBool(const char* key, bool defaultValue = false) { return getValue<uint8_t>(key, defaultValue) != 0; }
+    size_t putUChar(const char* key, uint8_t value) { return putValue(key, value); }
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return getValue(key, defaultValue); }
+    size_t putUShort(const char* key, uint16_t value) { return putValue(key, value); }
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return getValue(key, defaultValue); }
+    size_t putUInt(const char* key, uint32_t value) { return putValue(key, value); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return getValue(key, defaultValue); }
+    size_t putInt(const char* key, int32_t value) { return putValue(key, value); }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) { return getValue(key, defaultValue); }
+    
+private:
+    NativeNvsNamespace* ns = nullptr;
+    bool readOnly = false;
+    
+    bool writable() const { return ns && !readOnly && !nativeNvsFailWrites; }
+    const std::vector<uint8_t>* find(const char* key) const {
+        if (!ns) return nullptr;
+        auto it = ns->find(key);
+        return (it == ns->end()) ? nullptr : &it->second;
+    }
+    template <typename T> size_t putValue(const char* key, T value) {
+        return putBytes(key, &value, sizeof(value));
+    }
+    template <typename T> T getValue(const char* key, T defaultValue) {
+        const std::vector<uint8_t>* v = find(key);
+        if (!v || v->size() != sizeof(T)) return defaultValue;
+        T value;
+        memcpy(&value, v->data(), sizeof(T));
+        return value;
+    }
+};
+
+#endif // NATIVE_PREFERENCES_H
@@ -0,0 +1,11 @@
+/**
+ * @file esp_random.h
+ * @brief esp_random() for the native test environment (defined in Arduino.h)
+ */
+
+#ifndef NATIVE_ESP_RANDOM_H
+#define NATIVE_ESP_RANDOM_H
+
+#include <Arduino.h>
+
+#endif // NATIVE_ESP_RANDOM_H
@@ -0,0 +1,25 @@
+/**
+ * @file semphr.h
+ * @brief Mutex API for the native test environment
+ *
+ * Tests run on one thread, so taking a mutex always succeeds.
+ */
+
+#ifndef NATIVE_SEMPHR_H
+#define NATIVE_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    static int handle;
+    return &handle;
+}
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return xSemaphoreCreateMutex(); }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t) { return pdTRUE; }
+
+#endif // NATIVE_SEMPHR_H
@@ -0,0 +1,101 @@
+/**
+ * @file ccm.h
+ * @brief Stand-in for mbedTLS CCM in the native test environment
+ *
+ * NOT AES: a keyed XOR stream plus a 64-bit FNV-1a tag over key, nonce,
+ * associated data and plaintext. It has the mbedTLS interface and the
+ * property the tests rely on: a frame only authenticates under the key,
+ * nonce and header it was sealed with.
+ */
+
+#ifndef NATIVE_MBEDTLS_CCM_H
+#define NATIVE_MBEDTLS_CCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MBEDTLS_ERR_CCM_BAD_INPUT   -0x000D
+#define MBEDTLS_ERR_CCM_AUTH_FAILED -0x000F
+
+typedef enum {
+    MBEDTLS_CIPHER_ID_AES = 2
+} mbedtls_cipher_id_t;
+
+typedef struct {
+    uint8_t key[32];
+    unsigned int keyBytes;
+} mbedtls_ccm_context;
+
+inline void mbedtls_ccm_init(mbedtls_ccm_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+inline void mbedtls_ccm_free(mbedtls_ccm_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+
+inline int mbedtls_ccm_setkey(mbedtls_ccm_context* ctx, mbedtls_cipher_id_t cipher,
+                              const unsigned char* key, unsigned int keybits) {
+    if (cipher != MBEDTLS_CIPHER_ID_AES || keybits == 0 || keybits > 256 || keybits % 8) {
+        return MBEDTLS_ERR_CCM_BAD_INPUT;
+    }
+    ctx->keyBytes = keybits / 8;
+    memcpy(ctx->key, key, ctx->keyBytes);
+    return 0;
+}
+
+inline uint64_t nativeCcmHash(uint64_t h, const unsigned char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ data[i]) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+inline uint64_t nativeCcmTag(const mbedtls_ccm_context* ctx, const unsigned char* iv, size_t ivLen,
+                             const unsigned char* add, size_t addLen,
+                             const unsigned char* plaintext, size_t length) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h = nativeCcmHash(h, ctx->key, ctx->keyBytes);
+    h = nativeCcmHash(h, iv, ivLen);
+    h = nativeCcmHash(h, add, addLen);
+    return nativeCcmHash(h, plaintext, length);
+}
+
+inline unsigned char nativeCcmStream(const mbedtls_ccm_context* ctx, const unsigned char* iv,
+                                     size_t ivLen, size_t i) {
+    return (unsigned char)(ctx->key[i % ctx->keyBytes] ^ iv[i % ivLen] ^ (i * 31));
+}
+
+inline int mbedtls_ccm_encrypt_and_tag(mbedtls_ccm_context* ctx, size_t length,
+                                       const unsigned char* iv, size_t ivLen,
+                                       const unsigned char* add, size_t addLen,
+                                       const unsigned char* input, unsigned char* output,
+                                       unsigned char* tag, size_t tagLen) {
+    if (ctx->keyBytes == 0 || tagLen > 8) {
+        return MBEDTLS_ERR_CCM_BAD_INPUT;
+    }
+    // Tag first: input and output may be the same buffer
+    uint64_t t = nativeCcmTag(ctx, iv, ivLen, add, addLen, input, length);
+    for (size_t i = 0; i < length; i++) {
+        output[i] = input[i] ^ nativeCcmStream(ctx, iv, ivLen, i);
+    }
+    memcpy(tag, &t, tagLen);
+    return 0;
+}
+
+inline int mbedtls_ccm_auth_decrypt(mbedtls_ccm_context* ctx, size_t length,
+                                    const unsigned char* iv, size_t ivLen,
+                                    const unsigned char* add, size_t addLen,
+                                    const unsigned char* input, unsigned char* output,
+                                    const unsigned char* tag, size_t tagLen) {
+    if (ctx->keyBytes == 0 || tagLen > 8) {
+        return MBEDTLS_ERR_CCM_BAD_INPUT;
+    }
+    for (size_t i = 0; i < length; i++) {
+        output[i] = input[i] ^ nativeCcmStream(ctx, iv, ivLen, i);
+    }
+    uint64_t t = nativeCcmTag(ctx, iv, ivLen, add, addLen, output, length);
+    if (memcmp(&t, tag, tagLen) != 0) {
+        memset(output, 0, length);
+        return MBEDTLS_ERR_CCM_AUTH_FAILED;
+    }
+    return 0;
+}
+
+#endif // NATIVE_MBEDTLS_CCM_H
@@ -0,0 +1,185 @@
+/**
+ * @file test_main.cpp
+ * @brief CRC-16 tables against the standard check values, a bitwise reference
+ *        and random corruption
+ *
+ * Run: pio test -e native -f test_crc16
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "crc16.h"
+
+static const uint8_t CHECK_INPUT[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+static uint32_t rngState;
+
+static uint32_t nextRandom() {
+    uint32_t x = rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rngState = x;
+    return x;
+}
+
+static void fillRandom(uint8_t* buffer, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        buffer[i] = (uint8_t)nextRandom();
+    }
+}
+
+// Bit-at-a-time references, independent of the generated tables
+static uint16_t referenceCcitt(const uint8_t* data, size_t length, uint16_t crc) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t referenceModbus(const uint8_t* data, size_t length, uint16_t crc) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x0001) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+void setUp(void) {
+    rngState = 0x5EED1234;
+}
+
+void tearDown(void) {}
+
+void test_check_values(void) {
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16Ccitt(CHECK_INPUT, sizeof(CHECK_INPUT)));
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16CcittSlice4(CHECK_INPUT, sizeof(CHECK_INPUT)));
+    TEST_ASSERT_EQUAL_HEX16(0x4B37, crc16Modbus(CHECK_INPUT, sizeof(CHECK_INPUT)));
+    TEST_ASSERT_TRUE(crc16SelfTest());
+}
+
+void test_empty_input_returns_seed(void) {
+    TEST_ASSERT_EQUAL_HEX16(CRC16_INIT, crc16Ccitt(CHECK_INPUT, 0));
+    TEST_ASSERT_EQUAL_HEX16(CRC16_INIT, crc16CcittSlice4(CHECK_INPUT, 0));
+    TEST_ASSERT_EQUAL_HEX16(CRC16_INIT, crc16Modbus(CHECK_INPUT, 0));
+    TEST_ASSERT_EQUAL_HEX16(0x1234, crc16CcittSlice4(CHECK_INPUT, 0, 0x1234));
+}
+
+// Chaining covers non-contiguous fields (e.g. header, then payload)
+void test_chained_calls_match_single_pass(void) {
+    uint8_t buffer[64];
+    fillRandom(buffer, sizeof(buffer));
+    for (size_t split = 0; split <= sizeof(buffer); split++) {
+        uint16_t whole = crc16Ccitt(buffer, sizeof(buffer));
+        TEST_ASSERT_EQUAL_HEX16(whole, crc16Ccitt(buffer + split, sizeof(buffer) - split,
+                                                  crc16Ccitt(buffer, split)));
+        TEST_ASSERT_EQUAL_HEX16(whole, crc16CcittSlice4(buffer + split, sizeof(buffer) - split,
+                                                        crc16CcittSlice4(buffer, split)));
+        TEST_ASSERT_EQUAL_HEX16(crc16Modbus(buffer, sizeof(buffer)),
+                                crc16Modbus(buffer + split, sizeof(buffer) - split,
+                                            crc16Modbus(buffer, split)));
+    }
+}
+
+// Slicing-by-4 against byte-wise and the bitwise reference: random lengths
+// (every remainder mod 4), seeds and buffer alignments
+void test_slice4_matches_bytewise_on_random_buffers(void) {
+    uint8_t storage[260];
+    for (int trial = 0; trial < 5000; trial++) {
+        size_t offset = nextRandom() % 4;
+        size_t length = nextRandom() % 256;
+        uint16_t seed = (trial % 2) ? (uint16_t)nextRandom() : CRC16_INIT;
+        uint8_t* buffer = storage + offset;
+        fillRandom(buffer, length);
+
+        uint16_t expected = referenceCcitt(buffer, length, seed);
+        TEST_ASSERT_EQUAL_HEX16(expected, crc16Ccitt(buffer, length, seed));
+        TEST_ASSERT_EQUAL_HEX16(expected, crc16CcittSlice4(buffer, length, seed));
+        TEST_ASSERT_EQUAL_HEX16(referenceModbus(buffer, length, seed), crc16Modbus(buffer, length, seed));
+    }
+}
+
+// CRC-16/CCITT guarantees: every 1-bit and 2-bit error and every burst up to
+// 16 bits in a frame this size is caught
+void test_detects_bit_errors_and_short_bursts(void) {
+    uint8_t frame[48];
+    uint8_t corrupted[sizeof(frame)];
+    fillRandom(frame, sizeof(frame));
+    const uint16_t good = crc16CcittSlice4(frame, sizeof(frame));
+    const size_t bits = sizeof(frame) * 8;
+
+    for (size_t a = 0; a < bits; a++) {
+        memcpy(corrupted, frame, sizeof(frame));
+        corrupted[a / 8] ^= (uint8_t)(0x80 >> (a % 8));
+        TEST_ASSERT_TRUE(crc16CcittSlice4(corrupted, sizeof(frame)) != good);
+
+        for (size_t b = a + 1; b < bits; b++) {
+            corrupted[b / 8] ^= (uint8_t)(0x80 >> (b % 8));
+            TEST_ASSERT_TRUE(crc16CcittSlice4(corrupted, sizeof(frame)) != good);
+            corrupted[b / 8] ^= (uint8_t)(0x80 >> (b % 8));
+        }
+    }
+
+    for (int trial = 0; trial < 20000; trial++) {
+        // Burst: first and last bit flipped, anything in between
+        size_t length = 2 + nextRandom() % 15;
+        size_t start = nextRandom() % (bits - length + 1);
+        memcpy(corrupted, frame, sizeof(frame));
+        for (size_t i = 0; i < length; i++) {
+            if (i == 0 || i == length - 1 || (nextRandom() & 1)) {
+                size_t bit = start + i;
+                corrupted[bit / 8] ^= (uint8_t)(0x80 >> (bit % 8));
+            }
+        }
+        TEST_ASSERT_TRUE(crc16CcittSlice4(corrupted, sizeof(frame)) != good);
+    }
+}
+
+// Random multi-byte corruption: a 16-bit check lets about 1 in 65536 through
+void test_random_corruption_detection_rate(void) {
+    const int trials = 200000;
+    uint8_t frame[32];
+    uint8_t corrupted[sizeof(frame)];
+    int undetected = 0;
+
+    for (int trial = 0; trial < trials; trial++) {
+        fillRandom(frame, sizeof(frame));
+        memcpy(corrupted, frame, sizeof(frame));
+        int bytes = 2 + nextRandom() % 6;
+        for (int i = 0; i < bytes; i++) {
+            corrupted[nextRandom() % sizeof(frame)] ^= (uint8_t)(1 + nextRandom() % 255);
+        }
+        if (memcmp(frame, corrupted, sizeof(frame)) == 0) {
+            continue;  // Flips cancelled out; nothing to detect
+        }
+        if (crc16CcittSlice4(corrupted, sizeof(frame)) == crc16CcittSlice4(frame, sizeof(frame))) {
+            undetected++;
+        }
+    }
+
+    char message[96];
+    snprintf(message, sizeof(message), "undetected %d of %d corrupted frames (%.4f%%)",
+             undetected, trials, undetected * 100.0 / trials);
+    TEST_MESSAGE(message);
+    // Expected ~3; allow for chance without letting a weak check pass
+    TEST_ASSERT_TRUE(undetected <= 15);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_check_values);
+    RUN_TEST(test_empty_input_returns_seed);
+    RUN_TEST(test_chained_calls_match_single_pass);
+    RUN_TEST(test_slice4_matches_bytewise_on_random_buffers);
+    RUN_TEST(test_detects_bit_errors_and_short_bursts);
+    RUN_TEST(test_random_corruption_detection_rate);
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file test_main.cpp
+ * @brief Mesh duplicate suppression: per-source sequence window
+ *
+ * Drives MeshRouter::processReceivedPacket() with data frames addressed to the
+ * node under test; it returns true only for the first copy of each frame.
+ *
+ * Run: pio test -e native -f test_mesh_seen
+ */
+
+#include <unity.h>
+#include "mesh_routing.h"
+
+#define NODE_ID 2
+
+// SEEN_PACKET_TIMEOUT_MS in mesh_routing.cpp
+#define SEEN_TIMEOUT_MS 30000
+
+static MeshRouter* router;
+
+// True if the router delivers the frame (first copy), false if suppressed
+static bool deliver(uint8_t sourceId, uint16_t seq) {
+    uint8_t frame[sizeof(MeshHeader) + 4] = {0};
+    MeshHeader* header = (MeshHeader*)frame;
+    header->packetType = MESH_DATA;
+    header->sourceId = sourceId;
+    header->destId = NODE_ID;
+    header->nextHop = NODE_ID;
+    header->prevHop = sourceId;
+    header->hopCount = 0;
+    header->ttl = MAX_HOPS;
+    header->sequenceNum = seq;
+    return router->processReceivedPacket(frame, sizeof(frame), -90, 5);
+}
+
+void setUp(void) {
+    nativeMillis = 1000;
+    router = new MeshRouter();
+    router->begin(NODE_ID);
+}
+
+void tearDown(void) {
+    delete router;
+    router = nullptr;
+}
+
+void test_first_copy_only(void) {
+    TEST_ASSERT_TRUE(deliver(3, 10));
+    TEST_ASSERT_FALSE(deliver(3, 10));
+    TEST_ASSERT_TRUE(deliver(3, 11));
+    TEST_ASSERT_FALSE(deliver(3, 11));
+    TEST_ASSERT_FALSE(deliver(3, 10));
+}
+
+void test_sources_are_independent(void) {
+    for (uint16_t seq = 1; seq <= 20; seq++) {
+        for (uint8_t source = 3; source < 40; source++) {
+            TEST_ASSERT_TRUE(deliver(source, seq));
+        }
+    }
+    for (uint8_t source = 3; source < 40; source++) {
+        TEST_ASSERT_FALSE(deliver(source, 20));
+        TEST_ASSERT_FALSE(deliver(source, 1));
+    }
+}
+
+// A relayed copy can arrive after newer frames heard directly
+void test_out_of_order_inside_bitmap(void) {
+    TEST_ASSERT_TRUE(deliver(3, 100));
+    TEST_ASSERT_TRUE(deliver(3, 99));
+    TEST_ASSERT_TRUE(deliver(3, 90));
+    TEST_ASSERT_TRUE(deliver(3, 69));      // 31 behind: last bit of the window
+    TEST_ASSERT_FALSE(deliver(3, 99));
+    TEST_ASSERT_FALSE(deliver(3, 90));
+    TEST_ASSERT_FALSE(deliver(3, 69));
+    TEST_ASSERT_TRUE(deliver(3, 95));      // Never seen, still inside
+
+    // Sliding forward keeps what was seen relative to the new newest
+    TEST_ASSERT_TRUE(deliver(3, 110));
+    TEST_ASSERT_FALSE(deliver(3, 100));
+    TEST_ASSERT_FALSE(deliver(3, 95));
+    TEST_ASSERT_TRUE(deliver(3, 96));
+}
+
+// Further back than the bitmap (but not a reboot) is taken as a late copy
+void test_out_of_order_outside_bitmap(void) {
+    TEST_ASSERT_TRUE(deliver(3, 200));
+    TEST_ASSERT_FALSE(deliver(3, 168));    // 32 behind: just outside
+    TEST_ASSERT_FALSE(deliver(3, 150));
+
+    // A jump of more than the window clears the bitmap
+    TEST_ASSERT_TRUE(deliver(3, 240));
+    TEST_ASSERT_TRUE(deliver(3, 239));
+    TEST_ASSERT_FALSE(deliver(3, 200));    // 40 behind the new newest
+}
+
+void test_sequence_wrap(void) {
+    TEST_ASSERT_TRUE(deliver(3, 0xFFFD));
+    TEST_ASSERT_TRUE(deliver(3, 0xFFFF));
+    TEST_ASSERT_TRUE(deliver(3, 0x0000));
+    TEST_ASSERT_TRUE(deliver(3, 0x0001));
+    TEST_ASSERT_FALSE(deliver(3, 0xFFFF));
+    TEST_ASSERT_FALSE(deliver(3, 0x0000));
+    TEST_ASSERT_FALSE(deliver(3, 0xFFFD));
+    TEST_ASSERT_TRUE(deliver(3, 0xFFFE));  // Gap before the wrap, still in the window
+    TEST_ASSERT_FALSE(deliver(3, 0xFFFE));
+    TEST_ASSERT_TRUE(deliver(3, 0x0002));
+}
+
+// A source that rebooted restarts its count far behind the newest we saw
+void test_restart_gap_resets_window(void) {
+    TEST_ASSERT_TRUE(deliver(3, 5000));
+    TEST_ASSERT_TRUE(deliver(3, 5001));
+
+    // Just inside the gap: still a late copy
+    TEST_ASSERT_FALSE(deliver(3, (uint16_t)(5001 - (MESH_SEEN_RESTART_GAP - 1))));
+
+    // Further behind than the gap: fresh window from the new count
+    TEST_ASSERT_TRUE(deliver(3, 1));
+    TEST_ASSERT_FALSE(deliver(3, 1));
+    TEST_ASSERT_TRUE(deliver(3, 2));
+    TEST_ASSERT_FALSE(deliver(3, 2));
+}
+
+void test_window_ages_out(void) {
+    TEST_ASSERT_TRUE(deliver(3, 10));
+    TEST_ASSERT_TRUE(deliver(4, 10));
+
+    nativeMillis += SEEN_TIMEOUT_MS;
+    TEST_ASSERT_FALSE(deliver(3, 10));     // Still inside the timeout
+    TEST_ASSERT_TRUE(deliver(4, 11));      // Keeps source 4 fresh
+
+    nativeMillis += 1;
+    router->loop();                        // Periodic cleanup runs as well
+    TEST_ASSERT_TRUE(deliver(3, 10));      // Idle source forgotten
+    TEST_ASSERT_FALSE(deliver(3, 10));
+    TEST_ASSERT_FALSE(deliver(4, 10));     // Active source keeps its window
+    TEST_ASSERT_FALSE(deliver(4, 11));
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_first_copy_only);
+    RUN_TEST(test_sources_are_independent);
+    RUN_TEST(test_out_of_order_inside_bitmap);
+    RUN_TEST(test_out_of_order_outside_bitmap);
+    RUN_TEST(test_sequence_wrap);
+    RUN_TEST(test_restart_gap_resets_window);
+    RUN_TEST(test_window_ages_out);
+    return UNITY_END();
+}
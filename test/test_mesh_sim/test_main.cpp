@@ -0,0 +1,865 @@
+/**
+ * @file test_main.cpp
+ * @brief Network simulator: mesh routers and the telemetry/command path on a simulated LoRa channel
+ *
+ * Every virtual node runs the real MeshRouter with its own millis() (nodes boot
+ * at different times) on one virtual clock. Frames handed to the transmitter
+ * hook go on a shared channel with:
+ * - links set by hand (delivery ratio, RSSI, SNR), or derived from random node
+ *   placement: log-distance path loss with log-normal shadowing, thermal noise
+ *   for the configured bandwidth, and per-frame fading against the SX126x
+ *   demodulation floor of the spreading factor
+ * - SX126x time on air for the configured modem settings
+ * - half-duplex radios (a node hears nothing while it transmits)
+ * - collisions with capture: an overlapped frame survives at a receiver if it
+ *   is SIM_CAPTURE_DB above the sum of everything else that receiver hears
+ *
+ * Above the radio the nodes run the telemetry and command path of lora_comm.cpp
+ * with the same codec and queue code (lora_comm.cpp itself needs the Radio and
+ * WiFi stacks and is not built here):
+ * - sensors build v3 frames as buildTelemetryFrameV3() does (keyframes until one
+ *   is ACKed and every V3_KEYFRAME_INTERVAL frames, deltas otherwise) and send
+ *   them to the base through their router
+ * - the base decodes them with decodeMultiSensorV3(), keeps the delta reference
+ *   and answers keyframes with a TelemetryAckPacket sent direct (not through
+ *   the mesh) after the RX hold-down, as handlePendingCommandSend() does
+ * - optionally the base queues a command for every sensor in a real
+ *   RemoteConfigManager. It goes out direct after that sensor's next reading;
+ *   the sensor checks the CRC and piggybacks the ACK on an immediate reading,
+ *   and the manager retries on its timer-wheel ACK deadline
+ *
+ * Not modelled: the AES-CCM envelope (SECURE_FRAME_OVERHEAD bytes per frame
+ * with encryption on), the TX airtime budget and regional duty-cycle limits.
+ *
+ * test_scaling_random_geometry runs MESH_SIM_SCALE_NODES node counts on random
+ * placements and prints one line per count: delivery ratio, end-to-end latency
+ * of readings, airtime spent per delivered reading, and command success.
+ * Airtime over duration is summed over all nodes, so it passes 100% once
+ * nodes out of each other's range transmit at the same time.
+ *
+ * The router has no per-hop ACK or carrier sense, so collisions and link
+ * losses compound with every hop. The delivery floors asserted below are what
+ * the current code reaches with some margin; they catch regressions, they are
+ * not targets.
+ *
+ * Run: pio test -e native -f test_mesh_sim -v
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <vector>
+#include "mesh_routing.h"
+#include "tx_scheduler.h"
+#include "remote_config.h"
+#include "timer_wheel.h"
+#include "sensor_interface.h"
+
+#ifndef MESH_SIM_NODES
+  #define MESH_SIM_NODES 8
+#endif
+
+// Node counts and length of the scaling scenarios
+#ifndef MESH_SIM_SCALE_NODES
+  #define MESH_SIM_SCALE_NODES 10, 25, 50, 100, 200
+#endif
+#ifndef MESH_SIM_SCALE_MINUTES
+  #define MESH_SIM_SCALE_MINUTES 60
+#endif
+
+// Simulation tick
+#define SIM_STEP_MS 5
+
+// A finished frame is kept this long to check later frames against it
+#define SIM_AIR_HISTORY_MS 5000
+
+// Readings are spread +/- this share of the interval; real sensors drift apart,
+// and strictly periodic senders would collide on every cycle or never
+#define SIM_READING_JITTER_PERCENT 10
+
+#define SIM_NETWORK_ID 0x2A
+
+// Base waits this long after RX before answering (BASE_RX_TO_TX_HOLDDOWN_MS in lora_comm.cpp)
+#define SIM_RX_TO_TX_HOLDDOWN_MS 120
+
+// Sensor keeps the ACK fields of a command in its telemetry this long (lora_comm.cpp)
+#define SIM_ACK_FIELDS_VALID_MS 30000
+
+// Channel model for placed nodes
+#define SIM_PATH_LOSS_1M_DB 31.2f       // Free space at 1 m, 868 MHz
+#define SIM_PATH_LOSS_EXPONENT 3.5f     // Suburban, antennas near the ground
+#define SIM_SHADOWING_SIGMA_DB 4.0f     // Per link, fixed for the run
+#define SIM_FADING_SIGMA_DB 2.0f        // Per frame
+#define SIM_NOISE_FIGURE_DB 6.0f
+#define SIM_CAPTURE_DB 6.0f
+#define SIM_RSSI_NONE -200              // Link too weak to matter, even as interference
+
+/**
+ * @brief Directional link between two nodes
+ */
+struct SimLink {
+    float deliveryRatio;        // 0 = cannot be decoded
+    int16_t rssi;               // SIM_RSSI_NONE = not heard at all
+    int8_t snr;
+};
+
+/**
+ * @brief Frame on (or recently on) the channel
+ */
+struct SimFrame {
+    uint8_t sender;             // Node index
+    uint32_t start;
+    uint32_t end;
+    bool delivered;
+    uint16_t size;
+    uint8_t data[MESH_MAX_FRAME];
+};
+
+class MeshSim;
+
+/**
+ * @brief One virtual node: router, radio and the sensor or base state above it
+ */
+struct SimNode {
+    MeshSim* sim;
+    uint8_t index;
+    uint8_t id;
+    uint32_t bootAt;            // Simulation time at which the node powers up
+    bool booted;
+    uint32_t radioBusyUntil;
+    float x;
+    float y;
+    MeshRouter router;
+
+    // Sensor side (as buildTelemetryFrameV3() and the sensor RX path)
+    uint32_t nextReadingAt;
+    float temperature;
+    float humidity;
+    uint8_t frameSeq;
+    uint8_t framesSinceKeyframe;
+    TelemetryReferenceV3 ackedRef;
+    TelemetryReferenceV3 pendingRef;
+    uint8_t lastCommandSeq;
+    uint32_t ackFieldsValidUntil;
+    uint32_t sentAtBySeq[256];      // Simulation time each frameSeq was built
+    uint32_t readingBySeq[256];     // Reading number of each frameSeq
+    uint32_t readingsSent;
+    uint32_t readingsRefused;
+    uint32_t keyframesSent;
+    uint32_t commandsApplied;
+
+    // Base side, per source
+    TelemetryReferenceV3 baseRef;
+    uint32_t delivered;
+    uint64_t latencySumMs;
+    uint32_t latencyMaxMs;
+    uint32_t commandQueuedAt;
+
+    // Channel use
+    uint32_t framesOnAir;
+    uint64_t airtimeUs;
+};
+
+static bool simTransmit(void* context, const uint8_t* frame, size_t size);
+
+// Virtual time runs on across simulations in one process: the timer wheel the
+// base's RemoteConfigManager uses must never see millis() go backwards
+static uint32_t simClock = 0;
+
+static float gaussian() {
+    const double u1 = (esp_random() + 1.0) / 4294967297.0;
+    const double u2 = esp_random() / 4294967296.0;
+    return (float)(sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+}
+
+class MeshSim {
+public:
+    explicit MeshSim(uint8_t nodeCount, bool sendCommands = false)
+        : nodeCount(nodeCount), now(simClock), start(simClock), sendCommands(sendCommands) {
+        modem.spreadingFactor = LORA_SPREADING_FACTOR;
+        modem.bandwidthHz = LORA_BANDWIDTH;
+        modem.codingRate = LORA_CODINGRATE;
+        modem.preambleLength = LORA_PREAMBLE_LENGTH;
+        modem.crcOn = true;
+        modem.implicitHeader = false;
+        noiseFloorDbm = -174.0f + 10.0f * log10f((float)LORA_BANDWIDTH) + SIM_NOISE_FIGURE_DB;
+
+        links.assign((size_t)nodeCount * nodeCount, SimLink{0.0f, SIM_RSSI_NONE, 0});
+        for (uint8_t i = 0; i < nodeCount; i++) {
+            std::unique_ptr<SimNode> node(new SimNode());
+            node->sim = this;
+            node->index = i;
+            node->id = MESH_BASE_STATION_ID + i;  // Node 0 is the base station
+            // The base's clock is the simulation clock, so it only moves forward
+            node->bootAt = (i == 0) ? 0 : start + esp_random() % NEIGHBOR_BEACON_INTERVAL_MS;
+            node->temperature = 18.0f + (esp_random() % 600) / 100.0f;
+            node->humidity = 40.0f + (esp_random() % 2000) / 100.0f;
+            nodes.push_back(std::move(node));
+        }
+
+        if (sendCommands) {
+            enterNode(*nodes[0]);
+            timerWheel.begin();
+            commands.reset(new RemoteConfigManager());
+            commands->init();
+        }
+    }
+
+    ~MeshSim() {
+        if (commands) {
+            commands->init();   // Disarms its ACK timers before it goes away
+        }
+        simClock = now;
+    }
+
+    // Symmetric link
+    void connect(uint8_t a, uint8_t b, float deliveryRatio, int16_t rssi, int8_t snr) {
+        links[a * nodeCount + b] = SimLink{deliveryRatio, rssi, snr};
+        links[b * nodeCount + a] = SimLink{deliveryRatio, rssi, snr};
+    }
+
+    /**
+     * @brief Scatter the nodes over a square with the base in the middle
+     *
+     * Each node is placed where it can decode at least one node placed before
+     * it at least half the time, so the network is connected; beyond that the
+     * geometry (and with it the hop count) is random.
+     */
+    void placeRandom(float sideM) {
+        nodes[0]->x = sideM / 2;
+        nodes[0]->y = sideM / 2;
+        for (uint8_t i = 1; i < nodeCount; i++) {
+            for (int attempt = 0; attempt < 1000; attempt++) {
+                nodes[i]->x = (esp_random() % 10000) * sideM / 10000;
+                nodes[i]->y = (esp_random() % 10000) * sideM / 10000;
+                bool reachable = false;
+                for (uint8_t j = 0; j < i && !reachable; j++) {
+                    reachable = linkFromGeometry(i, j, 0.0f).deliveryRatio >= 0.5f;
+                }
+                if (reachable) {
+                    break;
+                }
+            }
+        }
+        for (uint8_t a = 0; a < nodeCount; a++) {
+            for (uint8_t b = a + 1; b < nodeCount; b++) {
+                SimLink l = linkFromGeometry(a, b, gaussian() * SIM_SHADOWING_SIGMA_DB);
+                links[a * nodeCount + b] = l;
+                links[b * nodeCount + a] = l;
+            }
+        }
+    }
+
+    void run(uint32_t durationMs, uint32_t readingIntervalMs) {
+        const uint32_t endAt = now + durationMs;
+        while (now < endAt) {
+            now += SIM_STEP_MS;
+
+            for (auto& node : nodes) {
+                if (!node->booted && now >= node->bootAt) {
+                    node->booted = true;
+                    node->nextReadingAt = now;  // First reading right after boot
+                    enterNode(*node);
+                    node->router.setTransmitter(simTransmit, node.get());
+                    node->router.begin(node->id, node->index == 0);
+                }
+            }
+
+            deliverFinishedFrames();
+
+            for (auto& node : nodes) {
+                if (!node->booted) {
+                    continue;
+                }
+                if (node->index != 0 && readingIntervalMs > 0 && now >= node->nextReadingAt) {
+                    sendReading(*node);
+                    const uint32_t spread = readingIntervalMs * SIM_READING_JITTER_PERCENT / 100;
+                    node->nextReadingAt = now + readingIntervalMs - spread + esp_random() % (2 * spread + 1);
+                }
+                enterNode(*node);
+                node->router.loop();
+            }
+            serviceBase();
+        }
+    }
+
+    // Called from the router's transmitter hook and for the base's direct frames
+    bool transmit(SimNode& node, const uint8_t* frame, size_t size) {
+        if (node.radioBusyUntil > now || size > MESH_MAX_FRAME) {
+            return false;
+        }
+        const uint32_t airUs = loraTimeOnAirUs(modem, size);
+        SimFrame f;
+        f.sender = node.index;
+        f.start = now;
+        f.end = now + (airUs + 999) / 1000;
+        f.delivered = false;
+        f.size = size;
+        memcpy(f.data, frame, size);
+        air.push_back(f);
+
+        node.radioBusyUntil = f.end;
+        node.framesOnAir++;
+        node.airtimeUs += airUs;
+        if (isMeshFrame(frame, size) && frame[0] == MESH_DATA) {
+            dataAirtimeUs += airUs;
+        }
+        return true;
+    }
+
+    SimNode& node(uint8_t index) { return *nodes[index]; }
+    uint8_t size() const { return nodeCount; }
+
+    uint32_t collisions = 0;
+    uint32_t captures = 0;
+    uint32_t linkLosses = 0;
+    uint32_t duplicates = 0;
+    uint32_t decodeFailures = 0;
+    uint32_t hopSum = 0;
+    uint32_t commandsIssued = 0;
+    uint32_t commandsAcked = 0;
+    uint32_t commandFramesSent = 0;
+    uint64_t commandLatencySumMs = 0;
+    uint32_t telemetryAcksSent = 0;
+    uint64_t dataAirtimeUs = 0;
+    std::vector<uint32_t> latencies;
+
+    /**
+     * @brief Print per-node results
+     */
+    void report(const char* title, uint32_t durationMs) {
+        printf("\n=== Mesh simulation: %s (%u nodes, %lu s) ===\n",
+               title, nodeCount, (unsigned long)(durationMs / 1000));
+        printf("node  next hops  cost   sent  refused  keyframes  delivered  ratio  avg/max latency ms  frames  airtime %%\n");
+        for (auto& n : nodes) {
+            enterNode(*n);
+            RouteEntry* route = (n->index == 0) ? nullptr : n->router.getRoute(MESH_BASE_STATION_ID);
+            float ratio = n->readingsSent ? (float)n->delivered / n->readingsSent : 0.0f;
+            uint32_t avgLatency = n->delivered ? (uint32_t)(n->latencySumMs / n->delivered) : 0;
+            printf("%4u  %4d %4d  %5.2f  %4lu  %7lu  %9lu  %9lu  %5.2f  %7lu / %-7lu  %6lu  %8.2f\n",
+                   n->id,
+                   route ? route->nextHop : -1,
+                   route ? route->hopCount : (n->index == 0 ? 0 : -1),
+                   route ? route->cost / (float)MESH_COST_SCALE : 0.0f,
+                   (unsigned long)n->readingsSent, (unsigned long)n->readingsRefused,
+                   (unsigned long)n->keyframesSent,
+                   (unsigned long)n->delivered, ratio,
+                   (unsigned long)avgLatency, (unsigned long)n->latencyMaxMs,
+                   (unsigned long)n->framesOnAir,
+                   n->airtimeUs / 10.0 / durationMs);
+        }
+        printf("Total: %lu/%lu readings delivered (%.1f%%), %lu duplicates, %lu collisions (%lu captured), "
+               "%lu link losses, %lu keyframe ACKs, channel busy %.2f%%\n",
+               (unsigned long)delivered(), (unsigned long)sent(), deliveryRatio() * 100.0f,
+               (unsigned long)duplicates, (unsigned long)collisions, (unsigned long)captures,
+               (unsigned long)linkLosses, (unsigned long)telemetryAcksSent,
+               totalAirtimeUs() / 10.0 / durationMs);
+    }
+
+    /**
+     * @brief One line of the scaling table (header printed by the caller)
+     */
+    void reportLine(uint32_t durationMs) {
+        std::vector<uint32_t> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        const uint32_t p95 = sorted.empty() ? 0 : sorted[sorted.size() * 95 / 100];
+        uint64_t latencySum = 0;
+        for (uint32_t latency : sorted) {
+            latencySum += latency;
+        }
+        const uint32_t avg = sorted.empty() ? 0 : (uint32_t)(latencySum / sorted.size());
+        uint32_t keyframes = 0;
+        for (auto& n : nodes) {
+            keyframes += n->keyframesSent;
+        }
+        const uint64_t airtimeUs = totalAirtimeUs();
+        printf("%5u  %8.3f  %9.2f  %6lu / %-6lu  %18.0f  %6.1f  %18.1f  %10.1f  %5lu / %-5lu  %8.1f\n",
+               nodeCount, deliveryRatio(),
+               delivered() ? (float)hopSum / delivered() : 0.0f,
+               (unsigned long)avg, (unsigned long)p95,
+               delivered() ? airtimeUs / 1000.0 / delivered() : 0.0,
+               airtimeUs ? dataAirtimeUs * 100.0 / airtimeUs : 0.0,
+               airtimeUs / 10.0 / durationMs,
+               sent() ? keyframes * 100.0 / sent() : 0.0,
+               (unsigned long)commandsAcked, (unsigned long)commandsIssued,
+               commandsAcked ? commandLatencySumMs / 1000.0 / commandsAcked : 0.0);
+    }
+
+    uint32_t sent() const {
+        uint32_t total = 0;
+        for (auto& n : nodes) {
+            total += n->readingsSent;
+        }
+        return total;
+    }
+
+    uint32_t delivered() const {
+        uint32_t total = 0;
+        for (auto& n : nodes) {
+            total += n->delivered;
+        }
+        return total;
+    }
+
+    float deliveryRatio() const {
+        return sent() ? (float)delivered() / sent() : 0.0f;
+    }
+
+    uint64_t totalAirtimeUs() const {
+        uint64_t total = 0;
+        for (auto& n : nodes) {
+            total += n->airtimeUs;
+        }
+        return total;
+    }
+
+    // Point the shared millis() at this node's uptime
+    void enterNode(const SimNode& node) {
+        nativeMillis = (now >= node.bootAt) ? now - node.bootAt : 0;
+    }
+
+private:
+    uint8_t nodeCount;
+    uint32_t now;
+    uint32_t start;
+    bool sendCommands;
+    float noiseFloorDbm;
+    LoRaModemParams modem;
+    std::vector<std::unique_ptr<SimNode>> nodes;
+    std::vector<SimLink> links;
+    std::vector<SimFrame> air;
+    std::set<uint64_t> seenReadings;    // (nodeId << 32) | reading number
+
+    // Base station state above the router
+    std::unique_ptr<RemoteConfigManager> commands;
+    uint8_t nextCommandNode = 1;
+    uint8_t pendingCommandNode = 0;     // 0 = none
+    uint32_t pendingCommandAt = 0;
+    bool pendingTelemetryAck = false;
+    uint8_t pendingTelemetryAckNode = 0;
+    uint8_t pendingTelemetryAckSeq = 0;
+    uint32_t pendingTelemetryAckAt = 0;
+
+    const SimLink& link(uint8_t from, uint8_t to) const {
+        return links[from * nodeCount + to];
+    }
+
+    SimLink linkFromGeometry(uint8_t a, uint8_t b, float shadowingDb) const {
+        const float dx = nodes[a]->x - nodes[b]->x;
+        const float dy = nodes[a]->y - nodes[b]->y;
+        const float d = fmaxf(sqrtf(dx * dx + dy * dy), 1.0f);
+        const float pathLoss = SIM_PATH_LOSS_1M_DB + 10.0f * SIM_PATH_LOSS_EXPONENT * log10f(d) + shadowingDb;
+        const float rssi = TX_OUTPUT_POWER - pathLoss;
+        const float snr = rssi - noiseFloorDbm;
+
+        SimLink l;
+        // Probability that the per-frame fade leaves the SNR above the floor
+        l.deliveryRatio = 0.5f * erfcf(-(snr - MESH_SNR_FLOOR_DB) / (SIM_FADING_SIGMA_DB * sqrtf(2.0f)));
+        if (l.deliveryRatio < 0.01f) {
+            l.deliveryRatio = 0.0f;
+        }
+        l.rssi = (rssi < noiseFloorDbm - 20.0f) ? SIM_RSSI_NONE : (int16_t)lroundf(rssi);
+        l.snr = (int8_t)fmaxf(-128.0f, fminf(127.0f, roundf(snr)));
+        return l;
+    }
+
+    static bool isMeshFrame(const uint8_t* frame, size_t size) {
+        // As the RX path: no sync word starts as low as the mesh packet types
+        return size >= sizeof(MeshHeader) && frame[0] <= MESH_NEIGHBOR_BEACON;
+    }
+
+    // ------------------------------------------------------------------------
+    // Sensor
+    // ------------------------------------------------------------------------
+
+    // Build and queue a v3 reading as buildTelemetryFrameV3()/sendTelemetryFrame()
+    void sendReading(SimNode& node) {
+        enterNode(node);
+        if (node.ackFieldsValidUntil != 0 && (int32_t)(now - node.ackFieldsValidUntil) >= 0) {
+            node.lastCommandSeq = 0;
+            node.ackFieldsValidUntil = 0;
+        }
+
+        node.temperature += (int32_t)(esp_random() % 21 - 10) / 100.0f;
+        node.humidity += (int32_t)(esp_random() % 41 - 20) / 100.0f;
+        MultiSensorPacket packet;
+        memset(&packet, 0, sizeof(packet));
+        packet.header.syncWord = MULTI_SENSOR_SYNC_WORD;
+        packet.header.networkId = SIM_NETWORK_ID;
+        packet.header.sensorId = node.id;
+        packet.header.valueCount = 2;
+        packet.header.batteryPercent = 90;
+        packet.header.lastCommandSeq = node.lastCommandSeq;
+        packet.values[0].type = VALUE_TEMPERATURE;
+        packet.values[0].value = node.temperature;
+        packet.values[1].type = VALUE_HUMIDITY;
+        packet.values[1].value = node.humidity;
+
+        const uint8_t frameSeq = ++node.frameSeq;
+        bool keyframe = !node.ackedRef.valid || node.pendingRef.valid ||
+                        node.framesSinceKeyframe >= V3_KEYFRAME_INTERVAL;
+        uint8_t frame[MAX_PACKET_SIZE];
+        size_t len = 0;
+        if (!keyframe) {
+            len = encodeMultiSensorV3(&packet, frameSeq, false, &node.ackedRef, frame, sizeof(frame));
+            keyframe = !(((const MultiSensorHeaderV3*)frame)->flags & V3_FLAG_DELTA);
+        }
+        if (keyframe) {
+            len = encodeMultiSensorV3(&packet, frameSeq, true, nullptr, frame, sizeof(frame));
+            makeTelemetryReferenceV3(&packet, frameSeq, &node.pendingRef);
+            node.framesSinceKeyframe = 0;
+        } else {
+            node.framesSinceKeyframe++;
+        }
+
+        node.sentAtBySeq[frameSeq] = now;
+        node.readingBySeq[frameSeq] = node.readingsSent + node.readingsRefused;
+        if (node.router.sendPacket(MESH_BASE_STATION_ID, frame, len)) {
+            node.readingsSent++;
+            node.keyframesSent += keyframe ? 1 : 0;
+        } else {
+            node.readingsRefused++;
+        }
+    }
+
+    // Frame sent direct by the base: keyframe ACK or command (sensor RX path)
+    void sensorReceiveDirect(SimNode& node, const uint8_t* frame, size_t size) {
+        if (size == sizeof(TelemetryAckPacket)) {
+            TelemetryAckPacket ack;
+            memcpy(&ack, frame, sizeof(ack));
+            if (ack.syncWord == MULTI_SENSOR_SYNC_WORD && ack.packetType == PACKET_ACK &&
+                ack.networkId == SIM_NETWORK_ID && ack.sensorId == node.id &&
+                ack.checksum == calculateTelemetryAckChecksum(&ack)) {
+                if (node.pendingRef.valid && node.pendingRef.frameSeq == ack.frameSeq) {
+                    node.ackedRef = node.pendingRef;
+                    node.pendingRef.valid = false;
+                }
+                return;
+            }
+        }
+
+        CommandPacket cmd;
+        if (!commands || !commands->parseCommandFrame(frame, size, cmd) || cmd.targetSensorId != node.id) {
+            return;
+        }
+        if (cmd.checksum != commands->calculateChecksum(frame, size - sizeof(uint16_t))) {
+            return;
+        }
+        // ACK it with a reading right away
+        node.lastCommandSeq = cmd.sequenceNumber;
+        node.ackFieldsValidUntil = now + SIM_ACK_FIELDS_VALID_MS;
+        node.nextReadingAt = now;
+        node.commandsApplied++;
+    }
+
+    // ------------------------------------------------------------------------
+    // Base station
+    // ------------------------------------------------------------------------
+
+    // Telemetry delivered by the base's router (processTelemetryFrame())
+    void baseReceiveTelemetry(const uint8_t* payload, size_t size, uint8_t hops) {
+        const MultiSensorHeaderV3* hdr = (const MultiSensorHeaderV3*)payload;
+        if (size < sizeof(MultiSensorHeaderV3) + sizeof(uint16_t) || hdr->syncWord != MULTI_SENSOR_SYNC_WORD ||
+            hdr->packetType != PACKET_MULTI_SENSOR_V3 || hdr->networkId != SIM_NETWORK_ID ||
+            hdr->sensorId <= MESH_BASE_STATION_ID || hdr->sensorId >= MESH_BASE_STATION_ID + nodeCount) {
+            decodeFailures++;
+            return;
+        }
+        SimNode& source = *nodes[hdr->sensorId - MESH_BASE_STATION_ID];
+
+        MultiSensorPacket received;
+        uint8_t frameSeq = 0;
+        uint8_t flags = 0;
+        bool refMissing = false;
+        if (!decodeMultiSensorV3(payload, size, source.baseRef.valid ? &source.baseRef : nullptr,
+                                 &received, &frameSeq, &flags, &refMissing)) {
+            decodeFailures++;
+            return;
+        }
+        if (flags & V3_FLAG_ACK_REQ) {
+            makeTelemetryReferenceV3(&received, frameSeq, &source.baseRef);
+            pendingTelemetryAck = true;
+            pendingTelemetryAckNode = source.index;
+            pendingTelemetryAckSeq = frameSeq;
+            pendingTelemetryAckAt = now + SIM_RX_TO_TX_HOLDDOWN_MS;
+        }
+
+        const uint64_t key = ((uint64_t)source.id << 32) | source.readingBySeq[frameSeq];
+        if (!seenReadings.insert(key).second) {
+            duplicates++;
+        } else {
+            const uint32_t latency = now - source.sentAtBySeq[frameSeq];
+            source.delivered++;
+            source.latencySumMs += latency;
+            source.latencyMaxMs = max(source.latencyMaxMs, latency);
+            latencies.push_back(latency);
+            hopSum += hops;
+        }
+
+        if (!commands) {
+            return;
+        }
+        if (received.header.lastCommandSeq != 0) {
+            const uint8_t before = commands->getQueuedCount(source.id);
+            commands->handleAck(source.id, received.header.lastCommandSeq, received.header.ackStatus);
+            if (commands->getQueuedCount(source.id) < before) {
+                commandsAcked++;
+                commandLatencySumMs += now - source.commandQueuedAt;
+            }
+        }
+        if (commands->getQueuedCount(source.id) > 0 && pendingCommandNode == 0) {
+            pendingCommandNode = source.index;
+            pendingCommandAt = now + SIM_RX_TO_TX_HOLDDOWN_MS;
+        }
+    }
+
+    // Queue commands, send the due command or keyframe ACK (handlePendingCommandSend())
+    void serviceBase() {
+        SimNode& base = *nodes[0];
+        enterNode(base);
+        if (commands) {
+            timerWheel.runDue();
+            // The store holds a few sensors at a time; top it up as commands complete
+            while (nextCommandNode < nodeCount && nodes[nextCommandNode]->booted) {
+                const uint8_t data[2] = { 0x2C, 0x01 };    // SET_INTERVAL 300 s (unchanged)
+                if (!commands->queueCommand(nodes[nextCommandNode]->id, CMD_SET_INTERVAL, data, sizeof(data))) {
+                    break;
+                }
+                nodes[nextCommandNode]->commandQueuedAt = now;
+                commandsIssued++;
+                nextCommandNode++;
+            }
+        }
+        if (base.radioBusyUntil > now) {
+            return;
+        }
+
+        if (pendingCommandNode != 0 && now >= pendingCommandAt) {
+            const uint8_t sensorId = nodes[pendingCommandNode]->id;
+            pendingCommandNode = 0;
+            pendingTelemetryAck = false;    // The command takes the sensor's RX window
+            CommandPacket cmd;
+            uint8_t frame[sizeof(CommandPacket)];
+            if (commands->peekPendingCommand(sensorId, cmd)) {
+                size_t size = commands->encodeCommandFrame(cmd, frame, sizeof(frame));
+                if (size > 0 && commands->getPendingCommand(sensorId, cmd) && transmit(base, frame, size)) {
+                    commandFramesSent++;
+                }
+            }
+            return;
+        }
+
+        if (pendingTelemetryAck && now >= pendingTelemetryAckAt) {
+            pendingTelemetryAck = false;
+            TelemetryAckPacket ack;
+            ack.syncWord = MULTI_SENSOR_SYNC_WORD;
+            ack.networkId = SIM_NETWORK_ID;
+            ack.packetType = PACKET_ACK;
+            ack.sensorId = nodes[pendingTelemetryAckNode]->id;
+            ack.frameSeq = pendingTelemetryAckSeq;
+            ack.checksum = calculateTelemetryAckChecksum(&ack);
+            if (transmit(base, (const uint8_t*)&ack, sizeof(ack))) {
+                telemetryAcksSent++;
+            }
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Channel
+    // ------------------------------------------------------------------------
+
+    // A frame is lost at a receiver that was transmitting while it was on air,
+    // or when it is not SIM_CAPTURE_DB above the sum of the overlapping frames
+    bool collided(const SimFrame& f, uint8_t receiver) {
+        double interferenceMw = 0.0;
+        for (const auto& g : air) {
+            if (&g == &f || g.end <= f.start || g.start >= f.end) {
+                continue;
+            }
+            if (g.sender == receiver) {
+                return true;
+            }
+            const SimLink& gl = link(g.sender, receiver);
+            if (gl.rssi != SIM_RSSI_NONE) {
+                interferenceMw += pow(10.0, gl.rssi / 10.0);
+            }
+        }
+        if (interferenceMw == 0.0) {
+            return false;
+        }
+        if (link(f.sender, receiver).rssi - 10.0 * log10(interferenceMw) >= SIM_CAPTURE_DB) {
+            captures++;
+            return false;
+        }
+        return true;
+    }
+
+    void deliverFinishedFrames() {
+        for (auto& f : air) {
+            if (f.delivered || f.end > now) {
+                continue;
+            }
+            f.delivered = true;
+
+            for (uint8_t r = 0; r < nodeCount; r++) {
+                const SimLink& l = link(f.sender, r);
+                if (r == f.sender || l.deliveryRatio <= 0.0f || !nodes[r]->booted) {
+                    continue;
+                }
+                if (collided(f, r)) {
+                    collisions++;
+                    continue;
+                }
+                if ((esp_random() % 10000) >= (uint32_t)(l.deliveryRatio * 10000)) {
+                    linkLosses++;
+                    continue;
+                }
+                receive(*nodes[r], f, l);
+            }
+        }
+
+        air.erase(std::remove_if(air.begin(), air.end(), [this](const SimFrame& f) {
+            return f.delivered && now - f.end > SIM_AIR_HISTORY_MS;
+        }), air.end());
+    }
+
+    void receive(SimNode& node, const SimFrame& f, const SimLink& l) {
+        enterNode(node);
+        if (!isMeshFrame(f.data, f.size)) {
+            if (node.index != 0) {
+                sensorReceiveDirect(node, f.data, f.size);
+            }
+            return;
+        }
+
+        uint8_t buffer[MESH_MAX_FRAME];
+        memcpy(buffer, f.data, f.size);
+        if (!node.router.processReceivedPacket(buffer, f.size, l.rssi, l.snr) || node.index != 0) {
+            return;
+        }
+        const MeshHeader* header = (const MeshHeader*)f.data;
+        baseReceiveTelemetry(f.data + sizeof(MeshHeader), f.size - sizeof(MeshHeader), header->hopCount + 1);
+    }
+};
+
+static bool simTransmit(void* context, const uint8_t* frame, size_t size) {
+    SimNode* node = (SimNode*)context;
+    return node->sim->transmit(*node, frame, size);
+}
+
+void setUp(void) {
+    nativeRandomSeed(0xC0FFEE);
+    nativeMillis = 0;
+}
+
+void tearDown(void) {}
+
+/**
+ * Nodes in a line, each hearing only its neighbours: every reading has to be
+ * relayed by all nodes between the sensor and the base (as far as TTL allows).
+ */
+void test_line_topology_multi_hop(void) {
+    const uint8_t count = (MESH_SIM_NODES < MAX_HOPS + 1) ? MESH_SIM_NODES : MAX_HOPS + 1;
+    const uint32_t duration = 30UL * 60 * 1000;
+    MeshSim sim(count);
+    for (uint8_t i = 0; i + 1 < count; i++) {
+        sim.connect(i, i + 1, 1.0f, -95, 5);
+    }
+
+    sim.run(duration, 60000);
+    sim.report("line", duration);
+
+    for (uint8_t i = 1; i < count; i++) {
+        sim.enterNode(sim.node(i));
+        RouteEntry* route = sim.node(i).router.getRoute(MESH_BASE_STATION_ID);
+        TEST_ASSERT_NOT_NULL(route);
+        TEST_ASSERT_EQUAL_UINT8(MESH_BASE_STATION_ID + i - 1, route->nextHop);
+        TEST_ASSERT_EQUAL_UINT8(i, route->hopCount);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, sim.duplicates);
+    TEST_ASSERT_EQUAL_UINT32(0, sim.decodeFailures);
+    TEST_ASSERT_TRUE(sim.deliveryRatio() >= 0.7f);
+
+    // Keyframe ACKs are sent direct, so only the base's neighbour gets to send deltas
+    TEST_ASSERT_TRUE(sim.node(1).keyframesSent < sim.node(1).readingsSent);
+    if (count > 2) {
+        TEST_ASSERT_EQUAL_UINT32(sim.node(2).readingsSent, sim.node(2).keyframesSent);
+    }
+}
+
+/**
+ * Nodes on a grid three wide with the base in a corner. Orthogonal neighbours
+ * have good links, diagonal ones are weak and lossy, so routing has to pick
+ * cheap paths rather than fewest hops.
+ */
+void test_grid_topology_lossy_links(void) {
+    const uint8_t count = MESH_SIM_NODES;
+    const uint8_t cols = 3;
+    const uint32_t duration = 60UL * 60 * 1000;
+    MeshSim sim(count);
+    for (uint8_t a = 0; a < count; a++) {
+        for (uint8_t b = a + 1; b < count; b++) {
+            int dx = abs((int)(a % cols) - (int)(b % cols));
+            int dy = abs((int)(a / cols) - (int)(b / cols));
+            if (dx + dy == 1) {
+                sim.connect(a, b, 0.9f, -100, 0);
+            } else if (dx == 1 && dy == 1) {
+                sim.connect(a, b, 0.5f, -118, -13);
+            }
+        }
+    }
+
+    sim.run(duration, 120000);
+    sim.report("grid", duration);
+
+    for (uint8_t i = 1; i < count; i++) {
+        sim.enterNode(sim.node(i));
+        TEST_ASSERT_NOT_NULL(sim.node(i).router.getRoute(MESH_BASE_STATION_ID));
+    }
+    // The base's diagonal neighbour goes over two good links, not the weak one
+    if (count > cols + 1) {
+        sim.enterNode(sim.node(cols + 1));
+        TEST_ASSERT_TRUE(sim.node(cols + 1).router.getRoute(MESH_BASE_STATION_ID)->nextHop != MESH_BASE_STATION_ID);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, sim.duplicates);
+    TEST_ASSERT_EQUAL_UINT32(0, sim.decodeFailures);
+    TEST_ASSERT_TRUE(sim.deliveryRatio() >= 0.5f);
+}
+
+/**
+ * Random placement over a 6 km square (about two to three hops from the edge
+ * to the base at SF10), every sensor reporting every 5 minutes and one
+ * command queued for each. One report line per node count.
+ */
+void test_scaling_random_geometry(void) {
+    static const uint8_t counts[] = { MESH_SIM_SCALE_NODES };
+    const uint32_t duration = MESH_SIM_SCALE_MINUTES * 60UL * 1000;
+
+    printf("\n=== Mesh simulation: random geometry, 6 km square, SF%d, readings every 300 s, %d min ===\n",
+           LORA_SPREADING_FACTOR, MESH_SIM_SCALE_MINUTES);
+    printf("nodes  delivery  avg hops  latency avg/p95 ms  airtime/reading ms  data %%  airtime/duration %%  keyframe %%  "
+           "cmds acked/issued  cmd latency s\n");
+    for (uint8_t count : counts) {
+        MeshSim sim(count, true);
+        sim.placeRandom(6000.0f);
+        sim.run(duration, 300000);
+        sim.reportLine(duration);
+
+        TEST_ASSERT_EQUAL_UINT32(0, sim.duplicates);
+        TEST_ASSERT_EQUAL_UINT32(0, sim.decodeFailures);
+        TEST_ASSERT_TRUE(sim.deliveryRatio() > 0.0f);
+        TEST_ASSERT_TRUE(sim.commandsAcked > 0);
+    }
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_line_topology_multi_hop);
+    RUN_TEST(test_grid_topology_lossy_links);
+    RUN_TEST(test_scaling_random_geometry);
+    return UNITY_END();
+}
@@ -0,0 +1,264 @@
+/**
+ * @file test_main.cpp
+ * @brief MQTT outbound queue: RAM ring, drop-oldest and the LittleFS journal
+ *
+ * LittleFS is the in-memory stub (test/stubs/FS.h); a restart is a second
+ * queue loading the journal the first one left behind.
+ *
+ * Run: pio test -e native -f test_mqtt_queue
+ */
+
+#include <unity.h>
+#include "mqtt_queue.h"
+#include <LittleFS.h>
+
+#define PAYLOAD_LEN 100
+#define RECORD_SIZE (sizeof(MQTTRecordHeader) + 6 + PAYLOAD_LEN)     // Topic "t/NNNN"
+#define RING_RECORDS (MQTT_QUEUE_BYTES / RECORD_SIZE)
+
+static MQTTQueue* queue;
+
+static bool pushMessage(MQTTQueue& q, int id, size_t payloadLen = PAYLOAD_LEN) {
+    char topic[16];
+    char payload[MQTT_PAYLOAD_MAX + 1];
+    snprintf(topic, sizeof(topic), "t/%04d", id);
+    memset(payload, 'a' + id % 26, payloadLen);
+    payload[payloadLen] = '\0';
+    return q.push(topic, payload, false);
+}
+
+// Peeks the next record, checks it is message id with payloadLen bytes, pops it
+static void expectMessage(MQTTQueue& q, int id, size_t payloadLen = PAYLOAD_LEN) {
+    uint16_t size;
+    const uint8_t* record = q.peek(size);
+    TEST_ASSERT_NOT_NULL(record);
+    const MQTTRecordHeader* header = (const MQTTRecordHeader*)record;
+    TEST_ASSERT_EQUAL(sizeof(MQTTRecordHeader) + header->topicLen + header->payloadLen, size);
+
+    char topic[16];
+    snprintf(topic, sizeof(topic), "t/%04d", id);
+    TEST_ASSERT_EQUAL(strlen(topic), header->topicLen);
+    TEST_ASSERT_EQUAL_MEMORY(topic, record + sizeof(MQTTRecordHeader), header->topicLen);
+    TEST_ASSERT_EQUAL(payloadLen, header->payloadLen);
+    const uint8_t* payload = record + sizeof(MQTTRecordHeader) + header->topicLen;
+    for (size_t i = 0; i < payloadLen; i++) {
+        TEST_ASSERT_EQUAL('a' + id % 26, payload[i]);
+    }
+    q.pop(true);
+}
+
+static MQTTQueueStats stats(MQTTQueue& q) {
+    MQTTQueueStats out;
+    memset(&out, 0, sizeof(out));
+    q.getStats(out);
+    return out;
+}
+
+void setUp(void) {
+    nativeFsErase();
+    nativeMillis = 0;
+    queue = new MQTTQueue();
+}
+
+void tearDown(void) {
+    delete queue;
+    queue = nullptr;
+}
+
+// Records of varying size straddle the end of the ring many times over
+void test_ring_wrap(void) {
+    nativeFsMountFails = true;
+    queue->begin();
+
+    int next = 0;
+    int expected = 0;
+    for (int round = 0; round < 300; round++) {
+        for (int i = 0; i < 3; i++) {
+            TEST_ASSERT_TRUE(pushMessage(*queue, next, (next * 37) % MQTT_PAYLOAD_MAX));
+            next++;
+        }
+        for (int i = 0; i < 3; i++) {
+            expectMessage(*queue, expected, (expected * 37) % MQTT_PAYLOAD_MAX);
+            expected++;
+        }
+    }
+    queue->endBatch();
+
+    MQTTQueueStats s = stats(*queue);
+    TEST_ASSERT_TRUE(queue->empty());
+    TEST_ASSERT_EQUAL(0, s.ramBytes);
+    TEST_ASSERT_EQUAL(900, s.enqueued);
+    TEST_ASSERT_EQUAL(0, s.dropped);
+    TEST_ASSERT_TRUE(s.ramHighWater > 0);
+    uint16_t size;
+    TEST_ASSERT_NULL(queue->peek(size));
+}
+
+// With nowhere to spill, a full ring gives up its oldest messages and counts them
+void test_full_ring_drops_oldest(void) {
+    nativeFsMountFails = true;
+    queue->begin();
+
+    const int total = RING_RECORDS + 29;
+    for (int id = 0; id < total; id++) {
+        TEST_ASSERT_TRUE(pushMessage(*queue, id));
+    }
+    MQTTQueueStats s = stats(*queue);
+    TEST_ASSERT_EQUAL(total, s.enqueued);
+    TEST_ASSERT_EQUAL(29, s.dropped);
+    TEST_ASSERT_EQUAL(RING_RECORDS, s.depth);
+    TEST_ASSERT_EQUAL(RING_RECORDS * RECORD_SIZE, s.ramBytes);
+
+    for (int id = 29; id < total; id++) {
+        expectMessage(*queue, id);
+    }
+    queue->endBatch();
+    TEST_ASSERT_TRUE(queue->empty());
+
+    // Too large to queue at all
+    TEST_ASSERT_FALSE(pushMessage(*queue, 0, MQTT_PAYLOAD_MAX + 1));
+    TEST_ASSERT_FALSE(queue->push("", "x", false));
+    queue->countDropped();
+    TEST_ASSERT_EQUAL(32, stats(*queue).dropped);
+}
+
+// The record being published is evicted by a producer: it still goes out, the
+// pop must not take the next record with it, and it is only counted as dropped
+// if it is never sent
+void test_evicted_while_sending(void) {
+    nativeFsMountFails = true;
+    queue->begin();
+    for (int id = 0; id < (int)RING_RECORDS; id++) {
+        TEST_ASSERT_TRUE(pushMessage(*queue, id));
+    }
+
+    uint16_t size;
+    TEST_ASSERT_NOT_NULL(queue->peek(size));
+    TEST_ASSERT_TRUE(pushMessage(*queue, 1000));        // Evicts message 0
+    queue->pop(true);
+    queue->endBatch();
+    TEST_ASSERT_EQUAL(0, stats(*queue).dropped);
+    TEST_ASSERT_EQUAL(RING_RECORDS, stats(*queue).depth);
+
+    TEST_ASSERT_NOT_NULL(queue->peek(size));            // Message 1
+    TEST_ASSERT_TRUE(pushMessage(*queue, 1001));        // Evicts it
+    queue->endBatch();                                  // Broker went away before the pop
+    TEST_ASSERT_EQUAL(1, stats(*queue).dropped);
+
+    for (int id = 2; id < (int)RING_RECORDS; id++) {
+        expectMessage(*queue, id);
+    }
+    expectMessage(*queue, 1000);
+    expectMessage(*queue, 1001);
+    queue->endBatch();
+    TEST_ASSERT_TRUE(queue->empty());
+}
+
+// Spilled messages go out before the newer ones still in RAM
+void test_spill_keeps_order(void) {
+    queue->begin();
+    const int total = RING_RECORDS * 3 / 4;
+    for (int id = 0; id < total; id++) {
+        TEST_ASSERT_TRUE(pushMessage(*queue, id));
+    }
+    queue->spill();
+
+    MQTTQueueStats s = stats(*queue);
+    TEST_ASSERT_TRUE(s.spilled > 0);
+    TEST_ASSERT_EQUAL(s.spilled, s.spillMessages);
+    TEST_ASSERT_EQUAL(s.spilled * RECORD_SIZE, s.spillBytes);
+    TEST_ASSERT_TRUE(s.ramBytes <= MQTT_QUEUE_BYTES * MQTT_SPILL_PERCENT / 200);
+    TEST_ASSERT_EQUAL(total, s.depth);
+
+    for (int id = 0; id < total; id++) {
+        expectMessage(*queue, id);
+    }
+    queue->endBatch();
+
+    s = stats(*queue);
+    TEST_ASSERT_TRUE(queue->empty());
+    TEST_ASSERT_EQUAL(s.spilled, s.replayed);
+    TEST_ASSERT_FALSE(LittleFS.exists(MQTT_JOURNAL_PATH));
+}
+
+// Journal left by the previous boot is replayed in order; a torn last record
+// (power lost mid-write) is trimmed off
+void test_journal_replay_after_restart(void) {
+    queue->begin();
+    const int total = RING_RECORDS * 3 / 4;
+    for (int id = 0; id < total; id++) {
+        TEST_ASSERT_TRUE(pushMessage(*queue, id));
+    }
+    queue->spill();
+    const uint32_t spilled = stats(*queue).spilled;
+    TEST_ASSERT_TRUE(spilled > 0);
+
+    File f = LittleFS.open(MQTT_JOURNAL_PATH, FILE_APPEND);
+    const uint8_t torn[5] = { 0x10, 0x00, 0x00, 0x00, 0x40 };
+    f.write(torn, sizeof(torn));
+    f.close();
+
+    // Restart: RAM is gone, the journal is not
+    nativeMillis = 60000;
+    MQTTQueue* rebooted = new MQTTQueue();
+    rebooted->begin();
+    MQTTQueueStats s = stats(*rebooted);
+    TEST_ASSERT_EQUAL(spilled, s.depth);
+    TEST_ASSERT_EQUAL(spilled, s.spillMessages);
+    TEST_ASSERT_EQUAL(spilled * RECORD_SIZE, s.spillBytes);
+    File trimmed = LittleFS.open(MQTT_JOURNAL_PATH, FILE_READ);
+    TEST_ASSERT_EQUAL(spilled * RECORD_SIZE, trimmed.size());
+    trimmed.close();
+
+    // New messages queue behind the replay
+    TEST_ASSERT_TRUE(pushMessage(*rebooted, 500));
+    for (uint32_t id = 0; id < spilled; id++) {
+        expectMessage(*rebooted, id);
+    }
+    expectMessage(*rebooted, 500);
+    rebooted->endBatch();
+
+    s = stats(*rebooted);
+    TEST_ASSERT_TRUE(rebooted->empty());
+    TEST_ASSERT_EQUAL(spilled, s.replayed);
+    TEST_ASSERT_EQUAL(0, s.dropped);
+    TEST_ASSERT_FALSE(LittleFS.exists(MQTT_JOURNAL_PATH));
+    delete rebooted;
+}
+
+// A failed journal write leaves the ring as it was
+void test_failed_spill_keeps_messages(void) {
+    queue->begin();
+    const int total = RING_RECORDS * 3 / 4;
+    for (int id = 0; id < total; id++) {
+        TEST_ASSERT_TRUE(pushMessage(*queue, id));
+    }
+    nativeFsFailWrites = true;
+    queue->spill();
+    nativeFsFailWrites = false;
+
+    MQTTQueueStats s = stats(*queue);
+    TEST_ASSERT_EQUAL(0, s.spilled);
+    TEST_ASSERT_EQUAL(total, s.ramMessages);
+
+    queue->spill();
+    TEST_ASSERT_TRUE(stats(*queue).spilled > 0);
+    for (int id = 0; id < total; id++) {
+        expectMessage(*queue, id);
+    }
+    queue->endBatch();
+    TEST_ASSERT_TRUE(queue->empty());
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_wrap);
+    RUN_TEST(test_full_ring_drops_oldest);
+    RUN_TEST(test_evicted_while_sending);
+    RUN_TEST(test_spill_keeps_order);
+    RUN_TEST(test_journal_replay_after_restart);
+    RUN_TEST(test_failed_spill_keeps_messages);
+    return UNITY_END();
+}
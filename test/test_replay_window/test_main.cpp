@@ -0,0 +1,257 @@
+/**
+ * @file test_main.cpp
+ * @brief Per-sender anti-replay window in SecurityManager
+ *
+ * Frames are sealed here with the manager's key (test/stubs/mbedtls/ccm.h
+ * stands in for AES-CCM) and go through decryptPacket(), so the window is
+ * exercised exactly as on the RX path. NVS is the in-memory Preferences stub;
+ * a reboot is a second manager loading from it.
+ *
+ * Run: pio test -e native -f test_replay_window
+ */
+
+#include <unity.h>
+#include <vector>
+#include "security.h"
+#include <Preferences.h>
+
+#define NETWORK_ID 0x2A
+
+static SecurityManager* security;
+
+// Seal a 4-byte frame from sender/sequence under key, as a sensor would
+static uint16_t sealFrame(EncryptedPacket& packet, uint8_t sender, uint32_t sequence, const uint8_t* key) {
+    static const uint8_t plaintext[4] = { 't', 'e', 's', 't' };
+    memset(&packet, 0, sizeof(packet));
+    packet.packetType = ENCRYPTED_PACKET_TYPE;
+    packet.sensorId = sender;
+    packet.networkId = NETWORK_ID;
+    packet.sequenceNumber = sequence;
+    packet.length = sizeof(plaintext);
+
+    // Nonce as SecurityManager::buildNonce(): sender, network, sequence, zero fill
+    uint8_t nonce[SECURE_NONCE_SIZE] = {0};
+    memcpy(nonce, (const uint8_t*)&packet + 1, 7);
+
+    mbedtls_ccm_context ccm;
+    mbedtls_ccm_init(&ccm);
+    mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, LORA_AES_KEY_SIZE * 8);
+    mbedtls_ccm_encrypt_and_tag(&ccm, sizeof(plaintext), nonce, SECURE_NONCE_SIZE,
+                                (const uint8_t*)&packet, SECURE_AAD_SIZE,
+                                plaintext, packet.payload, packet.tag, HMAC_SIZE);
+    mbedtls_ccm_free(&ccm);
+    return SECURE_FRAME_OVERHEAD + sizeof(plaintext);
+}
+
+// True if the manager accepts the frame
+static bool receive(SecurityManager& manager, uint8_t sender, uint32_t sequence) {
+    uint8_t key[LORA_AES_KEY_SIZE];
+    manager.getKey(key);
+    EncryptedPacket packet;
+    uint16_t size = sealFrame(packet, sender, sequence, key);
+    uint8_t plaintext[16];
+    return manager.decryptPacket(&packet, size, plaintext, sizeof(plaintext)) == 4;
+}
+
+static bool receive(uint8_t sender, uint32_t sequence) {
+    return receive(*security, sender, sequence);
+}
+
+void setUp(void) {
+    nativeNvsErase();
+    nativeRandomSeed(0xBADC0DE);
+    security = new SecurityManager();
+    security->setEncryptionEnabled(true);
+}
+
+void tearDown(void) {
+    delete security;
+    security = nullptr;
+}
+
+void test_sequence_zero_is_never_valid(void) {
+    TEST_ASSERT_FALSE(receive(3, 0));
+    TEST_ASSERT_TRUE(receive(3, 1));
+}
+
+// Many senders interleaved, each slightly out of order: every frame is
+// accepted once and every repeat is rejected
+void test_interleaved_senders(void) {
+    const int senders = 200;
+    const uint32_t frames = 150;
+    std::vector<std::vector<uint32_t>> order(senders + 1);
+    for (int s = 1; s <= senders; s++) {
+        for (uint32_t seq = 1; seq <= frames; seq++) {
+            order[s].push_back(seq);
+        }
+        // Local reordering within the window (relayed copies arriving late);
+        // each frame moves at most once and at most 32 places, so none ends up
+        // 64 or more behind the newest
+        for (uint32_t i = 0; i + 1 < frames; i++) {
+            uint32_t j = i + 1 + esp_random() % 32;
+            if (j < frames && (esp_random() % 4) == 0 &&
+                order[s][i] == i + 1 && order[s][j] == j + 1) {
+                std::swap(order[s][i], order[s][j]);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < frames; i++) {
+        for (int s = 1; s <= senders; s++) {
+            TEST_ASSERT_TRUE(receive(s, order[s][i]));
+        }
+    }
+    for (int s = 1; s <= senders; s++) {
+        TEST_ASSERT_FALSE(receive(s, frames));
+        TEST_ASSERT_FALSE(receive(s, frames - 63));
+    }
+
+    // One sender racing ahead does not affect anyone else
+    TEST_ASSERT_TRUE(receive(1, 1000000));
+    for (int s = 2; s <= senders; s++) {
+        TEST_ASSERT_TRUE(receive(s, frames + 1));
+    }
+}
+
+void test_window_shift(void) {
+    for (uint32_t seq = 1; seq <= 10; seq++) {
+        TEST_ASSERT_TRUE(receive(3, seq));
+    }
+
+    // Shift by less than the window keeps the history
+    TEST_ASSERT_TRUE(receive(3, 40));
+    TEST_ASSERT_FALSE(receive(3, 10));
+    TEST_ASSERT_TRUE(receive(3, 11));
+    TEST_ASSERT_TRUE(receive(3, 39));
+
+    // Shift by the full window clears it; only the last 64 numbers can pass
+    TEST_ASSERT_TRUE(receive(3, 40 + REPLAY_WINDOW_SIZE));
+    TEST_ASSERT_FALSE(receive(3, 40));
+    TEST_ASSERT_TRUE(receive(3, 41));
+    TEST_ASSERT_FALSE(receive(3, 41));
+}
+
+void test_window_edge_63_64(void) {
+    TEST_ASSERT_TRUE(receive(3, 1000));
+    TEST_ASSERT_TRUE(receive(3, 1000 - (REPLAY_WINDOW_SIZE - 1)));   // Offset 63: oldest slot
+    TEST_ASSERT_FALSE(receive(3, 1000 - (REPLAY_WINDOW_SIZE - 1)));
+    TEST_ASSERT_FALSE(receive(3, 1000 - REPLAY_WINDOW_SIZE));        // Offset 64: stale
+
+    // A shift of 63 moves the newest frame to the oldest slot, still remembered
+    TEST_ASSERT_TRUE(receive(4, 500));
+    TEST_ASSERT_TRUE(receive(4, 500 + (REPLAY_WINDOW_SIZE - 1)));
+    TEST_ASSERT_FALSE(receive(4, 500));
+
+    // A shift of 64 drops it off the end
+    TEST_ASSERT_TRUE(receive(5, 500));
+    TEST_ASSERT_TRUE(receive(5, 500 + REPLAY_WINDOW_SIZE));
+    TEST_ASSERT_FALSE(receive(5, 500));
+    TEST_ASSERT_TRUE(receive(5, 501));
+}
+
+// A frame that fails authentication must not move the window
+void test_forged_frame_does_not_move_window(void) {
+    TEST_ASSERT_TRUE(receive(3, 100));
+
+    uint8_t key[LORA_AES_KEY_SIZE];
+    security->getKey(key);
+    EncryptedPacket packet;
+    uint16_t size = sealFrame(packet, 3, 100000, key);
+    packet.tag[0] ^= 0x01;
+    uint8_t plaintext[16];
+    TEST_ASSERT_EQUAL(0, security->decryptPacket(&packet, size, plaintext, sizeof(plaintext)));
+
+    TEST_ASSERT_TRUE(receive(3, 99));
+    TEST_ASSERT_TRUE(receive(3, 101));
+}
+
+// After a reboot everything at or below the checkpoint counts as seen
+void test_checkpoint_restore(void) {
+    TEST_ASSERT_TRUE(receive(5, 1000));
+    TEST_ASSERT_TRUE(receive(6, 20));
+    TEST_ASSERT_TRUE(receive(6, 18));
+
+    // A failed flash write is retried by the next checkpoint
+    nativeNvsFailWrites = true;
+    TEST_ASSERT_FALSE(security->checkpointReplayWindows());
+    nativeNvsFailWrites = false;
+    TEST_ASSERT_TRUE(security->checkpointReplayWindows());
+
+    // Managers are not destroyed after begin(): it links a node into the timer wheel
+    static SecurityManager rebooted;
+    rebooted.begin();
+    TEST_ASSERT_TRUE(rebooted.isEncryptionEnabled());
+
+    TEST_ASSERT_FALSE(receive(rebooted, 5, 1000));
+    TEST_ASSERT_FALSE(receive(rebooted, 5, 999));   // Never received, but at or below the checkpoint
+    TEST_ASSERT_TRUE(receive(rebooted, 5, 1001));
+    TEST_ASSERT_FALSE(receive(rebooted, 6, 19));
+    TEST_ASSERT_TRUE(receive(rebooted, 6, 21));
+    TEST_ASSERT_TRUE(receive(rebooted, 7, 1));      // Unknown sender starts fresh
+}
+
+// A sensor replaced under the same ID starts again at 1; resetting its window
+// lets it in without touching anyone else, and the reset is on flash at once
+void test_reset_one_sender(void) {
+    TEST_ASSERT_TRUE(receive(3, 500));
+    TEST_ASSERT_TRUE(receive(4, 500));
+    TEST_ASSERT_TRUE(security->checkpointReplayWindows());
+    TEST_ASSERT_FALSE(receive(3, 1));
+
+    TEST_ASSERT_TRUE(security->resetReplayWindow(3));
+    TEST_ASSERT_TRUE(receive(3, 1));
+    TEST_ASSERT_FALSE(receive(3, 1));
+    TEST_ASSERT_FALSE(receive(4, 1));
+
+    static SecurityManager rebooted;
+    rebooted.begin();
+    TEST_ASSERT_TRUE(receive(rebooted, 3, 1));
+    TEST_ASSERT_FALSE(receive(rebooted, 4, 500));
+
+    // Pairing a sensor through the whitelist resets it as well
+    TEST_ASSERT_TRUE(receive(5, 900));
+    TEST_ASSERT_TRUE(security->addToWhitelist(5));
+    TEST_ASSERT_TRUE(receive(5, 1));
+}
+
+// Frames under the old key no longer authenticate, so a new key starts
+// every window over; setting the same key again keeps them
+void test_key_change_resets_windows(void) {
+    TEST_ASSERT_TRUE(receive(3, 500));
+    TEST_ASSERT_TRUE(receive(4, 7));
+
+    uint8_t key[LORA_AES_KEY_SIZE];
+    security->getKey(key);
+    security->setKey(key);
+    TEST_ASSERT_FALSE(receive(3, 500));
+    TEST_ASSERT_FALSE(receive(3, 1));
+
+    uint8_t oldKey[LORA_AES_KEY_SIZE];
+    memcpy(oldKey, key, sizeof(key));
+    key[0] ^= 0xFF;
+    security->setKey(key);
+    TEST_ASSERT_TRUE(receive(3, 1));
+    TEST_ASSERT_TRUE(receive(4, 1));
+    TEST_ASSERT_FALSE(receive(3, 1));
+
+    // A frame sealed under the old key is rejected outright
+    EncryptedPacket packet;
+    uint16_t size = sealFrame(packet, 5, 1, oldKey);
+    uint8_t plaintext[16];
+    TEST_ASSERT_EQUAL(0, security->decryptPacket(&packet, size, plaintext, sizeof(plaintext)));
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_sequence_zero_is_never_valid);
+    RUN_TEST(test_interleaved_senders);
+    RUN_TEST(test_window_shift);
+    RUN_TEST(test_window_edge_63_64);
+    RUN_TEST(test_forged_frame_does_not_move_window);
+    RUN_TEST(test_checkpoint_restore);
+    RUN_TEST(test_reset_one_sender);
+    RUN_TEST(test_key_change_resets_windows);
+    return UNITY_END();
+}
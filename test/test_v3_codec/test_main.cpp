@@ -0,0 +1,115 @@
+/**
+ * @file test_main.cpp
+ * @brief Compact v3 telemetry: keyframe/delta round trips and range edges
+ *
+ * Run: pio test -e native -f test_v3_codec
+ */
+
+#include <unity.h>
+#include <math.h>
+#include "data_types.h"
+#include "sensor_interface.h"
+
+static MultiSensorPacket packet;
+static uint8_t frame[MAX_PACKET_SIZE];
+
+static void setValues(float temperature, float gas) {
+    packet.header.valueCount = 2;
+    packet.values[0].type = VALUE_TEMPERATURE;
+    packet.values[0].value = temperature;
+    packet.values[1].type = VALUE_GAS_RESISTANCE;
+    packet.values[1].value = gas;
+}
+
+static bool decode(size_t len, const TelemetryReferenceV3* ref, MultiSensorPacket* decoded, uint8_t* flags) {
+    uint8_t frameSeq;
+    bool refMissing;
+    return decodeMultiSensorV3(frame, len, ref, decoded, &frameSeq, flags, &refMissing);
+}
+
+void setUp(void) {
+    memset(&packet, 0, sizeof(packet));
+    packet.header.syncWord = MULTI_SENSOR_SYNC_WORD;
+    packet.header.sensorId = 7;
+    packet.header.batteryPercent = 80;
+}
+
+void tearDown(void) {}
+
+void test_keyframe_and_delta_round_trip(void) {
+    setValues(21.37f, 120000.0f);
+    TelemetryReferenceV3 ref;
+    makeTelemetryReferenceV3(&packet, 1, &ref);
+
+    setValues(21.42f, 119000.0f);
+    size_t len = encodeMultiSensorV3(&packet, 2, false, &ref, frame, sizeof(frame));
+    TEST_ASSERT_TRUE(len > 0);
+
+    MultiSensorPacket decoded;
+    uint8_t flags;
+    TEST_ASSERT_TRUE(decode(len, &ref, &decoded, &flags));
+    TEST_ASSERT_TRUE(flags & V3_FLAG_DELTA);
+    TEST_ASSERT_EQUAL(2, decoded.header.valueCount);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 21.42f, decoded.values[0].value);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 119000.0f, decoded.values[1].value);
+}
+
+// Readings at opposite ends of the int32 range: the difference does not fit
+// a delta, so the encoder sends absolute values instead
+void test_saturated_difference_falls_back_to_keyframe(void) {
+    setValues(20.0f, -3.0e9f);
+    TelemetryReferenceV3 ref;
+    makeTelemetryReferenceV3(&packet, 1, &ref);
+    TEST_ASSERT_EQUAL_INT32(INT32_MIN, ref.quantized[1]);
+
+    setValues(20.0f, 3.0e9f);
+    size_t len = encodeMultiSensorV3(&packet, 2, false, &ref, frame, sizeof(frame));
+    TEST_ASSERT_TRUE(len > 0);
+
+    MultiSensorPacket decoded;
+    uint8_t flags;
+    TEST_ASSERT_TRUE(decode(len, nullptr, &decoded, &flags));
+    TEST_ASSERT_FALSE(flags & V3_FLAG_DELTA);
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, quantizeSensorValue(VALUE_GAS_RESISTANCE, decoded.values[1].value));
+}
+
+// A delta that overflows the reference it is applied to is rejected
+void test_decoder_rejects_overflowing_delta(void) {
+    setValues(20.0f, 0.0f);
+    TelemetryReferenceV3 ref;
+    makeTelemetryReferenceV3(&packet, 1, &ref);
+
+    setValues(20.0f, 3.0e9f);
+    size_t len = encodeMultiSensorV3(&packet, 2, false, &ref, frame, sizeof(frame));
+    MultiSensorPacket decoded;
+    uint8_t flags;
+    TEST_ASSERT_TRUE(decode(len, &ref, &decoded, &flags));
+    TEST_ASSERT_TRUE(flags & V3_FLAG_DELTA);
+
+    // Same frameSeq, different values: delta + reference leaves the int32 range
+    ref.quantized[1] = 1000;
+    TEST_ASSERT_FALSE(decode(len, &ref, &decoded, &flags));
+}
+
+void test_nan_is_sent_as_no_reading(void) {
+    TEST_ASSERT_EQUAL_INT32(quantizeSensorValue(VALUE_TEMPERATURE, SENSOR_NO_READING),
+                            quantizeSensorValue(VALUE_TEMPERATURE, NAN));
+
+    setValues(NAN, 1000.0f);
+    size_t len = encodeMultiSensorV3(&packet, 1, true, nullptr, frame, sizeof(frame));
+    MultiSensorPacket decoded;
+    uint8_t flags;
+    TEST_ASSERT_TRUE(decode(len, nullptr, &decoded, &flags));
+    TEST_ASSERT_EQUAL_FLOAT(SENSOR_NO_READING, decoded.values[0].value);
+}
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_keyframe_and_delta_round_trip);
+    RUN_TEST(test_saturated_difference_falls_back_to_keyframe);
+    RUN_TEST(test_decoder_rejects_overflowing_delta);
+    RUN_TEST(test_nan_is_sent_as_no_reading);
+    return UNITY_END();
+}